@@ -3,6 +3,7 @@
 #endif
 
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <unistd.h>
@@ -16,9 +17,14 @@
 #include <ctype.h>
 #include <pthread.h>
 #include <time.h>
+#include <math.h>
+#include <errno.h>
 
 #include "module.h"
 #include "device.h"
+#include "page.h"
+#include "hist.h"
+#include "trace.h"
 
 #ifdef USE_LEGACY_RANDOM
 #pragma message "Disable linux kernel supported random generator"
@@ -37,12 +43,70 @@
 #define SEC_TO_NS (1000000000L)
 #define NS_PER_MS (1000000L)
 #define DEVICE_PATH_SIZE (PAGE_SIZE)
+#define MAX_IO_SIZES (16) /**< maximum entries of the I/O size distribution */
+#define SIZE_LIST_SIZE (256)
+#define TRACE_MAGIC "FTLTRACE" /**< header of the binary trace */
+#define TRACE_MAGIC_SIZE (8)
+#define TRACE_LINE_SIZE (256)
+#define CRC32_NR_LOCKS (256) /**< stripes of the blocks' crc32 locks */
 
 enum {
 	WRITE = 0,
 	READ,
 	RAND_WRITE,
 	RAND_READ,
+	MIXED,
+	REPLAY,
+};
+
+/**
+ * @brief operations of the trace record
+ */
+enum {
+	TRACE_READ = 0,
+	TRACE_WRITE,
+};
+
+/**
+ * @brief record of the replayed trace
+ *
+ * @note
+ * The binary trace is the `TRACE_MAGIC` followed by these records (native
+ * endian). The text trace has a record per line:
+ * `<timestamp(s)> <R|W> <offset(bytes)> <length(bytes)> [stream]`.
+ */
+struct trace_record {
+	uint64_t timestamp; /**< issue time from the first record (ns) */
+	uint64_t offset;
+	uint32_t length;
+	uint16_t stream; /**< records of the same stream are issued in order */
+	uint8_t op;
+	uint8_t reserved;
+};
+
+/**
+ * @brief per-interval samples of the running workload
+ */
+struct timeseries {
+	FILE *fp;
+	bool is_json;
+	size_t nr_samples;
+	struct hist prev; /**< merged latency at the previous sample */
+	struct hist cur; /**< merged latency at the current sample */
+	struct hist diff; /**< latency recorded during the interval */
+	size_t prev_bytes;
+	uint64_t prev_erase;
+	uint64_t prev_copy;
+	uint64_t prev_time; /**< time from the start (ns) */
+};
+
+/**
+ * @brief block distributions of the mixed workload
+ */
+enum {
+	DIST_UNIFORM = 0,
+	DIST_ZIPF,
+	DIST_HOTCOLD,
 };
 
 static const char *module_str[] = {
@@ -58,7 +122,14 @@ static const char *device_str[] = {
 };
 
 static const char *workload_str[] = {
-	"write", "read", "randwrite", "randread", NULL,
+	"write", "read", "randwrite", "randread", "mixed", "replay", NULL,
+};
+
+static const char *dist_str[] = {
+	"uniform",
+	"zipf",
+	"hotcold",
+	NULL,
 };
 
 static const int module_list[] = {
@@ -80,6 +151,19 @@ struct benchmark_parameter {
 
 	size_t block_sz;
 	size_t nr_blocks;
+	size_t nr_passes; /**< steady-state: each job repeats the blocks this */
+	size_t nr_ios; /**< number of I/Os of each job */
+
+	int read_ratio; /**< percentage of the reads in the mixed workload */
+	int dist_idx;
+	double zipf_theta;
+	double zipf_zetan, zipf_eta, zipf_alpha; /**< zipf generator constants */
+	double hot_ratio; /**< percentage of the hot blocks */
+	double hot_access_ratio; /**< percentage of accesses to the hot blocks */
+	size_t io_sizes[MAX_IO_SIZES]; /**< I/O size distribution (bytes) */
+	int io_size_weights[MAX_IO_SIZES];
+	int nr_io_sizes;
+	int total_io_size_weight;
 
 	char device_path[DEVICE_PATH_SIZE];
 
@@ -88,12 +172,41 @@ struct benchmark_parameter {
 
 	uint32_t *crc32_list;
 	bool *crc32_is_match;
+	size_t crc32_unit; /**< granularity of the mixed workload's data (bytes) */
+	uint64_t *unit_seeds; /**< data of each unit is made from its seed */
+	pthread_mutex_t *crc32_locks; /**< orders the I/O and its crc32 */
 
 	off_t *offset_sequence;
 	gint thread_id_allocator;
 	size_t *wp;
 	size_t *total_time;
-	GList **timer_list;
+	struct hist *latency; /**< per-thread latency histogram (ns) */
+	struct hist *read_latency; /**< reads of the mixed workload only */
+	size_t *io_bytes; /**< transferred bytes of each job */
+
+	int nr_namespaces; /**< namespace 0 runs the workload, others are noisy */
+	struct flash_device **namespaces;
+	pthread_t *noisy_threads;
+	size_t *noisy_writes;
+	gint noisy_id_allocator;
+	gint is_noisy_exit;
+
+	bool is_gc_paced; /**< garbage collection is paced by the host writes */
+	bool is_numa_local; /**< jobs prefer the buses on their NUMA node */
+
+	char trace_path[DEVICE_PATH_SIZE];
+	bool is_timed_replay; /**< follow the timestamps (default: AFAP) */
+	struct trace_record *trace;
+	size_t nr_records;
+	size_t max_record_length;
+	struct timespec replay_start, replay_end;
+	gint nr_finished_jobs; /**< jobs which finished the workload */
+	struct page_ftl_stat base_stat; /**< ftl counters before the workload */
+
+	char timeseries_path[DEVICE_PATH_SIZE];
+	size_t sample_interval; /**< time-series sampling interval (ms) */
+	struct timeseries *timeseries; /**< NULL when the path isn't given */
+	char tracepoint_path[DEVICE_PATH_SIZE]; /**< dump of the tracepoints */
 };
 
 static void make_sequence(struct benchmark_parameter *);
@@ -108,17 +221,50 @@ static void fill_buffer_random(char *buffer, size_t block_sz);
 #endif
 static void *alloc_buffer(size_t block_sz);
 static void free_buffer(void *buffer);
+static void lock_blocks(struct benchmark_parameter *parm, size_t first,
+			size_t nr_blocks);
+static void unlock_blocks(struct benchmark_parameter *parm, size_t first,
+			  size_t nr_blocks);
+static size_t get_gcd(size_t a, size_t b);
+static void fill_buffer_units(struct benchmark_parameter *parm,
+			      unsigned char *buffer, size_t io_size,
+			      off_t offset, uint64_t *state);
+static void update_crc(struct benchmark_parameter *parm,
+		       unsigned char *scratch, const unsigned char *buffer,
+		       size_t io_size, off_t offset);
+static void check_crc(struct benchmark_parameter *parm,
+		      unsigned char *scratch, const unsigned char *buffer,
+		      size_t io_size, off_t offset);
 
 static void *write_data(void *);
 static void *read_data(void *);
+static void *mixed_data(void *);
+static void *noisy_write_data(void *);
+static void *replay_data(void *);
 
 static void report_result(struct benchmark_parameter *parm);
+static void report_wear(struct benchmark_parameter *parm);
+static void report_latency(struct benchmark_parameter *parm);
+static void set_gc_pacing(struct benchmark_parameter *parm,
+			  struct flash_device *flash);
+static void set_local_node(struct benchmark_parameter *parm,
+			   struct flash_device *flash);
+static void report_noisy(struct benchmark_parameter *parm, size_t runtime);
+static int load_trace(struct benchmark_parameter *parm);
+static void get_ftl_stat(struct benchmark_parameter *parm,
+			 struct page_ftl_stat *stat);
+static void report_stat(struct benchmark_parameter *parm);
+static void report_replay(struct benchmark_parameter *parm);
+static int open_timeseries(struct benchmark_parameter *parm);
+static void write_sample(struct benchmark_parameter *parm, uint64_t elapsed);
+static void close_timeseries(struct benchmark_parameter *parm);
 
 int main(int argc, char **argv)
 {
 	struct flash_device *flash;
 	struct benchmark_parameter *parm;
 	char *path = NULL;
+	struct timespec start, end, next;
 
 	int module, device;
 
@@ -132,23 +278,37 @@ int main(int argc, char **argv)
 	device = device_list[parm->device_idx];
 	path = parm->device_path;
 
-	g_assert(module_init(module, &flash, (uint64_t)device) == 0);
-	g_assert(flash->f_op->open(flash, path, O_CREAT | O_RDWR) == 0);
+	if (parm->nr_namespaces > 1) {
+		g_assert(module_init_partitions(module, parm->namespaces,
+						(size_t)parm->nr_namespaces,
+						(uint64_t)device) == 0);
+		for (idx = 0; idx < (size_t)parm->nr_namespaces; idx++) {
+			struct flash_device *ns = parm->namespaces[idx];
+			g_assert(ns->f_op->open(ns, path, O_CREAT | O_RDWR) ==
+				 0);
+			set_gc_pacing(parm, ns);
+		}
+		flash = parm->namespaces[0];
+	} else {
+		g_assert(module_init(module, &flash, (uint64_t)device) == 0);
+		g_assert(flash->f_op->open(flash, path, O_CREAT | O_RDWR) == 0);
+		set_gc_pacing(parm, flash);
+	}
 	parm->flash = flash;
 
 	/* running part */
 	print_parameters(parm);
 	if (DO_WARM_UP || parm->workload_idx == RAND_READ ||
-	    parm->workload_idx == READ) {
+	    parm->workload_idx == READ || parm->workload_idx == MIXED ||
+	    parm->workload_idx == REPLAY) {
 		printf("fill data start!\n");
+		parm->nr_ios = parm->nr_blocks; /**< fill the blocks only once */
 		write_data(parm);
+		parm->nr_ios = parm->nr_blocks * parm->nr_passes;
 		for (idx = 0; idx < (size_t)parm->nr_jobs; idx++) {
-			if (!parm->timer_list[idx]) {
-				continue;
-			}
-			g_list_free(parm->timer_list[idx]);
-			parm->timer_list[idx] = NULL;
+			hist_reset(&parm->latency[idx]);
 			parm->wp[idx] = 0;
+			parm->io_bytes[idx] = 0;
 		}
 		printf("ready to read!\n");
 	}
@@ -166,6 +326,30 @@ int main(int argc, char **argv)
 		pthread_func = read_data;
 	}
 
+	if (parm->workload_idx == MIXED) {
+		pthread_func = mixed_data;
+	}
+
+	if (parm->workload_idx == REPLAY) {
+		pthread_func = replay_data;
+	}
+
+	get_ftl_stat(parm, &parm->base_stat);
+	if (strlen(parm->timeseries_path) > 0) {
+		g_assert(open_timeseries(parm) == 0);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	parm->replay_start = start;
+	next = start;
+	g_atomic_int_set(&parm->nr_finished_jobs, 0);
+	g_atomic_int_set(&parm->is_noisy_exit, 0);
+	g_atomic_int_set(&parm->noisy_id_allocator, 1);
+	for (idx = 1; idx < (size_t)parm->nr_namespaces; idx++) {
+		g_assert(pthread_create(&parm->noisy_threads[idx], NULL,
+					noisy_write_data, (void *)parm) == 0);
+	}
+
 	g_atomic_int_set(&parm->thread_id_allocator, 0);
 	for (idx = 0; idx < (size_t)parm->nr_jobs; idx++) {
 		int thread_id;
@@ -176,7 +360,7 @@ int main(int argc, char **argv)
 
 	do {
 		size_t total_time = 0;
-		wp = INT32_MAX;
+		wp = SIZE_MAX;
 		for (idx = 0; idx < (size_t)parm->nr_jobs; idx++) {
 			if (wp < parm->wp[idx]) {
 				continue;
@@ -189,8 +373,18 @@ int main(int argc, char **argv)
 		       ((double)wp * (double)parm->block_sz) /
 			       (((double)total_time / (NS_PER_MS * 1000L)) *
 				(0x1 << 20)));*/
-		sleep(1);
-	} while (wp < parm->nr_blocks - 1);
+		next.tv_sec += (time_t)(parm->sample_interval / 1000);
+		next.tv_nsec +=
+			(long)(parm->sample_interval % 1000) * NS_PER_MS;
+		if (next.tv_nsec >= SEC_TO_NS) {
+			next.tv_sec += 1;
+			next.tv_nsec -= SEC_TO_NS;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		write_sample(parm, (uint64_t)((next.tv_sec - start.tv_sec) *
+						      SEC_TO_NS +
+					      (next.tv_nsec - start.tv_nsec)));
+	} while (g_atomic_int_get(&parm->nr_finished_jobs) < parm->nr_jobs);
 	printf("\n");
 
 	for (idx = 0; idx < (size_t)parm->nr_jobs; idx++) {
@@ -198,12 +392,40 @@ int main(int argc, char **argv)
 		pthread_join(parm->threads[idx], (void **)&status);
 		printf("finish thread %zu\n", idx);
 	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	write_sample(parm, (uint64_t)((end.tv_sec - start.tv_sec) * SEC_TO_NS +
+				      (end.tv_nsec - start.tv_nsec)));
+	close_timeseries(parm);
+	if (strlen(parm->tracepoint_path) > 0 &&
+	    trace_dump(parm->tracepoint_path)) {
+		printf("cannot dump the tracepoints (%s)\n",
+		       parm->tracepoint_path);
+	}
+
+	g_atomic_int_set(&parm->is_noisy_exit, 1);
+	for (idx = 1; idx < (size_t)parm->nr_namespaces; idx++) {
+		pthread_join(parm->noisy_threads[idx], NULL);
+	}
 
 	report_result(parm);
+	report_latency(parm);
+	report_wear(parm);
+	report_stat(parm);
+	report_noisy(parm, (size_t)((end.tv_sec - start.tv_sec) * SEC_TO_NS +
+				    (end.tv_nsec - start.tv_nsec)));
+	report_replay(parm);
 
 	/* deallocate the crc32 list */
-	g_assert(flash->f_op->close(flash) == 0);
-	g_assert(module_exit(flash) == 0);
+	if (parm->nr_namespaces > 1) {
+		for (idx = 0; idx < (size_t)parm->nr_namespaces; idx++) {
+			struct flash_device *ns = parm->namespaces[idx];
+			g_assert(ns->f_op->close(ns) == 0);
+			g_assert(module_exit(ns) == 0);
+		}
+	} else {
+		g_assert(flash->f_op->close(flash) == 0);
+		g_assert(module_exit(flash) == 0);
+	}
 	print_parameters(parm);
 	free_parameters(parm);
 
@@ -230,7 +452,7 @@ static void help_message(struct benchmark_parameter *parm, char **argv)
 	char *device_path = parm->device_path;
 
 	fprintf(stderr,
-		"%s -m <module name> -d <device name> -t <workload> -j <# of jobs> -b <block size(bytes)> -n <# of blocks> -p <device path>\n",
+		"%s -m <module name> -d <device name> -t <workload> -j <# of jobs> -b <block size(bytes)> -n <# of blocks> -p <device path> -N <# of namespaces> [-P] -r <read ratio> -D <distribution> -s <I/O sizes> -S <# of passes> -T <trace path> [-F] -I <interval(ms)> -o <time-series path> -R <tracepoint path> [-L]\n",
 		argv[0]);
 	fprintf(stderr, "\t- modules     [");
 	print_list(stderr, module_str);
@@ -246,6 +468,29 @@ static void help_message(struct benchmark_parameter *parm, char **argv)
 	fprintf(stderr, "\t- # of block  (default: %zu)\n", nr_blocks);
 	fprintf(stderr, "\t- path        (default: %s)\n",
 		strlen(device_path) > 0 ? device_path : NULL);
+	fprintf(stderr,
+		"\t- namespaces  (default: 1, others run the noisy random write)\n");
+	fprintf(stderr, "\t- gc pacing   (default: disabled, -P enables)\n");
+	fprintf(stderr, "\t- read ratio  (default: 70, mixed workload only)\n");
+	fprintf(stderr, "\t- distrib.    [");
+	print_list(stderr, dist_str);
+	fprintf(stderr,
+		"] (default: uniform, zipf[:theta], hotcold[:hot%%:access%%])\n");
+	fprintf(stderr,
+		"\t- I/O sizes   (default: block size, e.g. 512:20,4k:70,16k:10)\n");
+	fprintf(stderr, "\t- # of passes (default: 1, steady-state overwrites)\n");
+	fprintf(stderr,
+		"\t- trace path  (replay workload, text or binary trace)\n");
+	fprintf(stderr,
+		"\t- timed       (default: as fast as possible, -F follows timestamps)\n");
+	fprintf(stderr,
+		"\t- interval    (default: 1000, time-series sampling)\n");
+	fprintf(stderr,
+		"\t- time-series (default: none, *.json for JSON, CSV otherwise)\n");
+	fprintf(stderr,
+		"\t- tracepoint  (default: none, needs the USE_TRACE build)\n");
+	fprintf(stderr,
+		"\t- numa local  (default: disabled, -L makes the jobs prefer the buses on their node)\n");
 }
 
 static void processing_parameters_error(char ch)
@@ -258,6 +503,15 @@ static void processing_parameters_error(char ch)
 	case 'n':
 	case 'b':
 	case 'p':
+	case 'N':
+	case 'r':
+	case 'D':
+	case 's':
+	case 'S':
+	case 'T':
+	case 'I':
+	case 'o':
+	case 'R':
 		fprintf(stderr, "option -%c requires an arguments\n", ch);
 		break;
 	default:
@@ -331,6 +585,235 @@ static void shuffling(off_t *sequence, size_t nr_blocks)
 	}
 }
 
+static int parse_distribution(struct benchmark_parameter *parm,
+			      const char *arg)
+{
+	char name[SIZE_LIST_SIZE];
+	const char *sep;
+	size_t len;
+
+	sep = strchr(arg, ':');
+	len = sep ? (size_t)(sep - arg) : strlen(arg);
+	if (len >= sizeof(name)) {
+		return -1;
+	}
+	memcpy(name, arg, len);
+	name[len] = '\0';
+
+	for (parm->dist_idx = 0; dist_str[parm->dist_idx] != NULL;
+	     parm->dist_idx++) {
+		if (!strcmp(name, dist_str[parm->dist_idx])) {
+			break;
+		}
+	}
+	switch (parm->dist_idx) {
+	case DIST_UNIFORM:
+		return 0;
+	case DIST_ZIPF:
+		if (sep) {
+			parm->zipf_theta = atof(sep + 1);
+		}
+		return (parm->zipf_theta > 0 && parm->zipf_theta < 1) ? 0 : -1;
+	case DIST_HOTCOLD:
+		if (sep && sscanf(sep + 1, "%lf:%lf", &parm->hot_ratio,
+				  &parm->hot_access_ratio) != 2) {
+			return -1;
+		}
+		return (parm->hot_ratio > 0 && parm->hot_ratio < 100 &&
+			parm->hot_access_ratio >= 0 &&
+			parm->hot_access_ratio <= 100) ?
+			       0 :
+			       -1;
+	default:
+		return -1;
+	}
+}
+
+static int parse_io_sizes(struct benchmark_parameter *parm, const char *arg)
+{
+	char list[SIZE_LIST_SIZE];
+	char *token, *saveptr;
+
+	strncpy(list, arg, sizeof(list) - 1);
+	list[sizeof(list) - 1] = '\0';
+
+	parm->nr_io_sizes = 0;
+	parm->total_io_size_weight = 0;
+	for (token = strtok_r(list, ",", &saveptr); token != NULL;
+	     token = strtok_r(NULL, ",", &saveptr)) {
+		char *weight = strchr(token, ':');
+		size_t io_size;
+		int nr_weight = 1;
+
+		if (parm->nr_io_sizes == MAX_IO_SIZES) {
+			return -1;
+		}
+		if (weight) {
+			*weight = '\0';
+			nr_weight = atoi(weight + 1);
+		}
+		io_size = (size_t)atoi(token) * get_size_from_character(token);
+		if (io_size == 0 || nr_weight <= 0) {
+			return -1;
+		}
+		parm->io_sizes[parm->nr_io_sizes] = io_size;
+		parm->io_size_weights[parm->nr_io_sizes] = nr_weight;
+		parm->total_io_size_weight += nr_weight;
+		parm->nr_io_sizes++;
+	}
+	return parm->nr_io_sizes > 0 ? 0 : -1;
+}
+
+/**
+ * @brief initialize the zipfian generator (Gray et al., SIGMOD '94)
+ */
+static void init_zipf(struct benchmark_parameter *parm)
+{
+	double theta = parm->zipf_theta;
+	double n = (double)parm->nr_blocks;
+	double zeta2 = 1.0 + pow(0.5, theta);
+	size_t idx;
+
+	parm->zipf_zetan = 0;
+	for (idx = 1; idx <= parm->nr_blocks; idx++) {
+		parm->zipf_zetan += 1.0 / pow((double)idx, theta);
+	}
+	parm->zipf_alpha = 1.0 / (1.0 - theta);
+	parm->zipf_eta = (1.0 - pow(2.0 / n, 1.0 - theta)) /
+			 (1.0 - zeta2 / parm->zipf_zetan);
+}
+
+/**
+ * @brief append the record to the trace
+ *
+ * @return 0 for success, -1 for fail
+ */
+static int append_record(struct benchmark_parameter *parm,
+			 const struct trace_record *record, size_t *capacity)
+{
+	if (parm->nr_records == *capacity) {
+		struct trace_record *trace;
+		*capacity = *capacity ? *capacity * 2 : 1024;
+		trace = (struct trace_record *)realloc(
+			parm->trace, *capacity * sizeof(struct trace_record));
+		if (trace == NULL) {
+			return -1;
+		}
+		parm->trace = trace;
+	}
+	parm->trace[parm->nr_records++] = *record;
+	parm->max_record_length =
+		MAX(parm->max_record_length, (size_t)record->length);
+	return 0;
+}
+
+/**
+ * @brief parse the line of the text trace
+ *
+ * @return 1 for the record, 0 for the skipped line, -1 for the invalid line
+ */
+static int parse_record(const char *line, struct trace_record *record)
+{
+	double timestamp;
+	char op[16];
+	uint64_t offset;
+	unsigned int length, stream = 0;
+	int nr_fields;
+
+	while (isspace(*line)) {
+		line++;
+	}
+	if (*line == '\0' || *line == '#') {
+		return 0;
+	}
+	nr_fields = sscanf(line, "%lf %15s %" SCNu64 " %u %u", &timestamp, op,
+			   &offset, &length, &stream);
+	if (nr_fields < 4 || timestamp < 0) {
+		return -1;
+	}
+	memset(record, 0, sizeof(struct trace_record));
+	switch (toupper(op[0])) {
+	case 'R':
+		record->op = TRACE_READ;
+		break;
+	case 'W':
+		record->op = TRACE_WRITE;
+		break;
+	default:
+		return 0; /**< trim, flush and so on are not replayed */
+	}
+	record->timestamp = (uint64_t)(timestamp * (double)SEC_TO_NS);
+	record->offset = offset;
+	record->length = (uint32_t)length;
+	record->stream = (uint16_t)stream;
+	return length > 0 ? 1 : 0;
+}
+
+/**
+ * @brief load the whole trace into the memory
+ *
+ * @return 0 for success, -1 for fail
+ *
+ * @note
+ * The timestamps are rebased to the first record. The records are issued in
+ * the file order, so the trace must be sorted by the timestamp.
+ */
+static int load_trace(struct benchmark_parameter *parm)
+{
+	char magic[TRACE_MAGIC_SIZE];
+	char line[TRACE_LINE_SIZE];
+	struct trace_record record;
+	size_t capacity = 0, lineno = 0, idx;
+	uint64_t base;
+	FILE *fp;
+	int ret = 0;
+
+	fp = fopen(parm->trace_path, "rb");
+	if (fp == NULL) {
+		return -1;
+	}
+	if (fread(magic, 1, TRACE_MAGIC_SIZE, fp) == TRACE_MAGIC_SIZE &&
+	    !memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE)) {
+		while (ret == 0 && fread(&record, sizeof(record), 1, fp) == 1) {
+			if ((record.op != TRACE_READ &&
+			     record.op != TRACE_WRITE) ||
+			    record.length == 0) {
+				continue;
+			}
+			ret = append_record(parm, &record, &capacity);
+		}
+	} else {
+		rewind(fp);
+		while (ret == 0 && fgets(line, sizeof(line), fp) != NULL) {
+			lineno++;
+			switch (parse_record(line, &record)) {
+			case 1:
+				ret = append_record(parm, &record, &capacity);
+				break;
+			case 0:
+				break;
+			default:
+				fprintf(stderr, "invalid trace line %zu: %s",
+					lineno, line);
+				ret = -1;
+				break;
+			}
+		}
+	}
+	fclose(fp);
+	if (ret || parm->nr_records == 0) {
+		return -1;
+	}
+
+	base = parm->trace[0].timestamp;
+	for (idx = 0; idx < parm->nr_records; idx++) {
+		struct trace_record *rec = &parm->trace[idx];
+		rec->timestamp =
+			rec->timestamp > base ? rec->timestamp - base : 0;
+	}
+	return 0;
+}
+
 static struct benchmark_parameter *init_parameters(int argc, char **argv)
 {
 	struct benchmark_parameter *parm;
@@ -345,6 +828,8 @@ static struct benchmark_parameter *init_parameters(int argc, char **argv)
 	size_t nr_blocks = (size_t)1;
 
 	char *device_path;
+	int nr_namespaces = 1;
+	bool is_gc_paced = false;
 
 	int c = 0;
 	int i;
@@ -353,11 +838,20 @@ static struct benchmark_parameter *init_parameters(int argc, char **argv)
 		sizeof(struct benchmark_parameter));
 	memset(parm, 0, sizeof(struct benchmark_parameter));
 
+	parm->nr_passes = 1;
+	parm->sample_interval = 1000;
+	parm->read_ratio = 70;
+	parm->dist_idx = DIST_UNIFORM;
+	parm->zipf_theta = 0.99;
+	parm->hot_ratio = 20;
+	parm->hot_access_ratio = 80;
+
 	device_path = parm->device_path;
 	memset(device_path, 0, (size_t)(DEVICE_PATH_SIZE - 1));
 	nr_jobs = (int)g_get_num_processors();
 
-	while ((c = getopt(argc, argv, "m:d:t:j:b:n:p:h")) != -1) {
+	while ((c = getopt(argc, argv, "m:d:t:j:b:n:p:N:Pr:D:s:S:T:FI:o:R:Lh")) !=
+	       -1) {
 		switch (c) {
 		case 'm':
 			module_idx = get_index_from_list(module_str);
@@ -403,6 +897,84 @@ static struct benchmark_parameter *init_parameters(int argc, char **argv)
 		case 'p':
 			strncpy(device_path, optarg, DEVICE_PATH_SIZE - 1);
 			break;
+		case 'N':
+			nr_namespaces = atoi(optarg);
+			if (nr_namespaces < 1) {
+				fprintf(stderr,
+					"error: invalid number of namespaces (%s)\n",
+					optarg);
+				help_message(parm, argv);
+				exit(1);
+			}
+			break;
+		case 'P':
+			is_gc_paced = true;
+			break;
+		case 'r':
+			parm->read_ratio = atoi(optarg);
+			if (parm->read_ratio < 0 || parm->read_ratio > 100) {
+				fprintf(stderr,
+					"error: invalid read ratio (%s)\n",
+					optarg);
+				help_message(parm, argv);
+				exit(1);
+			}
+			break;
+		case 'D':
+			if (parse_distribution(parm, optarg)) {
+				fprintf(stderr,
+					"error: invalid distribution (%s)\n",
+					optarg);
+				help_message(parm, argv);
+				exit(1);
+			}
+			break;
+		case 's':
+			if (parse_io_sizes(parm, optarg)) {
+				fprintf(stderr,
+					"error: invalid I/O sizes (%s)\n",
+					optarg);
+				help_message(parm, argv);
+				exit(1);
+			}
+			break;
+		case 'S':
+			parm->nr_passes = (size_t)atoi(optarg);
+			if (parm->nr_passes == 0) {
+				fprintf(stderr,
+					"error: invalid number of passes (%s)\n",
+					optarg);
+				help_message(parm, argv);
+				exit(1);
+			}
+			break;
+		case 'T':
+			strncpy(parm->trace_path, optarg, DEVICE_PATH_SIZE - 1);
+			break;
+		case 'F':
+			parm->is_timed_replay = true;
+			break;
+		case 'I':
+			parm->sample_interval = (size_t)atoi(optarg);
+			if (parm->sample_interval == 0) {
+				fprintf(stderr,
+					"error: invalid sampling interval (%s)\n",
+					optarg);
+				help_message(parm, argv);
+				exit(1);
+			}
+			break;
+		case 'o':
+			strncpy(parm->timeseries_path, optarg,
+				DEVICE_PATH_SIZE - 1);
+			break;
+		case 'R':
+			strncpy(parm->tracepoint_path, optarg,
+				DEVICE_PATH_SIZE - 1);
+			break;
+		case 'L':
+			parm->is_numa_local = true;
+			break;
 		case 'h':
 			help_message(parm, argv);
 			exit(0);
@@ -424,6 +996,40 @@ static struct benchmark_parameter *init_parameters(int argc, char **argv)
 
 	parm->block_sz = block_sz;
 	parm->nr_blocks = nr_blocks;
+	parm->nr_ios = nr_blocks * parm->nr_passes;
+	if (parm->nr_io_sizes == 0) {
+		parm->io_sizes[0] = block_sz;
+		parm->io_size_weights[0] = 1;
+		parm->total_io_size_weight = 1;
+		parm->nr_io_sizes = 1;
+	}
+	if (parm->dist_idx == DIST_ZIPF) {
+		init_zipf(parm);
+	}
+	if (parm->workload_idx == REPLAY && load_trace(parm)) {
+		fprintf(stderr, "error: cannot load the trace (%s)\n",
+			parm->trace_path);
+		help_message(parm, argv);
+		exit(1);
+	}
+
+	parm->nr_namespaces = nr_namespaces;
+	parm->is_gc_paced = is_gc_paced;
+	parm->namespaces = (struct flash_device **)malloc(
+		(size_t)nr_namespaces * sizeof(struct flash_device *));
+	g_assert(parm->namespaces != NULL);
+	memset(parm->namespaces, 0,
+	       (size_t)nr_namespaces * sizeof(struct flash_device *));
+
+	parm->noisy_threads =
+		(pthread_t *)malloc((size_t)nr_namespaces * sizeof(pthread_t));
+	g_assert(parm->noisy_threads != NULL);
+	memset(parm->noisy_threads, 0, (size_t)nr_namespaces * sizeof(pthread_t));
+
+	parm->noisy_writes =
+		(size_t *)malloc((size_t)nr_namespaces * sizeof(size_t));
+	g_assert(parm->noisy_writes != NULL);
+	memset(parm->noisy_writes, 0, (size_t)nr_namespaces * sizeof(size_t));
 
 	/* initialize the crc32 list */
 	parm->crc32_list =
@@ -435,6 +1041,26 @@ static struct benchmark_parameter *init_parameters(int argc, char **argv)
 	g_assert(parm->crc32_is_match != NULL);
 	memset(parm->crc32_is_match, true, parm->nr_blocks * sizeof(bool));
 
+	/**< the sub-block I/O of the mixed workload is verified by the units */
+	if (parm->workload_idx == MIXED) {
+		parm->crc32_unit = parm->block_sz;
+		for (int idx = 0; idx < parm->nr_io_sizes; idx++) {
+			parm->crc32_unit =
+				get_gcd(parm->crc32_unit, parm->io_sizes[idx]);
+		}
+		parm->unit_seeds = (uint64_t *)malloc(
+			parm->nr_blocks * (parm->block_sz / parm->crc32_unit) *
+			sizeof(uint64_t));
+		g_assert(parm->unit_seeds != NULL);
+	}
+
+	parm->crc32_locks = (pthread_mutex_t *)malloc(CRC32_NR_LOCKS *
+						      sizeof(pthread_mutex_t));
+	g_assert(parm->crc32_locks != NULL);
+	for (size_t idx = 0; idx < CRC32_NR_LOCKS; idx++) {
+		pthread_mutex_init(&parm->crc32_locks[idx], NULL);
+	}
+
 	parm->offset_sequence =
 		(off_t *)malloc(parm->nr_blocks * sizeof(size_t));
 	g_assert(parm->offset_sequence != NULL);
@@ -445,13 +1071,23 @@ static struct benchmark_parameter *init_parameters(int argc, char **argv)
 	g_assert(parm->threads != NULL);
 	memset(parm->threads, 0, (size_t)parm->nr_jobs * sizeof(pthread_t));
 
-	parm->timer_list =
-		(GList **)malloc((size_t)parm->nr_jobs * sizeof(GList *));
-	g_assert(parm->timer_list != NULL);
+	parm->latency = (struct hist *)malloc((size_t)parm->nr_jobs *
+					      sizeof(struct hist));
+	g_assert(parm->latency != NULL);
+	parm->read_latency = (struct hist *)malloc((size_t)parm->nr_jobs *
+						   sizeof(struct hist));
+	g_assert(parm->read_latency != NULL);
 	for (i = 0; i < parm->nr_jobs; i++) {
-		parm->timer_list[i] = NULL;
+		g_assert(hist_init(&parm->latency[i]) == 0);
+		g_assert(hist_init(&parm->read_latency[i]) == 0);
 	}
 
+	parm->io_bytes =
+		(size_t *)malloc((size_t)parm->nr_jobs * sizeof(size_t));
+	g_assert(parm->io_bytes != NULL);
+	memset(parm->io_bytes, 0, (size_t)parm->nr_jobs * sizeof(size_t));
+
+
 	g_atomic_int_set(&parm->thread_id_allocator, 0);
 
 	parm->wp = (size_t *)malloc((size_t)parm->nr_jobs * sizeof(size_t));
@@ -480,6 +1116,37 @@ static void print_parameters(const struct benchmark_parameter *parm)
 	printf("\t- io size     %zuMiB\n",
 	       (parm->nr_blocks * parm->block_sz) >> 20);
 	printf("\t- path        %s\n", path);
+	printf("\t- namespaces  %d\n", parm->nr_namespaces);
+	printf("\t- gc pacing   %s\n", parm->is_gc_paced ? "on" : "off");
+	printf("\t- numa local  %s\n", parm->is_numa_local ? "on" : "off");
+	printf("\t- # of passes %zu\n", parm->nr_passes);
+	if (parm->workload_idx == MIXED) {
+		int idx;
+		printf("\t- read ratio  %d%%\n", parm->read_ratio);
+		printf("\t- distrib.    %s", dist_str[parm->dist_idx]);
+		if (parm->dist_idx == DIST_ZIPF) {
+			printf(" (theta: %.2lf)", parm->zipf_theta);
+		} else if (parm->dist_idx == DIST_HOTCOLD) {
+			printf(" (%.1lf%% blocks get %.1lf%% accesses)",
+			       parm->hot_ratio, parm->hot_access_ratio);
+		}
+		printf("\n\t- I/O sizes   ");
+		for (idx = 0; idx < parm->nr_io_sizes; idx++) {
+			printf("%zu:%d ", parm->io_sizes[idx],
+			       parm->io_size_weights[idx]);
+		}
+		printf("\n");
+	}
+	if (parm->workload_idx == REPLAY) {
+		printf("\t- trace       %s (%zu records)\n", parm->trace_path,
+		       parm->nr_records);
+		printf("\t- timed       %s\n",
+		       parm->is_timed_replay ? "on" : "off");
+	}
+	if (strlen(parm->timeseries_path) > 0) {
+		printf("\t- time-series %s (%zums)\n", parm->timeseries_path,
+		       parm->sample_interval);
+	}
 }
 
 static void free_parameters(struct benchmark_parameter *parm)
@@ -493,6 +1160,15 @@ static void free_parameters(struct benchmark_parameter *parm)
 	if (parm->crc32_is_match) {
 		free(parm->crc32_is_match);
 	}
+	if (parm->unit_seeds) {
+		free(parm->unit_seeds);
+	}
+	if (parm->crc32_locks) {
+		for (size_t idx = 0; idx < CRC32_NR_LOCKS; idx++) {
+			pthread_mutex_destroy(&parm->crc32_locks[idx]);
+		}
+		free(parm->crc32_locks);
+	}
 	if (parm->offset_sequence) {
 		free(parm->offset_sequence);
 	}
@@ -505,15 +1181,34 @@ static void free_parameters(struct benchmark_parameter *parm)
 	if (parm->total_time) {
 		free(parm->total_time);
 	}
-	if (parm->timer_list) {
+	if (parm->namespaces) {
+		free(parm->namespaces);
+	}
+	if (parm->noisy_threads) {
+		free(parm->noisy_threads);
+	}
+	if (parm->noisy_writes) {
+		free(parm->noisy_writes);
+	}
+	if (parm->latency) {
 		int idx;
 		for (idx = 0; idx < parm->nr_jobs; idx++) {
-			if (!parm->timer_list[idx]) {
-				continue;
-			}
-			g_list_free(parm->timer_list[idx]);
+			hist_free(&parm->latency[idx]);
+		}
+		free(parm->latency);
+	}
+	if (parm->read_latency) {
+		int idx;
+		for (idx = 0; idx < parm->nr_jobs; idx++) {
+			hist_free(&parm->read_latency[idx]);
 		}
-		free(parm->timer_list);
+		free(parm->read_latency);
+	}
+	if (parm->io_bytes) {
+		free(parm->io_bytes);
+	}
+	if (parm->trace) {
+		free(parm->trace);
 	}
 	free(parm);
 }
@@ -526,9 +1221,14 @@ static void fill_buffer_random(char *buffer, size_t block_sz)
 	while (pos < block_sz) {
 		ssize_t ret;
 		char *ptr = &buffer[pos];
-		ret = syscall(SYS_getrandom, ptr, block_sz, GRND_NONBLOCK);
+		/**< the signal (e.g., io_uring's task work) makes a short read */
+		ret = syscall(SYS_getrandom, ptr, block_sz - pos,
+			      GRND_NONBLOCK);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
 		g_assert(ret >= 0);
-		pos += ret;
+		pos += (size_t)ret;
 	}
 #else
 	size_t pos = 0;
@@ -555,6 +1255,52 @@ static void free_buffer(void *buffer)
 	free(buffer);
 }
 
+/**
+ * @brief check the block's lock is taken by the I/O of the blocks
+ *
+ * @note
+ * The blocks are contiguous, so their locks are the contiguous stripes
+ * (wrapped around).
+ */
+static bool is_locked_stripe(size_t stripe, size_t first, size_t nr_blocks)
+{
+	if (nr_blocks >= CRC32_NR_LOCKS) {
+		return true;
+	}
+	return (stripe + CRC32_NR_LOCKS - first % CRC32_NR_LOCKS) %
+		       CRC32_NR_LOCKS <
+	       nr_blocks;
+}
+
+/**
+ * @brief lock the blocks to keep the I/O and its crc32 in the same order
+ *
+ * @note
+ * The stripes are locked in the ascending order, so the jobs which access the
+ * overlapped blocks never deadlock.
+ */
+static void lock_blocks(struct benchmark_parameter *parm, size_t first,
+			size_t nr_blocks)
+{
+	size_t stripe;
+	for (stripe = 0; stripe < CRC32_NR_LOCKS; stripe++) {
+		if (is_locked_stripe(stripe, first, nr_blocks)) {
+			pthread_mutex_lock(&parm->crc32_locks[stripe]);
+		}
+	}
+}
+
+static void unlock_blocks(struct benchmark_parameter *parm, size_t first,
+			  size_t nr_blocks)
+{
+	size_t stripe;
+	for (stripe = CRC32_NR_LOCKS; stripe-- > 0;) {
+		if (is_locked_stripe(stripe, first, nr_blocks)) {
+			pthread_mutex_unlock(&parm->crc32_locks[stripe]);
+		}
+	}
+}
+
 static void *write_data(void *data)
 {
 	struct timespec start, end;
@@ -564,6 +1310,7 @@ static void *write_data(void *data)
 	gint thread_id;
 	struct flash_device *flash;
 	struct benchmark_parameter *parm;
+	uint64_t state;
 #ifdef USE_PER_CORE
 	uint64_t mask;
 #endif
@@ -579,14 +1326,22 @@ static void *write_data(void *data)
 				     (cpu_set_t *)&mask);
 	g_assert(ret >= 0);
 #endif
+	set_local_node(parm, flash);
 
 	buffer = (unsigned char *)alloc_buffer(parm->block_sz);
 	g_assert(buffer != NULL);
+	g_assert(getentropy(&state, sizeof(state)) == 0);
 
-	for (int i = 0; i < (int)parm->nr_blocks; i++) {
-		off_t offset = parm->offset_sequence[i];
+	for (size_t i = 0; i < parm->nr_ios; i++) {
+		off_t offset = parm->offset_sequence[i % parm->nr_blocks];
 #ifdef USE_CRC
-		fill_buffer_random((char *)buffer, parm->block_sz);
+		if (parm->unit_seeds) {
+			/**< fill the blocks of the mixed workload */
+			fill_buffer_units(parm, buffer, parm->block_sz, offset,
+					  &state);
+		} else {
+			fill_buffer_random((char *)buffer, parm->block_sz);
+		}
 		parm->crc32_list[(size_t)offset / parm->block_sz] =
 			xcrc32(buffer, (int)parm->block_sz, CRC32_INIT);
 #endif
@@ -597,12 +1352,12 @@ static void *write_data(void *data)
 		interval = (gsize)((end.tv_sec - start.tv_sec) * SEC_TO_NS) +
 			   (unsigned long)(end.tv_nsec - start.tv_nsec);
 		parm->total_time[thread_id] += interval;
-		parm->timer_list[thread_id] =
-			g_list_prepend(parm->timer_list[thread_id],
-				       GSIZE_TO_POINTER(interval));
-		parm->wp[thread_id] = (size_t)i;
+		hist_record(&parm->latency[thread_id], (uint64_t)interval);
+		parm->io_bytes[thread_id] += parm->block_sz;
+		parm->wp[thread_id] = i;
 	}
 	free_buffer(buffer);
+	g_atomic_int_inc(&parm->nr_finished_jobs);
 	return NULL;
 }
 
@@ -632,8 +1387,9 @@ static void *read_data(void *data)
 				     (cpu_set_t *)&mask);
 	g_assert(ret >= 0);
 #endif
-	for (int i = 0; i < (int)parm->nr_blocks; i++) {
-		off_t offset = parm->offset_sequence[i];
+	set_local_node(parm, flash);
+	for (size_t i = 0; i < parm->nr_ios; i++) {
+		off_t offset = parm->offset_sequence[i % parm->nr_blocks];
 #ifdef USE_CRC
 		memset(buffer, 0, parm->block_sz);
 #endif
@@ -644,10 +1400,9 @@ static void *read_data(void *data)
 		interval = (gsize)((end.tv_sec - start.tv_sec) * SEC_TO_NS) +
 			   (unsigned long)(end.tv_nsec - start.tv_nsec);
 		parm->total_time[thread_id] += interval;
-		parm->timer_list[thread_id] =
-			g_list_prepend(parm->timer_list[thread_id],
-				       GSIZE_TO_POINTER(interval));
-		parm->wp[thread_id] = (size_t)i;
+		hist_record(&parm->latency[thread_id], (uint64_t)interval);
+		parm->io_bytes[thread_id] += parm->block_sz;
+		parm->wp[thread_id] = i;
 #ifdef USE_CRC
 		{
 			uint32_t crc32 =
@@ -661,58 +1416,474 @@ static void *read_data(void *data)
 #endif
 	}
 	free_buffer(buffer);
+	g_atomic_int_inc(&parm->nr_finished_jobs);
+	return NULL;
+}
+
+/**
+ * @brief overwrite the random blocks of the noisy namespace until the
+ * workload of the namespace 0 finishes
+ *
+ * @note
+ * The page FTL reclaims the segments by the background thread only. So, the
+ * noisy writes are bounded by the number of blocks to avoid exhausting the
+ * namespace's free pages.
+ */
+static void *noisy_write_data(void *data)
+{
+	struct benchmark_parameter *parm;
+	struct flash_device *flash;
+	unsigned char *buffer;
+	gint ns_id;
+	ssize_t ret;
+
+	parm = (struct benchmark_parameter *)data;
+	ns_id = g_atomic_int_add(&parm->noisy_id_allocator, 1);
+	flash = parm->namespaces[ns_id];
+
+	buffer = (unsigned char *)alloc_buffer(parm->block_sz);
+	g_assert(buffer != NULL);
+
+	while (!g_atomic_int_get(&parm->is_noisy_exit) &&
+	       parm->noisy_writes[ns_id] < parm->nr_blocks) {
+		size_t blknum;
+#ifdef USE_CRC
+		fill_buffer_random((char *)buffer, parm->block_sz);
+#endif
+		g_assert(getentropy(&blknum, sizeof(size_t)) == 0);
+		blknum = blknum % parm->nr_blocks;
+		ret = flash->f_op->write(flash, buffer, parm->block_sz,
+					 (off_t)(blknum * parm->block_sz));
+		g_assert(ret == (ssize_t)parm->block_sz);
+		parm->noisy_writes[ns_id] += 1;
+	}
+	free_buffer(buffer);
+	return NULL;
+}
+
+/**
+ * @brief xorshift64* pseudo random number generator
+ */
+static inline uint64_t next_random(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline double next_random_double(uint64_t *state)
+{
+	return (double)(next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static size_t get_gcd(size_t a, size_t b)
+{
+	while (b != 0) {
+		size_t r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+/**
+ * @brief fill the unit's data which is made from the seed
+ */
+static void fill_unit(unsigned char *buffer, size_t len, uint64_t seed)
+{
+	uint64_t state = seed | 1; /**< xorshift's state must not be zero */
+	size_t pos;
+
+	for (pos = 0; pos < len; pos += sizeof(uint64_t)) {
+		uint64_t value = next_random(&state);
+		memcpy(&buffer[pos], &value, MIN(sizeof(uint64_t), len - pos));
+	}
+}
+
+/**
+ * @brief fill the write's data by the new seeds of its units
+ *
+ * @note
+ * The caller must hold the blocks' locks. The seeds are kept instead of the
+ * data, so the expected data of any range can be made again by the
+ * `fill_block()`.
+ */
+static void fill_buffer_units(struct benchmark_parameter *parm,
+			      unsigned char *buffer, size_t io_size,
+			      off_t offset, uint64_t *state)
+{
+	size_t unit = parm->crc32_unit;
+	size_t pos;
+
+	for (pos = 0; pos < io_size; pos += unit) {
+		uint64_t seed = next_random(state);
+		parm->unit_seeds[((size_t)offset + pos) / unit] = seed;
+		fill_unit(&buffer[pos], unit, seed);
+	}
+}
+
+/**
+ * @brief make the expected data of the block from its units' seeds
+ */
+static void fill_block(struct benchmark_parameter *parm, unsigned char *buffer,
+		       size_t blknum)
+{
+	size_t unit = parm->crc32_unit;
+	size_t nr_units = parm->block_sz / unit;
+	size_t idx;
+
+	for (idx = 0; idx < nr_units; idx++) {
+		fill_unit(&buffer[idx * unit], unit,
+			  parm->unit_seeds[blknum * nr_units + idx]);
+	}
+}
+
+/**
+ * @brief update the crc32 of the blocks which are written
+ *
+ * @param scratch buffer of a block for the partially written block
+ *
+ * @note
+ * The caller must hold the blocks' locks. The partially written block's crc32
+ * is made from the block's expected data.
+ */
+static void update_crc(struct benchmark_parameter *parm,
+		       unsigned char *scratch, const unsigned char *buffer,
+		       size_t io_size, off_t offset)
+{
+	size_t block_sz = parm->block_sz;
+	size_t pos = (size_t)offset;
+	size_t end = pos + io_size;
+	size_t blknum;
+
+	for (blknum = pos / block_sz; blknum * block_sz < end; blknum++) {
+		size_t start = blknum * block_sz;
+		const unsigned char *data = &buffer[start - pos];
+		if (start < pos || start + block_sz > end) {
+			fill_block(parm, scratch, blknum);
+			data = scratch;
+		}
+		parm->crc32_list[blknum] =
+			xcrc32(data, (int)block_sz, CRC32_INIT);
+	}
+}
+
+/**
+ * @brief check the crc32 of the blocks which are read
+ *
+ * @param scratch buffer of a block for the partially read block
+ *
+ * @note
+ * The caller must hold the blocks' locks. The partially read block is
+ * compared with the same range of the block's expected data.
+ */
+static void check_crc(struct benchmark_parameter *parm,
+		      unsigned char *scratch, const unsigned char *buffer,
+		      size_t io_size, off_t offset)
+{
+	size_t block_sz = parm->block_sz;
+	size_t pos = (size_t)offset;
+	size_t end = pos + io_size;
+	size_t blknum;
+
+	for (blknum = pos / block_sz; blknum * block_sz < end; blknum++) {
+		size_t start = MAX(blknum * block_sz, pos);
+		size_t len = MIN((blknum + 1) * block_sz, end) - start;
+		uint32_t crc32 = xcrc32(&buffer[start - pos], (int)len,
+					CRC32_INIT);
+		uint32_t expected = parm->crc32_list[blknum];
+
+		if (len < block_sz) {
+			fill_block(parm, scratch, blknum);
+			expected = xcrc32(&scratch[start - blknum * block_sz],
+					  (int)len, CRC32_INIT);
+		}
+		if (crc32 != expected) {
+			parm->crc32_is_match[blknum] = false;
+		}
+	}
+}
+
+static size_t next_block(struct benchmark_parameter *parm, uint64_t *state)
+{
+	size_t nr_blocks = parm->nr_blocks;
+	size_t nr_hot, blknum;
+	double u;
+
+	switch (parm->dist_idx) {
+	case DIST_ZIPF:
+		u = next_random_double(state);
+		if (u * parm->zipf_zetan < 1.0) {
+			return 0;
+		}
+		if (u * parm->zipf_zetan < 1.0 + pow(0.5, parm->zipf_theta)) {
+			return 1 % nr_blocks;
+		}
+		blknum = (size_t)((double)nr_blocks *
+				  pow(parm->zipf_eta * u - parm->zipf_eta + 1,
+				      parm->zipf_alpha));
+		return blknum < nr_blocks ? blknum : nr_blocks - 1;
+	case DIST_HOTCOLD:
+		nr_hot = (size_t)((double)nr_blocks * parm->hot_ratio / 100.0);
+		nr_hot = nr_hot == 0 ? 1 : nr_hot;
+		if (nr_hot == nr_blocks ||
+		    next_random_double(state) * 100.0 < parm->hot_access_ratio) {
+			return next_random(state) % nr_hot;
+		}
+		return nr_hot + next_random(state) % (nr_blocks - nr_hot);
+	default:
+		return next_random(state) % nr_blocks;
+	}
+}
+
+static size_t next_io_size(struct benchmark_parameter *parm, uint64_t *state)
+{
+	int weight, idx;
+
+	weight = (int)(next_random(state) %
+		       (uint64_t)parm->total_io_size_weight);
+	for (idx = 0; idx < parm->nr_io_sizes - 1; idx++) {
+		weight -= parm->io_size_weights[idx];
+		if (weight < 0) {
+			break;
+		}
+	}
+	return parm->io_sizes[idx];
+}
+
+static void *mixed_data(void *data)
+{
+	struct timespec start, end;
+	gsize interval;
+	ssize_t ret;
+	unsigned char *buffer, *scratch;
+	gint thread_id;
+	struct flash_device *flash;
+	struct benchmark_parameter *parm;
+	size_t max_io_size, device_size;
+	size_t first, nr_locked;
+	uint64_t state;
+	int idx;
+#ifdef USE_PER_CORE
+	uint64_t mask;
+#endif
+
+	parm = (struct benchmark_parameter *)data;
+	flash = parm->flash;
+
+	thread_id = g_atomic_int_add(&parm->thread_id_allocator, 1);
+#ifdef USE_PER_CORE
+	mask = (0x1 << thread_id);
+	ret = pthread_setaffinity_np(pthread_self(), sizeof(mask),
+				     (cpu_set_t *)&mask);
+	g_assert(ret >= 0);
+#endif
+	set_local_node(parm, flash);
+
+	max_io_size = 0;
+	for (idx = 0; idx < parm->nr_io_sizes; idx++) {
+		max_io_size = MAX(max_io_size, parm->io_sizes[idx]);
+	}
+	buffer = (unsigned char *)alloc_buffer(max_io_size);
+	g_assert(buffer != NULL);
+	scratch = (unsigned char *)alloc_buffer(parm->block_sz);
+	g_assert(scratch != NULL);
+	device_size = parm->nr_blocks * parm->block_sz;
+	g_assert(max_io_size <= device_size);
+
+	g_assert(getentropy(&state, sizeof(state)) == 0);
+	state |= 1; /**< xorshift's state must not be zero */
+
+	for (size_t i = 0; i < parm->nr_ios; i++) {
+		size_t io_size = next_io_size(parm, &state);
+		off_t offset = (off_t)(next_block(parm, &state) * parm->block_sz);
+		bool is_read;
+
+		if ((size_t)offset + io_size > device_size) {
+			offset = (off_t)(device_size - io_size);
+		}
+		is_read = (int)(next_random(&state) % 100) < parm->read_ratio;
+		first = (size_t)offset / parm->block_sz;
+		nr_locked = ((size_t)offset + io_size - 1) / parm->block_sz -
+			    first + 1;
+#ifdef USE_CRC
+		lock_blocks(parm, first, nr_locked);
+		if (is_read) {
+			memset(buffer, 0, io_size);
+		} else {
+			fill_buffer_units(parm, buffer, io_size, offset,
+					  &state);
+		}
+#else
+		if (!is_read) {
+			memset(buffer, (int)(i & 0xff), io_size);
+		}
+#endif
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (is_read) {
+			ret = flash->f_op->read(flash, buffer, io_size, offset);
+		} else {
+			ret = flash->f_op->write(flash, buffer, io_size,
+						 offset);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		g_assert(ret == (ssize_t)io_size);
+#ifdef USE_CRC
+		if (is_read) {
+			check_crc(parm, scratch, buffer, io_size, offset);
+		} else {
+			update_crc(parm, scratch, buffer, io_size, offset);
+		}
+		unlock_blocks(parm, first, nr_locked);
+#endif
+		interval = (gsize)((end.tv_sec - start.tv_sec) * SEC_TO_NS) +
+			   (unsigned long)(end.tv_nsec - start.tv_nsec);
+		parm->total_time[thread_id] += interval;
+		hist_record(&parm->latency[thread_id], (uint64_t)interval);
+		if (is_read) {
+			hist_record(&parm->read_latency[thread_id],
+				    (uint64_t)interval);
+		}
+		parm->io_bytes[thread_id] += io_size;
+		parm->wp[thread_id] = i;
+	}
+	free_buffer(scratch);
+	free_buffer(buffer);
+	g_atomic_int_inc(&parm->nr_finished_jobs);
+	return NULL;
+}
+
+/**
+ * @brief replay the trace's streams which are dispatched to this job
+ *
+ * @note
+ * The stream is dispatched by `stream % jobs`, so the records of a stream
+ * are issued by the one job in the trace's order.
+ */
+static void *replay_data(void *data)
+{
+	struct timespec start, end;
+	gsize interval;
+	ssize_t ret;
+	unsigned char *buffer;
+	gint thread_id;
+	struct flash_device *flash;
+	struct benchmark_parameter *parm;
+	size_t max_io_size, device_size;
+#ifdef USE_PER_CORE
+	uint64_t mask;
+#endif
+
+	parm = (struct benchmark_parameter *)data;
+	flash = parm->flash;
+
+	thread_id = g_atomic_int_add(&parm->thread_id_allocator, 1);
+#ifdef USE_PER_CORE
+	mask = (0x1 << thread_id);
+	ret = pthread_setaffinity_np(pthread_self(), sizeof(mask),
+				     (cpu_set_t *)&mask);
+	g_assert(ret >= 0);
+#endif
+	set_local_node(parm, flash);
+
+	device_size = parm->nr_blocks * parm->block_sz;
+	max_io_size = MIN(parm->max_record_length, device_size);
+	buffer = (unsigned char *)alloc_buffer(max_io_size);
+	g_assert(buffer != NULL);
+
+	for (size_t i = 0; i < parm->nr_records; i++) {
+		struct trace_record *record = &parm->trace[i];
+		size_t io_size = MIN((size_t)record->length, device_size);
+		off_t offset = (off_t)(record->offset % device_size);
+
+		if (record->stream % parm->nr_jobs != thread_id) {
+			continue;
+		}
+		if ((size_t)offset + io_size > device_size) {
+			offset = (off_t)(device_size - io_size);
+		}
+		if (record->op == TRACE_WRITE) {
+			memset(buffer, (int)(i & 0xff), io_size);
+		}
+		if (parm->is_timed_replay) {
+			struct timespec issue = parm->replay_start;
+			uint64_t nsec = (uint64_t)issue.tv_nsec +
+					record->timestamp % SEC_TO_NS;
+			issue.tv_sec += (time_t)(record->timestamp / SEC_TO_NS +
+						 nsec / SEC_TO_NS);
+			issue.tv_nsec = (long)(nsec % SEC_TO_NS);
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+					       &issue, NULL) == EINTR)
+				;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (record->op == TRACE_WRITE) {
+			ret = flash->f_op->write(flash, buffer, io_size,
+						 offset);
+		} else {
+			ret = flash->f_op->read(flash, buffer, io_size, offset);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		g_assert(ret == (ssize_t)io_size);
+		interval = (gsize)((end.tv_sec - start.tv_sec) * SEC_TO_NS) +
+			   (unsigned long)(end.tv_nsec - start.tv_nsec);
+		parm->total_time[thread_id] += interval;
+		hist_record(&parm->latency[thread_id], (uint64_t)interval);
+		if (record->op == TRACE_READ) {
+			hist_record(&parm->read_latency[thread_id],
+				    (uint64_t)interval);
+		}
+		parm->io_bytes[thread_id] += io_size;
+		parm->wp[thread_id] = i;
+	}
+	free_buffer(buffer);
+	if (g_atomic_int_add(&parm->nr_finished_jobs, 1) == parm->nr_jobs - 1) {
+		clock_gettime(CLOCK_MONOTONIC, &parm->replay_end);
+	}
 	return NULL;
 }
 
 static void report_result(struct benchmark_parameter *parm)
 {
-	GList *node;
-	size_t max_latency, min_latency;
 	size_t idx = 0;
-	size_t write_size;
 #ifdef USE_CRC
 	bool is_valid;
 #endif
 
-	max_latency = 0;
-	min_latency = INT32_MAX;
-
-	write_size = parm->block_sz * parm->nr_blocks;
 	printf("[job information]\n");
 	printf("%-4s%-10s%-10s%-10s%-10s%-10s%-10s\n", "id", "time(s)",
 	       "bw(MiB/s)", "iops", "avg(ms)", "max(ms)", "min(ms)");
 	printf("=====\n");
 	/* check interval */
 	for (idx = 0; idx < (size_t)parm->nr_jobs; idx++) {
-		size_t total_time = 0;
-		size_t iops = 0;
-		node = parm->timer_list[idx];
-		while (node != NULL) {
-			gsize interval;
-			interval = GPOINTER_TO_SIZE(node->data);
-			total_time += interval;
-			max_latency =
-				max_latency > interval ? max_latency : interval;
-			min_latency =
-				min_latency < interval ? min_latency : interval;
-			node = node->next;
-			iops += 1;
+		struct hist *latency = &parm->latency[idx];
+		size_t total_time = (size_t)latency->sum;
+		size_t iops = (size_t)latency->total;
+		size_t write_size = parm->io_bytes[idx];
+		if (iops == 0) {
+			continue;
 		}
 		printf("%-4zu%-10.4lf%-10.4lf%-10zu%-10.4lf%-10.4lf%-10.4lf\n",
 		       idx, ((double)total_time / (NS_PER_MS * 1000L)),
 		       (double)(write_size) /
 			       (((double)total_time / (NS_PER_MS * 1000L)) *
 				(0x1 << 20)),
-		       iops, ((double)total_time / NS_PER_MS) / (double)iops,
-		       (double)max_latency / NS_PER_MS,
-		       (double)min_latency / NS_PER_MS);
+		       iops, hist_mean(latency) / NS_PER_MS,
+		       (double)latency->max / NS_PER_MS,
+		       (double)latency->min / NS_PER_MS);
 	}
 
 #ifdef USE_CRC
 	printf("[crc status]\n");
 	/* check blocks */
 	is_valid = true;
-	if (parm->workload_idx == RAND_READ || parm->workload_idx == READ) {
+	if (parm->workload_idx == RAND_READ || parm->workload_idx == READ ||
+	    parm->workload_idx == MIXED) {
 		for (idx = 0; idx < parm->nr_blocks; idx++) {
 			if (!parm->crc32_is_match[idx]) {
 				is_valid = false;
@@ -727,3 +1898,339 @@ static void report_result(struct benchmark_parameter *parm)
 	}
 #endif
 }
+
+static void print_latency(const char *name, struct hist *hists, int nr_jobs)
+{
+	const double percentiles[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+	struct hist merged;
+	size_t idx;
+
+	g_assert(hist_init(&merged) == 0);
+	for (idx = 0; idx < (size_t)nr_jobs; idx++) {
+		hist_merge(&merged, &hists[idx]);
+	}
+	if (merged.total == 0) {
+		hist_free(&merged);
+		return;
+	}
+
+	printf("[%s distribution]\n", name);
+	for (idx = 0; idx < sizeof(percentiles) / sizeof(double); idx++) {
+		printf("p%-9.2lf%-10.4lf(ms)\n", percentiles[idx],
+		       (double)hist_percentile(&merged, percentiles[idx]) /
+			       NS_PER_MS);
+	}
+	printf("%-10s%-10.4lf(ms)\n", "max", (double)merged.max / NS_PER_MS);
+	hist_free(&merged);
+}
+
+static void report_latency(struct benchmark_parameter *parm)
+{
+	print_latency("latency", parm->latency, parm->nr_jobs);
+	print_latency("read latency", parm->read_latency, parm->nr_jobs);
+}
+
+static void set_gc_pacing(struct benchmark_parameter *parm,
+			  struct flash_device *flash)
+{
+	if (!parm->is_gc_paced ||
+	    module_list[parm->module_idx] != PAGE_FTL_MODULE) {
+		return;
+	}
+	g_assert(flash->f_op->ioctl(flash, PAGE_FTL_IOCTL_GC_PACING, 1) == 0);
+}
+
+/**
+ * @brief make the job's writes prefer the buses on the job's NUMA node
+ *
+ * @note
+ * The node is decided by the CPU which runs the job (it is pinned by the
+ * `USE_PER_CORE`).
+ */
+static void set_local_node(struct benchmark_parameter *parm,
+			   struct flash_device *flash)
+{
+	unsigned int cpu, node;
+
+	if (!parm->is_numa_local ||
+	    module_list[parm->module_idx] != PAGE_FTL_MODULE) {
+		return;
+	}
+	g_assert(syscall(SYS_getcpu, &cpu, &node, NULL) == 0);
+	g_assert(flash->f_op->ioctl(flash, PAGE_FTL_IOCTL_LOCAL_NODE,
+				    (int)node) == 0);
+}
+
+static void report_wear(struct benchmark_parameter *parm)
+{
+	struct page_ftl_wear_stat stat;
+	struct flash_device *flash = parm->flash;
+
+	if (module_list[parm->module_idx] != PAGE_FTL_MODULE) {
+		return;
+	}
+	if (flash->f_op->ioctl(flash, PAGE_FTL_IOCTL_WEAR_STAT, &stat)) {
+		printf("cannot get the wear information\n");
+		return;
+	}
+	printf("[wear information]\n");
+	printf("%-10s%-10s%-10s%-10s%-10s%-10s\n", "segments", "total",
+	       "min", "max", "avg", "stddev");
+	printf("=====\n");
+	printf("%-10zu%-10" PRIu64 "%-10" PRIu64 "%-10" PRIu64
+	       "%-10.4lf%-10.4lf\n",
+	       stat.nr_segments, stat.total_erase, stat.min_erase,
+	       stat.max_erase, stat.avg_erase, stat.stddev_erase);
+}
+
+static void report_noisy(struct benchmark_parameter *parm, size_t runtime)
+{
+	int idx;
+
+	if (parm->nr_namespaces <= 1) {
+		return;
+	}
+	printf("[noisy neighbor information]\n");
+	printf("%-4s%-10s%-10s%-10s\n", "ns", "time(s)", "bw(MiB/s)",
+	       "writes");
+	printf("=====\n");
+	for (idx = 1; idx < parm->nr_namespaces; idx++) {
+		size_t nr_writes = parm->noisy_writes[idx];
+		printf("%-4d%-10.4lf%-10.4lf%-10zu\n", idx,
+		       ((double)runtime / (NS_PER_MS * 1000L)),
+		       (double)(nr_writes * parm->block_sz) /
+			       (((double)runtime / (NS_PER_MS * 1000L)) *
+				(0x1 << 20)),
+		       nr_writes);
+	}
+}
+
+static void get_ftl_stat(struct benchmark_parameter *parm,
+			 struct page_ftl_stat *stat)
+{
+	struct flash_device *flash = parm->flash;
+
+	memset(stat, 0, sizeof(struct page_ftl_stat));
+	if (module_list[parm->module_idx] != PAGE_FTL_MODULE) {
+		return;
+	}
+	g_assert(flash->f_op->ioctl(flash, PAGE_FTL_IOCTL_STAT, stat) == 0);
+}
+
+/**
+ * @brief get the write amplification factor since the workload started
+ *
+ * @return waf, 0 for no host writes
+ */
+static double get_waf(struct benchmark_parameter *parm,
+		      const struct page_ftl_stat *stat)
+{
+	uint64_t host_pages, flash_pages;
+
+	host_pages = stat->host_write_pages - parm->base_stat.host_write_pages;
+	flash_pages =
+		stat->flash_write_pages - parm->base_stat.flash_write_pages;
+	if (host_pages == 0) {
+		return 0;
+	}
+	return (double)flash_pages / (double)host_pages;
+}
+
+static void report_stat(struct benchmark_parameter *parm)
+{
+	struct page_ftl_stat *base = &parm->base_stat;
+	struct page_ftl_stat stat;
+
+	if (module_list[parm->module_idx] != PAGE_FTL_MODULE) {
+		return;
+	}
+	get_ftl_stat(parm, &stat);
+	printf("[ftl information]\n");
+	printf("%-12s%-12s%-12s%-12s%-12s%-12s%-12s%-10s\n", "host write",
+	       "host read", "flash write", "gc copy", "erase", "rmw read",
+	       "defer erase", "waf");
+	printf("=====\n");
+	printf("%-12" PRIu64 "%-12" PRIu64 "%-12" PRIu64 "%-12" PRIu64
+	       "%-12" PRIu64 "%-12" PRIu64 "%-12" PRIu64 "%-10.4lf\n",
+	       stat.host_write_pages - base->host_write_pages,
+	       stat.host_read_pages - base->host_read_pages,
+	       stat.flash_write_pages - base->flash_write_pages,
+	       stat.gc_copy_pages - base->gc_copy_pages,
+	       stat.nr_erase - base->nr_erase,
+	       stat.rmw_read_pages - base->rmw_read_pages,
+	       stat.nr_deferred_erase - base->nr_deferred_erase,
+	       get_waf(parm, &stat));
+}
+
+/**
+ * @brief report the replay's throughput and write amplification factor
+ *
+ * @note
+ * The runtime ends when the last job finishes its records.
+ */
+static void report_replay(struct benchmark_parameter *parm)
+{
+	struct timespec *start = &parm->replay_start, *end = &parm->replay_end;
+	struct page_ftl_stat stat;
+	size_t nr_ios = 0, io_bytes = 0;
+	double seconds;
+	int idx;
+
+	if (parm->workload_idx != REPLAY) {
+		return;
+	}
+	for (idx = 0; idx < parm->nr_jobs; idx++) {
+		nr_ios += (size_t)parm->latency[idx].total;
+		io_bytes += parm->io_bytes[idx];
+	}
+	seconds = (double)(end->tv_sec - start->tv_sec) +
+		  (double)(end->tv_nsec - start->tv_nsec) / SEC_TO_NS;
+	get_ftl_stat(parm, &stat);
+
+	printf("[replay information]\n");
+	printf("%-10s%-10s%-12s%-12s%-10s\n", "time(s)", "ios", "iops",
+	       "bw(MiB/s)", "waf");
+	printf("=====\n");
+	printf("%-10.4lf%-10zu%-12.2lf%-12.4lf%-10.4lf\n", seconds, nr_ios,
+	       (double)nr_ios / seconds,
+	       (double)io_bytes / (seconds * (0x1 << 20)),
+	       get_waf(parm, &stat));
+}
+
+static int open_timeseries(struct benchmark_parameter *parm)
+{
+	struct timeseries *ts;
+	const char *path = parm->timeseries_path;
+	size_t len = strlen(path);
+
+	ts = (struct timeseries *)malloc(sizeof(struct timeseries));
+	if (ts == NULL) {
+		return -1;
+	}
+	memset(ts, 0, sizeof(struct timeseries));
+	ts->fp = fopen(path, "w");
+	if (ts->fp == NULL) {
+		fprintf(stderr, "cannot open the time-series file (%s)\n",
+			path);
+		free(ts);
+		return -1;
+	}
+	g_assert(hist_init(&ts->prev) == 0);
+	g_assert(hist_init(&ts->cur) == 0);
+	g_assert(hist_init(&ts->diff) == 0);
+	ts->prev_erase = parm->base_stat.nr_erase;
+	ts->prev_copy = parm->base_stat.gc_copy_pages;
+	ts->is_json = len > 5 && !strcmp(&path[len - 5], ".json");
+	if (ts->is_json) {
+		fprintf(ts->fp, "[");
+	} else {
+		fprintf(ts->fp, "time_s,iops,bw_mib_s,p50_us,p99_us,p999_us,"
+				"max_us,free_segments,erases,gc_copies,waf\n");
+	}
+	parm->timeseries = ts;
+	return 0;
+}
+
+/**
+ * @brief write the sample of the last interval to the time-series file
+ *
+ * @param parm pointer of the benchmark parameters
+ * @param elapsed time from the start of the workload (ns)
+ *
+ * @note
+ * The latency percentiles are calculated by the values which are recorded
+ * during the interval only. The erases and copies show the garbage
+ * collection's (and the wear leveling's) activity during the interval, and
+ * the waf is accumulated from the start. The interval shorter
+ * than 1ms (e.g., the last one) is not sampled.
+ */
+static void write_sample(struct benchmark_parameter *parm, uint64_t elapsed)
+{
+	struct timeseries *ts = parm->timeseries;
+	struct page_ftl_wear_stat wear;
+	struct page_ftl_stat stat;
+	size_t io_bytes = 0, idx;
+	uint64_t nr_erase, nr_copy;
+	double seconds;
+
+	if (ts == NULL || elapsed < ts->prev_time + NS_PER_MS) {
+		return;
+	}
+	hist_reset(&ts->cur);
+	for (idx = 0; idx < (size_t)parm->nr_jobs; idx++) {
+		hist_merge(&ts->cur, &parm->latency[idx]);
+		io_bytes += parm->io_bytes[idx];
+	}
+	hist_diff(&ts->diff, &ts->cur, &ts->prev);
+
+	memset(&wear, 0, sizeof(wear));
+	if (module_list[parm->module_idx] == PAGE_FTL_MODULE) {
+		parm->flash->f_op->ioctl(parm->flash, PAGE_FTL_IOCTL_WEAR_STAT,
+					 &wear);
+	}
+	get_ftl_stat(parm, &stat);
+	nr_erase = stat.nr_erase - ts->prev_erase;
+	nr_copy = stat.gc_copy_pages - ts->prev_copy;
+	seconds = (double)(elapsed - ts->prev_time) / SEC_TO_NS;
+
+	if (ts->is_json) {
+		fprintf(ts->fp,
+			"%s\n  {\"time_s\": %.3lf, \"iops\": %.2lf, "
+			"\"bw_mib_s\": %.4lf, \"p50_us\": %.3lf, "
+			"\"p99_us\": %.3lf, \"p999_us\": %.3lf, "
+			"\"max_us\": %.3lf, \"free_segments\": %zu, "
+			"\"erases\": %" PRIu64 ", \"gc_copies\": %" PRIu64
+			", \"waf\": %.4lf}",
+			ts->nr_samples ? "," : "", (double)elapsed / SEC_TO_NS,
+			(double)ts->diff.total / seconds,
+			(double)(io_bytes - ts->prev_bytes) /
+				(seconds * (0x1 << 20)),
+			(double)hist_percentile(&ts->diff, 50.0) / 1000.0,
+			(double)hist_percentile(&ts->diff, 99.0) / 1000.0,
+			(double)hist_percentile(&ts->diff, 99.9) / 1000.0,
+			(double)hist_percentile(&ts->diff, 100.0) / 1000.0,
+			wear.nr_free_segments, nr_erase, nr_copy,
+			get_waf(parm, &stat));
+	} else {
+		fprintf(ts->fp,
+			"%.3lf,%.2lf,%.4lf,%.3lf,%.3lf,%.3lf,%.3lf,%zu,%" PRIu64
+			",%" PRIu64 ",%.4lf\n",
+			(double)elapsed / SEC_TO_NS,
+			(double)ts->diff.total / seconds,
+			(double)(io_bytes - ts->prev_bytes) /
+				(seconds * (0x1 << 20)),
+			(double)hist_percentile(&ts->diff, 50.0) / 1000.0,
+			(double)hist_percentile(&ts->diff, 99.0) / 1000.0,
+			(double)hist_percentile(&ts->diff, 99.9) / 1000.0,
+			(double)hist_percentile(&ts->diff, 100.0) / 1000.0,
+			wear.nr_free_segments, nr_erase, nr_copy,
+			get_waf(parm, &stat));
+	}
+	fflush(ts->fp);
+
+	hist_reset(&ts->prev);
+	hist_merge(&ts->prev, &ts->cur);
+	ts->prev_bytes = io_bytes;
+	ts->prev_erase = stat.nr_erase;
+	ts->prev_copy = stat.gc_copy_pages;
+	ts->prev_time = elapsed;
+	ts->nr_samples++;
+}
+
+static void close_timeseries(struct benchmark_parameter *parm)
+{
+	struct timeseries *ts = parm->timeseries;
+
+	if (ts == NULL) {
+		return;
+	}
+	if (ts->is_json) {
+		fprintf(ts->fp, "\n]\n");
+	}
+	fclose(ts->fp);
+	hist_free(&ts->prev);
+	hist_free(&ts->cur);
+	hist_free(&ts->diff);
+	free(ts);
+	parm->timeseries = NULL;
+}
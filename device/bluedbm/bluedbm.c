@@ -21,8 +21,49 @@
 
 #include <time.h>
 
-gint *g_badseg_counter = NULL; /**< counter for bad segemnt detection */
-gint *g_erase_counter = NULL; /**< counter for # of erase in the segment*/
+/**
+ * @brief bluedbm instance which owns the memio handle
+ *
+ * @note
+ * The trim callback of the libmemio doesn't pass any private data and the
+ * libmemio manages only one flash board per process. So, the erase
+ * completion is routed by this pointer and only one bluedbm can be opened.
+ */
+static struct bluedbm *bluedbm_owner = NULL;
+
+static void bluedbm_end_rw_request(async_bdbm_req *rw_req);
+
+/**
+ * @brief allocate the DMA descriptors and requests of every DMA tag
+ *
+ * @param bdbm pointer of the bluedbm
+ *
+ * @return array which is indexed by the DMA tag, NULL for fail
+ *
+ * @note
+ * The descriptor of a tag is used by one request at a time because the
+ * libmemio doesn't give the tag to the others until it is freed.
+ */
+static bluedbm_dma_t *bluedbm_alloc_dma(struct bluedbm *bdbm)
+{
+	bluedbm_dma_t *dmas, *dma;
+	uint32_t tag;
+
+	dmas = (bluedbm_dma_t *)malloc(sizeof(bluedbm_dma_t) *
+				       BLUEDBM_NR_DMA_TAGS);
+	if (dmas == NULL) {
+		return NULL;
+	}
+	memset(dmas, 0, sizeof(bluedbm_dma_t) * BLUEDBM_NR_DMA_TAGS);
+	for (tag = 0; tag < BLUEDBM_NR_DMA_TAGS; tag++) {
+		dma = &dmas[tag];
+		dma->tag = tag;
+		dma->bdbm = bdbm;
+		dma->rw_req.private_data = (void *)dma;
+		dma->rw_req.end_req = bluedbm_end_rw_request;
+	}
+	return dmas;
+}
 
 /**
  * @brief end request for the erase
@@ -36,15 +77,16 @@ gint *g_erase_counter = NULL; /**< counter for # of erase in the segment*/
  */
 static void bluedbm_erase_end_request(uint64_t segnum, uint8_t is_bad)
 {
-	if (g_badseg_counter == NULL || g_erase_counter == NULL) {
-		pr_err("NULL pointer detected\n");
-		pr_err("\tg_badseg_counter: %p\n", g_badseg_counter);
-		pr_err("\tg_erase_counter: %p\n", g_erase_counter);
+	struct bluedbm *bdbm = (struct bluedbm *)g_atomic_pointer_get(
+		&bluedbm_owner);
+	if (bdbm == NULL || bdbm->badseg_counter == NULL ||
+	    bdbm->erase_counter == NULL) {
+		pr_err("NULL pointer detected (bdbm: %p)\n", bdbm);
 		return;
 	}
-	g_atomic_int_inc(&g_erase_counter[segnum]);
+	g_atomic_int_inc(&bdbm->erase_counter[segnum]);
 	if (is_bad) {
-		g_atomic_int_inc(&g_badseg_counter[segnum]);
+		g_atomic_int_inc(&bdbm->badseg_counter[segnum]);
 	}
 }
 
@@ -100,6 +142,7 @@ static int bluedbm_clear(struct device *dev)
 static void bluedbm_wait_erase_finish(struct device *dev, size_t segnum,
 				      size_t nr_segments)
 {
+	struct bluedbm *bdbm = (struct bluedbm *)dev->d_private;
 	size_t blocks_per_segment;
 	size_t end_segment = segnum + nr_segments;
 	blocks_per_segment = device_get_blocks_per_segment(dev);
@@ -107,17 +150,18 @@ static void bluedbm_wait_erase_finish(struct device *dev, size_t segnum,
 		gint nr_erased_block;
 		gint status;
 
-		status = g_atomic_int_get(&g_badseg_counter[segnum]);
+		status = g_atomic_int_get(&bdbm->badseg_counter[segnum]);
 		if (status) {
 			set_bit(dev->badseg_bitmap, segnum);
 			segnum++;
 			continue;
 		}
 
-		nr_erased_block = g_atomic_int_get(&g_erase_counter[segnum]);
+		nr_erased_block =
+			g_atomic_int_get(&bdbm->erase_counter[segnum]);
 
 		if (nr_erased_block == (gint)blocks_per_segment) {
-			g_atomic_int_set(&g_erase_counter[segnum], 0);
+			g_atomic_int_set(&bdbm->erase_counter[segnum], 0);
 			segnum++;
 			continue;
 		}
@@ -162,6 +206,11 @@ int bluedbm_open(struct device *dev, const char *name, int flags)
 	pr_info("bdbm device spec : info->nr_bus: %d \t info->nr_chips: %d \t block->nr_pages: %d \t page->size: %d \t package->nr_blocks: %d \t nr_segments: %d \n", info->nr_bus, info->nr_chips, block->nr_pages, page->size, package->nr_blocks, nr_segments);
 
 	bdbm = (struct bluedbm *)dev->d_private;
+	if (!g_atomic_pointer_compare_and_exchange(&bluedbm_owner, NULL,
+						   bdbm)) {
+		pr_err("bluedbm is already opened by the other device\n");
+		return -EBUSY;
+	}
 	mio = memio_open();
 	if (mio == NULL) {
 		pr_err("memio open failed\n");
@@ -181,21 +230,29 @@ int bluedbm_open(struct device *dev, const char *name, int flags)
 	}
 	memset(dev->badseg_bitmap, 0, BITS_TO_UINT64_ALIGN(nr_segments));
 
-	g_erase_counter = (gint *)malloc(nr_segments * sizeof(gint));
-	if (g_erase_counter == NULL) {
+	bdbm->erase_counter = (gint *)malloc(nr_segments * sizeof(gint));
+	if (bdbm->erase_counter == NULL) {
+		pr_err("memory allocation failed\n");
+		ret = -ENOMEM;
+		goto exception;
+	}
+	memset(bdbm->erase_counter, 0, nr_segments * sizeof(gint));
+
+	bdbm->badseg_counter = (gint *)malloc(nr_segments * sizeof(gint));
+	if (bdbm->badseg_counter == NULL) {
 		pr_err("memory allocation failed\n");
 		ret = -ENOMEM;
 		goto exception;
 	}
-	memset(g_erase_counter, 0, nr_segments * sizeof(gint));
+	memset(bdbm->badseg_counter, 0, nr_segments * sizeof(gint));
 
-	g_badseg_counter = (gint *)malloc(nr_segments * sizeof(gint));
-	if (g_badseg_counter == NULL) {
+	bdbm->write_dma = bluedbm_alloc_dma(bdbm);
+	bdbm->read_dma = bluedbm_alloc_dma(bdbm);
+	if (bdbm->write_dma == NULL || bdbm->read_dma == NULL) {
 		pr_err("memory allocation failed\n");
 		ret = -ENOMEM;
 		goto exception;
 	}
-	memset(g_badseg_counter, 0, nr_segments * sizeof(gint));
 
 	if (bdbm->o_flags & O_CREAT) {
 		//pr_err("bdm clear! stt\n");
@@ -211,8 +268,6 @@ exception:
 	return ret;
 }
 
-long read_sum = 0, write_sum = 0;
-long read_cnt = 0, write_cnt = 0;
 /**
  * @brief end request for the read/write
  *
@@ -233,9 +288,9 @@ static void bluedbm_end_rw_request(async_bdbm_req *rw_req)
 	dma = (bluedbm_dma_t *)rw_req->private_data;
 	if (dma == NULL) {
 		pr_warn("NULL request detected (rw_req: %p)\n", rw_req);
-		free(rw_req);
 		return;
 	}
+	/**< the descriptor can be reused by the others after the tag is freed */
 	user_rq = (struct device_request *)dma->d_private;
 	assert(NULL != user_rq);
 
@@ -243,8 +298,8 @@ static void bluedbm_end_rw_request(async_bdbm_req *rw_req)
 	case REQTYPE_IO_WRITE:
 		clock_gettime(CLOCK_MONOTONIC, &end);
 		time_ns = (end.tv_sec - user_rq->begin.tv_sec) * 1000000000L + (end.tv_nsec - user_rq->begin.tv_nsec);
-		write_sum += time_ns;
-		write_cnt++;
+		dma->bdbm->write_sum += time_ns;
+		dma->bdbm->write_cnt++;
 		//printf("time of a write from device : %ld ns \n", time_ns);
 		memio_free_dma(DMA_WRITE_BUF, dma->tag);
 		break;
@@ -252,8 +307,8 @@ static void bluedbm_end_rw_request(async_bdbm_req *rw_req)
 		//printf("cnt : %d\n", read_cnt++);
 		clock_gettime(CLOCK_MONOTONIC, &end);
 		time_ns = (end.tv_sec - user_rq->begin.tv_sec) * 1000000000L + (end.tv_nsec - user_rq->begin.tv_nsec);
-		read_sum += time_ns;
-		read_cnt++;
+		dma->bdbm->read_sum += time_ns;
+		dma->bdbm->read_cnt++;
 		//printf("time of a read from device : %ld ns \n", time_ns);
 		memcpy(user_rq->data, dma->data, user_rq->data_len);
 		memio_free_dma(DMA_READ_BUF, dma->tag);
@@ -263,8 +318,6 @@ static void bluedbm_end_rw_request(async_bdbm_req *rw_req)
 			rw_req->type);
 		break;
 	}
-	free(dma);
-	free(rw_req);
 
 	if (user_rq && user_rq->end_rq) {
 		user_rq->end_rq(user_rq);
@@ -281,9 +334,10 @@ static void bluedbm_end_rw_request(async_bdbm_req *rw_req)
  */
 ssize_t bluedbm_write(struct device *dev, struct device_request *request)
 {
-	bluedbm_dma_t *dma = NULL;
-	async_bdbm_req *write_rq = NULL;
+	bluedbm_dma_t *dma;
 	memio_t *mio;
+	char *data;
+	int tag;
 
 	struct bluedbm *bdbm;
 
@@ -330,38 +384,28 @@ ssize_t bluedbm_write(struct device *dev, struct device_request *request)
 
 	lpn = request->paddr.lpn;
 
-	dma = (bluedbm_dma_t *)malloc(sizeof(bluedbm_dma_t));
-	if (dma == NULL) {
-		pr_err("dma cannot be allocated\n");
-		ret = -errno;
+	tag = memio_alloc_dma(DMA_WRITE_BUF, &data);
+	if (tag < 0 || tag >= BLUEDBM_NR_DMA_TAGS) {
+		pr_err("DMA tag is out of range (tag: %d, max: %d)\n", tag,
+		       BLUEDBM_NR_DMA_TAGS);
+		if (tag >= 0) {
+			memio_free_dma(DMA_WRITE_BUF, tag);
+		}
+		ret = -EFAULT;
 		goto exception;
 	}
-	dma->tag = memio_alloc_dma(DMA_WRITE_BUF, &dma->data);
+	dma = &bdbm->write_dma[tag];
+	dma->data = data;
 	dma->d_private = (void *)request;
+	dma->rw_req.type = REQTYPE_IO_WRITE;
 	memcpy(dma->data, request->data, page_size);
 
-	write_rq = (async_bdbm_req *)malloc(sizeof(async_bdbm_req));
-	if (write_rq == NULL) {
-		pr_err("memory allocation failed\n");
-		ret = -ENOMEM;
-		goto exception;
-	}
-	write_rq->type = REQTYPE_IO_WRITE;
-	write_rq->private_data = (void *)dma;
-	write_rq->end_req = bluedbm_end_rw_request;
-
 	clock_gettime(CLOCK_MONOTONIC, &request->begin);
 	ret = memio_write(mio, lpn, page_size, (uint8_t *)dma->data, false,
-			  (void *)write_rq, dma->tag);
+			  (void *)&dma->rw_req, dma->tag);
 
 	return ret;
 exception:
-	if (write_rq) {
-		free(write_rq);
-	}
-	if (dma) {
-		free(dma);
-	}
 	return ret;
 }
 
@@ -375,9 +419,10 @@ exception:
  */
 ssize_t bluedbm_read(struct device *dev, struct device_request *request)
 {
-	bluedbm_dma_t *dma = NULL;
-	async_bdbm_req *read_rq = NULL;
+	bluedbm_dma_t *dma;
 	memio_t *mio;
+	char *data;
+	int tag;
 
 	struct bluedbm *bdbm;
 
@@ -422,36 +467,26 @@ ssize_t bluedbm_read(struct device *dev, struct device_request *request)
 
 	lpn = request->paddr.lpn;
 
-	dma = (bluedbm_dma_t *)malloc(sizeof(bluedbm_dma_t));
-	if (dma == NULL) {
-		pr_err("memory allocation failed\n");
-		ret = -ENOMEM;
+	tag = memio_alloc_dma(DMA_READ_BUF, &data);
+	if (tag < 0 || tag >= BLUEDBM_NR_DMA_TAGS) {
+		pr_err("DMA tag is out of range (tag: %d, max: %d)\n", tag,
+		       BLUEDBM_NR_DMA_TAGS);
+		if (tag >= 0) {
+			memio_free_dma(DMA_READ_BUF, tag);
+		}
+		ret = -EFAULT;
 		goto exception;
 	}
-	dma->tag = memio_alloc_dma(DMA_READ_BUF, &dma->data);
+	dma = &bdbm->read_dma[tag];
+	dma->data = data;
 	dma->d_private = (void *)request;
-
-	read_rq = (async_bdbm_req *)malloc(sizeof(async_bdbm_req));
-	if (read_rq == NULL) {
-		pr_err("memory allocation failed\n");
-		ret = -ENOMEM;
-		goto exception;
-	}
-	read_rq->type = REQTYPE_IO_READ;
-	read_rq->private_data = (void *)dma;
-	read_rq->end_req = bluedbm_end_rw_request;
+	dma->rw_req.type = REQTYPE_IO_READ;
 	clock_gettime(CLOCK_MONOTONIC, &request->begin);
 
 	ret = memio_read(mio, lpn, page_size, (uint8_t *)dma->data, false,
-			 (void *)read_rq, dma->tag);
+			 (void *)&dma->rw_req, dma->tag);
 	return ret;
 exception:
-	if (read_rq) {
-		free(read_rq);
-	}
-	if (dma) {
-		free(dma);
-	}
 	return ret;
 }
 
@@ -540,18 +575,31 @@ int bluedbm_close(struct device *dev)
 		dev->badseg_bitmap = NULL;
 	}
 
-	if (g_erase_counter) {
-		free(g_erase_counter);
-		g_erase_counter = NULL;
+	if (bdbm->erase_counter) {
+		free(bdbm->erase_counter);
+		bdbm->erase_counter = NULL;
+	}
+
+	if (bdbm->badseg_counter) {
+		free(bdbm->badseg_counter);
+		bdbm->badseg_counter = NULL;
 	}
 
-	if (g_badseg_counter) {
-		free(g_badseg_counter);
-		g_badseg_counter = NULL;
+	free(bdbm->write_dma);
+	free(bdbm->read_dma);
+	bdbm->write_dma = NULL;
+	bdbm->read_dma = NULL;
+
+	if (bdbm->write_cnt) {
+		printf("Average of all write(device code layer) times : %ld ns \n",
+		       bdbm->write_sum / bdbm->write_cnt);
+	}
+	if (bdbm->read_cnt) {
+		printf("Average of all read(device code layer) times : %ld ns \n",
+		       bdbm->read_sum / bdbm->read_cnt);
 	}
 
-	printf("Average of all write(device code layer) times : %ld ns \n", write_sum/write_cnt);
-	printf("Average of all read(device code layer) times : %ld ns \n", read_sum/read_cnt);
+	g_atomic_pointer_compare_and_exchange(&bluedbm_owner, bdbm, NULL);
 
 	return 0;
 }
@@ -565,6 +613,8 @@ const struct device_operations __bluedbm_dops = {
 	.read = bluedbm_read,
 	.erase = bluedbm_erase,
 	.close = bluedbm_close,
+	.flush = NULL,
+	.get_bus_node = NULL,
 };
 
 /**
@@ -93,6 +93,31 @@ void device_free_request(struct device_request *request)
 	free(request);
 }
 
+/**
+ * @brief allocate the data buffer which the device can use directly
+ *
+ * @param size size of the buffer (bytes)
+ *
+ * @return pointer of the buffer, NULL for fail
+ *
+ * @note
+ * The buffer is aligned by the `DEVICE_BUFFER_ALIGN`, so the device opened
+ * with the `O_DIRECT` does not need the bounce buffer. Deallocate it by the
+ * `free()`.
+ */
+void *device_alloc_buffer(size_t size)
+{
+	void *buffer;
+	int ret;
+
+	ret = posix_memalign(&buffer, DEVICE_BUFFER_ALIGN, size);
+	if (ret) {
+		errno = ret;
+		return NULL;
+	}
+	return buffer;
+}
+
 /**
  * @brief initialize the device module
  *
@@ -0,0 +1,454 @@
+/**
+ * @file part.c
+ * @brief implementation of the partition(namespace) layer
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "part.h"
+#include "device.h"
+#include "log.h"
+#include "bits.h"
+
+/**
+ * @brief partition module operations
+ */
+const struct device_operations __part_dops = {
+	.open = part_open,
+	.write = part_write,
+	.read = part_read,
+	.erase = part_erase,
+	.close = part_close,
+	.flush = part_flush,
+	.get_bus_node = part_get_bus_node,
+};
+
+/**
+ * @brief get the segment range of the partition
+ *
+ * @param part pointer of the partition structure
+ * @param nr_segments number of segments in the parent device
+ *
+ * @note
+ * The segments are split equally and the last partition takes the remains.
+ */
+static void part_set_range(struct part *part, size_t nr_segments)
+{
+	size_t nr_parts = part->shared->nr_parts;
+	size_t segments_per_part = nr_segments / nr_parts;
+
+	part->base_segnum = part->id * segments_per_part;
+	part->nr_segments = segments_per_part;
+	if (part->id == nr_parts - 1) {
+		part->nr_segments = nr_segments - part->base_segnum;
+	}
+}
+
+/**
+ * @brief convert the partition's address to the parent's address
+ *
+ * @param dev pointer of the partition's device structure
+ * @param request pointer of the device request structure
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * The request's address is changed in place. Because the parent may call the
+ * `end_rq` (which can free the request) before returning, the address is
+ * not restored after the submission.
+ */
+static int part_convert_address(struct device *dev,
+				struct device_request *request)
+{
+	struct part *part = (struct part *)dev->d_private;
+	size_t segnum;
+
+	if (request->paddr.lpn == PADDR_EMPTY) {
+		pr_err("physical address is not specified...\n");
+		return -EINVAL;
+	}
+	segnum = request->paddr.format.block;
+	if (segnum >= part->nr_segments) {
+		pr_err("segment number overflow (part: %zu, segnum: %zu, max: %zu)\n",
+		       part->id, segnum, part->nr_segments);
+		return -EINVAL;
+	}
+	request->paddr.format.block =
+		(part->base_segnum + segnum) & ((1U << DEVICE_NR_BLOCKS_BITS) - 1);
+	return 0;
+}
+
+/**
+ * @brief open the partition
+ *
+ * @param dev pointer of the partition's device structure
+ * @param name device name passed to the parent device
+ * @param flags open flags passed to the parent device
+ *
+ * @return 0 for success, negative value to fail
+ *
+ * @note
+ * The first opened partition opens the parent device.
+ */
+int part_open(struct device *dev, const char *name, int flags)
+{
+	struct part *part = (struct part *)dev->d_private;
+	struct part_shared *shared = part->shared;
+	struct device *parent = shared->parent;
+	size_t segnum;
+	int ret = 0;
+
+	pthread_mutex_lock(&shared->mutex);
+	if (shared->nr_opened == 0) {
+		ret = parent->d_op->open(parent, name, flags);
+		if (ret) {
+			pr_err("parent device open failed (errno: %d)\n", ret);
+			pthread_mutex_unlock(&shared->mutex);
+			return ret;
+		}
+	}
+	shared->nr_opened++;
+	pthread_mutex_unlock(&shared->mutex);
+	part->o_flags = flags;
+
+	part_set_range(part, device_get_nr_segments(parent));
+	if (part->nr_segments == 0) {
+		pr_err("partition doesn't have any segment (part: %zu)\n",
+		       part->id);
+		ret = -ENOSPC;
+		goto exception;
+	}
+
+	dev->info = parent->info;
+	dev->info.package.nr_blocks = part->nr_segments;
+	if (parent->info.max_open_segments) {
+		/**< the partitions share the parent's open segments */
+		dev->info.max_open_segments = parent->info.max_open_segments /
+					      part->shared->nr_parts;
+		if (dev->info.max_open_segments == 0) {
+			dev->info.max_open_segments = 1;
+		}
+	}
+
+	if (parent->badseg_bitmap) {
+		dev->badseg_bitmap = (uint64_t *)malloc(
+			BITS_TO_UINT64_ALIGN(part->nr_segments));
+		if (dev->badseg_bitmap == NULL) {
+			pr_err("memory allocation failed\n");
+			ret = -ENOMEM;
+			goto exception;
+		}
+		memset(dev->badseg_bitmap, 0,
+		       BITS_TO_UINT64_ALIGN(part->nr_segments));
+		for (segnum = 0; segnum < part->nr_segments; segnum++) {
+			if (get_bit(parent->badseg_bitmap,
+				    part->base_segnum + segnum)) {
+				set_bit(dev->badseg_bitmap, segnum);
+			}
+		}
+	}
+
+	pr_info("partition opened (part: %zu, segments: %zu ~ %zu)\n", part->id,
+		part->base_segnum, part->base_segnum + part->nr_segments - 1);
+	return 0;
+exception:
+	part_close(dev);
+	return ret;
+}
+
+/**
+ * @brief write to the partition
+ *
+ * @param dev pointer of the partition's device structure
+ * @param request pointer of the device request structure
+ *
+ * @return written size (bytes)
+ */
+ssize_t part_write(struct device *dev, struct device_request *request)
+{
+	struct part *part = (struct part *)dev->d_private;
+	struct device *parent = part->shared->parent;
+	ssize_t ret;
+
+	ret = part_convert_address(dev, request);
+	if (ret) {
+		return ret;
+	}
+	return parent->d_op->write(parent, request);
+}
+
+/**
+ * @brief read from the partition
+ *
+ * @param dev pointer of the partition's device structure
+ * @param request pointer of the device request structure
+ *
+ * @return read size (bytes)
+ */
+ssize_t part_read(struct device *dev, struct device_request *request)
+{
+	struct part *part = (struct part *)dev->d_private;
+	struct device *parent = part->shared->parent;
+	ssize_t ret;
+
+	ret = part_convert_address(dev, request);
+	if (ret) {
+		return ret;
+	}
+	return parent->d_op->read(parent, request);
+}
+
+/**
+ * @brief erase a segment of the partition
+ *
+ * @param dev pointer of the partition's device structure
+ * @param request pointer of the device request structure
+ *
+ * @return 0 for success, negative value for fail
+ */
+int part_erase(struct device *dev, struct device_request *request)
+{
+	struct part *part = (struct part *)dev->d_private;
+	struct device *parent = part->shared->parent;
+	int ret;
+
+	ret = part_convert_address(dev, request);
+	if (ret) {
+		return ret;
+	}
+	return parent->d_op->erase(parent, request);
+}
+
+/**
+ * @brief persist the parent device's data
+ *
+ * @param dev pointer of the partition's device structure
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * The parent device is shared, so every partition's data is flushed.
+ */
+int part_flush(struct device *dev)
+{
+	struct part *part = (struct part *)dev->d_private;
+	struct device *parent = part->shared->parent;
+
+	if (parent->d_op->flush == NULL) {
+		return 0;
+	}
+	return parent->d_op->flush(parent);
+}
+
+/**
+ * @brief get the NUMA node of the parent device's bus
+ *
+ * @param dev pointer of the partition's device structure
+ * @param bus bus number
+ *
+ * @return node number, negative value for unknown
+ *
+ * @note
+ * The partitions split the segments, so every partition has all buses.
+ */
+int part_get_bus_node(struct device *dev, size_t bus)
+{
+	struct part *part = (struct part *)dev->d_private;
+	struct device *parent = part->shared->parent;
+
+	if (parent->d_op->get_bus_node == NULL) {
+		return -1;
+	}
+	return parent->d_op->get_bus_node(parent, bus);
+}
+
+/**
+ * @brief close the partition
+ *
+ * @param dev pointer of the partition's device structure
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * The last closed partition closes the parent device.
+ */
+int part_close(struct device *dev)
+{
+	struct part *part = (struct part *)dev->d_private;
+	struct part_shared *shared;
+	int ret = 0;
+
+	if (part == NULL || part->o_flags == -1) {
+		return 0;
+	}
+	shared = part->shared;
+
+	if (dev->badseg_bitmap) {
+		free(dev->badseg_bitmap);
+		dev->badseg_bitmap = NULL;
+	}
+
+	pthread_mutex_lock(&shared->mutex);
+	shared->nr_opened--;
+	if (shared->nr_opened == 0) {
+		ret = shared->parent->d_op->close(shared->parent);
+	}
+	pthread_mutex_unlock(&shared->mutex);
+	part->o_flags = -1;
+	return ret;
+}
+
+/**
+ * @brief deallocate the partition
+ *
+ * @param dev pointer of the partition's device structure
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * The last exited partition deallocates the parent device.
+ */
+int part_device_exit(struct device *dev)
+{
+	struct part *part = (struct part *)dev->d_private;
+	struct part_shared *shared;
+	int nr_refs;
+
+	if (part == NULL) {
+		return 0;
+	}
+	part_close(dev);
+	shared = part->shared;
+	free(part);
+	dev->d_private = NULL;
+
+	pthread_mutex_lock(&shared->mutex);
+	nr_refs = --shared->nr_refs;
+	pthread_mutex_unlock(&shared->mutex);
+	if (nr_refs == 0) {
+		device_module_exit(shared->parent);
+		pthread_mutex_destroy(&shared->mutex);
+		free(shared);
+	}
+	return 0;
+}
+
+/**
+ * @brief allocate the partition's device structure
+ *
+ * @param shared pointer of the shared information
+ * @param id partition number
+ * @param __dev device structure pointer (will be allocated)
+ *
+ * @return 0 for success, negative value for fail
+ */
+static int part_device_init(struct part_shared *shared, size_t id,
+			    struct device **__dev)
+{
+	struct device *dev;
+	struct part *part;
+
+	dev = (struct device *)malloc(sizeof(struct device));
+	if (dev == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	memset(dev, 0, sizeof(struct device));
+	pthread_mutex_init(&dev->mutex, NULL);
+
+	part = (struct part *)malloc(sizeof(struct part));
+	if (part == NULL) {
+		pr_err("memory allocation failed\n");
+		device_module_exit(dev);
+		return -ENOMEM;
+	}
+	memset(part, 0, sizeof(struct part));
+	part->shared = shared;
+	part->id = id;
+	part->o_flags = -1; /**< not opened */
+
+	dev->d_op = &__part_dops;
+	dev->d_private = (void *)part;
+	dev->d_submodule_exit = part_device_exit;
+
+	pthread_mutex_lock(&shared->mutex);
+	shared->nr_refs++;
+	pthread_mutex_unlock(&shared->mutex);
+
+	*__dev = dev;
+	return 0;
+}
+
+/**
+ * @brief split the one device into the partitions
+ *
+ * @param modnum parent device's module number
+ * @param parts array of the device pointer (will be allocated)
+ * @param nr_parts number of partitions
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * Each partition is the independent `struct device`, so each partition can be
+ * used by its own FTL. Deallocate each partition by `device_module_exit()`,
+ * and the parent device is deallocated with the last partition.
+ */
+int part_create(const uint64_t modnum, struct device **parts, size_t nr_parts)
+{
+	struct part_shared *shared;
+	size_t idx;
+	int ret;
+
+	if (parts == NULL || nr_parts == 0) {
+		pr_err("invalid partition parameter (parts: %p, nr_parts: %zu)\n",
+		       parts, nr_parts);
+		return -EINVAL;
+	}
+	memset(parts, 0, sizeof(struct device *) * nr_parts);
+
+	shared = (struct part_shared *)malloc(sizeof(struct part_shared));
+	if (shared == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	memset(shared, 0, sizeof(struct part_shared));
+	pthread_mutex_init(&shared->mutex, NULL);
+	shared->nr_parts = nr_parts;
+
+	ret = device_module_init(modnum, &shared->parent, 0);
+	if (ret) {
+		pr_err("initialize the parent device failed\n");
+		pthread_mutex_destroy(&shared->mutex);
+		free(shared);
+		return ret;
+	}
+
+	for (idx = 0; idx < nr_parts; idx++) {
+		ret = part_device_init(shared, idx, &parts[idx]);
+		if (ret) {
+			pr_err("initialize the partition failed (part: %zu)\n",
+			       idx);
+			goto exception;
+		}
+	}
+	return 0;
+exception:
+	if (idx == 0) {
+		device_module_exit(shared->parent);
+		pthread_mutex_destroy(&shared->mutex);
+		free(shared);
+		return ret;
+	}
+	while (idx > 0) {
+		idx--;
+		device_module_exit(parts[idx]);
+		parts[idx] = NULL;
+	}
+	return ret;
+}
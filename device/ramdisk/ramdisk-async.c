@@ -0,0 +1,245 @@
+/**
+ * @file ramdisk-async.c
+ * @brief asynchronous ramdisk which processes the requests by worker threads
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ *
+ * @note
+ * Each bus has a queue and a worker thread. The submission only validates
+ * the request, and the worker copies the data and calls the `end_rq`.
+ * The requests to the same chip are always processed in the submitted order
+ * (e.g., the read after the write sees the written data).
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ramdisk.h"
+#include "device.h"
+#include "log.h"
+
+/**
+ * @brief pick the next request from the bus queue
+ *
+ * @param ramdisk pointer of the ramdisk
+ * @param bus pointer of the bus queue (it must not be empty)
+ *
+ * @return list node of the request
+ *
+ * @note
+ * The out-of-order mode picks a random chip, and its oldest request is
+ * processed. So, the requests are reordered only between the chips.
+ */
+static GList *ramdisk_async_pick(struct ramdisk *ramdisk,
+				 struct ramdisk_async_bus *bus)
+{
+	struct device_request *request;
+	GList *node;
+	uint32_t chip;
+
+	if (!ramdisk->is_out_of_order || bus->head == bus->tail) {
+		return bus->head;
+	}
+	node = g_list_nth(bus->head,
+			  (guint)((size_t)rand_r(&bus->seed) % bus->nr_queued));
+	chip = ((struct device_request *)node->data)->paddr.format.chip;
+	for (node = bus->head; node != NULL; node = node->next) {
+		request = (struct device_request *)node->data;
+		if (request->paddr.format.chip == chip) {
+			break;
+		}
+	}
+	return node;
+}
+
+/**
+ * @brief worker thread which processes the bus queue
+ *
+ * @param data pointer of the bus queue
+ *
+ * @return NULL
+ *
+ * @note
+ * The worker finishes after the queue is drained.
+ */
+static void *ramdisk_async_thread(void *data)
+{
+	struct ramdisk_async_bus *bus = (struct ramdisk_async_bus *)data;
+	struct ramdisk *ramdisk = (struct ramdisk *)bus->dev->d_private;
+	struct device_request *request;
+	GList *node;
+	int ret;
+
+	pthread_mutex_lock(&bus->mutex);
+	while (!bus->is_stop || bus->head != NULL) {
+		if (bus->head == NULL) {
+			pthread_cond_wait(&bus->cond, &bus->mutex);
+			continue;
+		}
+		node = ramdisk_async_pick(ramdisk, bus);
+		if (node == bus->tail) {
+			bus->tail = node->prev;
+		}
+		request = (struct device_request *)node->data;
+		bus->head = g_list_delete_link(bus->head, node);
+		pthread_mutex_unlock(&bus->mutex);
+
+		ret = ramdisk_execute(bus->dev, request);
+		if (ret) {
+			pr_err("request completion failed (errno: %d)\n", ret);
+		}
+
+		pthread_mutex_lock(&bus->mutex);
+		bus->nr_queued--;
+		if (bus->nr_queued == 0) {
+			pthread_cond_broadcast(&bus->idle);
+		}
+	}
+	pthread_mutex_unlock(&bus->mutex);
+	return NULL;
+}
+
+/**
+ * @brief queue the validated request to its bus
+ *
+ * @param dev pointer of the device structure
+ * @param request request which wants to process
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * The request and its data must be valid until the `end_rq` is called.
+ */
+int ramdisk_async_submit(struct device *dev, struct device_request *request)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	struct ramdisk_async_bus *bus;
+
+	bus = &ramdisk->buses[request->paddr.format.bus];
+	pthread_mutex_lock(&bus->mutex);
+	bus->tail = g_list_append(bus->tail, request);
+	if (bus->head == NULL) {
+		bus->head = bus->tail;
+	} else {
+		bus->tail = bus->tail->next;
+	}
+	bus->nr_queued++;
+	pthread_cond_signal(&bus->cond);
+	pthread_mutex_unlock(&bus->mutex);
+	return 0;
+}
+
+/**
+ * @brief wait until every bus queue is empty
+ *
+ * @param dev pointer of the device structure
+ */
+void ramdisk_async_drain(struct device *dev)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	struct ramdisk_async_bus *bus;
+	size_t i;
+
+	for (i = 0; i < dev->info.nr_bus; i++) {
+		bus = &ramdisk->buses[i];
+		pthread_mutex_lock(&bus->mutex);
+		while (bus->nr_queued > 0) {
+			pthread_cond_wait(&bus->idle, &bus->mutex);
+		}
+		pthread_mutex_unlock(&bus->mutex);
+	}
+}
+
+/**
+ * @brief stop the workers of the bus queues
+ *
+ * @param buses array of the bus queues
+ * @param nr_bus number of the running workers
+ */
+static void ramdisk_async_stop(struct ramdisk_async_bus *buses, size_t nr_bus)
+{
+	struct ramdisk_async_bus *bus;
+	size_t i;
+
+	for (i = 0; i < nr_bus; i++) {
+		bus = &buses[i];
+		pthread_mutex_lock(&bus->mutex);
+		bus->is_stop = 1;
+		pthread_cond_signal(&bus->cond);
+		pthread_mutex_unlock(&bus->mutex);
+		pthread_join(bus->thread, NULL);
+
+		pthread_cond_destroy(&bus->idle);
+		pthread_cond_destroy(&bus->cond);
+		pthread_mutex_destroy(&bus->mutex);
+	}
+}
+
+/**
+ * @brief allocate the bus queues and run the workers
+ *
+ * @param dev pointer of the device structure
+ *
+ * @return 0 for success, negative value for fail
+ */
+int ramdisk_async_init(struct device *dev)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	struct ramdisk_async_bus *buses, *bus;
+	size_t nr_bus, i;
+	int ret;
+
+	nr_bus = dev->info.nr_bus;
+	buses = (struct ramdisk_async_bus *)malloc(
+		sizeof(struct ramdisk_async_bus) * nr_bus);
+	if (buses == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	memset(buses, 0, sizeof(struct ramdisk_async_bus) * nr_bus);
+
+	for (i = 0; i < nr_bus; i++) {
+		bus = &buses[i];
+		bus->dev = dev;
+		bus->seed = (unsigned int)i;
+		pthread_mutex_init(&bus->mutex, NULL);
+		pthread_cond_init(&bus->cond, NULL);
+		pthread_cond_init(&bus->idle, NULL);
+		ret = pthread_create(&bus->thread, NULL, ramdisk_async_thread,
+				     (void *)bus);
+		if (ret) {
+			pr_err("worker thread creation failed (bus: %zu)\n",
+			       i);
+			pthread_cond_destroy(&bus->idle);
+			pthread_cond_destroy(&bus->cond);
+			pthread_mutex_destroy(&bus->mutex);
+			ramdisk_async_stop(buses, i);
+			free(buses);
+			return -ret;
+		}
+	}
+	ramdisk->buses = buses;
+	pr_info("asynchronous mode enabled (workers: %zu, out-of-order: %s)\n",
+		nr_bus, ramdisk->is_out_of_order ? "on" : "off");
+	return 0;
+}
+
+/**
+ * @brief process the queued requests and deallocate the bus queues
+ *
+ * @param dev pointer of the device structure
+ */
+void ramdisk_async_free(struct device *dev)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+
+	if (ramdisk->buses == NULL) {
+		return;
+	}
+	ramdisk_async_stop(ramdisk->buses, dev->info.nr_bus);
+	free(ramdisk->buses);
+	ramdisk->buses = NULL;
+}
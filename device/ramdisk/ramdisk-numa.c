@@ -0,0 +1,177 @@
+/**
+ * @file ramdisk-numa.c
+ * @brief NUMA placement of the ramdisk's bus regions
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ *
+ * @note
+ * The memory policy is set before the regions are touched (the mapping is
+ * lazily allocated), so each page is allocated on the policy's node when it
+ * is written first. The `RAMDISK_NUMA_LOCAL` binds the buses to the nodes in
+ * order (e.g., 8 buses on 2 nodes: bus 0~3 to node 0, bus 4~7 to node 1).
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef RAMDISK_USE_NUMA
+#include <numa.h>
+#include <numaif.h>
+#endif
+
+#include "ramdisk.h"
+#include "device.h"
+#include "log.h"
+
+#ifdef RAMDISK_USE_NUMA
+/**
+ * @brief set the memory policy of the region
+ *
+ * @param region start address of the region (page aligned)
+ * @param size size of the region (bytes)
+ * @param mode memory policy (`MPOL_BIND` or `MPOL_INTERLEAVE`)
+ * @param nodes nodes of the policy
+ *
+ * @return 0 for success, negative value for fail
+ */
+static int ramdisk_numa_bind(char *region, size_t size, int mode,
+			     struct bitmask *nodes)
+{
+	if (mbind(region, size, mode, nodes->maskp, nodes->size + 1, 0)) {
+		pr_err("memory policy setting failed (errno: %d)\n", errno);
+		return -errno;
+	}
+	return 0;
+}
+
+/**
+ * @brief place the bus regions on the NUMA nodes
+ *
+ * @param dev pointer of the device structure
+ *
+ * @return 0 for success, negative value for fail
+ */
+static int ramdisk_numa_place(struct device *dev)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	struct bitmask *nodes;
+	size_t nr_bus, bus_size, bus;
+	int nr_nodes, node;
+	int ret = 0;
+
+	if (numa_available() < 0) {
+		pr_warn("NUMA is not available (first-touch placement is used)\n");
+		return 0;
+	}
+	if (ramdisk->is_persistent) {
+		pr_warn("placement of the backing file is decided by the page cache\n");
+		return 0;
+	}
+
+	nr_bus = dev->info.nr_bus;
+	bus_size = ramdisk->size / nr_bus;
+	nr_nodes = numa_num_configured_nodes();
+	if (ramdisk->numa_policy == RAMDISK_NUMA_INTERLEAVE) {
+		ret = ramdisk_numa_bind(ramdisk->buffer, ramdisk->size,
+					MPOL_INTERLEAVE, numa_all_nodes_ptr);
+		if (ret == 0) {
+			pr_info("bus regions are interleaved (nodes: %d)\n",
+				nr_nodes);
+		}
+		return ret;
+	}
+
+	nodes = numa_allocate_nodemask();
+	if (nodes == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	for (bus = 0; bus < nr_bus; bus++) {
+		node = (int)(bus * (size_t)nr_nodes / nr_bus);
+		numa_bitmask_clearall(nodes);
+		numa_bitmask_setbit(nodes, (unsigned int)node);
+		ret = ramdisk_numa_bind(&ramdisk->buffer[bus * bus_size],
+					bus_size, MPOL_BIND, nodes);
+		if (ret) {
+			break;
+		}
+		ramdisk->bus_node[bus] = node;
+		pr_debug("bus %zu is bound to the node %d\n", bus, node);
+	}
+	numa_free_nodemask(nodes);
+	if (ret == 0) {
+		pr_info("bus regions are bound to the local nodes (nodes: %d)\n",
+			nr_nodes);
+	}
+	return ret;
+}
+#endif
+
+/**
+ * @brief allocate the bus-to-node table and place the bus regions
+ *
+ * @param dev pointer of the device structure
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * This must be called before the buffer is touched.
+ */
+int ramdisk_numa_init(struct device *dev)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	size_t nr_bus, bus;
+
+	nr_bus = dev->info.nr_bus;
+	ramdisk->bus_node = (int *)malloc(sizeof(int) * nr_bus);
+	if (ramdisk->bus_node == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	for (bus = 0; bus < nr_bus; bus++) {
+		ramdisk->bus_node[bus] = -1;
+	}
+	if (ramdisk->numa_policy == RAMDISK_NUMA_NONE) {
+		return 0;
+	}
+#ifdef RAMDISK_USE_NUMA
+	return ramdisk_numa_place(dev);
+#else
+	pr_warn("NUMA support is not built (first-touch placement is used)\n");
+	return 0;
+#endif
+}
+
+/**
+ * @brief get the NUMA node of the bus region
+ *
+ * @param dev pointer of the device structure
+ * @param bus bus number
+ *
+ * @return node number, negative value for the unbound region
+ */
+int ramdisk_get_bus_node(struct device *dev, size_t bus)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+
+	if (ramdisk == NULL || ramdisk->bus_node == NULL ||
+	    bus >= dev->info.nr_bus) {
+		return -1;
+	}
+	return ramdisk->bus_node[bus];
+}
+
+/**
+ * @brief deallocate the bus-to-node table
+ *
+ * @param dev pointer of the device structure
+ */
+void ramdisk_numa_free(struct device *dev)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+
+	free(ramdisk->bus_node);
+	ramdisk->bus_node = NULL;
+}
@@ -0,0 +1,377 @@
+/**
+ * @file ramdisk-timing.c
+ * @brief NAND timing emulation of the ramdisk
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ *
+ * @note
+ * The data is copied when the request is submitted. Only the completion
+ * (`end_rq`) is delayed until the modeled time, which is derived from the
+ * busy-until time of the request's channel(bus) and chip.
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "ramdisk.h"
+#include "device.h"
+#include "log.h"
+
+/**
+ * @brief request which waits for the modeled completion time
+ */
+struct ramdisk_timing_entry {
+	uint64_t deadline; /**< CLOCK_MONOTONIC (ns) */
+	uint64_t seq; /**< submission order which breaks the tie */
+	struct device_request *request;
+};
+
+/**
+ * @brief get the current time
+ *
+ * @return CLOCK_MONOTONIC time (ns)
+ */
+static inline uint64_t ramdisk_timing_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static inline uint64_t ramdisk_timing_max(uint64_t a, uint64_t b)
+{
+	return a > b ? a : b;
+}
+
+/**
+ * @brief check the entry should be completed before the other
+ *
+ * @param a entry which wants to compare
+ * @param b entry which is compared
+ *
+ * @return 1 if `a` precedes `b`, 0 for the others
+ */
+static inline int ramdisk_timing_precede(const struct ramdisk_timing_entry *a,
+					 const struct ramdisk_timing_entry *b)
+{
+	if (a->deadline != b->deadline) {
+		return a->deadline < b->deadline;
+	}
+	return a->seq < b->seq;
+}
+
+/**
+ * @brief push the entry to the pending heap
+ *
+ * @param queue pointer of the timing queue
+ * @param entry entry which is pushed
+ *
+ * @note
+ * The caller must hold the queue's mutex and guarantee the free slot.
+ */
+static void ramdisk_timing_push(struct ramdisk_timing_queue *queue,
+				struct ramdisk_timing_entry entry)
+{
+	struct ramdisk_timing_entry *pending = queue->pending;
+	size_t pos, parent;
+
+	pos = queue->nr_inflight++;
+	while (pos > 0) {
+		parent = (pos - 1) / 2;
+		if (!ramdisk_timing_precede(&entry, &pending[parent])) {
+			break;
+		}
+		pending[pos] = pending[parent];
+		pos = parent;
+	}
+	pending[pos] = entry;
+}
+
+/**
+ * @brief pop the earliest entry from the pending heap
+ *
+ * @param queue pointer of the timing queue
+ *
+ * @return request of the popped entry
+ *
+ * @note
+ * The caller must hold the queue's mutex and guarantee the heap is not
+ * empty.
+ */
+static struct device_request *
+ramdisk_timing_pop(struct ramdisk_timing_queue *queue)
+{
+	struct ramdisk_timing_entry *pending = queue->pending;
+	struct ramdisk_timing_entry last;
+	struct device_request *request;
+	size_t pos, child;
+
+	request = pending[0].request;
+	last = pending[--queue->nr_inflight];
+
+	pos = 0;
+	while ((child = pos * 2 + 1) < queue->nr_inflight) {
+		if (child + 1 < queue->nr_inflight &&
+		    ramdisk_timing_precede(&pending[child + 1],
+					   &pending[child])) {
+			child++;
+		}
+		if (!ramdisk_timing_precede(&pending[child], &last)) {
+			break;
+		}
+		pending[pos] = pending[child];
+		pos = child;
+	}
+	pending[pos] = last;
+	return request;
+}
+
+/**
+ * @brief completion thread which calls the `end_rq` at the modeled time
+ *
+ * @param data pointer of the timing queue
+ *
+ * @return NULL
+ *
+ * @note
+ * The thread finishes after the pending requests are drained.
+ */
+static void *ramdisk_timing_thread(void *data)
+{
+	struct ramdisk_timing_queue *queue = (struct ramdisk_timing_queue *)data;
+	struct device_request *request;
+	struct timespec deadline;
+	uint64_t earliest;
+
+	pthread_mutex_lock(&queue->mutex);
+	while (!queue->is_stop || queue->nr_inflight > 0) {
+		if (queue->nr_inflight == 0) {
+			pthread_cond_wait(&queue->cond, &queue->mutex);
+			continue;
+		}
+		earliest = queue->pending[0].deadline;
+		if (earliest > ramdisk_timing_now()) {
+			deadline.tv_sec = (time_t)(earliest / 1000000000ULL);
+			deadline.tv_nsec = (long)(earliest % 1000000000ULL);
+			pthread_cond_timedwait(&queue->cond, &queue->mutex,
+					       &deadline);
+			continue;
+		}
+		request = ramdisk_timing_pop(queue);
+		pthread_cond_signal(&queue->space);
+		pthread_mutex_unlock(&queue->mutex);
+
+		if (request->end_rq) {
+			request->end_rq(request);
+		}
+		pthread_mutex_lock(&queue->mutex);
+	}
+	pthread_mutex_unlock(&queue->mutex);
+	return NULL;
+}
+
+/**
+ * @brief reserve the channel and chips, and get the completion time
+ *
+ * @param dev pointer of the device structure
+ * @param request request which wants to submit
+ * @param now submission time (ns)
+ *
+ * @return modeled completion time (ns)
+ *
+ * @note
+ * - write: transfer on the channel, then program in the chip
+ * - read: sense in the chip, then transfer on the channel (the chip holds
+ *   the page register until the transfer finishes)
+ * - erase: the segment has a block in every chip, so all chips are erased
+ *
+ * The caller must hold the queue's mutex.
+ */
+static uint64_t ramdisk_timing_reserve(struct device *dev,
+				       struct device_request *request,
+				       uint64_t now)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	struct ramdisk_timing *timing = &ramdisk->timing;
+	struct ramdisk_timing_queue *queue = ramdisk->queue;
+	struct device_address paddr = request->paddr;
+	uint64_t *bus, *chip;
+	uint64_t start, end;
+	size_t i, nr_total_chips;
+
+	bus = &queue->bus_busy_until[paddr.format.bus];
+	chip = &queue->chip_busy_until[paddr.format.bus * dev->info.nr_chips +
+				       paddr.format.chip];
+	switch (request->flag) {
+	case DEVICE_WRITE:
+		start = ramdisk_timing_max(now, ramdisk_timing_max(*bus, *chip));
+		*bus = start + timing->xfer_ns;
+		*chip = *bus + timing->prog_ns;
+		end = *chip;
+		break;
+	case DEVICE_READ:
+		start = ramdisk_timing_max(now, *chip) + timing->read_ns;
+		*bus = ramdisk_timing_max(start, *bus) + timing->xfer_ns;
+		*chip = *bus;
+		end = *chip;
+		break;
+	case DEVICE_ERASE:
+		end = now;
+		nr_total_chips = dev->info.nr_bus * dev->info.nr_chips;
+		for (i = 0; i < nr_total_chips; i++) {
+			chip = &queue->chip_busy_until[i];
+			*chip = ramdisk_timing_max(now, *chip) +
+				timing->erase_ns;
+			end = ramdisk_timing_max(end, *chip);
+		}
+		break;
+	default:
+		end = now;
+		break;
+	}
+	return end;
+}
+
+/**
+ * @brief submit the request which is completed at the modeled time
+ *
+ * @param dev pointer of the device structure
+ * @param request request whose data is already processed
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * This blocks while `queue_depth` requests are in flight. The request must
+ * not be touched after the submission because `end_rq` may free it. The
+ * entries are preallocated, so the submission doesn't allocate the memory.
+ */
+int ramdisk_timing_submit(struct device *dev, struct device_request *request)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	struct ramdisk_timing_queue *queue = ramdisk->queue;
+	struct ramdisk_timing_entry entry;
+
+	entry.request = request;
+
+	pthread_mutex_lock(&queue->mutex);
+	while (queue->nr_inflight >= ramdisk->timing.queue_depth) {
+		pthread_cond_wait(&queue->space, &queue->mutex);
+	}
+	entry.deadline =
+		ramdisk_timing_reserve(dev, request, ramdisk_timing_now());
+	entry.seq = queue->seq++;
+	ramdisk_timing_push(queue, entry);
+	if (queue->pending[0].seq == entry.seq) {
+		pthread_cond_signal(&queue->cond);
+	}
+	pthread_mutex_unlock(&queue->mutex);
+	return 0;
+}
+
+/**
+ * @brief allocate the timing queue and run the completion thread
+ *
+ * @param dev pointer of the device structure
+ *
+ * @return 0 for success, negative value for fail
+ */
+int ramdisk_timing_init(struct device *dev)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	struct ramdisk_timing_queue *queue;
+	pthread_condattr_t attr;
+	size_t nr_bus, nr_total_chips;
+	int ret;
+
+	if (ramdisk->timing.queue_depth == 0) {
+		pr_err("queue depth must be larger than 0\n");
+		return -EINVAL;
+	}
+
+	queue = (struct ramdisk_timing_queue *)malloc(
+		sizeof(struct ramdisk_timing_queue));
+	if (queue == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	memset(queue, 0, sizeof(struct ramdisk_timing_queue));
+
+	nr_bus = dev->info.nr_bus;
+	nr_total_chips = nr_bus * dev->info.nr_chips;
+	queue->bus_busy_until = (uint64_t *)calloc(nr_bus, sizeof(uint64_t));
+	queue->chip_busy_until =
+		(uint64_t *)calloc(nr_total_chips, sizeof(uint64_t));
+	queue->pending = (struct ramdisk_timing_entry *)calloc(
+		ramdisk->timing.queue_depth,
+		sizeof(struct ramdisk_timing_entry));
+	if (queue->bus_busy_until == NULL || queue->chip_busy_until == NULL ||
+	    queue->pending == NULL) {
+		pr_err("memory allocation failed\n");
+		ret = -ENOMEM;
+		goto exception;
+	}
+
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&queue->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_cond_init(&queue->space, NULL);
+
+	ret = pthread_create(&queue->thread, NULL, ramdisk_timing_thread,
+			     (void *)queue);
+	if (ret) {
+		pr_err("completion thread creation failed\n");
+		pthread_cond_destroy(&queue->space);
+		pthread_cond_destroy(&queue->cond);
+		pthread_mutex_destroy(&queue->mutex);
+		ret = -ret;
+		goto exception;
+	}
+	ramdisk->queue = queue;
+	pr_info("timing emulation enabled (tR: %" PRIu64 "ns, tPROG: %" PRIu64
+		"ns, tBERS: %" PRIu64 "ns, transfer: %" PRIu64 "ns)\n",
+		ramdisk->timing.read_ns, ramdisk->timing.prog_ns,
+		ramdisk->timing.erase_ns, ramdisk->timing.xfer_ns);
+	return 0;
+exception:
+	free(queue->bus_busy_until);
+	free(queue->chip_busy_until);
+	free(queue->pending);
+	free(queue);
+	return ret;
+}
+
+/**
+ * @brief wait for the in-flight requests and deallocate the timing queue
+ *
+ * @param dev pointer of the device structure
+ */
+void ramdisk_timing_free(struct device *dev)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	struct ramdisk_timing_queue *queue = ramdisk->queue;
+
+	if (queue == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&queue->mutex);
+	queue->is_stop = 1;
+	pthread_cond_signal(&queue->cond);
+	pthread_mutex_unlock(&queue->mutex);
+	pthread_join(queue->thread, NULL);
+
+	pthread_cond_destroy(&queue->space);
+	pthread_cond_destroy(&queue->cond);
+	pthread_mutex_destroy(&queue->mutex);
+	free(queue->bus_busy_until);
+	free(queue->chip_busy_until);
+	free(queue->pending);
+	free(queue);
+	ramdisk->queue = NULL;
+}
@@ -12,6 +12,8 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "flash.h"
 #include "ramdisk.h"
@@ -19,11 +21,260 @@
 #include "log.h"
 #include "bits.h"
 
+/**
+ * @brief complete the request immediately or at the modeled time
+ *
+ * @param dev pointer of the device structure
+ * @param request request whose data is already processed
+ *
+ * @return 0 for success, negative value for fail
+ */
+static int ramdisk_end_request(struct device *dev,
+			       struct device_request *request)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+
+	if (ramdisk->queue != NULL) {
+		return ramdisk_timing_submit(dev, request);
+	}
+	if (request->end_rq) {
+		request->end_rq(request);
+	}
+	return 0;
+}
+
+/**
+ * @brief get the offset of the page in the ramdisk's buffer
+ *
+ * @param dev pointer of the device structure
+ * @param paddr physical address of the page
+ *
+ * @return offset in the buffer (bytes)
+ *
+ * @note
+ * The buffer is in the bus-major order. The pages of a bus are contiguous
+ * (ordered by the address without the bus bits).
+ */
+static inline size_t ramdisk_get_offset(struct device *dev,
+					struct device_address paddr)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	size_t bus_size = ramdisk->size / dev->info.nr_bus;
+
+	return (size_t)paddr.format.bus * bus_size +
+	       (size_t)(paddr.lpn >> DEVICE_NR_BUS_BITS) *
+		       device_get_page_size(dev);
+}
+
+/**
+ * @brief copy the request's data and complete the request
+ *
+ * @param dev pointer of the device structure
+ * @param request validated read or write request
+ *
+ * @return 0 for success, negative value for fail
+ */
+int ramdisk_execute(struct device *dev, struct device_request *request)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	char *page = &ramdisk->buffer[ramdisk_get_offset(dev, request->paddr)];
+	char *oob = &ramdisk->oob[request->paddr.lpn * DEVICE_OOB_SIZE];
+
+	switch (request->flag) {
+	case DEVICE_WRITE:
+		memcpy(page, request->data, request->data_len);
+		if (request->oob) {
+			memcpy(oob, request->oob, DEVICE_OOB_SIZE);
+		}
+		break;
+	case DEVICE_READ:
+		memcpy(request->data, page, request->data_len);
+		if (request->oob) {
+			memcpy(request->oob, oob, DEVICE_OOB_SIZE);
+		}
+		break;
+	default:
+		break;
+	}
+	return ramdisk_end_request(dev, request);
+}
+
+/**
+ * @brief process the request now or by the bus's worker
+ *
+ * @param dev pointer of the device structure
+ * @param request validated read or write request
+ *
+ * @return 0 for success, negative value for fail
+ */
+static int ramdisk_submit(struct device *dev, struct device_request *request)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+
+	if (ramdisk->buses != NULL) {
+		return ramdisk_async_submit(dev, request);
+	}
+	return ramdisk_execute(dev, request);
+}
+
+/**
+ * @brief map the zero-filled memory of the ramdisk
+ *
+ * @param size size of the mapping (multiple of `RAMDISK_HUGEPAGE_SIZE`)
+ *
+ * @return mapped address, NULL for fail
+ *
+ * @note
+ * The memory is allocated when each page is written first. So, the open
+ * doesn't touch the whole ramdisk and the resident memory follows the live
+ * data. The hugepage build tries the hugetlbfs pages first and falls back
+ * to the transparent hugepages.
+ */
+static char *ramdisk_map(size_t size)
+{
+	const int prot = PROT_READ | PROT_WRITE;
+	const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+	void *buffer;
+
+#ifdef RAMDISK_USE_HUGEPAGE
+	/**< reserve the pages now; without it, the fault kills us */
+	buffer = mmap(NULL, size, prot,
+		      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (buffer != MAP_FAILED) {
+		pr_info("hugetlb pages are used\n");
+		return (char *)buffer;
+	}
+	pr_warn("hugetlb pages are not available (errno: %d)\n", errno);
+#endif
+	buffer = mmap(NULL, size, prot, flags, -1, 0);
+	if (buffer == MAP_FAILED) {
+		return NULL;
+	}
+#ifdef RAMDISK_USE_HUGEPAGE
+	if (madvise(buffer, size, MADV_HUGEPAGE)) {
+		pr_warn("transparent hugepages are not available (errno: %d)\n",
+			errno);
+	}
+#endif
+	return (char *)buffer;
+}
+
+/**
+ * @brief map the backing file of the persistent ramdisk
+ *
+ * @param ramdisk pointer of the ramdisk
+ * @param name path of the backing file
+ * @param flags open flags (O_CREAT and O_TRUNC are used)
+ * @param nr_pages number of pages in the ramdisk
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * The empty file is initialized. The existing file must have the same
+ * geometry, and its data is kept.
+ */
+static int ramdisk_map_file(struct ramdisk *ramdisk, const char *name,
+			    int flags, size_t nr_pages)
+{
+	struct ramdisk_file_header *header;
+	struct stat st;
+	void *base;
+	int fd, is_new, ret;
+
+	if (name == NULL || strlen(name) == 0) {
+		pr_err("path of the backing file is not specified\n");
+		return -EINVAL;
+	}
+	fd = open(name, O_RDWR | (flags & (O_CREAT | O_TRUNC)), 0644);
+	if (fd < 0) {
+		pr_err("cannot open the backing file (path: %s, errno: %d)\n",
+		       name, errno);
+		return -errno;
+	}
+	if (fstat(fd, &st)) {
+		ret = -errno;
+		goto exception;
+	}
+	is_new = st.st_size == 0;
+	if (is_new && ftruncate(fd, (off_t)ramdisk->map_size)) {
+		ret = -errno;
+		pr_err("cannot resize the backing file (errno: %d)\n", -ret);
+		goto exception;
+	}
+	if (!is_new && (size_t)st.st_size != ramdisk->map_size) {
+		pr_err("size of the backing file is not matched (expected: %zu, current: %zu)\n",
+		       ramdisk->map_size, (size_t)st.st_size);
+		ret = -EINVAL;
+		goto exception;
+	}
+
+	base = mmap(NULL, ramdisk->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    fd, 0);
+	if (base == MAP_FAILED) {
+		ret = -errno;
+		pr_err("cannot map the backing file (errno: %d)\n", -ret);
+		goto exception;
+	}
+	header = (struct ramdisk_file_header *)base;
+	if (is_new) {
+		memcpy(header->magic, RAMDISK_FILE_MAGIC, sizeof(header->magic));
+		header->page_size = DEVICE_PAGE_SIZE;
+		header->nr_pages = nr_pages;
+		header->oob_size = DEVICE_OOB_SIZE;
+	} else if (memcmp(header->magic, RAMDISK_FILE_MAGIC,
+			  sizeof(header->magic)) ||
+		   header->page_size != DEVICE_PAGE_SIZE ||
+		   header->nr_pages != nr_pages ||
+		   header->oob_size != DEVICE_OOB_SIZE) {
+		pr_err("geometry of the backing file is not matched\n");
+		munmap(base, ramdisk->map_size);
+		ret = -EINVAL;
+		goto exception;
+	} else if (!header->is_clean) {
+		pr_warn("backing file was not closed cleanly\n");
+	}
+	header->is_clean = 0;
+	pr_info("backing file mapped (path: %s, new: %d)\n", name, is_new);
+
+	ramdisk->base = (char *)base;
+	ramdisk->fd = fd;
+	return 0;
+exception:
+	close(fd);
+	return ret;
+}
+
+/**
+ * @brief discard the range of the ramdisk's buffer (it is read as zero)
+ *
+ * @param ramdisk pointer of the ramdisk
+ * @param offset offset in the buffer (bytes)
+ * @param length length of the range (bytes)
+ */
+static void ramdisk_discard(struct ramdisk *ramdisk, size_t offset,
+			    size_t length)
+{
+	char *range = &ramdisk->buffer[offset];
+
+	if (ramdisk->is_persistent) {
+		offset += (size_t)(ramdisk->buffer - ramdisk->base);
+		if (fallocate(ramdisk->fd,
+			      FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+			      (off_t)offset, (off_t)length) == 0) {
+			return;
+		}
+	} else if (madvise(range, length, MADV_DONTNEED) == 0) {
+		/**< the pages are zero-filled when they are touched again */
+		return;
+	}
+	memset(range, 0, length);
+}
+
 /**
  * @brief open the ramdisk (allocate the device resources)
  *
  * @param dev pointer of the device structure
- * @param name this does not use in this module
+ * @param name path of the backing file (only for the persistent ramdisk)
  * @param flags open flags for ramdisk
  *
  * @return 0 for success, negative value to fail
@@ -31,9 +282,8 @@
 int ramdisk_open(struct device *dev, const char *name, int flags)
 {
 	int ret = 0;
-	char *buffer;
-	size_t bitmap_size;
-	uint64_t *is_used;
+	size_t header_size, oob_size, bitmap_size;
+	size_t nr_pages;
 	struct ramdisk *ramdisk;
 
 	struct device_info *info = &dev->info;
@@ -43,9 +293,6 @@ int ramdisk_open(struct device *dev, const char *name, int flags)
 
 	size_t nr_segments;
 
-	(void)name;
-	(void)flags;
-
 	info->nr_bus = (1 << DEVICE_NR_BUS_BITS);
 	info->nr_chips = (1 << DEVICE_NR_CHIPS_BITS);
 
@@ -59,26 +306,38 @@ int ramdisk_open(struct device *dev, const char *name, int flags)
 
 	printf("nr_bus:%zu\tnr_chips:%zu\tnr_blocks:%zu\tnr_pages:%zu\n", info->nr_bus, info->nr_chips, package->nr_blocks, block->nr_pages);
 
-	pr_info("ramdisk generated (size: %zu bytes)\n", ramdisk->size);
-	buffer = (char *)malloc(ramdisk->size);
-	if (buffer == NULL) {
-		pr_err("memory allocation failed\n");
-		ret = -ENOMEM;
-		goto exception;
+	nr_pages = ramdisk->size / page->size;
+	header_size = ramdisk->is_persistent ? RAMDISK_FILE_HEADER_SIZE : 0;
+	oob_size = nr_pages * DEVICE_OOB_SIZE;
+	bitmap_size = (size_t)BITS_TO_UINT64_ALIGN(nr_pages);
+	ramdisk->map_size = header_size + ramdisk->size + oob_size + bitmap_size;
+	ramdisk->map_size = (ramdisk->map_size + RAMDISK_HUGEPAGE_SIZE - 1) /
+			    RAMDISK_HUGEPAGE_SIZE * RAMDISK_HUGEPAGE_SIZE;
+
+	if (ramdisk->is_persistent) {
+		ret = ramdisk_map_file(ramdisk, name, flags, nr_pages);
+		if (ret) {
+			goto exception;
+		}
+	} else {
+		ramdisk->base = ramdisk_map(ramdisk->map_size);
+		if (ramdisk->base == NULL) {
+			pr_err("memory mapping failed (errno: %d)\n", errno);
+			ret = -ENOMEM;
+			goto exception;
+		}
 	}
-	memset(buffer, 0, ramdisk->size);
-	ramdisk->buffer = buffer;
+	pr_info("ramdisk generated (size: %zu bytes)\n", ramdisk->size);
+	ramdisk->buffer = ramdisk->base + header_size;
+	ramdisk->oob = ramdisk->buffer + ramdisk->size;
+	ramdisk->is_used = (uint64_t *)(ramdisk->oob + oob_size);
+	pr_info("bitmap generated (size: %zu bytes)\n", bitmap_size);
 
-	bitmap_size = (size_t)BITS_TO_UINT64_ALIGN(ramdisk->size / page->size);
-	is_used = (uint64_t *)malloc((size_t)bitmap_size);
-	if (is_used == NULL) {
-		pr_err("memory allocation failed\n");
-		ret = -ENOMEM;
+	ret = ramdisk_numa_init(dev);
+	if (ret) {
+		pr_err("NUMA placement failed\n");
 		goto exception;
 	}
-	pr_info("bitmap generated (size: %zu bytes)\n", bitmap_size);
-	memset(is_used, 0, bitmap_size);
-	ramdisk->is_used = is_used;
 
 	nr_segments = device_get_nr_segments(dev);
 	dev->badseg_bitmap =
@@ -90,6 +349,22 @@ int ramdisk_open(struct device *dev, const char *name, int flags)
 	}
 	memset(dev->badseg_bitmap, 0,
 	       (size_t)BITS_TO_UINT64_ALIGN(nr_segments));
+
+	if (ramdisk->timing.is_enabled) {
+		ret = ramdisk_timing_init(dev);
+		if (ret) {
+			pr_err("timing emulation initialize failed\n");
+			goto exception;
+		}
+	}
+
+	if (ramdisk->is_async) {
+		ret = ramdisk_async_init(dev);
+		if (ret) {
+			pr_err("asynchronous mode initialize failed\n");
+			goto exception;
+		}
+	}
 	return ret;
 exception:
 	ramdisk_close(dev);
@@ -110,7 +385,7 @@ ssize_t ramdisk_write(struct device *dev, struct device_request *request)
 	struct device_address addr = request->paddr;
 	size_t page_size = device_get_page_size(dev);
 	ssize_t ret = 0;
-	int is_used;
+	int is_used, err;
 
 	if (request->data == NULL) {
 		pr_err("you do not pass the data pointer to NULL\n");
@@ -145,11 +420,10 @@ ssize_t ramdisk_write(struct device *dev, struct device_request *request)
 		goto exit;
 	}
 	set_bit(ramdisk->is_used, addr.lpn);
-	memcpy(&ramdisk->buffer[addr.lpn * page_size], request->data,
-	       request->data_len);
 	ret = (ssize_t)request->data_len;
-	if (request->end_rq) {
-		request->end_rq(request);
+	err = ramdisk_submit(dev, request);
+	if (err) {
+		ret = err;
 	}
 exit:
 	return ret;
@@ -165,10 +439,9 @@ exit:
  */
 ssize_t ramdisk_read(struct device *dev, struct device_request *request)
 {
-	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
-	struct device_address addr = request->paddr;
 	size_t page_size;
 	ssize_t ret;
+	int err;
 
 	ret = 0;
 
@@ -199,13 +472,12 @@ ssize_t ramdisk_read(struct device *dev, struct device_request *request)
 		goto exit;
 	}
 
-	memcpy(request->data, &ramdisk->buffer[addr.lpn * page_size],
-	       request->data_len);
 	ret = (ssize_t)request->data_len;
 	pr_debug("request->end_rq %p %p\n", request->end_rq,
 		 &((struct device_request *)request->rq_private)->mutex);
-	if (request->end_rq) {
-		request->end_rq(request);
+	err = ramdisk_submit(dev, request);
+	if (err) {
+		ret = err;
 	}
 exit:
 	return ret;
@@ -223,7 +495,7 @@ int ramdisk_erase(struct device *dev, struct device_request *request)
 {
 	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
 	struct device_address addr;
-	size_t page_size;
+	size_t page_size, offset, bus_size, bus;
 	uint32_t nr_pages_per_segment;
 	uint32_t lpn;
 	uint16_t segnum;
@@ -238,18 +510,29 @@ int ramdisk_erase(struct device *dev, struct device_request *request)
 		ret = -EINVAL;
 		goto exit;
 	}
+	if (ramdisk->buses != NULL) {
+		/**< the segment has the pages in every bus */
+		ramdisk_async_drain(dev);
+	}
 	segnum = (uint16_t)request->paddr.format.block;
 	page_size = device_get_page_size(dev);
 	nr_pages_per_segment = (uint32_t)device_get_pages_per_segment(dev);
 	addr.format.block = segnum;
+	/**< the segment's pages are contiguous in each bus region */
+	offset = ramdisk_get_offset(dev, addr);
+	bus_size = ramdisk->size / dev->info.nr_bus;
+	for (bus = 0; bus < dev->info.nr_bus; bus++) {
+		ramdisk_discard(ramdisk, offset + bus * bus_size,
+				nr_pages_per_segment / dev->info.nr_bus *
+					page_size);
+	}
+	memset(&ramdisk->oob[(size_t)addr.lpn * DEVICE_OOB_SIZE], 0,
+	       nr_pages_per_segment * DEVICE_OOB_SIZE);
 	for (lpn = addr.lpn; lpn < addr.lpn + nr_pages_per_segment; lpn++) {
-		memset(&ramdisk->buffer[lpn * page_size], 0, page_size);
 		reset_bit(ramdisk->is_used, lpn);
 	}
 
-	if (request->end_rq) {
-		request->end_rq(request);
-	}
+	ret = ramdisk_end_request(dev, request);
 exit:
 	return ret;
 }
@@ -272,18 +555,59 @@ int ramdisk_close(struct device *dev)
 	if (ramdisk == NULL) {
 		return 0;
 	}
-	if (ramdisk->buffer != NULL) {
-		free(ramdisk->buffer);
-		ramdisk->buffer = NULL;
+	/**< wait for the in-flight requests */
+	ramdisk_async_free(dev);
+	ramdisk_timing_free(dev);
+	ramdisk_numa_free(dev);
+	if (ramdisk->base != NULL) {
+		if (ramdisk->is_persistent) {
+			((struct ramdisk_file_header *)ramdisk->base)->is_clean =
+				1;
+			msync(ramdisk->base, ramdisk->map_size, MS_SYNC);
+		}
+		munmap(ramdisk->base, ramdisk->map_size);
+		ramdisk->base = NULL;
 	}
-	if (ramdisk->is_used != NULL) {
-		free(ramdisk->is_used);
-		ramdisk->is_used = NULL;
+	if (ramdisk->fd >= 0) {
+		close(ramdisk->fd);
+		ramdisk->fd = -1;
 	}
+	ramdisk->buffer = NULL;
+	ramdisk->oob = NULL;
+	ramdisk->is_used = NULL;
 	ramdisk->size = 0;
 	return 0;
 }
 
+/**
+ * @brief write back the ramdisk's data to the backing file
+ *
+ * @param dev pointer of the device structure
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * The written data is persistent after this returns. The volatile ramdisk
+ * has nothing to do.
+ */
+int ramdisk_flush(struct device *dev)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+
+	if (ramdisk == NULL || ramdisk->base == NULL ||
+	    !ramdisk->is_persistent) {
+		return 0;
+	}
+	if (ramdisk->buses != NULL) {
+		ramdisk_async_drain(dev);
+	}
+	if (msync(ramdisk->base, ramdisk->map_size, MS_SYNC)) {
+		pr_err("flush failed (errno: %d)\n", errno);
+		return -errno;
+	}
+	return 0;
+}
+
 /**
  * @brief ramdisk operations
  */
@@ -293,6 +617,8 @@ const struct device_operations __ramdisk_dops = {
 	.read = ramdisk_read,
 	.erase = ramdisk_erase,
 	.close = ramdisk_close,
+	.flush = ramdisk_flush,
+	.get_bus_node = ramdisk_get_bus_node,
 };
 
 /**
@@ -316,7 +642,47 @@ int ramdisk_device_init(struct device *dev, uint64_t flags)
 		goto exception;
 	}
 	ramdisk->buffer = NULL;
+	ramdisk->is_used = NULL;
+	ramdisk->base = NULL;
+	ramdisk->oob = NULL;
+	ramdisk->fd = -1;
 	ramdisk->size = 0;
+	ramdisk->queue = NULL;
+	ramdisk->buses = NULL;
+	ramdisk->bus_node = NULL;
+
+	ramdisk->timing.read_ns = RAMDISK_TIMING_READ_NS;
+	ramdisk->timing.prog_ns = RAMDISK_TIMING_PROG_NS;
+	ramdisk->timing.erase_ns = RAMDISK_TIMING_ERASE_NS;
+	ramdisk->timing.xfer_ns = RAMDISK_TIMING_XFER_NS;
+	ramdisk->timing.queue_depth = RAMDISK_TIMING_QUEUE_DEPTH;
+#ifdef RAMDISK_USE_TIMING
+	ramdisk->timing.is_enabled = 1;
+#else
+	ramdisk->timing.is_enabled = 0;
+#endif
+#ifdef RAMDISK_USE_ASYNC
+	ramdisk->is_async = 1;
+#else
+	ramdisk->is_async = 0;
+#endif
+#ifdef RAMDISK_USE_OUT_OF_ORDER
+	ramdisk->is_out_of_order = 1;
+#else
+	ramdisk->is_out_of_order = 0;
+#endif
+#if defined(RAMDISK_USE_NUMA_INTERLEAVE)
+	ramdisk->numa_policy = RAMDISK_NUMA_INTERLEAVE;
+#elif defined(RAMDISK_USE_NUMA)
+	ramdisk->numa_policy = RAMDISK_NUMA_LOCAL;
+#else
+	ramdisk->numa_policy = RAMDISK_NUMA_NONE;
+#endif
+#ifdef RAMDISK_USE_FILE
+	ramdisk->is_persistent = 1;
+#else
+	ramdisk->is_persistent = 0;
+#endif
 	dev->d_op = &__ramdisk_dops;
 	dev->d_private = (void *)ramdisk;
 	dev->d_submodule_exit = ramdisk_device_exit;
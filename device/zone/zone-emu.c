@@ -0,0 +1,602 @@
+/**
+ * @file zone-emu.c
+ * @brief emulated zoned block device which replaces the libzbd
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ *
+ * @note
+ * The backing file has the zones' data and the metadata area in this order,
+ * so the device's offset is the file's offset. The metadata area is mapped
+ * by every descriptor, and the zones' states are shared through it.
+ *
+ * The emulated zone follows the host-managed device's rules:
+ * - the write must start at the write pointer (otherwise `EIO`)
+ * - the zone can be written up to its capacity, and it becomes full there
+ * - the write which opens a new zone over the maximum open zones fails
+ *   (`ETOOMANYREFS`, like the kernel's open resource error)
+ * - the reset makes the zone empty, and the finish makes it full
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "zone.h"
+#include "log.h"
+
+#ifdef ZONE_USE_EMULATION
+/**
+ * @brief descriptor of the emulated device which is opened by the `zbd_open()`
+ */
+struct zone_emu_file {
+	int fd;
+	int is_writable;
+	void *base; /**< mapped area which contains the metadata area */
+	size_t map_size;
+	struct zone_emu_header *header;
+	struct zone_emu_zone *zones;
+};
+
+static struct zone_emu_config zone_emu_config = {
+	ZONE_EMU_NR_ZONES,
+	ZONE_EMU_ZONE_SIZE,
+	ZONE_EMU_ZONE_CAPACITY,
+	ZONE_EMU_MAX_OPEN_ZONES,
+};
+
+static GList *zone_emu_files;
+/**< protects the opened files and the zones' states */
+static pthread_mutex_t zone_emu_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief get the geometry which is used by the next `zbd_open()`
+ *
+ * @return pointer of the geometry (it can be changed before the open)
+ */
+struct zone_emu_config *zone_emu_get_config(void)
+{
+	return &zone_emu_config;
+}
+
+/**
+ * @brief check the geometry of the emulated device
+ *
+ * @param config geometry of the emulated device
+ *
+ * @return 0 for success, negative value for fail
+ */
+static int zone_emu_check_config(const struct zone_emu_config *config)
+{
+	if (config->nr_zones == 0 || config->zone_size == 0 ||
+	    config->zone_size % ZONE_EMU_BLOCK_SIZE) {
+		pr_err("invalid zone geometry (zones: %lu, zone size: %lu)\n",
+		       config->nr_zones, config->zone_size);
+		return -EINVAL;
+	}
+	if (config->zone_capacity == 0 ||
+	    config->zone_capacity > config->zone_size ||
+	    config->zone_capacity % ZONE_EMU_BLOCK_SIZE) {
+		pr_err("invalid zone capacity (capacity: %lu, zone size: %lu)\n",
+		       config->zone_capacity, config->zone_size);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/**
+ * @brief find the opened file of the descriptor
+ *
+ * @param fd file descriptor which is returned by the `zbd_open()`
+ *
+ * @return pointer of the file, NULL for the unknown descriptor
+ *
+ * @note
+ * The caller must hold the `zone_emu_mutex`.
+ */
+static struct zone_emu_file *zone_emu_find(int fd)
+{
+	struct zone_emu_file *file;
+	GList *node;
+
+	for (node = zone_emu_files; node != NULL; node = node->next) {
+		file = (struct zone_emu_file *)node->data;
+		if (file->fd == fd) {
+			return file;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief make every zone of the emulated device empty
+ *
+ * @param file opened file of the emulated device
+ * @param config geometry of the emulated device
+ */
+static void zone_emu_format(struct zone_emu_file *file,
+			    const struct zone_emu_config *config)
+{
+	struct zone_emu_header *header = file->header;
+	uint64_t i;
+
+	memcpy(header->magic, ZONE_EMU_MAGIC, sizeof(header->magic));
+	header->nr_zones = config->nr_zones;
+	header->zone_size = config->zone_size;
+	header->zone_capacity = config->zone_capacity;
+	header->nr_open_zones = 0;
+	for (i = 0; i < config->nr_zones; i++) {
+		file->zones[i].wp = i * config->zone_size;
+		file->zones[i].cond = ZBD_ZONE_COND_EMPTY;
+	}
+}
+
+/**
+ * @brief map the metadata area of the backing file
+ *
+ * @param file opened file of the emulated device
+ * @param name path of the backing file
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * The file which doesn't have the metadata area of this geometry is
+ * formatted. Otherwise, the zones' states are kept like the real device.
+ */
+static int zone_emu_map(struct zone_emu_file *file, const char *name)
+{
+	const struct zone_emu_config *config = &zone_emu_config;
+	struct zone_emu_header *header;
+	uint64_t data_size, map_offset;
+	size_t meta_size;
+	struct stat st;
+	int fd, is_new;
+	int ret = 0;
+
+	data_size = config->nr_zones * config->zone_size;
+	meta_size = sizeof(struct zone_emu_header) +
+		    sizeof(struct zone_emu_zone) * config->nr_zones;
+	map_offset = data_size & ~((uint64_t)sysconf(_SC_PAGESIZE) - 1);
+	file->map_size = (size_t)(data_size - map_offset) + meta_size;
+
+	fd = open(name, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		pr_err("cannot open the backing file (path: %s, errno: %d)\n",
+		       name, errno);
+		return -errno;
+	}
+	if (fstat(fd, &st)) {
+		ret = -errno;
+		goto exit;
+	}
+	is_new = (uint64_t)st.st_size != data_size + meta_size;
+	if (is_new && (ftruncate(fd, 0) ||
+		       ftruncate(fd, (off_t)(data_size + meta_size)))) {
+		ret = -errno;
+		pr_err("cannot resize the backing file (errno: %d)\n", -ret);
+		goto exit;
+	}
+	file->base = mmap(NULL, file->map_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED, fd, (off_t)map_offset);
+	if (file->base == MAP_FAILED) {
+		ret = -errno;
+		file->base = NULL;
+		pr_err("cannot map the backing file (errno: %d)\n", -ret);
+		goto exit;
+	}
+	header = (struct zone_emu_header *)&(
+		(char *)file->base)[data_size - map_offset];
+	file->header = header;
+	file->zones = (struct zone_emu_zone *)&header[1];
+
+	pthread_mutex_lock(&zone_emu_mutex);
+	if (is_new ||
+	    memcmp(header->magic, ZONE_EMU_MAGIC, sizeof(header->magic)) ||
+	    header->nr_zones != config->nr_zones ||
+	    header->zone_size != config->zone_size ||
+	    header->zone_capacity != config->zone_capacity) {
+		zone_emu_format(file, config);
+		pr_info("emulated zoned device is formatted (path: %s, zones: %lu, zone size: %lu, capacity: %lu)\n",
+			name, config->nr_zones, config->zone_size,
+			config->zone_capacity);
+	}
+	header->max_open_zones = config->max_open_zones;
+	pthread_mutex_unlock(&zone_emu_mutex);
+exit:
+	close(fd);
+	return ret;
+}
+
+/**
+ * @brief open the emulated zoned block device
+ *
+ * @param filename path of the backing file (it is created if it doesn't exist)
+ * @param flags open flags of the descriptor
+ * @param info device information which is filled by this
+ *
+ * @return file descriptor for success, -1 for fail (`errno` is set)
+ */
+int zbd_open(const char *filename, int flags, struct zbd_info *info)
+{
+	const struct zone_emu_config *config = &zone_emu_config;
+	struct zone_emu_file *file;
+	int ret;
+
+	ret = zone_emu_check_config(config);
+	if (ret) {
+		errno = -ret;
+		return -1;
+	}
+	file = (struct zone_emu_file *)malloc(sizeof(struct zone_emu_file));
+	if (file == NULL) {
+		pr_err("memory allocation failed\n");
+		errno = ENOMEM;
+		return -1;
+	}
+	memset(file, 0, sizeof(struct zone_emu_file));
+
+	ret = zone_emu_map(file, filename);
+	if (ret) {
+		goto exception;
+	}
+	file->fd = open(filename, flags);
+	if (file->fd < 0 && errno == EINVAL && (flags & O_DIRECT)) {
+		pr_warn("direct I/O is not supported (path: %s)\n", filename);
+		file->fd = open(filename, flags & ~O_DIRECT);
+	}
+	if (file->fd < 0) {
+		ret = -errno;
+		goto exception;
+	}
+	file->is_writable = (flags & O_ACCMODE) != O_RDONLY;
+
+	pthread_mutex_lock(&zone_emu_mutex);
+	zone_emu_files = g_list_prepend(zone_emu_files, file);
+	pthread_mutex_unlock(&zone_emu_mutex);
+
+	memset(info, 0, sizeof(struct zbd_info));
+	strncpy(info->vendor_id, "FTL zoned device emulator",
+		ZBD_VENDOR_ID_LENGTH - 1);
+	info->zone_size = config->zone_size;
+	info->zone_sectors = (unsigned int)(config->zone_size >> 9);
+	info->nr_zones = (unsigned int)config->nr_zones;
+	info->nr_sectors = info->zone_sectors * config->nr_zones;
+	info->lblock_size = ZONE_EMU_BLOCK_SIZE;
+	info->pblock_size = ZONE_EMU_BLOCK_SIZE;
+	info->nr_lblocks = (config->nr_zones * config->zone_size) /
+			   ZONE_EMU_BLOCK_SIZE;
+	info->nr_pblocks = info->nr_lblocks;
+	info->max_nr_open_zones = config->max_open_zones;
+	info->max_nr_active_zones = config->max_open_zones;
+	info->model = ZBD_DM_HOST_MANAGED;
+	return file->fd;
+exception:
+	if (file->base) {
+		munmap(file->base, file->map_size);
+	}
+	free(file);
+	errno = -ret;
+	return -1;
+}
+
+/**
+ * @brief close the emulated zoned block device
+ *
+ * @param fd file descriptor which is returned by the `zbd_open()`
+ */
+void zbd_close(int fd)
+{
+	struct zone_emu_file *file;
+
+	pthread_mutex_lock(&zone_emu_mutex);
+	file = zone_emu_find(fd);
+	if (file != NULL) {
+		zone_emu_files = g_list_remove(zone_emu_files, file);
+	}
+	pthread_mutex_unlock(&zone_emu_mutex);
+	if (file == NULL) {
+		return;
+	}
+	munmap(file->base, file->map_size);
+	close(file->fd);
+	free(file);
+}
+
+/**
+ * @brief get the zones in the range
+ *
+ * @param fd file descriptor which is returned by the `zbd_open()`
+ * @param ofst start of the range (bytes)
+ * @param len length of the range (bytes)
+ * @param ro report option (only the `ZBD_RO_ALL` is supported)
+ * @param zones array of the zones which is allocated by this
+ * @param nr_zones number of the zones in the array
+ *
+ * @return 0 for success, negative value for fail
+ */
+int zbd_list_zones(int fd, off_t ofst, off_t len, enum zbd_report_option ro,
+		   struct zbd_zone **zones, unsigned int *nr_zones)
+{
+	struct zone_emu_file *file;
+	struct zone_emu_header *header;
+	struct zbd_zone *zone;
+	uint64_t first, last, i;
+
+	(void)ro;
+	pthread_mutex_lock(&zone_emu_mutex);
+	file = zone_emu_find(fd);
+	if (file == NULL) {
+		pthread_mutex_unlock(&zone_emu_mutex);
+		return -EBADF;
+	}
+	header = file->header;
+	first = (uint64_t)ofst / header->zone_size;
+	last = ((uint64_t)(ofst + len) + header->zone_size - 1) /
+	       header->zone_size;
+	last = last > header->nr_zones ? header->nr_zones : last;
+	*nr_zones = last > first ? (unsigned int)(last - first) : 0;
+	*zones = (struct zbd_zone *)calloc(*nr_zones ? *nr_zones : 1,
+					   sizeof(struct zbd_zone));
+	if (*zones == NULL) {
+		pthread_mutex_unlock(&zone_emu_mutex);
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	for (i = first; i < last; i++) {
+		zone = &(*zones)[i - first];
+		zone->start = i * header->zone_size;
+		zone->len = header->zone_size;
+		zone->capacity = header->zone_capacity;
+		zone->wp = file->zones[i].wp;
+		zone->type = ZBD_ZONE_TYPE_SWR;
+		zone->cond = (unsigned int)file->zones[i].cond;
+		if (zone->cond == ZBD_ZONE_COND_FULL) {
+			zone->wp = zone->start + zone->len;
+		}
+	}
+	pthread_mutex_unlock(&zone_emu_mutex);
+	return 0;
+}
+
+/**
+ * @brief get the writable file and the zones in the range
+ *
+ * @param fd file descriptor which is returned by the `zbd_open()`
+ * @param ofst start of the range (bytes, zone aligned)
+ * @param len length of the range (bytes, zone aligned)
+ * @param first first zone number of the range
+ * @param last zone number after the range
+ *
+ * @return pointer of the file, NULL for fail (`errno` is set)
+ *
+ * @note
+ * The caller must hold the `zone_emu_mutex`.
+ */
+static struct zone_emu_file *zone_emu_get_range(int fd, off_t ofst, off_t len,
+						uint64_t *first, uint64_t *last)
+{
+	struct zone_emu_file *file;
+	uint64_t zone_size;
+
+	file = zone_emu_find(fd);
+	if (file == NULL || !file->is_writable) {
+		errno = EBADF;
+		return NULL;
+	}
+	zone_size = file->header->zone_size;
+	if (ofst < 0 || len < 0 || (uint64_t)ofst % zone_size ||
+	    (uint64_t)len % zone_size ||
+	    (uint64_t)(ofst + len) > file->header->nr_zones * zone_size) {
+		pr_err("invalid zone range (%ld ~ %ld)\n", ofst, ofst + len);
+		errno = EINVAL;
+		return NULL;
+	}
+	*first = (uint64_t)ofst / zone_size;
+	*last = (uint64_t)(ofst + len) / zone_size;
+	return file;
+}
+
+/**
+ * @brief release the open resource of the zone
+ *
+ * @param file opened file of the emulated device
+ * @param zone zone which becomes empty or full
+ *
+ * @note
+ * The caller must hold the `zone_emu_mutex`.
+ */
+static void zone_emu_close_zone(struct zone_emu_file *file,
+				struct zone_emu_zone *zone)
+{
+	if (zone->cond == ZBD_ZONE_COND_IMP_OPEN) {
+		file->header->nr_open_zones--;
+	}
+}
+
+/**
+ * @brief reset the zones in the range
+ *
+ * @param fd file descriptor which is returned by the `zbd_open()`
+ * @param ofst start of the range (bytes, zone aligned)
+ * @param len length of the range (bytes, zone aligned)
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * The zones' data is discarded, and it is read as zero.
+ */
+int zbd_reset_zones(int fd, off_t ofst, off_t len)
+{
+	struct zone_emu_file *file;
+	struct zone_emu_zone *zone;
+	uint64_t first, last, i;
+
+	pthread_mutex_lock(&zone_emu_mutex);
+	file = zone_emu_get_range(fd, ofst, len, &first, &last);
+	if (file == NULL) {
+		pthread_mutex_unlock(&zone_emu_mutex);
+		return -errno;
+	}
+	for (i = first; i < last; i++) {
+		zone = &file->zones[i];
+		zone_emu_close_zone(file, zone);
+		zone->wp = i * file->header->zone_size;
+		zone->cond = ZBD_ZONE_COND_EMPTY;
+	}
+	if (len > 0 &&
+	    fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, ofst, len)) {
+		pr_debug("discard is not supported (errno: %d)\n", errno);
+	}
+	pthread_mutex_unlock(&zone_emu_mutex);
+	return 0;
+}
+
+/**
+ * @brief finish the zones in the range
+ *
+ * @param fd file descriptor which is returned by the `zbd_open()`
+ * @param ofst start of the range (bytes, zone aligned)
+ * @param len length of the range (bytes, zone aligned)
+ *
+ * @return 0 for success, negative value for fail
+ */
+int zbd_finish_zones(int fd, off_t ofst, off_t len)
+{
+	struct zone_emu_file *file;
+	struct zone_emu_zone *zone;
+	uint64_t first, last, i;
+
+	pthread_mutex_lock(&zone_emu_mutex);
+	file = zone_emu_get_range(fd, ofst, len, &first, &last);
+	if (file == NULL) {
+		pthread_mutex_unlock(&zone_emu_mutex);
+		return -errno;
+	}
+	for (i = first; i < last; i++) {
+		zone = &file->zones[i];
+		if (zone->cond == ZBD_ZONE_COND_FULL) {
+			continue;
+		}
+		zone_emu_close_zone(file, zone);
+		zone->wp = i * file->header->zone_size +
+			   file->header->zone_capacity;
+		zone->cond = ZBD_ZONE_COND_FULL;
+	}
+	pthread_mutex_unlock(&zone_emu_mutex);
+	return 0;
+}
+
+/**
+ * @brief accept the write and move the zone's write pointer
+ *
+ * @param fd file descriptor which is returned by the `zbd_open()`
+ * @param offset position of the write (bytes)
+ * @param count size of the write (bytes)
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * The data is written by the caller after this (e.g., by the io_uring). The
+ * write pointer is not rolled back when the data's write fails, like the
+ * real device whose write pointer is undefined after the write error.
+ */
+int zone_emu_advance(int fd, uint64_t offset, size_t count)
+{
+	struct zone_emu_file *file;
+	struct zone_emu_header *header;
+	struct zone_emu_zone *zone;
+	uint64_t zone_num, start;
+	int ret = 0;
+
+	pthread_mutex_lock(&zone_emu_mutex);
+	file = zone_emu_find(fd);
+	if (file == NULL || !file->is_writable) {
+		ret = -EBADF;
+		goto exit;
+	}
+	header = file->header;
+	zone_num = offset / header->zone_size;
+	if (zone_num >= header->nr_zones) {
+		pr_err("write beyond the device (offset: %lu)\n", offset);
+		ret = -EIO;
+		goto exit;
+	}
+	zone = &file->zones[zone_num];
+	start = zone_num * header->zone_size;
+	if (zone->cond == ZBD_ZONE_COND_FULL ||
+	    offset + count > start + header->zone_capacity) {
+		pr_err("write beyond the zone capacity (zone: %lu, offset: %lu)\n",
+		       zone_num, offset);
+		ret = -EIO;
+		goto exit;
+	}
+	if (offset != zone->wp) {
+		pr_err("unaligned write (zone: %lu, wp: %lu, offset: %lu)\n",
+		       zone_num, zone->wp, offset);
+		ret = -EIO;
+		goto exit;
+	}
+	if (zone->cond == ZBD_ZONE_COND_EMPTY) {
+		if (header->max_open_zones &&
+		    header->nr_open_zones >= header->max_open_zones) {
+			pr_err("too many open zones (max: %lu, zone: %lu)\n",
+			       header->max_open_zones, zone_num);
+			ret = -ETOOMANYREFS;
+			goto exit;
+		}
+		header->nr_open_zones++;
+		zone->cond = ZBD_ZONE_COND_IMP_OPEN;
+	}
+	zone->wp += count;
+	if (zone->wp == start + header->zone_capacity) {
+		zone_emu_close_zone(file, zone);
+		zone->cond = ZBD_ZONE_COND_FULL;
+	}
+exit:
+	pthread_mutex_unlock(&zone_emu_mutex);
+	return ret;
+}
+
+/**
+ * @brief write to the emulated zoned block device
+ *
+ * @param fd file descriptor which is returned by the `zbd_open()`
+ * @param buffer data which wants to write
+ * @param count size of the write (bytes)
+ * @param offset position of the write (bytes)
+ *
+ * @return the number of written bytes, -1 for fail (`errno` is set)
+ */
+ssize_t zone_emu_pwrite(int fd, const void *buffer, size_t count,
+			off_t offset)
+{
+	size_t remaining = count;
+	ssize_t ret;
+
+	ret = zone_emu_advance(fd, (uint64_t)offset, count);
+	if (ret) {
+		errno = (int)-ret;
+		return -1;
+	}
+	/**< the write pointer is moved already, so the short write is retried */
+	while (remaining) {
+		ret = pwrite(fd, &((const char *)buffer)[count - remaining],
+			     remaining, offset + (off_t)(count - remaining));
+		if (ret < 0) {
+			return ret;
+		}
+		remaining -= (size_t)ret;
+	}
+	return (ssize_t)count;
+}
+#endif
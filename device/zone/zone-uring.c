@@ -0,0 +1,571 @@
+/**
+ * @file zone-uring.c
+ * @brief io_uring submission path of the zoned block device
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ *
+ * @note
+ * The submitter queues the entry which uses the request's data directly.
+ * Only the unaligned write is copied to the slot's registered buffer (the
+ * write file descriptor is opened with the `O_DIRECT`). The entries are submitted in a batch when `ZONE_URING_BATCH`
+ * entries are queued, or by the reaping thread after it reaps the
+ * completions. So, a syscall submits many entries under the high queue
+ * depth, and a lonely request is submitted immediately.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include "zone.h"
+#include "device.h"
+#include "log.h"
+
+#define ZONE_URING_STOP ((uint64_t)UINT64_MAX) /**< user data of the stop */
+
+/**
+ * @brief queue the slot's request to the submission queue
+ *
+ * @param dev pointer of the device structure
+ * @param slot_num slot number (negative value queues the no-op)
+ *
+ * @note
+ * The caller must hold the `uring->mutex`. The submission queue never
+ * overflows because the entries are limited by the slots.
+ */
+static void zone_uring_prepare(struct device *dev, int slot_num)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zone_uring *uring = meta->uring;
+	struct device_request *request;
+	struct zone_uring_slot *slot;
+	struct io_uring_sqe *sqe;
+	unsigned int tail, idx;
+	int is_fixed;
+
+	tail = *uring->sq_tail;
+	idx = tail & *uring->sq_mask;
+	sqe = &uring->sqes[idx];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	if (slot_num < 0) {
+		sqe->opcode = IORING_OP_NOP;
+		sqe->user_data = ZONE_URING_STOP;
+	} else {
+		slot = &uring->slots[slot_num];
+		request = slot->request;
+		is_fixed = uring->is_fixed && slot->data == slot->buffer;
+		if (slot->flag == DEVICE_WRITE) {
+			sqe->opcode = is_fixed ? IORING_OP_WRITE_FIXED :
+						 IORING_OP_WRITE;
+			sqe->fd = meta->write.fd;
+		} else {
+			sqe->opcode = is_fixed ? IORING_OP_READ_FIXED :
+						 IORING_OP_READ;
+			sqe->fd = meta->read.fd;
+		}
+		sqe->addr = (uint64_t)(uintptr_t)slot->data;
+		sqe->len = (uint32_t)request->data_len;
+		sqe->off = slot->offset;
+		sqe->buf_index = (uint16_t)slot_num;
+		sqe->user_data = (uint64_t)slot_num;
+	}
+	uring->sq_array[idx] = idx;
+	/**< the kernel sees the entry after the tail is updated */
+	__atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	uring->nr_pending++;
+}
+
+/**
+ * @brief submit the queued entries
+ *
+ * @param uring pointer of the io_uring
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * The caller must hold the `uring->mutex`.
+ */
+static int zone_uring_flush(struct zone_uring *uring)
+{
+	long ret;
+
+	while (uring->nr_pending > 0) {
+		ret = syscall(__NR_io_uring_enter, uring->fd,
+			      (unsigned int)uring->nr_pending, 0, 0, NULL, 0);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			pr_err("io_uring submission failed (errno: %d)\n",
+			       errno);
+			return -errno;
+		}
+		uring->nr_pending -= (size_t)ret;
+		uring->nr_submitted += (size_t)ret;
+	}
+	return 0;
+}
+
+/**
+ * @brief queue the waiting requests after the zone's write is completed
+ *
+ * @param dev pointer of the device structure
+ * @param zone_num zone number of the completed write
+ *
+ * @note
+ * The caller must hold the `uring->mutex`. The reads are queued until the
+ * next write of the zone is queued.
+ */
+static void zone_uring_next(struct device *dev, uint64_t zone_num)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zone_uring *uring = meta->uring;
+	struct zone_uring_zone *zone = &uring->zones[zone_num];
+	int slot_num;
+
+	zone->is_writing = 0;
+	while (zone->waiting != NULL && !zone->is_writing) {
+		slot_num = GPOINTER_TO_INT(zone->waiting->data);
+		zone->waiting = g_list_delete_link(zone->waiting, zone->waiting);
+		if (uring->slots[slot_num].flag == DEVICE_WRITE) {
+			zone->is_writing = 1;
+		}
+		zone_uring_prepare(dev, slot_num);
+	}
+}
+
+/**
+ * @brief finish the completed request and call its `end_rq`
+ *
+ * @param dev pointer of the device structure
+ * @param slot pointer of the completed slot
+ *
+ * @note
+ * The result of the request is passed by the `request->status`. The failed
+ * write leaves the zone's write pointer unknown, so the zone is marked as
+ * stale instead of being finished.
+ */
+static void zone_uring_end_request(struct device *dev,
+				   struct zone_uring_slot *slot)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct device_request *request = slot->request;
+	struct zbd_zone *zone = &meta->zones[slot->zone_num];
+	uint64_t end;
+
+	request->status = 0;
+	if (slot->result != (int)request->data_len) {
+		pr_err("%s failed (lpn: %u, result: %d)\n",
+		       slot->flag == DEVICE_WRITE ? "write" : "read",
+		       request->paddr.lpn, slot->result);
+		/**< the short I/O doesn't have the errno */
+		request->status = slot->result < 0 ? slot->result : -EIO;
+	}
+	if (slot->flag == DEVICE_WRITE && request->status) {
+		/**< the next write of the zone reads the device's write pointer */
+		g_atomic_int_set(&meta->states[slot->zone_num].is_stale, 1);
+	} else if (slot->flag == DEVICE_WRITE) {
+		end = slot->offset + request->data_len;
+		if (end == zone->start + zone->capacity) {
+			if (zbd_finish_zones(meta->write.fd,
+					     (long long)zone->start,
+					     (long long)zone->len)) {
+				pr_err("zone close failed (start:%llu, len: %llu)\n",
+				       zone->start, zone->len);
+			}
+			zone_close_zone(dev, slot->zone_num);
+		}
+	}
+	if (request->end_rq) {
+		request->end_rq(request);
+	}
+}
+
+/**
+ * @brief reaping thread which completes the requests
+ *
+ * @param data pointer of the device structure
+ *
+ * @return NULL
+ *
+ * @note
+ * The thread finishes after the stop is requested and every submitted
+ * entry is completed.
+ */
+static void *zone_uring_thread(void *data)
+{
+	struct device *dev = (struct device *)data;
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zone_uring *uring = meta->uring;
+	struct zone_uring_slot *slot;
+	struct io_uring_cqe *cqe;
+	unsigned int head, tail;
+	int *done = uring->completed;
+	size_t nr_done, i;
+	int is_exit = 0;
+
+	while (!is_exit) {
+		if (syscall(__NR_io_uring_enter, uring->fd, 0, 1,
+			    IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+		    errno != EINTR) {
+			pr_err("io_uring wait failed (errno: %d)\n", errno);
+		}
+
+		nr_done = 0;
+		pthread_mutex_lock(&uring->mutex);
+		head = *uring->cq_head;
+		tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++) {
+			cqe = &uring->cqes[head & *uring->cq_mask];
+			uring->nr_submitted--;
+			if (cqe->user_data == ZONE_URING_STOP) {
+				continue;
+			}
+			done[nr_done] = (int)cqe->user_data;
+			slot = &uring->slots[done[nr_done]];
+			slot->result = cqe->res;
+			if (slot->flag == DEVICE_WRITE) {
+				zone_uring_next(dev, slot->zone_num);
+			}
+			nr_done++;
+		}
+		__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+		zone_uring_flush(uring);
+		is_exit = uring->is_stop && uring->nr_submitted == 0 &&
+			  uring->nr_pending == 0;
+		pthread_mutex_unlock(&uring->mutex);
+
+		for (i = 0; i < nr_done; i++) {
+			zone_uring_end_request(dev, &uring->slots[done[i]]);
+		}
+		if (nr_done == 0) {
+			continue;
+		}
+		pthread_mutex_lock(&uring->mutex);
+		for (i = 0; i < nr_done; i++) {
+			uring->free_slots[uring->nr_free_slots++] = done[i];
+		}
+		pthread_cond_broadcast(&uring->space);
+		if (uring->nr_free_slots == ZONE_URING_QUEUE_DEPTH) {
+			pthread_cond_broadcast(&uring->idle);
+		}
+		pthread_mutex_unlock(&uring->mutex);
+	}
+	return NULL;
+}
+
+/**
+ * @brief submit the validated request by the io_uring
+ *
+ * @param dev pointer of the device structure
+ * @param request read or write request
+ * @param zone_num zone number of the request
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * This blocks while `ZONE_URING_QUEUE_DEPTH` requests are in flight. The
+ * request's data must be valid until the `end_rq` is called.
+ */
+int zone_uring_submit(struct device *dev, struct device_request *request,
+		      uint64_t zone_num)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zone_uring *uring = meta->uring;
+	struct zone_uring_zone *zone = &uring->zones[zone_num];
+	struct zone_uring_slot *slot;
+	int slot_num;
+	int ret = 0;
+
+	pthread_mutex_lock(&uring->mutex);
+	while (uring->nr_free_slots == 0) {
+		pthread_cond_wait(&uring->space, &uring->mutex);
+	}
+	slot_num = uring->free_slots[--uring->nr_free_slots];
+	slot = &uring->slots[slot_num];
+	slot->request = request;
+	slot->flag = request->flag;
+	slot->offset = (uint64_t)request->paddr.lpn * device_get_page_size(dev);
+	slot->zone_num = zone_num;
+	slot->data = (char *)request->data;
+	if (request->flag == DEVICE_WRITE &&
+	    (uintptr_t)request->data % DEVICE_BUFFER_ALIGN) {
+		slot->data = slot->buffer;
+		memcpy(slot->buffer, request->data, request->data_len);
+	}
+
+	if (zone->is_writing) {
+		zone->waiting =
+			g_list_append(zone->waiting, GINT_TO_POINTER(slot_num));
+		goto exit;
+	}
+	if (request->flag == DEVICE_WRITE) {
+		zone->is_writing = 1;
+	}
+	zone_uring_prepare(dev, slot_num);
+	/**< otherwise, the reaping thread submits it after a completion */
+	if (uring->nr_pending >= ZONE_URING_BATCH || uring->nr_submitted == 0) {
+		ret = zone_uring_flush(uring);
+	}
+exit:
+	pthread_mutex_unlock(&uring->mutex);
+	return ret;
+}
+
+/**
+ * @brief wait until every submitted request is completed
+ *
+ * @param dev pointer of the device structure
+ */
+void zone_uring_drain(struct device *dev)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zone_uring *uring = meta->uring;
+
+	pthread_mutex_lock(&uring->mutex);
+	while (uring->nr_free_slots < ZONE_URING_QUEUE_DEPTH) {
+		pthread_cond_wait(&uring->idle, &uring->mutex);
+	}
+	pthread_mutex_unlock(&uring->mutex);
+}
+
+/**
+ * @brief map the submission and completion queues of the io_uring
+ *
+ * @param uring pointer of the io_uring (`fd` must be set)
+ * @param params parameters which are returned by the setup
+ *
+ * @return 0 for success, negative value for fail
+ */
+static int zone_uring_map(struct zone_uring *uring,
+			  struct io_uring_params *params)
+{
+	const int prot = PROT_READ | PROT_WRITE;
+	const int flags = MAP_SHARED | MAP_POPULATE;
+	char *sq, *cq;
+	void *sqes;
+
+	uring->sq_ring_size =
+		params->sq_off.array + params->sq_entries * sizeof(unsigned int);
+	uring->cq_ring_size = params->cq_off.cqes + params->cq_entries *
+							    sizeof(struct io_uring_cqe);
+	uring->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+
+	uring->sq_ring = mmap(NULL, uring->sq_ring_size, prot, flags,
+			      uring->fd, IORING_OFF_SQ_RING);
+	uring->cq_ring = mmap(NULL, uring->cq_ring_size, prot, flags,
+			      uring->fd, IORING_OFF_CQ_RING);
+	sqes = mmap(NULL, uring->sqes_size, prot, flags, uring->fd,
+		    IORING_OFF_SQES);
+	if (uring->sq_ring == MAP_FAILED || uring->cq_ring == MAP_FAILED ||
+	    sqes == MAP_FAILED) {
+		pr_err("io_uring mapping failed (errno: %d)\n", errno);
+		uring->sq_ring = uring->sq_ring == MAP_FAILED ? NULL :
+								uring->sq_ring;
+		uring->cq_ring = uring->cq_ring == MAP_FAILED ? NULL :
+								uring->cq_ring;
+		uring->sqes = sqes == MAP_FAILED ? NULL :
+						   (struct io_uring_sqe *)sqes;
+		return -ENOMEM;
+	}
+	uring->sqes = (struct io_uring_sqe *)sqes;
+
+	sq = (char *)uring->sq_ring;
+	uring->sq_head = (unsigned int *)(sq + params->sq_off.head);
+	uring->sq_tail = (unsigned int *)(sq + params->sq_off.tail);
+	uring->sq_mask = (unsigned int *)(sq + params->sq_off.ring_mask);
+	uring->sq_array = (unsigned int *)(sq + params->sq_off.array);
+
+	cq = (char *)uring->cq_ring;
+	uring->cq_head = (unsigned int *)(cq + params->cq_off.head);
+	uring->cq_tail = (unsigned int *)(cq + params->cq_off.tail);
+	uring->cq_mask = (unsigned int *)(cq + params->cq_off.ring_mask);
+	uring->cqes = (struct io_uring_cqe *)(cq + params->cq_off.cqes);
+	return 0;
+}
+
+/**
+ * @brief allocate the slots and register their buffers
+ *
+ * @param dev pointer of the device structure
+ *
+ * @return 0 for success, negative value for fail
+ *
+ * @note
+ * The kernel which cannot pin the buffers (e.g., `RLIMIT_MEMLOCK`) uses the
+ * same buffers without the registration.
+ */
+static int zone_uring_alloc_slots(struct device *dev)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zone_uring *uring = meta->uring;
+	size_t page_size = device_get_page_size(dev);
+	struct iovec *iovecs;
+	int i, ret;
+
+	ret = posix_memalign((void **)&uring->buffers,
+			     (size_t)sysconf(_SC_PAGESIZE),
+			     page_size * ZONE_URING_QUEUE_DEPTH);
+	if (ret) {
+		uring->buffers = NULL;
+		return -ret;
+	}
+	uring->slots = (struct zone_uring_slot *)calloc(
+		ZONE_URING_QUEUE_DEPTH, sizeof(struct zone_uring_slot));
+	uring->free_slots = (int *)malloc(sizeof(int) * ZONE_URING_QUEUE_DEPTH);
+	uring->completed = (int *)malloc(sizeof(int) * ZONE_URING_QUEUE_DEPTH);
+	uring->zones = (struct zone_uring_zone *)calloc(
+		meta->nr_zones, sizeof(struct zone_uring_zone));
+	iovecs = (struct iovec *)malloc(sizeof(struct iovec) *
+					ZONE_URING_QUEUE_DEPTH);
+	if (uring->slots == NULL || uring->free_slots == NULL ||
+	    uring->completed == NULL || uring->zones == NULL || iovecs == NULL) {
+		free(iovecs);
+		return -ENOMEM;
+	}
+	for (i = 0; i < ZONE_URING_QUEUE_DEPTH; i++) {
+		uring->slots[i].buffer = &uring->buffers[(size_t)i * page_size];
+		/**< the lower slot number is popped first */
+		uring->free_slots[i] = ZONE_URING_QUEUE_DEPTH - 1 - i;
+		iovecs[i].iov_base = uring->slots[i].buffer;
+		iovecs[i].iov_len = page_size;
+	}
+	uring->nr_free_slots = ZONE_URING_QUEUE_DEPTH;
+
+	uring->is_fixed = syscall(__NR_io_uring_register, uring->fd,
+				  IORING_REGISTER_BUFFERS, iovecs,
+				  ZONE_URING_QUEUE_DEPTH) == 0;
+	if (!uring->is_fixed) {
+		pr_warn("fixed buffers are not registered (errno: %d)\n",
+			errno);
+	}
+	free(iovecs);
+	return 0;
+}
+
+/**
+ * @brief set up the io_uring and run the reaping thread
+ *
+ * @param dev pointer of the device structure
+ *
+ * @return 0 for success, negative value for fail
+ */
+int zone_uring_init(struct device *dev)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct io_uring_params params;
+	struct zone_uring *uring;
+	int ret;
+
+	uring = (struct zone_uring *)malloc(sizeof(struct zone_uring));
+	if (uring == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	memset(uring, 0, sizeof(struct zone_uring));
+	uring->fd = -1;
+	meta->uring = uring;
+
+	memset(&params, 0, sizeof(struct io_uring_params));
+	/**< slots and the stop's no-op */
+	uring->fd = (int)syscall(__NR_io_uring_setup,
+				 ZONE_URING_QUEUE_DEPTH + 1, &params);
+	if (uring->fd < 0) {
+		ret = -errno;
+		pr_err("io_uring setup failed (errno: %d)\n", -ret);
+		goto exception;
+	}
+	uring->nr_entries = params.sq_entries;
+	ret = zone_uring_map(uring, &params);
+	if (ret) {
+		goto exception;
+	}
+	ret = zone_uring_alloc_slots(dev);
+	if (ret) {
+		pr_err("slot allocation failed\n");
+		goto exception;
+	}
+
+	pthread_mutex_init(&uring->mutex, NULL);
+	pthread_cond_init(&uring->space, NULL);
+	pthread_cond_init(&uring->idle, NULL);
+	ret = pthread_create(&uring->thread, NULL, zone_uring_thread,
+			     (void *)dev);
+	if (ret) {
+		pr_err("reaping thread creation failed\n");
+		pthread_cond_destroy(&uring->idle);
+		pthread_cond_destroy(&uring->space);
+		pthread_mutex_destroy(&uring->mutex);
+		ret = -ret;
+		goto exception;
+	}
+	uring->is_running = 1;
+	pr_info("io_uring enabled (entries: %u, fixed buffers: %s)\n",
+		uring->nr_entries, uring->is_fixed ? "on" : "off");
+	return 0;
+exception:
+	zone_uring_free(dev);
+	return ret;
+}
+
+/**
+ * @brief complete the in-flight requests and release the io_uring
+ *
+ * @param dev pointer of the device structure
+ */
+void zone_uring_free(struct device *dev)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zone_uring *uring = meta->uring;
+	uint64_t i;
+
+	if (uring == NULL) {
+		return;
+	}
+	if (uring->is_running) {
+		pthread_mutex_lock(&uring->mutex);
+		uring->is_stop = 1;
+		zone_uring_prepare(dev, -1);
+		zone_uring_flush(uring);
+		pthread_mutex_unlock(&uring->mutex);
+		pthread_join(uring->thread, NULL);
+
+		pthread_cond_destroy(&uring->idle);
+		pthread_cond_destroy(&uring->space);
+		pthread_mutex_destroy(&uring->mutex);
+	}
+	if (uring->sqes) {
+		munmap(uring->sqes, uring->sqes_size);
+	}
+	if (uring->cq_ring) {
+		munmap(uring->cq_ring, uring->cq_ring_size);
+	}
+	if (uring->sq_ring) {
+		munmap(uring->sq_ring, uring->sq_ring_size);
+	}
+	if (uring->fd >= 0) {
+		close(uring->fd); /**< it unregisters the buffers */
+	}
+	if (uring->zones) {
+		for (i = 0; i < meta->nr_zones; i++) {
+			g_list_free(uring->zones[i].waiting);
+		}
+		free(uring->zones);
+	}
+	free(uring->completed);
+	free(uring->free_slots);
+	free(uring->slots);
+	free(uring->buffers);
+	free(uring);
+	meta->uring = NULL;
+}
@@ -9,17 +9,273 @@
 #define _GNU_SOURCE
 #endif
 
-#include <libzbd/zbd.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <errno.h>
 #include <glib.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "zone.h"
 #include "device.h"
 #include "log.h"
 
+/**
+ * @brief allocate the bounce buffers of the unaligned writes
+ *
+ * @param dev pointer of the device structure
+ *
+ * @return 0 for success, negative number for fail
+ */
+static int zone_alloc_pool(struct device *dev)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zone_buffer_pool *pool = &meta->pool;
+	size_t page_size = device_get_page_size(dev);
+	int i;
+
+	pool->buffers =
+		(char *)device_alloc_buffer(page_size * ZONE_NR_BUFFERS);
+	pool->free_buffers = (int *)malloc(sizeof(int) * ZONE_NR_BUFFERS);
+	if (pool->buffers == NULL || pool->free_buffers == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	for (i = 0; i < ZONE_NR_BUFFERS; i++) {
+		pool->free_buffers[i] = i;
+	}
+	pool->nr_free_buffers = ZONE_NR_BUFFERS;
+	return 0;
+}
+
+/**
+ * @brief deallocate the bounce buffers of the unaligned writes
+ *
+ * @param meta pointer of the zoned block device's metadata
+ */
+static void zone_free_pool(struct zone_meta *meta)
+{
+	struct zone_buffer_pool *pool = &meta->pool;
+
+	free(pool->buffers);
+	free(pool->free_buffers);
+	pool->buffers = NULL;
+	pool->free_buffers = NULL;
+	pool->nr_free_buffers = 0;
+}
+
+/**
+ * @brief get the bounce buffer from the pool
+ *
+ * @param dev pointer of the device structure
+ *
+ * @return pointer of the page-sized buffer
+ *
+ * @note
+ * This blocks while every buffer is used.
+ */
+static char *zone_get_buffer(struct device *dev)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zone_buffer_pool *pool = &meta->pool;
+	int idx;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->nr_free_buffers == 0) {
+		pthread_cond_wait(&pool->cond, &pool->mutex);
+	}
+	idx = pool->free_buffers[--pool->nr_free_buffers];
+	pthread_mutex_unlock(&pool->mutex);
+	return &pool->buffers[(size_t)idx * device_get_page_size(dev)];
+}
+
+/**
+ * @brief return the bounce buffer to the pool
+ *
+ * @param dev pointer of the device structure
+ * @param buffer buffer which is got by the `zone_get_buffer()`
+ */
+static void zone_put_buffer(struct device *dev, char *buffer)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zone_buffer_pool *pool = &meta->pool;
+	size_t idx;
+
+	idx = (size_t)(buffer - pool->buffers) / device_get_page_size(dev);
+	pthread_mutex_lock(&pool->mutex);
+	pool->free_buffers[pool->nr_free_buffers++] = (int)idx;
+	pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+/**
+ * @brief check the buffer can be used for the direct I/O
+ *
+ * @param data pointer of the buffer
+ *
+ * @return 1 for the aligned buffer, 0 for the others
+ */
+static inline int zone_is_aligned(const void *data)
+{
+	return ((uintptr_t)data % DEVICE_BUFFER_ALIGN) == 0;
+}
+
+/**
+ * @brief allocate the zones' write states
+ *
+ * @param dev pointer of the device structure
+ *
+ * @return 0 for success, negative number for fail
+ *
+ * @note
+ * The zone which is partially written is open already.
+ */
+static int zone_alloc_states(struct device *dev)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zbd_zone *zone;
+	uint64_t i;
+	gint nr_open = 0;
+
+	meta->states = (struct zone_state *)malloc(sizeof(struct zone_state) *
+						   meta->nr_zones);
+	if (meta->states == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	for (i = 0; i < meta->nr_zones; i++) {
+		zone = &meta->zones[i];
+		pthread_mutex_init(&meta->states[i].mutex, NULL);
+		g_atomic_int_set(&meta->states[i].is_stale, 0);
+		g_atomic_int_set(&meta->states[i].is_open,
+				 zone->wp != zone->start && !zone_is_full(zone));
+		nr_open += g_atomic_int_get(&meta->states[i].is_open);
+	}
+	g_atomic_int_set(&meta->nr_open_zones, nr_open);
+	return 0;
+}
+
+/**
+ * @brief deallocate the zones' write states
+ *
+ * @param meta pointer of the zoned block device's metadata
+ */
+static void zone_free_states(struct zone_meta *meta)
+{
+	uint64_t i;
+
+	if (meta->states == NULL) {
+		return;
+	}
+	for (i = 0; i < meta->nr_zones; i++) {
+		pthread_mutex_destroy(&meta->states[i].mutex);
+	}
+	free(meta->states);
+	meta->states = NULL;
+	g_atomic_int_set(&meta->nr_open_zones, 0);
+}
+
+/**
+ * @brief open the zone which is written first
+ *
+ * @param dev pointer of the device structure
+ * @param zone_num zone number which wants to write
+ *
+ * @return 0 for success, negative number for fail
+ *
+ * @note
+ * The caller must hold the zone's mutex. The write which opens a new zone
+ * over the `max_open_zones` fails like the real device.
+ */
+static int zone_open_zone(struct device *dev, uint64_t zone_num)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zone_state *state = &meta->states[zone_num];
+	gint nr_open;
+
+	if (g_atomic_int_get(&state->is_open)) {
+		return 0;
+	}
+	do {
+		nr_open = g_atomic_int_get(&meta->nr_open_zones);
+		if (meta->max_open_zones &&
+		    (size_t)nr_open >= meta->max_open_zones) {
+			pr_err("too many open zones (max: %zu, zone: %lu)\n",
+			       meta->max_open_zones, zone_num);
+			return -EBUSY;
+		}
+	} while (!g_atomic_int_compare_and_exchange(&meta->nr_open_zones,
+						    nr_open, nr_open + 1));
+	g_atomic_int_set(&state->is_open, 1);
+	return 0;
+}
+
+/**
+ * @brief close the zone which becomes full or empty
+ *
+ * @param dev pointer of the device structure
+ * @param zone_num zone number which is finished or reset
+ *
+ * @note
+ * The io_uring's reaping thread calls this without the zone's mutex.
+ */
+void zone_close_zone(struct device *dev, uint64_t zone_num)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zone_state *state = &meta->states[zone_num];
+
+	if (g_atomic_int_compare_and_exchange(&state->is_open, 1, 0)) {
+		g_atomic_int_add(&meta->nr_open_zones, -1);
+	}
+}
+
+/**
+ * @brief read the zone's write pointer from the device again
+ *
+ * @param dev pointer of the device structure
+ * @param zone_num zone number which has the stale write pointer
+ *
+ * @return 0 for success, negative number for fail
+ *
+ * @note
+ * The caller must hold the zone's mutex. The failed write may advance the
+ * device's write pointer or not, so the write pointer is not rolled back.
+ * The in-flight writes of the zone are completed before the zone is listed.
+ */
+static int zone_sync_wp(struct device *dev, uint64_t zone_num)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct zbd_zone *zone = &meta->zones[zone_num];
+	struct zbd_zone *reported = NULL;
+	unsigned int nr_reported = 0;
+	int ret;
+
+	if (meta->uring != NULL) {
+		zone_uring_drain(dev);
+	}
+	ret = zbd_list_zones(meta->read.fd, (off_t)zone->start,
+			     (off_t)zone->len, ZBD_RO_ALL, &reported,
+			     &nr_reported);
+	if (ret || nr_reported != 1) {
+		pr_err("failed to list the zone (zone: %lu, err: %d)\n",
+		       zone_num, ret);
+		free(reported);
+		return ret ? ret : -EIO;
+	}
+	pr_warn("write pointer is synced (zone: %lu, wp: %llu => %llu)\n",
+		zone_num, zone->wp, reported->wp);
+	zone->wp = reported->wp;
+	zone->cond = reported->cond;
+	free(reported);
+	if (zone_is_full(zone)) {
+		zone_close_zone(dev, zone_num);
+	}
+	g_atomic_int_set(&meta->states[zone_num].is_stale, 0);
+	return 0;
+}
+
 /**
  * @brief open the zoned block deivce file
  *
@@ -106,6 +362,26 @@ int zone_open(struct device *dev, const char *name, int flags)
 		}
 	}
 
+	ret = zone_alloc_states(dev);
+	if (ret) {
+		goto exception;
+	}
+	meta->max_open_zones = zone_info.max_nr_open_zones;
+	info->max_open_segments = meta->max_open_zones;
+	info->is_append = meta->is_append;
+
+	ret = zone_alloc_pool(dev);
+	if (ret) {
+		goto exception;
+	}
+
+	if (meta->is_uring) {
+		ret = zone_uring_init(dev);
+		if (ret) {
+			pr_err("io_uring initialize failed\n");
+			goto exception;
+		}
+	}
 	return ret;
 exception:
 	zone_close(dev);
@@ -134,7 +410,11 @@ static ssize_t zone_do_rw(int fd, int flag, void *buffer, size_t count,
 		if (flag == DEVICE_READ) {
 			ret = pread(fd, buffer, remaining, ofst);
 		} else if (flag == DEVICE_WRITE) {
+#ifdef ZONE_USE_EMULATION
+			ret = zone_emu_pwrite(fd, buffer, remaining, ofst);
+#else
 			ret = pwrite(fd, buffer, remaining, ofst);
+#endif
 		} else {
 			pr_err("invalid flag detected (flag: %d)\n", flag);
 			return -EINVAL;
@@ -155,6 +435,41 @@ static ssize_t zone_do_rw(int fd, int flag, void *buffer, size_t count,
 	return count - remaining;
 }
 
+/**
+ * @brief submit the validated request by the io_uring
+ *
+ * @param dev pointer of the device structre
+ * @param request pointer of the user request
+ * @param zone_num zone number of the request
+ *
+ * @return the number of bytes to submit, negative number for fail
+ *
+ * @note
+ * The request without the `end_rq` cannot know its completion. So, it is
+ * completed before this returns, and its `request->status` is returned for
+ * the failure. The others get the result by the `request->status` in the
+ * `end_rq`.
+ */
+static ssize_t zone_submit(struct device *dev, struct device_request *request,
+			   uint64_t zone_num)
+{
+	size_t data_len = request->data_len;
+	int is_sync = request->end_rq == NULL;
+	int ret;
+
+	ret = zone_uring_submit(dev, request, zone_num);
+	if (ret) {
+		return ret;
+	}
+	if (is_sync) {
+		zone_uring_drain(dev);
+		if (request->status < 0) {
+			return request->status;
+		}
+	}
+	return (ssize_t)data_len;
+}
+
 /**
  * @brief write to the zoned block device
  *
@@ -162,18 +477,23 @@ static ssize_t zone_do_rw(int fd, int flag, void *buffer, size_t count,
  * @param request pointer of the user request
  *
  * @return the number of bytes to write, negative number for fail
+ *
+ * @note
+ * In the append mode, the page of `request->paddr` is ignored. The write is
+ * placed at the zone's write pointer, and the placement is stored to the
+ * `request->paddr` before the `end_rq` is called.
  */
 ssize_t zone_write(struct device *dev, struct device_request *request)
 {
 	struct zone_meta *meta;
 	struct zbd_zone *zone;
+	struct zone_state *state;
 	size_t page_size = device_get_page_size(dev);
 	ssize_t ret = 0;
 	uint64_t zone_num;
 	char *buffer;
 
 	meta = (struct zone_meta *)dev->d_private;
-	buffer = NULL;
 
 	if (request->data == NULL) {
 		pr_err("you do not pass the data pointer to NULL\n");
@@ -197,14 +517,6 @@ ssize_t zone_write(struct device *dev, struct device_request *request)
 		ret = -EINVAL;
 		goto exit;
 	}
-	ret = posix_memalign((void **)&buffer, sysconf(_SC_PAGESIZE),
-			     device_get_page_size(dev));
-	if (ret) {
-		pr_err("buffer allocation failed\n");
-		buffer = NULL;
-		goto exit;
-	}
-	memcpy(buffer, request->data, request->data_len);
 	zone_num = zone_get_zone_number(dev, request->paddr);
 	if (zone_num >= meta->nr_zones) {
 		pr_err("invalid address value detected (lpn: %u)\n",
@@ -213,40 +525,88 @@ ssize_t zone_write(struct device *dev, struct device_request *request)
 		goto exit;
 	}
 	zone = &meta->zones[zone_num];
-	if (zone->wp != (request->paddr.lpn * page_size)) {
+	state = &meta->states[zone_num];
+	pthread_mutex_lock(&state->mutex);
+	if (g_atomic_int_get(&state->is_stale)) {
+		ret = zone_sync_wp(dev, zone_num);
+		if (ret) {
+			goto unlock;
+		}
+	}
+	if (meta->is_append) {
+		if (zone_is_full(zone)) {
+			pr_err("zone is full (zone: %lu)\n", zone_num);
+			ret = -ENOSPC;
+			goto unlock;
+		}
+		/**< zone append: the write pointer decides the page */
+		request->paddr.lpn = (uint32_t)(zone->wp / page_size);
+	}
+	if (zone_is_full(zone) ||
+	    zone->wp != (request->paddr.lpn * page_size)) {
 		pr_err("write pointer doesn't match (expected: %lu, actual: %lu, zone: %lu)\n",
 		       (uint64_t)(zone->wp),
 		       (uint64_t)(request->paddr.lpn * page_size), zone_num);
 		ret = -EINVAL;
-		goto exit;
+		goto unlock;
+	}
+	ret = zone_open_zone(dev, zone_num);
+	if (ret) {
+		goto unlock;
+	}
+	if (meta->uring != NULL) {
+#ifdef ZONE_USE_EMULATION
+		/**< the emulated device accepts the write before the io_uring */
+		ret = zone_emu_advance(meta->write.fd, zone->wp, page_size);
+		if (ret) {
+			goto unlock;
+		}
+#endif
+		zone->wp += page_size; /**< the next write is queued after this */
+		ret = zone_submit(dev, request, zone_num);
+		if (ret < 0) {
+			g_atomic_int_set(&state->is_stale, 1);
+		}
+		goto unlock;
+	}
+	buffer = (char *)request->data;
+	if (!zone_is_aligned(buffer)) {
+		buffer = zone_get_buffer(dev);
+		memcpy(buffer, request->data, request->data_len);
 	}
 	ret = zone_do_rw(meta->write.fd, request->flag, buffer,
 			 request->data_len,
 			 (off_t)request->paddr.lpn * page_size);
+	if (buffer != request->data) {
+		zone_put_buffer(dev, buffer);
+	}
 	if (ret != (ssize_t)page_size) {
 		pr_err("do io sequence failed(expected: %ld, actual: %ld)\n",
 		       ret, (ssize_t)page_size);
+		g_atomic_int_set(&state->is_stale, 1);
 		ret = -EFAULT;
-		goto exit;
+		goto unlock;
 	}
 	zone->wp += ret;
-	if (zone->wp == zone->start + zone->len) {
+	if (zone_is_full(zone)) {
 		int status;
 		status = zbd_finish_zones(meta->write.fd, zone->start,
 					  zone->len);
 		if (status) {
 			pr_err("zone close failed (start:%llu, len: %llu)\n",
 			       zone->start, zone->len);
-			goto exit;
+			goto unlock;
 		}
+		zone_close_zone(dev, zone_num);
 	}
+	pthread_mutex_unlock(&state->mutex);
 	if (request->end_rq) {
 		request->end_rq(request);
 	}
+	return ret;
+unlock:
+	pthread_mutex_unlock(&state->mutex);
 exit:
-	if (buffer) {
-		free(buffer);
-	}
 	return ret;
 }
 
@@ -264,10 +624,8 @@ ssize_t zone_read(struct device *dev, struct device_request *request)
 	size_t page_size;
 	ssize_t ret = 0;
 	uint64_t zone_num;
-	char *buffer;
 
 	meta = (struct zone_meta *)dev->d_private;
-	buffer = NULL;
 
 	if (request->data == NULL) {
 		pr_err("NULL data pointer detected\n");
@@ -300,25 +658,21 @@ ssize_t zone_read(struct device *dev, struct device_request *request)
 		ret = -EINVAL;
 		goto exit;
 	}
-	ret = posix_memalign((void **)&buffer, sysconf(_SC_PAGESIZE),
-			     device_get_page_size(dev));
-	if (ret) {
-		pr_err("buffer allocation failed\n");
-		buffer = NULL;
+	if (meta->uring != NULL) {
+		ret = zone_submit(dev, request, zone_num);
 		goto exit;
 	}
-	memset(buffer, 0, page_size);
-	ret = zone_do_rw(meta->read.fd, request->flag, buffer,
+	/**< the read file descriptor is not opened with the `O_DIRECT` */
+	ret = zone_do_rw(meta->read.fd, request->flag, request->data,
 			 request->data_len,
 			 (off_t)request->paddr.lpn * page_size);
-	memcpy(request->data, buffer, page_size);
+	if (ret >= 0 && (size_t)ret < page_size) {
+		memset(&((char *)request->data)[ret], 0, page_size - (size_t)ret);
+	}
 	if (request && request->end_rq) {
 		request->end_rq(request);
 	}
 exit:
-	if (buffer) {
-		free(buffer);
-	}
 	return ret;
 }
 
@@ -333,6 +687,7 @@ exit:
 int zone_erase(struct device *dev, struct device_request *request)
 {
 	struct zone_meta *meta;
+	struct zone_state *state;
 	uint64_t zone_num;
 	int ret = 0;
 	off_t offset, length;
@@ -344,19 +699,28 @@ int zone_erase(struct device *dev, struct device_request *request)
 		ret = -EINVAL;
 		goto exit;
 	}
+	state = &meta->states[zone_num];
+	pthread_mutex_lock(&state->mutex);
+	if (meta->uring != NULL) {
+		/**< the reset must not overtake the zone's in-flight writes */
+		zone_uring_drain(dev);
+	}
 	offset = meta->zone_size * zone_num;
 	length = meta->zone_size;
 	ret = zbd_reset_zones(meta->write.fd, offset, length);
 	if (ret) {
 		pr_err("zone reset failed (%lu ~ %lu)\n", offset,
 		       offset + length);
+		pthread_mutex_unlock(&state->mutex);
 		goto exit;
 	}
+	meta->zones[zone_num].wp = meta->zones[zone_num].start;
+	zone_close_zone(dev, zone_num);
+	pthread_mutex_unlock(&state->mutex);
 
 	if (request->end_rq) {
 		request->end_rq(request);
 	}
-	meta->zones[zone_num].wp = meta->zones[zone_num].start;
 exit:
 	return ret;
 }
@@ -375,6 +739,8 @@ int zone_close(struct device *dev)
 	if (meta == NULL) {
 		return 0;
 	}
+	/**< wait for the in-flight requests */
+	zone_uring_free(dev);
 	if (meta->read.fd >= 0) {
 		zbd_close(meta->read.fd);
 		meta->read.fd = -1;
@@ -383,10 +749,36 @@ int zone_close(struct device *dev)
 		zbd_close(meta->write.fd);
 		meta->write.fd = -1;
 	}
+	zone_free_states(meta);
 	if (meta->zones) {
 		free(meta->zones);
 		meta->zones = NULL;
 	}
+	zone_free_pool(meta);
+	return 0;
+}
+
+/**
+ * @brief write back the written data to the zoned block device
+ *
+ * @param dev pointer of the device structure
+ *
+ * @return 0 for success, negative number for fail
+ */
+int zone_flush(struct device *dev)
+{
+	struct zone_meta *meta;
+	meta = (struct zone_meta *)dev->d_private;
+	if (meta == NULL || meta->write.fd < 0) {
+		return 0;
+	}
+	if (meta->uring != NULL) {
+		zone_uring_drain(dev);
+	}
+	if (fdatasync(meta->write.fd)) {
+		pr_err("flush failed (errno: %d)\n", errno);
+		return -errno;
+	}
 	return 0;
 }
 
@@ -399,6 +791,8 @@ struct device_operations __zone_dops = {
 	.read = zone_read,
 	.erase = zone_erase,
 	.close = zone_close,
+	.flush = zone_flush,
+	.get_bus_node = NULL,
 };
 
 /**
@@ -425,6 +819,18 @@ int zone_device_init(struct device *dev, uint64_t flags)
 	memset(meta, 0, sizeof(struct zone_meta));
 	meta->read.fd = -1;
 	meta->write.fd = -1;
+	pthread_mutex_init(&meta->pool.mutex, NULL);
+	pthread_cond_init(&meta->pool.cond, NULL);
+#ifdef ZONE_USE_URING
+	meta->is_uring = 1;
+#else
+	meta->is_uring = 0;
+#endif
+#ifdef ZONE_USE_APPEND
+	meta->is_append = 1;
+#else
+	meta->is_append = 0;
+#endif
 
 	dev->d_private = (void *)meta;
 	dev->d_submodule_exit = zone_device_exit;
@@ -449,6 +855,8 @@ int zone_device_exit(struct device *dev)
 	meta = (struct zone_meta *)dev->d_private;
 	if (meta != NULL) {
 		zone_close(dev);
+		pthread_cond_destroy(&meta->pool.cond);
+		pthread_mutex_destroy(&meta->pool.mutex);
 		free(meta);
 		dev->d_private = NULL;
 	}
@@ -20,10 +20,9 @@
 #include "bits.h"
 #include "device.h"
 #include "lru.h"
+#include "trace.h"
 #include <time.h>
 
-static int is_gc_thread_exit;
-int user_flag;
 /**
  * @brief do garbage collection thread
  *
@@ -60,9 +59,17 @@ static void *page_ftl_gc_thread(void *data)
 		size_t free_segments;
 		//size_t free_pages;
 		g_assert(nanosleep(&req, NULL) == 0);
-		if (g_atomic_int_get(&is_gc_thread_exit) == 1) {
+		if (g_atomic_int_get(&pgftl->is_gc_thread_exit) == 1) {
 			break;
 		}
+		if (page_ftl_wear_is_needed(pgftl)) {
+			ret = page_ftl_static_wear_leveling(pgftl);
+			if (ret < 0) {
+				pr_err("critical wear leveling error detected (errno: %zd)\n",
+				       ret);
+				break;
+			}
+		}
 		free_segments = page_ftl_get_free_segments(pgftl);
 		//free_pages = page_ftl_get_free_pages(pgftl);
 		/*
@@ -89,28 +96,18 @@ static void *page_ftl_gc_thread(void *data)
 }
 
 /**
- * @brief allocate the segment's bitmap
+ * @brief get the size of the segment's bitmap
  *
  * @param pgftl pointer of the page-ftl structure
- * @param bitmap double pointer of the bitmap
  *
- * @return 0 for successfully allocated
+ * @return bitmap size in bytes (multiple of the uint64_t)
  */
-static int page_ftl_alloc_bitmap(struct page_ftl *pgftl, uint64_t **bitmap)
+static size_t page_ftl_get_bitmap_size(struct page_ftl *pgftl)
 {
 	size_t nr_pages_per_segment;
-	uint64_t *bits;
-
 	nr_pages_per_segment = device_get_pages_per_segment(pgftl->dev);
-	bits = (uint64_t *)malloc(
-		(size_t)BITS_TO_UINT64_ALIGN(nr_pages_per_segment));
-	if (bits == NULL) {
-		pr_err("bitmap allocation failed\n");
-		return -ENOMEM;
-	}
-	memset(bits, 0, (size_t)BITS_TO_UINT64_ALIGN(nr_pages_per_segment));
-	*bitmap = bits;
-	return 0;
+	return (size_t)(BITS_TO_UINT64(nr_pages_per_segment - 1) + 1) *
+	       sizeof(uint64_t);
 }
 
 /**
@@ -125,12 +122,15 @@ int page_ftl_segment_data_init(struct page_ftl *pgftl,
 			       struct page_ftl_segment *segment)
 {
 	gint nr_pages_per_segment;
+	size_t segnum;
+
+	segnum = page_ftl_get_segment_number(pgftl, (uintptr_t)segment);
 	nr_pages_per_segment = (gint)device_get_pages_per_segment(pgftl->dev);
-	g_atomic_int_set(&segment->nr_free_pages, nr_pages_per_segment);
-	g_atomic_int_set(&segment->nr_valid_pages, 0);
+	g_atomic_int_set(&pgftl->counter.nr_free_pages[segnum],
+			 nr_pages_per_segment);
+	g_atomic_int_set(&pgftl->counter.nr_valid_pages[segnum], 0);
 
-	memset(segment->use_bits, 0,
-	       (size_t)BITS_TO_UINT64_ALIGN(nr_pages_per_segment));
+	memset(segment->use_bits, 0, page_ftl_get_bitmap_size(pgftl));
 	if (segment->lpn_list) {
 		g_list_free(segment->lpn_list);
 	}
@@ -144,32 +144,51 @@ int page_ftl_segment_data_init(struct page_ftl *pgftl,
  * @param pgftl pointer of the page ftl structure
  *
  * @return 0 to success, negative value to fail
+ *
+ * @note
+ * The counters and the bitmaps of all segments are allocated at once.
+ * Each segment's `use_bits` points to its slice of the `bitmap_arena`.
  */
 static int page_ftl_init_segment(struct page_ftl *pgftl)
 {
-	size_t nr_segments;
-
+	struct page_ftl_segment_counter *counter = &pgftl->counter;
 	struct page_ftl_segment *segments;
+	size_t nr_segments, bitmap_size;
+	gint *counters;
 
 	nr_segments = device_get_nr_segments(pgftl->dev);
+	bitmap_size = page_ftl_get_bitmap_size(pgftl);
 
-	segments = (struct page_ftl_segment *)malloc(
-		sizeof(struct page_ftl_segment) * nr_segments);
+	/**< zeroed, so the close can walk the segments after any failure */
+	segments = (struct page_ftl_segment *)calloc(
+		nr_segments, sizeof(struct page_ftl_segment));
 	if (segments == NULL) {
 		pr_err("memory allocation failed\n");
 		return -ENOMEM;
 	}
-	for (size_t i = 0; i < nr_segments; i++) {
-		segments[i].use_bits = NULL;
+	pgftl->segments = segments;
+
+	counters = (gint *)calloc(nr_segments * PAGE_FTL_NR_SEGMENT_COUNTERS,
+				  sizeof(gint));
+	if (counters == NULL) {
+		pr_err("counter allocation failed\n");
+		return -ENOMEM;
+	}
+	counter->nr_free_pages = &counters[0];
+	counter->nr_valid_pages = &counters[nr_segments];
+	counter->nr_erase = &counters[nr_segments * 2];
+	counter->nr_pending_writes = &counters[nr_segments * 3];
+
+	pgftl->bitmap_arena = (uint64_t *)malloc(bitmap_size * nr_segments);
+	if (pgftl->bitmap_arena == NULL) {
+		pr_err("bitmap arena allocation failed\n");
+		return -ENOMEM;
 	}
+
 	for (size_t i = 0; i < nr_segments; i++) {
 		int ret;
-		ret = page_ftl_alloc_bitmap(pgftl, &segments[i].use_bits);
-		if (ret) {
-			pr_err("initialize the use bitmap failed (segnum: %zu)\n",
-			       i);
-			return ret;
-		}
+		segments[i].use_bits =
+			&pgftl->bitmap_arena[i * bitmap_size / sizeof(uint64_t)];
 		segments[i].lpn_list = NULL;
 		ret = page_ftl_segment_data_init(pgftl, &segments[i]);
 		if (ret) {
@@ -177,13 +196,53 @@ static int page_ftl_init_segment(struct page_ftl *pgftl)
 			       i);
 			return ret;
 		}
-		pr_debug("initialize the segment %zu (bits: %zu, size: %lu)\n",
-			 i, device_get_pages_per_segment(pgftl->dev),
-			 (uint64_t)(device_get_pages_per_segment(pgftl->dev)) /
-				 8);
 	}
+	pr_debug("initialize the segments (count: %zu, bitmap: %zu bytes)\n",
+		 nr_segments, bitmap_size);
+	return 0;
+}
 
-	pgftl->segments = segments;
+/**
+ * @brief initialize the free segment heap and the active segments
+ *
+ * @param pgftl pointer of the page-ftl structure
+ *
+ * @return 0 to success, negative value to fail
+ *
+ * @note
+ * Bad segments are excluded in this function. So, the allocator doesn't need
+ * to check the bad segment bitmap for every allocation.
+ */
+static int page_ftl_init_free_segq(struct page_ftl *pgftl)
+{
+	struct page_ftl_segment_queue *queue = &pgftl->free_segq;
+	size_t nr_segments, segnum, stripe;
+	int frontier;
+
+	nr_segments = device_get_nr_segments(pgftl->dev);
+	queue->entries = (struct page_ftl_free_segment *)malloc(
+		sizeof(struct page_ftl_free_segment) * nr_segments);
+	if (queue->entries == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	queue->capacity = nr_segments;
+	queue->nr_entries = 0;
+	queue->seq = 0;
+	for (segnum = 0; segnum < nr_segments; segnum++) {
+		page_ftl_push_free_segment(pgftl, segnum);
+	}
+	pr_debug("free segment queue initialized (%zu/%zu)\n",
+		 queue->nr_entries, nr_segments);
+
+	for (frontier = 0; frontier < PAGE_FTL_NR_FRONTIERS; frontier++) {
+		for (stripe = 0; stripe < PAGE_FTL_MAX_STRIPES; stripe++) {
+			pgftl->alloc_segnum[frontier][stripe] =
+				PAGE_FTL_NO_SEGMENT;
+		}
+	}
+	pgftl->nr_stripes = page_ftl_get_nr_stripes(pgftl->dev);
+	g_atomic_int_set(&pgftl->next_stripe, 0);
 	return 0;
 }
 
@@ -277,6 +336,16 @@ int page_ftl_open(struct page_ftl *pgftl, const char *name, int flags)
 		goto exception;
 	}
 
+	pgftl->local_nodes = NULL;
+	err = pthread_key_create(&pgftl->local_key,
+				 page_ftl_release_local_node);
+	if (err) {
+		pr_err("local node key creation failed\n");
+		err = -err;
+		goto exception;
+	}
+	pgftl->is_local_key_created = 1;
+
 	dev = pgftl->dev;
 	err = dev->d_op->open(dev, name, flags);
 	if (err) {
@@ -290,6 +359,11 @@ int page_ftl_open(struct page_ftl *pgftl, const char *name, int flags)
 		goto exception;
 	}
 
+	err = page_ftl_sched_init(pgftl);
+	if (err) {
+		goto exception;
+	}
+
 	err = page_ftl_init_map(pgftl);
 	if (err) {
 		goto exception;
@@ -299,7 +373,22 @@ int page_ftl_open(struct page_ftl *pgftl, const char *name, int flags)
 	if (err) {
 		goto exception;
 	}
+
+	err = page_ftl_init_free_segq(pgftl);
+	if (err) {
+		goto exception;
+	}
 	pgftl->gc_list = NULL;
+	pgftl->pacer.victim = NULL;
+	pgftl->pacer.tokens = 0;
+	page_ftl_stat_reset(pgftl);
+	page_ftl_wear_init(pgftl);
+#if defined(PAGE_FTL_USE_WEAR_LEVELING) && !defined(DEVICE_USE_ZONED)
+	page_ftl_set_wear_leveling(pgftl, 1);
+#else
+	/**< the zoned device enables it by the ioctl if it is needed */
+	page_ftl_set_wear_leveling(pgftl, 0);
+#endif
 
 	nr_segments = device_get_nr_segments(dev);
 	pgftl->gc_seg_bits =
@@ -313,13 +402,14 @@ int page_ftl_open(struct page_ftl *pgftl, const char *name, int flags)
 
 	pgftl->o_flags = flags;
 
-	g_atomic_int_set(&is_gc_thread_exit, 0);
+	g_atomic_int_set(&pgftl->is_gc_thread_exit, 0);
 	gc_thread_status = pthread_create(&pgftl->gc_thread, NULL,
 					  page_ftl_gc_thread, (void *)pgftl);
 	if (gc_thread_status < 0) {
 		pr_err("garbage collection thread creation failed\n");
 		goto exception;
 	}
+	pgftl->is_gc_thread_running = 1;
 
 	return 0;
 
@@ -349,36 +439,56 @@ ssize_t page_ftl_submit_request(struct page_ftl *pgftl,
 		       request);
 		return -EINVAL;
 	}
+	if (request->flag == DEVICE_WRITE || request->flag == DEVICE_READ) {
+		trace_point(request->flag == DEVICE_WRITE ?
+				    TRACE_POINT_WRITE_BEGIN :
+				    TRACE_POINT_READ_BEGIN);
+	}
 	pthread_mutex_lock(&pgftl->gc_mutex);
 	switch (request->flag) {
 	case DEVICE_WRITE:
+		trace_point(TRACE_POINT_GC_LOCK);
+		/**< the relocation excludes the host reads and writes */
+		if (g_atomic_int_get(&pgftl->pacer.is_enabled) &&
+		    page_ftl_gc_pace_refill(pgftl)) {
 #ifdef PAGE_FTL_USE_GLOBAL_RWLOCK
-		pthread_rwlock_wrlock(&pgftl->rwlock);
+			pthread_rwlock_wrlock(&pgftl->rwlock);
+#endif
+			ret = page_ftl_gc_pace(pgftl);
+			if (ret < 0) {
+				pr_err("paced garbage collection failed\n");
+			}
+#ifdef PAGE_FTL_USE_GLOBAL_RWLOCK
+			pthread_rwlock_unlock(&pgftl->rwlock);
+#endif
+			trace_point(TRACE_POINT_GC_PACE);
+		}
+#ifdef PAGE_FTL_USE_GLOBAL_RWLOCK
+		if (pgftl->dev->info.is_append) {
+			/**< the device orders the writes of each segment */
+			pthread_rwlock_rdlock(&pgftl->rwlock);
+		} else {
+			pthread_rwlock_wrlock(&pgftl->rwlock);
+		}
 #endif
 		pthread_mutex_unlock(&pgftl->gc_mutex);
-		
-		/*
-		size_t sector, lpn;
-		sector = request->sector;
-		lpn = page_ftl_get_lpn(pgftl, sector);
-		user_flag = 1;
-		printf("W\tLPN: %016x \t\t", lpn);
-		*/
-
 		ret = page_ftl_write(pgftl, request);
 #ifdef PAGE_FTL_USE_GLOBAL_RWLOCK
 		pthread_rwlock_unlock(&pgftl->rwlock);
 #endif
+		trace_point(TRACE_POINT_END);
 		break;
 	case DEVICE_READ:
 #ifdef PAGE_FTL_USE_GLOBAL_RWLOCK
 		pthread_rwlock_rdlock(&pgftl->rwlock);
 #endif
 		pthread_mutex_unlock(&pgftl->gc_mutex);
+		trace_point(TRACE_POINT_GC_LOCK);
 		ret = page_ftl_read(pgftl, request);
 #ifdef PAGE_FTL_USE_GLOBAL_RWLOCK
 		pthread_rwlock_unlock(&pgftl->rwlock);
 #endif
+		trace_point(TRACE_POINT_END);
 		break;
 	case DEVICE_ERASE:
 #ifdef PAGE_FTL_USE_GLOBAL_RWLOCK
@@ -400,7 +510,7 @@ ssize_t page_ftl_submit_request(struct page_ftl *pgftl,
 /**
  * @brief deallocate the ftl's segments
  *
- * @param segments pointer of the segment array
+ * @param pgftl pointer of the page ftl structure
  */
 static void page_ftl_free_segments(struct page_ftl *pgftl)
 {
@@ -410,14 +520,6 @@ static void page_ftl_free_segments(struct page_ftl *pgftl)
 	assert(NULL != segments);
 	nr_segments = device_get_nr_segments(pgftl->dev);
 	for (i = 0; i < nr_segments; i++) {
-		uint64_t *use_bits;
-
-		use_bits = segments[i].use_bits;
-
-		if (use_bits != NULL) {
-			free(use_bits);
-		}
-
 		segments[i].use_bits = NULL;
 
 		if (segments[i].lpn_list) {
@@ -425,6 +527,17 @@ static void page_ftl_free_segments(struct page_ftl *pgftl)
 			segments[i].lpn_list = NULL;
 		}
 	}
+
+	if (pgftl->bitmap_arena) {
+		free(pgftl->bitmap_arena);
+		pgftl->bitmap_arena = NULL;
+	}
+
+	if (pgftl->counter.nr_free_pages) {
+		free(pgftl->counter.nr_free_pages); /**< head of the counters */
+		memset(&pgftl->counter, 0,
+		       sizeof(struct page_ftl_segment_counter));
+	}
 }
 
 /**
@@ -442,8 +555,17 @@ int page_ftl_close(struct page_ftl *pgftl)
 		pr_err("null page ftl structure submitted\n");
 		return ret;
 	}
-	g_atomic_int_set(&is_gc_thread_exit, 1);
-	pthread_join(pgftl->gc_thread, (void **)&status);
+	if (pgftl->is_gc_thread_running) {
+		g_atomic_int_set(&pgftl->is_gc_thread_exit, 1);
+		pthread_join(pgftl->gc_thread, (void **)&status);
+		pgftl->is_gc_thread_running = 0;
+	}
+
+	if (pgftl->is_local_key_created) {
+		/**< the exiting threads don't touch the entries after this */
+		pthread_key_delete(pgftl->local_key);
+		pgftl->is_local_key_created = 0;
+	}
 
 	pthread_mutex_destroy(&pgftl->mutex);
 	pthread_mutex_destroy(&pgftl->gc_mutex);
@@ -457,6 +579,12 @@ int page_ftl_close(struct page_ftl *pgftl)
 		pgftl->segments = NULL;
 	}
 
+	if (pgftl->free_segq.entries) {
+		free(pgftl->free_segq.entries);
+		pgftl->free_segq.entries = NULL;
+		pgftl->free_segq.nr_entries = 0;
+	}
+
 	if (pgftl->trans_map) {
 		free(pgftl->trans_map);
 		pgftl->trans_map = NULL;
@@ -467,6 +595,16 @@ int page_ftl_close(struct page_ftl *pgftl)
 		pgftl->gc_list = NULL;
 	}
 
+	if (pgftl->local_nodes) {
+		GList *node;
+		for (node = pgftl->local_nodes; node != NULL;
+		     node = node->next) {
+			free(node->data);
+		}
+		g_list_free(pgftl->local_nodes);
+		pgftl->local_nodes = NULL;
+	}
+
 	if (pgftl->gc_seg_bits) {
 		free(pgftl->gc_seg_bits);
 		pgftl->gc_seg_bits = NULL;
@@ -482,6 +620,8 @@ int page_ftl_close(struct page_ftl *pgftl)
 		pgftl->bus_rwlock = NULL;
 	}
 
+	page_ftl_sched_free(pgftl);
+
 	if (pgftl->dev && pgftl->dev->d_op) {
 		struct device *dev = pgftl->dev;
 		ret = dev->d_op->close(dev);
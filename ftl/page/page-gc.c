@@ -20,20 +20,19 @@
  *
  * @param a compare target 1
  * @param b compare target 2
+ * @param data pointer of the page FTL structure
  *
  * @return to make precede a segment that contains the less valid pages
  */
-gint page_ftl_gc_list_cmp(gconstpointer a, gconstpointer b)
+gint page_ftl_gc_list_cmp(gconstpointer a, gconstpointer b, gpointer data)
 {
-	struct page_ftl_segment *segment[2];
-	uint64_t nr_valid_pages[2];
-	segment[0] = (struct page_ftl_segment *)a;
-	segment[1] = (struct page_ftl_segment *)b;
-	nr_valid_pages[0] =
-		(uint64_t)g_atomic_int_get(&segment[0]->nr_valid_pages);
-	nr_valid_pages[1] =
-		(uint64_t)g_atomic_int_get(&segment[1]->nr_valid_pages);
-	return (gint)(nr_valid_pages[0] - nr_valid_pages[1]);
+	struct page_ftl *pgftl = (struct page_ftl *)data;
+	gint *nr_valid_pages = pgftl->counter.nr_valid_pages;
+	size_t segnum[2];
+	segnum[0] = page_ftl_get_segment_number(pgftl, (uintptr_t)a);
+	segnum[1] = page_ftl_get_segment_number(pgftl, (uintptr_t)b);
+	return g_atomic_int_get(&nr_valid_pages[segnum[0]]) -
+	       g_atomic_int_get(&nr_valid_pages[segnum[1]]);
 }
 
 /**
@@ -52,20 +51,38 @@ static void page_ftl_erase_end_rq(struct device_request *request)
  * @param pgftl pointer of the page FTL structure
  *
  * @return garbage collection target segment's pointer
+ *
+ * @note
+ * The segment which has the pending writes stays in the `gc_list`, because
+ * its `lpn_list` doesn't contain the pages of those writes yet.
  */
 static struct page_ftl_segment *page_ftl_pick_gc_target(struct page_ftl *pgftl)
 {
 	struct page_ftl_segment *segment;
+	GList *node;
+	size_t segnum;
 	if (pgftl->gc_list == NULL) {
 		return NULL;
 	}
-	pgftl->gc_list = g_list_sort(pgftl->gc_list, page_ftl_gc_list_cmp);
-	segment = (struct page_ftl_segment *)pgftl->gc_list->data;
-	pr_debug("gc target: %zu (valid: %d) => %p\n",
-		 page_ftl_get_segment_number(pgftl, (uintptr_t)segment),
-		 g_atomic_int_get(&segment->nr_valid_pages), segment);
+	pgftl->gc_list = g_list_sort_with_data(pgftl->gc_list,
+					       page_ftl_gc_list_cmp, pgftl);
+	for (node = pgftl->gc_list; node != NULL; node = node->next) {
+		segment = (struct page_ftl_segment *)node->data;
+		segnum = page_ftl_get_segment_number(pgftl, (uintptr_t)segment);
+		if (g_atomic_int_get(
+			    &pgftl->counter.nr_pending_writes[segnum]) == 0) {
+			break;
+		}
+	}
+	if (node == NULL) {
+		pr_debug("all gc targets have the pending writes\n");
+		return NULL;
+	}
+	pr_debug("gc target: %zu (valid: %d) => %p\n", segnum,
+		 g_atomic_int_get(&pgftl->counter.nr_valid_pages[segnum]),
+		 segment);
 	pgftl->gc_list = g_list_remove(pgftl->gc_list, segment);
-	g_atomic_int_set(&segment->nr_free_pages, 0);
+	g_atomic_int_set(&pgftl->counter.nr_free_pages[segnum], 0);
 	return segment;
 }
 
@@ -80,12 +97,9 @@ static struct page_ftl_segment *page_ftl_pick_gc_target(struct page_ftl *pgftl)
 static int page_ftl_segment_erase(struct page_ftl *pgftl,
 				  struct device_address paddr)
 {
-	struct device *dev;
 	struct device_request *request;
 	int ret;
 
-	dev = pgftl->dev;
-
 	request = device_alloc_request(DEVICE_DEFAULT_REQUEST);
 	if (request == NULL) {
 		pr_err("request allocation failed\n");
@@ -95,7 +109,7 @@ static int page_ftl_segment_erase(struct page_ftl *pgftl,
 	request->flag = DEVICE_ERASE;
 	request->paddr = paddr;
 	request->end_rq = page_ftl_erase_end_rq;
-	ret = dev->d_op->erase(dev, request);
+	ret = (int)page_ftl_sched_submit(pgftl, request, PAGE_FTL_SCHED_ERASE);
 	if (ret) {
 		pr_err("erase error detected(errno: %d)\n", ret);
 		return ret;
@@ -125,7 +139,7 @@ static ssize_t page_ftl_read_valid_page(struct page_ftl *pgftl, size_t lpn,
 	page_size = device_get_page_size(dev);
 	request = NULL;
 
-	buffer = (char *)malloc(page_size);
+	buffer = (char *)device_alloc_buffer(page_size);
 	if (buffer == NULL) {
 		pr_err("memory allocation failed\n");
 		ret = -ENOMEM;
@@ -145,7 +159,7 @@ static ssize_t page_ftl_read_valid_page(struct page_ftl *pgftl, size_t lpn,
 	request->sector = lpn * page_size;
 	request->data = buffer;
 
-	ret = page_ftl_read(pgftl, request);
+	ret = page_ftl_read_class(pgftl, request, PAGE_FTL_SCHED_GC);
 	if (ret != (ssize_t)page_size) {
 		pr_err("invalid read size detected (expected: %zd, acutal: %zd)\n",
 		       page_size, ret);
@@ -170,11 +184,12 @@ exception:
  * @param pgftl pointer of the page FTL structure
  * @param lpn write position which contains the logical page number
  * @param buffer buffer pointer containing the valid page
+ * @param frontier frontier which allocates the page
  *
  * @return writing data size. a negative number means fail to write
  */
 static ssize_t page_ftl_write_valid_page(struct page_ftl *pgftl, size_t lpn,
-					 char *buffer)
+					 char *buffer, int frontier)
 {
 	struct device *dev;
 	struct device_request *request;
@@ -195,7 +210,7 @@ static ssize_t page_ftl_write_valid_page(struct page_ftl *pgftl, size_t lpn,
 	request->sector = lpn * page_size;
 	request->data = buffer;
 
-	ret = page_ftl_write(pgftl, request);
+	ret = page_ftl_write_frontier(pgftl, request, frontier);
 	if (ret != (ssize_t)page_size) {
 		pr_err("invalid write size detected (expected: %zd, acutal: %zd)\n",
 		       page_size, ret);
@@ -205,16 +220,47 @@ static ssize_t page_ftl_write_valid_page(struct page_ftl *pgftl, size_t lpn,
 	return ret;
 }
 
+/**
+ * @brief copy a valid page to the frontier
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param lpn logical page number of the valid page
+ * @param frontier frontier which receives the page
+ *
+ * @return writing data size. a negative number means fail to copy
+ */
+static ssize_t page_ftl_gc_copy_page(struct page_ftl *pgftl, size_t lpn,
+				     int frontier)
+{
+	char *buffer;
+	ssize_t ret;
+
+	ret = page_ftl_read_valid_page(pgftl, lpn, &buffer);
+	if (ret < 0) {
+		pr_err("read valid page failed\n");
+		return ret;
+	}
+	ret = page_ftl_write_valid_page(pgftl, lpn, buffer, frontier);
+	if (ret < 0) {
+		pr_err("write valid page failed\n");
+		return ret;
+	}
+	page_ftl_stat_add(pgftl, PAGE_FTL_STAT_GC_COPY, 1);
+	return ret;
+}
+
 /**
  * @brief core logic of the valid page copy
  *
  * @param pgftl pointer of the page FTL structure
  * @param segment segment which wants to copy the valid pages
+ * @param frontier frontier which receives the valid pages
  *
  * @return 0 for success, negative number for fail
  */
 static ssize_t page_ftl_valid_page_copy(struct page_ftl *pgftl,
-					struct page_ftl_segment *segment)
+					struct page_ftl_segment *segment,
+					int frontier)
 {
 	ssize_t ret = 0;
 	GList *list;
@@ -224,18 +270,11 @@ static ssize_t page_ftl_valid_page_copy(struct page_ftl *pgftl,
 
 	while (list) {
 		size_t lpn;
-		char *buffer;
 
 		GList *next = list->next;
 		lpn = GPOINTER_TO_SIZE(list->data);
-		ret = page_ftl_read_valid_page(pgftl, lpn, &buffer);
+		ret = page_ftl_gc_copy_page(pgftl, lpn, frontier);
 		if (ret < 0) {
-			pr_err("read valid page failed\n");
-			return ret;
-		}
-		ret = page_ftl_write_valid_page(pgftl, lpn, buffer);
-		if (ret < 0) {
-			pr_err("write valid page failed\n");
 			return ret;
 		}
 		list = next;
@@ -244,38 +283,23 @@ static ssize_t page_ftl_valid_page_copy(struct page_ftl *pgftl,
 }
 
 /**
- * @brief core logic of the garbage collection
+ * @brief erase the segment which doesn't have the valid pages and return it
+ * to the allocator
  *
  * @param pgftl pointer of the page FTL structure
+ * @param segment target segment which all valid pages are copied
  *
  * @return 0 for success, negative number for fail
  */
-ssize_t page_ftl_do_gc(struct page_ftl *pgftl)
+static ssize_t page_ftl_gc_reclaim_segment(struct page_ftl *pgftl,
+					   struct page_ftl_segment *segment)
 {
 	struct device_address paddr;
-	struct page_ftl_segment *segment;
 	ssize_t ret;
-	size_t segnum;
+	size_t segnum, stripe;
+	int frontier;
 
-	pthread_mutex_lock(&pgftl->mutex);
-	segment = page_ftl_pick_gc_target(pgftl);
-	pthread_mutex_unlock(&pgftl->mutex);
-	if (segment == NULL) {
-		pr_debug("gc target segment doesn't exist\n");
-		return 0;
-	}
 	segnum = page_ftl_get_segment_number(pgftl, (uintptr_t)segment);
-	/*
-	printf("G\tVictim segment number: %zu\t\t Valid page number: %d\n", segnum, g_atomic_int_get(&segment->nr_valid_pages));
-	 */
-	pr_debug("current segnum: %zu\n", segnum);
-
-	ret = page_ftl_valid_page_copy(pgftl, segment);
-	if (ret < 0) {
-		pr_err("valid page copy failed\n");
-		return ret;
-	}
-
 	paddr.lpn = 0;
 	paddr.format.block = (uint16_t)segnum;
 	ret = page_ftl_segment_erase(pgftl, paddr);
@@ -285,17 +309,83 @@ ssize_t page_ftl_do_gc(struct page_ftl *pgftl)
 	}
 
 	pthread_mutex_lock(&pgftl->mutex);
+	g_atomic_int_inc(&pgftl->counter.nr_erase[segnum]);
+	page_ftl_wear_update(pgftl, segnum);
 	ret = page_ftl_segment_data_init(pgftl, segment);
 	if (ret) {
 		pr_err("initialize the segment data failed\n");
+		pthread_mutex_unlock(&pgftl->mutex);
 		return ret;
 	}
-	reset_bit(pgftl->gc_seg_bits, segnum);
+	atomic_reset_bit(pgftl->gc_seg_bits, segnum);
+	for (frontier = 0; frontier < PAGE_FTL_NR_FRONTIERS; frontier++) {
+		for (stripe = 0; stripe < PAGE_FTL_MAX_STRIPES; stripe++) {
+			if (pgftl->alloc_segnum[frontier][stripe] ==
+			    (uint64_t)segnum) {
+				pgftl->alloc_segnum[frontier][stripe] =
+					PAGE_FTL_NO_SEGMENT;
+			}
+		}
+	}
+	page_ftl_push_free_segment(pgftl, segnum);
 	pthread_mutex_unlock(&pgftl->mutex);
 
 	return 0;
 }
 
+/**
+ * @brief copy the valid pages of the segment and erase the segment
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param segment target segment which is already detached from the allocator
+ * @param frontier frontier which receives the valid pages
+ *
+ * @return 0 for success, negative number for fail
+ *
+ * @note
+ * The caller must set the segment's bit in the `gc_seg_bits` before calling
+ * this function. This function clears that bit after the erase finishes.
+ */
+ssize_t page_ftl_gc_segment(struct page_ftl *pgftl,
+			    struct page_ftl_segment *segment, int frontier)
+{
+	ssize_t ret;
+
+	/*
+	printf("G\tVictim segment number: %zu\t\t Valid page number: %d\n", segnum, g_atomic_int_get(&pgftl->counter.nr_valid_pages[segnum]));
+	 */
+	pr_debug("current segnum: %zu\n",
+		 page_ftl_get_segment_number(pgftl, (uintptr_t)segment));
+
+	ret = page_ftl_valid_page_copy(pgftl, segment, frontier);
+	if (ret < 0) {
+		pr_err("valid page copy failed\n");
+		return ret;
+	}
+	return page_ftl_gc_reclaim_segment(pgftl, segment);
+}
+
+/**
+ * @brief core logic of the garbage collection
+ *
+ * @param pgftl pointer of the page FTL structure
+ *
+ * @return 0 for success, negative number for fail
+ */
+ssize_t page_ftl_do_gc(struct page_ftl *pgftl)
+{
+	struct page_ftl_segment *segment;
+
+	pthread_mutex_lock(&pgftl->mutex);
+	segment = page_ftl_pick_gc_target(pgftl);
+	pthread_mutex_unlock(&pgftl->mutex);
+	if (segment == NULL) {
+		pr_debug("gc target segment doesn't exist\n");
+		return 0;
+	}
+	return page_ftl_gc_segment(pgftl, segment, PAGE_FTL_GC_FRONTIER);
+}
+
 /**
  * @brief do garbage collection from the gc list
  *
@@ -325,3 +415,163 @@ ssize_t page_ftl_gc_from_list(struct page_ftl *pgftl,
 	ret = (ssize_t)idx;
 	return ret;
 }
+
+/**
+ * @brief get the relocation budget of a host write
+ *
+ * @param nr_segments number of segments in the device
+ * @param free_segments number of free segments in the device
+ *
+ * @return number of pages which can be relocated per host write
+ *
+ * @note
+ * The budget grows linearly from 0 (at `PAGE_FTL_GC_PACE_HIGH`) to
+ * `PAGE_FTL_GC_PACE_MAX_BUDGET` (at no free segment).
+ */
+static double page_ftl_gc_pace_budget(size_t nr_segments, size_t free_segments)
+{
+	double free_ratio;
+
+	free_ratio = (double)free_segments / (double)nr_segments;
+	if (free_ratio >= PAGE_FTL_GC_PACE_HIGH) {
+		return 0;
+	}
+	return (double)PAGE_FTL_GC_PACE_MAX_BUDGET *
+	       (PAGE_FTL_GC_PACE_HIGH - free_ratio) / PAGE_FTL_GC_PACE_HIGH;
+}
+
+/**
+ * @brief add the budget of a host write to the token bucket
+ *
+ * @param pgftl pointer of the page FTL structure
+ *
+ * @return 1 if the pacer has the pages to relocate, 0 for nothing to do
+ *
+ * @note
+ * The caller must hold the `pgftl->gc_mutex`. The relocation needs the global
+ * write lock, so the caller takes it only when this returns 1. Otherwise, the
+ * host writes of the appending device keep sharing the lock.
+ */
+int page_ftl_gc_pace_refill(struct page_ftl *pgftl)
+{
+	struct page_ftl_gc_pacer *pacer = &pgftl->pacer;
+	size_t nr_segments, free_segments;
+	int has_victim;
+
+	nr_segments = device_get_nr_segments(pgftl->dev);
+	free_segments = page_ftl_get_free_segments(pgftl);
+	pacer->tokens += page_ftl_gc_pace_budget(nr_segments, free_segments);
+	pacer->tokens = MIN(pacer->tokens, (double)PAGE_FTL_GC_PACE_BUCKET);
+	pacer->is_urgent = free_segments < PAGE_FTL_GC_PACE_MIN_FREE;
+	if (pacer->tokens < 1 && !pacer->is_urgent) {
+		return 0;
+	}
+	pthread_mutex_lock(&pgftl->mutex);
+	has_victim = pacer->victim != NULL || pgftl->gc_list != NULL;
+	pthread_mutex_unlock(&pgftl->mutex);
+	return has_victim;
+}
+
+/**
+ * @brief relocate the victim's valid pages as much as the tokens
+ *
+ * @param pgftl pointer of the page FTL structure
+ *
+ * @return number of relocated pages, negative number for fail
+ *
+ * @note
+ * The caller must hold the `pgftl->gc_mutex` and the global write lock, and
+ * must call the `page_ftl_gc_pace_refill()` before. Each host write adds its
+ * budget to the token bucket, and each page copy or erase consumes a token.
+ * So the garbage collection is spread over the host writes. If the free
+ * segments are under `PAGE_FTL_GC_PACE_MIN_FREE`, the victim is collected
+ * regardless of the tokens to avoid running out of the free pages.
+ */
+ssize_t page_ftl_gc_pace(struct page_ftl *pgftl)
+{
+	struct page_ftl_gc_pacer *pacer = &pgftl->pacer;
+	struct page_ftl_segment *victim;
+	ssize_t nr_relocated, ret;
+	int is_urgent = pacer->is_urgent;
+
+	pacer->is_urgent = 0;
+	nr_relocated = 0;
+	while (pacer->tokens >= 1 || is_urgent) {
+		size_t lpn;
+		int is_empty;
+
+		if (pacer->victim == NULL) {
+			pthread_mutex_lock(&pgftl->mutex);
+			pacer->victim = page_ftl_pick_gc_target(pgftl);
+			pthread_mutex_unlock(&pgftl->mutex);
+			if (pacer->victim == NULL) {
+				break;
+			}
+		}
+		victim = pacer->victim;
+
+		pthread_mutex_lock(&pgftl->mutex);
+		is_empty = (victim->lpn_list == NULL);
+		lpn = is_empty ? 0 : GPOINTER_TO_SIZE(victim->lpn_list->data);
+		pthread_mutex_unlock(&pgftl->mutex);
+
+		if (is_empty) {
+			ret = page_ftl_gc_reclaim_segment(pgftl, victim);
+			pacer->victim = NULL;
+			if (ret) {
+				pr_err("paced reclaim failed\n");
+				return ret;
+			}
+			is_urgent = 0;
+		} else {
+			/**< the copy removes the lpn from the victim's list */
+			ret = page_ftl_gc_copy_page(pgftl, lpn,
+						    PAGE_FTL_GC_FRONTIER);
+			if (ret < 0) {
+				pr_err("paced relocation failed (lpn: %zu)\n",
+				       lpn);
+				return ret;
+			}
+			nr_relocated++;
+		}
+		pacer->tokens -= 1;
+	}
+	pacer->tokens = MAX(pacer->tokens, (double)0);
+	return nr_relocated;
+}
+
+/**
+ * @brief enable or disable the paced garbage collection
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param is_enabled 1 for enable, 0 for disable
+ *
+ * @return 0 for success, negative number for fail
+ *
+ * @note
+ * The partially collected victim is finished when the pacing is disabled.
+ * The collection updates the mapping, so the global write lock is taken like
+ * the other garbage collection paths.
+ */
+int page_ftl_gc_set_pacing(struct page_ftl *pgftl, int is_enabled)
+{
+	struct page_ftl_gc_pacer *pacer = &pgftl->pacer;
+	ssize_t ret = 0;
+
+	pthread_mutex_lock(&pgftl->gc_mutex);
+#ifdef PAGE_FTL_USE_GLOBAL_RWLOCK
+	pthread_rwlock_wrlock(&pgftl->rwlock);
+#endif
+	if (!is_enabled && pacer->victim) {
+		ret = page_ftl_gc_segment(pgftl, pacer->victim,
+					  PAGE_FTL_GC_FRONTIER);
+		pacer->victim = NULL;
+	}
+	pacer->tokens = 0;
+	g_atomic_int_set(&pacer->is_enabled, is_enabled ? 1 : 0);
+#ifdef PAGE_FTL_USE_GLOBAL_RWLOCK
+	pthread_rwlock_unlock(&pgftl->rwlock);
+#endif
+	pthread_mutex_unlock(&pgftl->gc_mutex);
+	return (int)ret;
+}
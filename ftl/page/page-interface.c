@@ -9,6 +9,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <stdarg.h>
 
 #include "log.h"
 #include "page.h"
@@ -293,6 +294,7 @@ static int page_ftl_ioctl_interface(struct flash_device *flash,
 {
 	struct device_request *device_rq;
 	struct page_ftl *pgftl = NULL;
+	va_list ap;
 	int ret = 0;
 
 	if (flash == NULL) {
@@ -317,8 +319,41 @@ static int page_ftl_ioctl_interface(struct flash_device *flash,
 		ret = (int)page_ftl_gc_from_list(pgftl, device_rq,
 						 PAGE_FTL_GC_ALL);
 		break;
+	case PAGE_FTL_IOCTL_GC_PACING:
+		va_start(ap, request);
+		ret = page_ftl_gc_set_pacing(pgftl, va_arg(ap, int));
+		va_end(ap);
+		break;
+	case PAGE_FTL_IOCTL_STAT:
+		va_start(ap, request);
+		ret = page_ftl_get_stat(pgftl,
+					va_arg(ap, struct page_ftl_stat *));
+		va_end(ap);
+		break;
+	case PAGE_FTL_IOCTL_FLUSH:
+		if (pgftl->dev->d_op->flush) {
+			ret = pgftl->dev->d_op->flush(pgftl->dev);
+		}
+		break;
+	case PAGE_FTL_IOCTL_LOCAL_NODE:
+		va_start(ap, request);
+		ret = page_ftl_set_local_node(pgftl, va_arg(ap, int));
+		va_end(ap);
+		break;
+	case PAGE_FTL_IOCTL_WEAR_LEVELING:
+		va_start(ap, request);
+		ret = page_ftl_set_wear_leveling(pgftl, va_arg(ap, int));
+		va_end(ap);
+		break;
+	case PAGE_FTL_IOCTL_WEAR_STAT:
+		va_start(ap, request);
+		ret = page_ftl_get_wear_stat(
+			pgftl, va_arg(ap, struct page_ftl_wear_stat *));
+		va_end(ap);
+		break;
 	default:
 		pr_err("invalid command requested(commands: %u)\n", request);
+		device_free_request(device_rq);
 		return -EINVAL;
 	}
 	device_free_request(device_rq);
@@ -337,44 +372,61 @@ const struct flash_operations __page_fops = {
 };
 
 /**
- * @brief initialize the page flash translation layer module
+ * @brief initialize the page flash translation layer module with the device
  *
  * @param flash pointer of the flash device information
- * @param flags flags for flash and submodule
+ * @param dev pointer of the device which is already initialized
  *
  * @return zero to success, error number to fail
+ *
+ * @note
+ * The page FTL takes the ownership of the device. So, the device is
+ * deallocated when the page FTL module exits.
  */
-int page_ftl_module_init(struct flash_device *flash, uint64_t flags)
+int page_ftl_module_init_with_device(struct flash_device *flash,
+				     struct device *dev)
 {
 	int err = 0;
-	uint64_t modnum = flags;
 	struct page_ftl *pgftl;
 
-	(void)flags;
-
 	flash->f_op = &__page_fops;
 
 	pgftl = (struct page_ftl *)malloc(sizeof(struct page_ftl));
 	if (pgftl == NULL) {
 		err = errno;
 		pr_err("fail to allocate the page FTL information pointer\n");
-		goto exception;
+		device_module_exit(dev);
+		return err;
 	}
 	memset(pgftl, 0, sizeof(*pgftl));
-
-	err = device_module_init(modnum, &pgftl->dev, 0);
-	if (err) {
-		pr_err("initialize the device module failed\n");
-		goto exception;
-	}
+	pgftl->dev = dev;
 
 	flash->f_private = (void *)pgftl;
 	flash->f_submodule_exit = page_ftl_module_exit;
 	return 0;
+}
 
-exception:
-	page_ftl_module_exit(flash);
-	return err;
+/**
+ * @brief initialize the page flash translation layer module
+ *
+ * @param flash pointer of the flash device information
+ * @param flags flags for flash and submodule
+ *
+ * @return zero to success, error number to fail
+ */
+int page_ftl_module_init(struct flash_device *flash, uint64_t flags)
+{
+	int err = 0;
+	uint64_t modnum = flags;
+	struct device *dev;
+
+	err = device_module_init(modnum, &dev, 0);
+	if (err) {
+		pr_err("initialize the device module failed\n");
+		return err;
+	}
+
+	return page_ftl_module_init_with_device(flash, dev);
 }
 
 /**
@@ -12,84 +12,575 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <stdlib.h>
+
+/*
+ * The `bus` is the first (lowest) bit-field of the `struct device_address`,
+ * so the bus of a page in the segment is `page % nr_bus`. Each `use_bits`
+ * word starts at the bus 0 only if the word's bits are a multiple of the
+ * buses, and then the same local page mask is applied to every word.
+ */
+static_assert(BITS_PER_UINT64 % (1 << DEVICE_NR_BUS_BITS) == 0,
+	      "use_bits word must contain the whole buses");
+
+/**
+ * @brief check the free segment should be popped before the other
+ *
+ * @param a free segment which wants to compare
+ * @param b free segment which is compared
+ *
+ * @return 1 if `a` precedes `b`, 0 for the others
+ */
+static inline int
+page_ftl_free_segment_precede(struct page_ftl_free_segment *a,
+			      struct page_ftl_free_segment *b)
+{
+	if (a->nr_erase != b->nr_erase) {
+		return a->nr_erase < b->nr_erase;
+	}
+	return a->seq < b->seq;
+}
+
+/**
+ * @brief push the erased segment to the free segment heap
+ *
+ * @param pgftl pointer of the page-ftl structure
+ * @param segnum erased segment number
+ *
+ * @note
+ * The caller must hold the `pgftl->mutex`. Bad segments are never pushed.
+ * The segment's erase count doesn't change while it is free, so the count
+ * at this time is the key of the heap.
+ */
+void page_ftl_push_free_segment(struct page_ftl *pgftl, size_t segnum)
+{
+	struct page_ftl_segment_queue *queue = &pgftl->free_segq;
+	struct page_ftl_free_segment *entries = queue->entries;
+	struct page_ftl_free_segment entry;
+	struct device *dev = pgftl->dev;
+	size_t pos, parent;
+
+	if (dev->badseg_bitmap && get_bit(dev->badseg_bitmap, segnum)) {
+		pr_debug("bad segment is not pushed (segnum: %zu)\n", segnum);
+		return;
+	}
+	if (queue->nr_entries == queue->capacity) {
+		pr_err("free segment queue overflow (segnum: %zu)\n", segnum);
+		return;
+	}
+	entry.segnum = segnum;
+	entry.nr_erase = g_atomic_int_get(&pgftl->counter.nr_erase[segnum]);
+	entry.seq = queue->seq++;
+
+	pos = queue->nr_entries++;
+	while (pos > 0) {
+		parent = (pos - 1) / 2;
+		if (!page_ftl_free_segment_precede(&entry, &entries[parent])) {
+			break;
+		}
+		entries[pos] = entries[parent];
+		pos = parent;
+	}
+	entries[pos] = entry;
+}
+
+/**
+ * @brief remove the entry of the free segment heap
+ *
+ * @param queue pointer of the free segment heap
+ * @param pos position of the removed entry
+ *
+ * @return free segment number which is removed
+ */
+static size_t page_ftl_remove_free_segment(struct page_ftl_segment_queue *queue,
+					   size_t pos)
+{
+	struct page_ftl_free_segment *entries = queue->entries;
+	struct page_ftl_free_segment last;
+	size_t segnum, parent, child;
+
+	segnum = entries[pos].segnum;
+	last = entries[--queue->nr_entries];
+	if (pos == queue->nr_entries) {
+		return segnum;
+	}
+
+	while (pos > 0) {
+		parent = (pos - 1) / 2;
+		if (!page_ftl_free_segment_precede(&last, &entries[parent])) {
+			break;
+		}
+		entries[pos] = entries[parent];
+		pos = parent;
+	}
+	while ((child = pos * 2 + 1) < queue->nr_entries) {
+		if (child + 1 < queue->nr_entries &&
+		    page_ftl_free_segment_precede(&entries[child + 1],
+						  &entries[child])) {
+			child++;
+		}
+		if (!page_ftl_free_segment_precede(&entries[child], &last)) {
+			break;
+		}
+		entries[pos] = entries[child];
+		pos = child;
+	}
+	entries[pos] = last;
+	return segnum;
+}
+
+/**
+ * @brief pop the least erased segment from the free segment heap
+ *
+ * @param pgftl pointer of the page-ftl structure
+ *
+ * @return free segment number, PAGE_FTL_NO_SEGMENT means the heap is empty
+ *
+ * @note
+ * The caller must hold the `pgftl->mutex`. Among the least erased segments,
+ * the least recently erased one is popped. This keeps the dynamic wear
+ * leveling property of the allocator.
+ */
+uint64_t page_ftl_pop_free_segment(struct page_ftl *pgftl)
+{
+	struct page_ftl_segment_queue *queue = &pgftl->free_segq;
+
+	if (queue->nr_entries == 0) {
+		return PAGE_FTL_NO_SEGMENT;
+	}
+	return (uint64_t)page_ftl_remove_free_segment(queue, 0);
+}
+
+/**
+ * @brief pop the most erased segment from the free segment heap
+ *
+ * @param pgftl pointer of the page-ftl structure
+ *
+ * @return free segment number, PAGE_FTL_NO_SEGMENT means the heap is empty
+ *
+ * @note
+ * The caller must hold the `pgftl->mutex`. The order of the heap is total,
+ * so the last one is a leaf, and only the leaves are scanned. This is used
+ * by the static wear leveling, which is much rarer than the allocation.
+ */
+uint64_t page_ftl_pop_worn_free_segment(struct page_ftl *pgftl)
+{
+	struct page_ftl_segment_queue *queue = &pgftl->free_segq;
+	struct page_ftl_free_segment *entries = queue->entries;
+	size_t pos, worn;
+
+	if (queue->nr_entries == 0) {
+		return PAGE_FTL_NO_SEGMENT;
+	}
+	worn = queue->nr_entries / 2;
+	for (pos = worn + 1; pos < queue->nr_entries; pos++) {
+		if (page_ftl_free_segment_precede(&entries[worn],
+						  &entries[pos])) {
+			worn = pos;
+		}
+	}
+	return (uint64_t)page_ftl_remove_free_segment(queue, worn);
+}
+
+/**
+ * @brief check the segment is the active segment of any frontier
+ *
+ * @param pgftl pointer of the page-ftl structure
+ * @param segnum target segment number
+ *
+ * @return 1 for the active segment, 0 for the others
+ */
+int page_ftl_is_active_segment(struct page_ftl *pgftl, size_t segnum)
+{
+	size_t stripe;
+	int frontier;
+	for (frontier = 0; frontier < PAGE_FTL_NR_FRONTIERS; frontier++) {
+		for (stripe = 0; stripe < PAGE_FTL_MAX_STRIPES; stripe++) {
+			if (pgftl->alloc_segnum[frontier][stripe] ==
+			    (uint64_t)segnum) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief get the number of the active segments of a frontier
+ *
+ * @param dev pointer of the device structure
+ *
+ * @return number of the stripes
+ *
+ * @note
+ * Only the appending device can write the segments at once without the
+ * global write lock. The active segment which is full still has the
+ * in-flight writes while its next segment is opened. So, each stripe of
+ * the frontiers can hold 2 open segments of the device.
+ */
+size_t page_ftl_get_nr_stripes(struct device *dev)
+{
+	size_t max_open = dev->info.max_open_segments;
+	size_t nr_stripes;
+
+	if (!dev->info.is_append) {
+		return 1;
+	}
+	if (max_open == 0) {
+		return PAGE_FTL_MAX_STRIPES;
+	}
+	nr_stripes = max_open / 2;
+	/**< the gc and wear frontiers use a stripe each */
+	nr_stripes = nr_stripes > PAGE_FTL_NR_FRONTIERS - 1 ?
+			     nr_stripes - (PAGE_FTL_NR_FRONTIERS - 1) :
+			     1;
+	return nr_stripes < PAGE_FTL_MAX_STRIPES ? nr_stripes :
+						   PAGE_FTL_MAX_STRIPES;
+}
+
+/**
+ * @brief get the stripe of the host write
+ *
+ * @param pgftl pointer of the page-ftl structure
+ * @param frontier frontier which requests the page
+ *
+ * @return stripe number
+ *
+ * @note
+ * The concurrent host writes take the stripes in the round-robin order, so
+ * they append to the different active segments and don't wait for the
+ * other's write pointer. The gc and wear frontiers are serialized by the
+ * `gc_mutex`, so each of them uses a stripe.
+ */
+static size_t page_ftl_get_stripe(struct page_ftl *pgftl, int frontier)
+{
+	guint stripe;
+	if (pgftl->nr_stripes == 1 || frontier != PAGE_FTL_HOST_FRONTIER) {
+		return 0;
+	}
+	stripe = (guint)g_atomic_int_add(&pgftl->next_stripe, 1);
+	return (size_t)stripe % pgftl->nr_stripes;
+}
+
+/**
+ * @brief find the active segment which still has free pages
+ *
+ * @param pgftl pointer of the page-ftl structure
+ * @param frontier frontier which requests the page
+ * @param stripe stripe of the frontier
+ *
+ * @return segment number, PAGE_FTL_NO_SEGMENT means not found
+ *
+ * @note
+ * This pops a new segment when the stripe's active segment is full. The
+ * wear frontier pops the most erased one, and the others pop the least one.
+ * If the free segment queue is empty, this borrows the other active
+ * segment.
+ */
+static uint64_t page_ftl_get_active_segment(struct page_ftl *pgftl,
+					    int frontier, size_t stripe)
+{
+	uint64_t segnum;
+	size_t i;
+	int idx;
+
+	segnum = pgftl->alloc_segnum[frontier][stripe];
+	if (segnum != PAGE_FTL_NO_SEGMENT &&
+	    g_atomic_int_get(&pgftl->counter.nr_free_pages[segnum]) > 0) {
+		return segnum;
+	}
+
+	if (frontier == PAGE_FTL_WEAR_FRONTIER) {
+		segnum = page_ftl_pop_worn_free_segment(pgftl);
+	} else {
+		segnum = page_ftl_pop_free_segment(pgftl);
+	}
+	pgftl->alloc_segnum[frontier][stripe] = segnum;
+	if (segnum != PAGE_FTL_NO_SEGMENT) {
+		return segnum;
+	}
+
+	for (idx = 0; idx < PAGE_FTL_NR_FRONTIERS; idx++) {
+		for (i = 0; i < pgftl->nr_stripes; i++) {
+			segnum = pgftl->alloc_segnum[idx][i];
+			if (segnum != PAGE_FTL_NO_SEGMENT &&
+			    g_atomic_int_get(
+				    &pgftl->counter.nr_free_pages[segnum]) > 0) {
+				return segnum;
+			}
+		}
+	}
+	return PAGE_FTL_NO_SEGMENT;
+}
+
+/**
+ * @brief reserve a free page in the segment
+ *
+ * @param pgftl pointer of the page-ftl structure
+ * @param segnum segment number which contains the free pages
+ *
+ * @return 1 for success, 0 means the segment is full
+ */
+static int page_ftl_reserve_free_page(struct page_ftl *pgftl, uint64_t segnum)
+{
+	gint *counter = &pgftl->counter.nr_free_pages[segnum];
+	gint nr_free_pages;
+	do {
+		nr_free_pages = g_atomic_int_get(counter);
+		if (nr_free_pages <= 0) {
+			return 0;
+		}
+	} while (!g_atomic_int_compare_and_exchange(counter, nr_free_pages,
+						    nr_free_pages - 1));
+	return 1;
+}
 
 /**
  * @brief get page from the segment
  *
  * @param pgftl pointer of the page-ftl structure
+ * @param frontier frontier which requests the page
  *
  * @return free space's device address
+ *
+ * @note
+ * The caller must NOT hold the `pgftl->mutex`. The mutex is only held while
+ * selecting the active segment. The page in the segment is reserved from
+ * `nr_free_pages` and claimed from `use_bits` by the atomic operations.
+ *
+ * The segment's `nr_pending_writes` is increased before the reservation,
+ * and the writer decreases it after the page is added to the `lpn_list`.
+ * The full segment can be put in the `gc_list` by the other page's
+ * invalidation while the write is in flight, so the gc skips the segment
+ * until its pending writes are finished. Because the reservation follows
+ * the increase, the gc which sees no free page and no pending write cannot
+ * race with a new reservation of the segment.
+ *
+ * The appending device decides the page, so only the segment is reserved
+ * here. The page is claimed by the `page_ftl_set_placement()` after the
+ * write, and the returned page only spreads the stripes over the chips of
+ * the scheduler.
  */
-struct device_address page_ftl_get_free_page(struct page_ftl *pgftl)
+struct device_address page_ftl_get_free_page(struct page_ftl *pgftl,
+					     int frontier)
 {
 	struct device_address paddr;
 	struct device *dev;
 
 	struct page_ftl_segment *segment;
 
-	size_t nr_segments;
 	size_t pages_per_segment;
-	size_t segnum;
-	size_t idx;
-
-	uint64_t nr_free_pages;
-	uint64_t nr_valid_pages;
-	uint32_t page;
+	size_t stripe;
+	uint64_t segnum;
+	uint64_t page;
+	uint64_t local_page_mask;
 
 	dev = pgftl->dev;
-	nr_segments = device_get_nr_segments(dev);
 	pages_per_segment = device_get_pages_per_segment(dev);
+	stripe = page_ftl_get_stripe(pgftl, frontier);
 
 	paddr.lpn = PADDR_EMPTY;
-	idx = 0;
+	local_page_mask = page_ftl_get_local_page_mask(pgftl);
 
 retry:
-	if (idx == nr_segments) {
+	pthread_mutex_lock(&pgftl->mutex);
+	segnum = page_ftl_get_active_segment(pgftl, frontier, stripe);
+	pthread_mutex_unlock(&pgftl->mutex);
+	if (segnum == PAGE_FTL_NO_SEGMENT) {
 		pr_err("cannot find the free page in the device\n");
 		paddr.lpn = PADDR_EMPTY;
 		return paddr;
 	}
-	segnum = ((size_t)pgftl->alloc_segnum + idx) % nr_segments;
-	idx += 1;
-
-	if (dev->badseg_bitmap && get_bit(dev->badseg_bitmap, segnum)) {
+	segment = &pgftl->segments[segnum];
+	g_atomic_int_inc(&pgftl->counter.nr_pending_writes[segnum]);
+	if (!page_ftl_reserve_free_page(pgftl, segnum)) {
+		/**< the other thread takes the last page */
+		g_atomic_int_add(&pgftl->counter.nr_pending_writes[segnum], -1);
 		goto retry;
 	}
+	if (dev->info.is_append) {
+		page = stripe % (dev->info.nr_bus * dev->info.nr_chips);
+		goto out;
+	}
 
-	segment = &pgftl->segments[segnum];
-	if (segment == NULL) {
-		pr_err("fatal error detected: cannot find the segnum %zu\n",
-		       segnum);
-		paddr.lpn = PADDR_EMPTY;
-		return paddr;
+	page = BITS_NOT_FOUND;
+	if (local_page_mask) {
+		page = claim_first_zero_bit_masked(segment->use_bits,
+						   pages_per_segment,
+						   local_page_mask);
 	}
-	nr_free_pages = (uint64_t)g_atomic_int_get(&segment->nr_free_pages);
-	if (nr_free_pages == 0) {
-		goto retry;
+	if (page == BITS_NOT_FOUND) {
+		/**< the local buses are full, so the other buses are used */
+		page = claim_first_zero_bit(segment->use_bits,
+					    pages_per_segment, 0);
 	}
-	pgftl->alloc_segnum = segnum;
-
-	page = (uint32_t)find_first_zero_bit(segment->use_bits,
-					     pages_per_segment, 0);
-	if (page == (uint32_t)BITS_NOT_FOUND) {
-		pr_warn("nr_free_pages and use_bits bitmap are not synchronized(nr_free_pages: %" PRIu64
-			", page: %u)\n",
-			nr_free_pages, page);
+	if (page == BITS_NOT_FOUND) {
+		/*
+		 * Every reservation claims at most one bit, so this only
+		 * happens when the counter and the bitmap are out of sync. The
+		 * reservation is not returned, which drains `nr_free_pages`
+		 * of the segment to 0 instead of retrying on it forever. The
+		 * drained pages are not leaked permanently: the drained
+		 * segment is full, so it goes to the `gc_list` by the next
+		 * invalidation of its pages (or the wear leveling picks it),
+		 * and its erase resets both `nr_free_pages` and `use_bits` by
+		 * the `page_ftl_segment_data_init()`.
+		 */
+		g_atomic_int_add(&pgftl->counter.nr_pending_writes[segnum], -1);
+		pr_warn("nr_free_pages and use_bits bitmap are not synchronized(nr_free_pages: %d, segnum: %" PRIu64
+			")\n",
+			g_atomic_int_get(&pgftl->counter.nr_free_pages[segnum]),
+			segnum);
 		goto retry;
 	}
+out:
 	paddr.lpn = 0;
 	paddr.format.block = (uint16_t)segnum;
-	paddr.lpn |= page;
-
-	set_bit(segment->use_bits, page);
-	g_atomic_int_set(&segment->nr_free_pages, (gint)nr_free_pages - 1);
+	paddr.lpn |= (uint32_t)page;
 
-	nr_valid_pages = (uint64_t)g_atomic_int_get(&segment->nr_valid_pages);
-	g_atomic_int_set(&segment->nr_valid_pages, (gint)nr_valid_pages + 1);
+	g_atomic_int_inc(&pgftl->counter.nr_valid_pages[segnum]);
 
 	return paddr;
 }
 
+/**
+ * @brief claim the page which the appending device placed the write
+ *
+ * @param pgftl pointer of the page-ftl structure
+ * @param paddr written address (the page is decided by the device)
+ */
+void page_ftl_set_placement(struct page_ftl *pgftl, struct device_address paddr)
+{
+	struct page_ftl_segment *segment;
+	size_t pages_per_segment;
+	uint64_t page;
+
+	pages_per_segment = device_get_pages_per_segment(pgftl->dev);
+	segment = &pgftl->segments[paddr.format.block];
+	page = paddr.lpn % pages_per_segment;
+	if (test_and_set_bit(segment->use_bits, page)) {
+		pr_warn("device placed the write to the used page (lpn: %u)\n",
+			paddr.lpn);
+	}
+}
+
+/**
+ * @brief get the pages of the calling thread's local buses
+ *
+ * @param pgftl pointer of the page-ftl structure
+ *
+ * @return mask of the pages in each `use_bits` word, 0 means no preference
+ *
+ * @note
+ * The entry is found by the instance's thread-specific key, so this doesn't
+ * need the `pgftl->mutex`. Only the owner thread reads and writes the mask.
+ */
+uint64_t page_ftl_get_local_page_mask(struct page_ftl *pgftl)
+{
+	struct page_ftl_local_node *local;
+
+	local = (struct page_ftl_local_node *)pthread_getspecific(
+		pgftl->local_key);
+	return local ? local->page_mask : 0;
+}
+
+/**
+ * @brief release the local node entry of the thread
+ *
+ * @param local pointer of the `struct page_ftl_local_node`
+ *
+ * @note
+ * This is the destructor of the instance's thread-specific key, so the
+ * entry is also removed when the thread exits. The thread ID can be reused
+ * by the next thread, but the new thread doesn't inherit the entry.
+ */
+void page_ftl_release_local_node(void *local)
+{
+	struct page_ftl *pgftl = ((struct page_ftl_local_node *)local)->pgftl;
+
+	pthread_mutex_lock(&pgftl->mutex);
+	pgftl->local_nodes = g_list_remove(pgftl->local_nodes, local);
+	pthread_mutex_unlock(&pgftl->mutex);
+	free(local);
+}
+
+/**
+ * @brief make the calling thread's writes prefer the buses on the NUMA node
+ *
+ * @param pgftl pointer of the page-ftl structure
+ * @param node NUMA node of the thread (negative value clears the preference)
+ *
+ * @return 0 for success, negative number for fail
+ *
+ * @note
+ * The free page is claimed from the local buses first, and the other buses
+ * are used only when the segment's local pages are exhausted. The device
+ * which doesn't know its buses' nodes leaves the thread without preference.
+ * The preference belongs to this instance, so the thread can write to the
+ * other instance on the other node.
+ */
+int page_ftl_set_local_node(struct page_ftl *pgftl, int node)
+{
+	struct page_ftl_local_node *local;
+	struct device *dev = pgftl->dev;
+	uint64_t mask = 0;
+	size_t nr_bus, bit;
+	int ret;
+
+	if (node >= 0) {
+		nr_bus = dev->info.nr_bus;
+		if (dev->d_op->get_bus_node == NULL ||
+		    nr_bus > BITS_PER_UINT64) {
+			pr_warn("device doesn't support the bus placement\n");
+		} else {
+			for (bit = 0; bit < BITS_PER_UINT64; bit++) {
+				if (dev->d_op->get_bus_node(dev, bit % nr_bus) ==
+				    node) {
+					mask |= (uint64_t)0x1 << bit;
+				}
+			}
+			if (mask == 0) {
+				pr_warn("no bus is placed on the node %d\n",
+					node);
+			}
+		}
+	}
+
+	local = (struct page_ftl_local_node *)pthread_getspecific(
+		pgftl->local_key);
+	if (local != NULL) {
+		if (mask) {
+			local->page_mask = mask;
+			return 0;
+		}
+		pthread_setspecific(pgftl->local_key, NULL);
+		page_ftl_release_local_node(local);
+		return 0;
+	}
+	if (mask == 0) {
+		return 0;
+	}
+	local = (struct page_ftl_local_node *)malloc(
+		sizeof(struct page_ftl_local_node));
+	if (local == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	local->pgftl = pgftl;
+	local->page_mask = mask;
+	ret = pthread_setspecific(pgftl->local_key, local);
+	if (ret) {
+		pr_err("local node registration failed\n");
+		free(local);
+		return -ret;
+	}
+	/**< the list only keeps the entries to free them on the close */
+	pthread_mutex_lock(&pgftl->mutex);
+	pgftl->local_nodes = g_list_prepend(pgftl->local_nodes, local);
+	pthread_mutex_unlock(&pgftl->mutex);
+	return 0;
+}
+
 /**
  * @brief update the mapping information
  *
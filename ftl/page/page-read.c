@@ -8,6 +8,7 @@
 #include "page.h"
 #include "log.h"
 #include "lru.h"
+#include "trace.h"
 
 #include <errno.h>
 #include <stdlib.h>
@@ -22,6 +23,7 @@ static void page_ftl_read_end_rq(struct device_request *read_rq)
 	struct device_request *request;
 	struct page_ftl *pgftl;
 	size_t offset;
+	int status;
 
 	request = (struct device_request *)read_rq->rq_private;
 	pgftl = (struct page_ftl *)request->rq_private;
@@ -29,10 +31,12 @@ static void page_ftl_read_end_rq(struct device_request *read_rq)
 
 	memcpy(request->data, &((char *)read_rq->data)[offset],
 	       request->data_len);
+	status = read_rq->status;
 	free(read_rq->data);
 	device_free_request(read_rq);
 
 	pthread_mutex_lock(&request->mutex);
+	request->status = status;
 	if (g_atomic_int_get(&request->is_finish) == 0) {
 		pthread_cond_signal(&request->cond);
 	}
@@ -45,12 +49,14 @@ static void page_ftl_read_end_rq(struct device_request *read_rq)
  *
  * @param pgftl pointer of the page FTL structure
  * @param request user's request pointer
+ * @param sched_class scheduling class of this read (`PAGE_FTL_SCHED_*`)
  *
  * @return reading data size. a negative number means fail to read.
  * @note
  * if paddr.lpn doesn't exist, this function returns the buffer filled 0 value.
  */
-ssize_t page_ftl_read(struct page_ftl *pgftl, struct device_request *request)
+ssize_t page_ftl_read_class(struct page_ftl *pgftl,
+			    struct device_request *request, int sched_class)
 {
 	struct device *dev;
 	struct device_request *read_rq;
@@ -63,6 +69,7 @@ ssize_t page_ftl_read(struct page_ftl *pgftl, struct device_request *request)
 
 	ssize_t ret = 0;
 	ssize_t data_len;
+	int is_traced = sched_class == PAGE_FTL_SCHED_READ;
 
 	buffer = NULL;
 	read_rq = NULL;
@@ -75,6 +82,9 @@ ssize_t page_ftl_read(struct page_ftl *pgftl, struct device_request *request)
 	pthread_mutex_lock(&pgftl->mutex);
 	paddr.lpn = pgftl->trans_map[lpn];
 	pthread_mutex_unlock(&pgftl->mutex);
+	if (is_traced) {
+		trace_point(TRACE_POINT_MAP_LOOKUP);
+	}
 
 	if (paddr.lpn == PADDR_EMPTY) { /**< YOU MUST TAKE CARE OF THIS LINE */
 		pr_warn("cannot find the mapping information (lpn: %zu)\n",
@@ -94,7 +104,7 @@ ssize_t page_ftl_read(struct page_ftl *pgftl, struct device_request *request)
 		goto exception;
 	}
 
-	buffer = (char *)malloc(page_size);
+	buffer = (char *)device_alloc_buffer(page_size);
 	if (buffer == NULL) {
 		pr_err("memory allocation failed\n");
 		ret = -ENOMEM;
@@ -118,7 +128,10 @@ ssize_t page_ftl_read(struct page_ftl *pgftl, struct device_request *request)
 
 	//printf("[FTL-log] read\tpaddr : %llX\tdata_len : %zubytes \n", read_rq->paddr, read_rq->data_len);
 	data_len = request->data_len;
-	ret = dev->d_op->read(dev, read_rq);
+	if (is_traced) {
+		trace_point(TRACE_POINT_PREPARE);
+	}
+	ret = page_ftl_sched_submit(pgftl, read_rq, sched_class);
 	if (ret < 0) {
 		pr_err("device read failed (ppn: %u)\n", request->paddr.lpn);
 		read_rq = NULL;
@@ -131,10 +144,17 @@ ssize_t page_ftl_read(struct page_ftl *pgftl, struct device_request *request)
 		pthread_cond_wait(&request->cond, &request->mutex);
 	}
 	pthread_mutex_unlock(&request->mutex);
+	if (is_traced) {
+		trace_point(TRACE_POINT_DEVICE);
+	}
 
+	/**< the device passes the failure of the completed read */
+	ret = request->status < 0 ? request->status : data_len;
+	if (ret < 0) {
+		pr_err("device read completion failed (ppn: %u, errno: %zd)\n",
+		       paddr.lpn, -ret);
+	}
 	device_free_request(request);
-
-	ret = data_len;
 	return ret;
 exception:
 	if (buffer) {
@@ -145,3 +165,22 @@ exception:
 	}
 	return ret;
 }
+
+/**
+ * @brief read the host request from the device.
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param request user's request pointer
+ *
+ * @return reading data size. a negative number means fail to read.
+ */
+ssize_t page_ftl_read(struct page_ftl *pgftl, struct device_request *request)
+{
+	ssize_t ret;
+
+	ret = page_ftl_read_class(pgftl, request, PAGE_FTL_SCHED_READ);
+	if (ret > 0) {
+		page_ftl_stat_add(pgftl, PAGE_FTL_STAT_HOST_READ, 1);
+	}
+	return ret;
+}
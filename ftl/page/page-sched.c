@@ -0,0 +1,458 @@
+/**
+ * @file page-sched.c
+ * @brief request scheduler between the page ftl and the device
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "page.h"
+#include "log.h"
+
+/**
+ * @brief context of the request which holds the chip until its completion
+ *
+ * @note
+ * The request's `end_rq` and `rq_private` are replaced by the scheduler's
+ * while the request is on the device. The submitter and the completion hold
+ * a reference each, because the failed submission doesn't call the `end_rq`.
+ *
+ * The context is reused through the free list of its `pool` chip, so the
+ * submission doesn't allocate the memory in the steady state.
+ */
+struct page_ftl_sched_rq {
+	struct page_ftl *pgftl;
+	struct page_ftl_sched_chip *chip; /**< NULL holds every chip (erase) */
+	struct page_ftl_sched_chip *pool; /**< chip whose free list owns this */
+	device_end_req_fn end_rq; /**< original `end_rq` of the request */
+	void *rq_private; /**< original `rq_private` of the request */
+	gint refcount;
+	gint is_released; /**< the chip is released by the completion or not */
+	struct page_ftl_sched_rq *next; /**< next context in the free list */
+};
+
+/**
+ * @brief maximum number of times that each class can be bypassed by the
+ * higher priority classes
+ *
+ * @note
+ * The host read is never bypassed. The erase is deferred longer than the
+ * others because it occupies every chip of the segment.
+ */
+static const int page_ftl_sched_max_bypass[PAGE_FTL_SCHED_NR_CLASSES] = {
+	/* [PAGE_FTL_SCHED_READ] = */ 0,
+	/* [PAGE_FTL_SCHED_WRITE] = */ PAGE_FTL_SCHED_MAX_BYPASS,
+	/* [PAGE_FTL_SCHED_GC] = */ PAGE_FTL_SCHED_MAX_BYPASS,
+	/* [PAGE_FTL_SCHED_ERASE] = */ PAGE_FTL_SCHED_MAX_DEFER,
+};
+
+/**
+ * @brief check the class is starved by the higher priority classes
+ *
+ * @param chip pointer of the chip's scheduling information
+ * @param sched_class request class which wants to check
+ *
+ * @return 1 for starved, 0 for not starved
+ */
+static inline int page_ftl_sched_is_starved(struct page_ftl_sched_chip *chip,
+					    int sched_class)
+{
+	return chip->nr_waiting[sched_class] > 0 && sched_class > 0 &&
+	       chip->nr_bypass[sched_class] >=
+		       page_ftl_sched_max_bypass[sched_class];
+}
+
+/**
+ * @brief check the request of the class can be issued to the chip
+ *
+ * @param chip pointer of the chip's scheduling information
+ * @param sched_class request class which wants to issue
+ *
+ * @return 1 for issuable, 0 for waiting
+ */
+static int page_ftl_sched_can_issue(struct page_ftl_sched_chip *chip,
+				    int sched_class)
+{
+	int prio;
+
+	if (chip->is_busy) {
+		return 0;
+	}
+	/**< the starved class goes first even if it has the lower priority */
+	for (prio = PAGE_FTL_SCHED_NR_CLASSES - 1; prio > sched_class; prio--) {
+		if (page_ftl_sched_is_starved(chip, prio)) {
+			return 0;
+		}
+	}
+	if (page_ftl_sched_is_starved(chip, sched_class)) {
+		return 1;
+	}
+	for (prio = 0; prio < sched_class; prio++) {
+		if (chip->nr_waiting[prio] > 0) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief wait until the chip is dispatched to the class
+ *
+ * @param chip pointer of the chip's scheduling information
+ * @param sched_class request class which wants to issue
+ */
+static void page_ftl_sched_acquire(struct page_ftl_sched_chip *chip,
+				   int sched_class)
+{
+	int prio;
+
+	pthread_mutex_lock(&chip->mutex);
+	chip->nr_waiting[sched_class]++;
+	while (!page_ftl_sched_can_issue(chip, sched_class)) {
+		pthread_cond_wait(&chip->cond, &chip->mutex);
+	}
+	chip->nr_waiting[sched_class]--;
+	chip->nr_bypass[sched_class] = 0;
+	for (prio = sched_class + 1; prio < PAGE_FTL_SCHED_NR_CLASSES; prio++) {
+		if (chip->nr_waiting[prio] > 0) {
+			chip->nr_bypass[prio]++;
+		}
+	}
+	chip->is_busy = 1;
+	pthread_mutex_unlock(&chip->mutex);
+}
+
+/**
+ * @brief release the chip and wake up the waiting requests
+ *
+ * @param chip pointer of the chip's scheduling information
+ */
+static void page_ftl_sched_release(struct page_ftl_sched_chip *chip)
+{
+	pthread_mutex_lock(&chip->mutex);
+	chip->is_busy = 0;
+	pthread_cond_broadcast(&chip->cond);
+	pthread_mutex_unlock(&chip->mutex);
+}
+
+/**
+ * @brief get the chip's scheduling information from the physical address
+ *
+ * @param sched pointer of the scheduler
+ * @param paddr physical address of the request
+ *
+ * @return pointer of the chip's scheduling information
+ */
+static inline struct page_ftl_sched_chip *
+page_ftl_sched_get_chip(struct page_ftl_sched *sched,
+			struct device_address paddr)
+{
+	return &sched->chips[paddr.format.bus * sched->nr_chips +
+			     paddr.format.chip];
+}
+
+/**
+ * @brief release the chips of the request only once
+ *
+ * @param ctx context of the request
+ *
+ * @return 1 if this call releases the chips, 0 if already released
+ */
+static int page_ftl_sched_release_rq(struct page_ftl_sched_rq *ctx)
+{
+	struct page_ftl_sched *sched = &ctx->pgftl->sched;
+	size_t i;
+
+	if (!g_atomic_int_compare_and_exchange(&ctx->is_released, 0, 1)) {
+		return 0;
+	}
+	if (ctx->chip) {
+		page_ftl_sched_release(ctx->chip);
+		return 1;
+	}
+	for (i = 0; i < sched->nr_bus * sched->nr_chips; i++) {
+		page_ftl_sched_release(&sched->chips[i]);
+	}
+	return 1;
+}
+
+/**
+ * @brief return the context to the free list of its chip
+ *
+ * @param ctx context whose references are all dropped
+ */
+static void page_ftl_sched_free_rq(struct page_ftl_sched_rq *ctx)
+{
+	struct page_ftl_sched_chip *pool = ctx->pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	ctx->next = pool->free_rqs;
+	pool->free_rqs = ctx;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+/**
+ * @brief drop a reference of the request's context
+ *
+ * @param ctx context of the request
+ */
+static void page_ftl_sched_put(struct page_ftl_sched_rq *ctx)
+{
+	if (g_atomic_int_dec_and_test(&ctx->refcount)) {
+		page_ftl_sched_free_rq(ctx);
+	}
+}
+
+/**
+ * @brief end request function which releases the chip
+ *
+ * @param request the request which is completed by the device
+ *
+ * @note
+ * The chip is busy until the device completes the request. So, the chip is
+ * released here, not after the submission returns.
+ */
+static void page_ftl_sched_end_rq(struct device_request *request)
+{
+	struct page_ftl_sched_rq *ctx;
+	device_end_req_fn end_rq;
+
+	ctx = (struct page_ftl_sched_rq *)request->rq_private;
+	end_rq = ctx->end_rq;
+	request->end_rq = ctx->end_rq;
+	request->rq_private = ctx->rq_private;
+	page_ftl_sched_release_rq(ctx);
+	page_ftl_sched_put(ctx);
+	if (end_rq) {
+		end_rq(request);
+	}
+}
+
+/**
+ * @brief wrap the request's `end_rq` by the scheduler's
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param request request which is submitted
+ * @param chip chip which is held by the request (NULL for every chip)
+ *
+ * @return context of the request, NULL for the allocation failure
+ *
+ * @note
+ * The erase holds every chip, so it takes the context of the first chip.
+ */
+static struct page_ftl_sched_rq *
+page_ftl_sched_wrap(struct page_ftl *pgftl, struct device_request *request,
+		    struct page_ftl_sched_chip *chip)
+{
+	struct page_ftl_sched_chip *pool = chip ? chip : &pgftl->sched.chips[0];
+	struct page_ftl_sched_rq *ctx;
+
+	pthread_mutex_lock(&pool->mutex);
+	ctx = pool->free_rqs;
+	if (ctx != NULL) {
+		pool->free_rqs = ctx->next;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	if (ctx == NULL) {
+		ctx = (struct page_ftl_sched_rq *)malloc(
+			sizeof(struct page_ftl_sched_rq));
+		if (ctx == NULL) {
+			pr_err("memory allocation failed\n");
+			return NULL;
+		}
+	}
+	ctx->pgftl = pgftl;
+	ctx->chip = chip;
+	ctx->pool = pool;
+	ctx->end_rq = request->end_rq;
+	ctx->rq_private = request->rq_private;
+	g_atomic_int_set(&ctx->refcount, 2);
+	g_atomic_int_set(&ctx->is_released, 0);
+	request->end_rq = page_ftl_sched_end_rq;
+	request->rq_private = ctx;
+	return ctx;
+}
+
+/**
+ * @brief finish the submission of the wrapped request
+ *
+ * @param request request which is submitted
+ * @param ctx context of the request
+ * @param ret return value of the device operation
+ *
+ * @note
+ * The request must not be touched unless the device rejects it without the
+ * completion, because the `end_rq` may free the request.
+ */
+static void page_ftl_sched_unwrap(struct device_request *request,
+				  struct page_ftl_sched_rq *ctx, ssize_t ret)
+{
+	gint nr_refs = 1;
+
+	if (ret < 0 && page_ftl_sched_release_rq(ctx)) {
+		/**< the completion never comes, so its reference is dropped */
+		request->end_rq = ctx->end_rq;
+		request->rq_private = ctx->rq_private;
+		nr_refs = 2;
+	}
+	if (g_atomic_int_add(&ctx->refcount, -nr_refs) == nr_refs) {
+		page_ftl_sched_free_rq(ctx);
+	}
+}
+
+/**
+ * @brief initialize the scheduling information of the chips
+ *
+ * @param pgftl pointer of the page FTL structure
+ *
+ * @return 0 for success, negative number for fail
+ */
+int page_ftl_sched_init(struct page_ftl *pgftl)
+{
+	struct page_ftl_sched *sched = &pgftl->sched;
+	struct device *dev = pgftl->dev;
+	size_t nr_total_chips, i;
+
+	sched->nr_bus = dev->info.nr_bus;
+	sched->nr_chips = dev->info.nr_chips;
+	nr_total_chips = sched->nr_bus * sched->nr_chips;
+
+	sched->chips = (struct page_ftl_sched_chip *)malloc(
+		sizeof(struct page_ftl_sched_chip) * nr_total_chips);
+	if (sched->chips == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	memset(sched->chips, 0,
+	       sizeof(struct page_ftl_sched_chip) * nr_total_chips);
+	for (i = 0; i < nr_total_chips; i++) {
+		pthread_mutex_init(&sched->chips[i].mutex, NULL);
+		pthread_cond_init(&sched->chips[i].cond, NULL);
+	}
+	return 0;
+}
+
+/**
+ * @brief deallocate the scheduler's resources
+ *
+ * @param pgftl pointer of the page FTL structure
+ */
+void page_ftl_sched_free(struct page_ftl *pgftl)
+{
+	struct page_ftl_sched *sched = &pgftl->sched;
+	size_t i;
+
+	if (sched->chips == NULL) {
+		return;
+	}
+	for (i = 0; i < sched->nr_bus * sched->nr_chips; i++) {
+		struct page_ftl_sched_chip *chip = &sched->chips[i];
+		while (chip->free_rqs != NULL) {
+			struct page_ftl_sched_rq *ctx = chip->free_rqs;
+			chip->free_rqs = ctx->next;
+			free(ctx);
+		}
+		pthread_mutex_destroy(&chip->mutex);
+		pthread_cond_destroy(&chip->cond);
+	}
+	free(sched->chips);
+	sched->chips = NULL;
+}
+
+/**
+ * @brief erase the segment after all chips are dispatched to the erase
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param request erase request
+ *
+ * @return 0 for success, negative number for fail
+ *
+ * @note
+ * The segment stripes over every chip. So the erase takes the chips in the
+ * fixed order (which prevents the deadlock) and each chip defers the erase
+ * while the host reads are waiting on it. The chips are released when the
+ * erase is completed.
+ */
+static int page_ftl_sched_erase(struct page_ftl *pgftl,
+				struct device_request *request)
+{
+	struct page_ftl_sched *sched = &pgftl->sched;
+	struct device *dev = pgftl->dev;
+	struct page_ftl_sched_rq *ctx;
+	size_t nr_total_chips, i;
+	int ret;
+
+	ctx = page_ftl_sched_wrap(pgftl, request, NULL);
+	if (ctx == NULL) {
+		return -ENOMEM;
+	}
+	nr_total_chips = sched->nr_bus * sched->nr_chips;
+	for (i = 0; i < nr_total_chips; i++) {
+		struct page_ftl_sched_chip *chip = &sched->chips[i];
+		pthread_mutex_lock(&chip->mutex);
+		if (chip->is_busy || chip->nr_waiting[PAGE_FTL_SCHED_READ]) {
+			g_atomic_int_inc(&sched->nr_deferred_erase);
+		}
+		pthread_mutex_unlock(&chip->mutex);
+		page_ftl_sched_acquire(chip, PAGE_FTL_SCHED_ERASE);
+	}
+	ret = dev->d_op->erase(dev, request);
+	page_ftl_sched_unwrap(request, ctx, ret);
+	if (ret == 0) {
+		page_ftl_stat_add(pgftl, PAGE_FTL_STAT_ERASE, 1);
+	}
+	return ret;
+}
+
+/**
+ * @brief submit the request to the device through the scheduler
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param request request which has the physical address
+ * @param sched_class class of the request (`PAGE_FTL_SCHED_*`)
+ *
+ * @return return value of the device operation
+ *
+ * @note
+ * The chip is held until the device completes the request. The device's
+ * `end_rq` may free the request, so the request must not be touched after
+ * the submission.
+ */
+ssize_t page_ftl_sched_submit(struct page_ftl *pgftl,
+			      struct device_request *request, int sched_class)
+{
+	struct page_ftl_sched_chip *chip;
+	struct page_ftl_sched_rq *ctx;
+	struct device *dev = pgftl->dev;
+	unsigned int flag = request->flag;
+	ssize_t ret;
+
+	if (flag == DEVICE_ERASE) {
+		return (ssize_t)page_ftl_sched_erase(pgftl, request);
+	}
+
+	chip = page_ftl_sched_get_chip(&pgftl->sched, request->paddr);
+	ctx = page_ftl_sched_wrap(pgftl, request, chip);
+	if (ctx == NULL) {
+		return -ENOMEM;
+	}
+	page_ftl_sched_acquire(chip, sched_class);
+	switch (flag) {
+	case DEVICE_WRITE:
+		ret = dev->d_op->write(dev, request);
+		break;
+	case DEVICE_READ:
+		ret = dev->d_op->read(dev, request);
+		break;
+	default:
+		pr_err("invalid flag detected: %u\n", flag);
+		ret = -EINVAL;
+		break;
+	}
+	page_ftl_sched_unwrap(request, ctx, ret);
+	return ret;
+}
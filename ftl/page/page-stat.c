@@ -0,0 +1,72 @@
+/**
+ * @file page-stat.c
+ * @brief internal I/O counters of the page ftl
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ */
+#include <errno.h>
+#include <string.h>
+
+#include "page.h"
+#include "log.h"
+
+/**
+ * @brief clear the counters of every slot
+ *
+ * @param pgftl pointer of the page FTL structure
+ */
+void page_ftl_stat_reset(struct page_ftl *pgftl)
+{
+	memset(pgftl->stat_slots, 0, sizeof(pgftl->stat_slots));
+	g_atomic_int_set(&pgftl->sched.nr_deferred_erase, 0);
+}
+
+/**
+ * @brief get the sum of the counters
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param stat pointer of the statistics structure which is filled by this
+ *
+ * @return 0 for success, negative number for fail
+ *
+ * @note
+ * The counters are read without the lock. So, the snapshot can miss the
+ * requests which are running while this is called.
+ */
+int page_ftl_get_stat(struct page_ftl *pgftl, struct page_ftl_stat *stat)
+{
+	uint64_t counts[PAGE_FTL_STAT_NR_COUNTERS];
+	size_t slot;
+	int counter;
+
+	if (pgftl == NULL || stat == NULL) {
+		pr_err("null detected (pgftl:%p, stat:%p)\n", pgftl, stat);
+		return -EINVAL;
+	}
+
+	memset(counts, 0, sizeof(counts));
+	for (slot = 0; slot < PAGE_FTL_STAT_NR_SLOTS; slot++) {
+		for (counter = 0; counter < PAGE_FTL_STAT_NR_COUNTERS;
+		     counter++) {
+			counts[counter] += __atomic_load_n(
+				&pgftl->stat_slots[slot].counts[counter],
+				__ATOMIC_RELAXED);
+		}
+	}
+
+	memset(stat, 0, sizeof(struct page_ftl_stat));
+	stat->host_write_pages = counts[PAGE_FTL_STAT_HOST_WRITE];
+	stat->host_read_pages = counts[PAGE_FTL_STAT_HOST_READ];
+	stat->flash_write_pages = counts[PAGE_FTL_STAT_FLASH_WRITE];
+	stat->gc_copy_pages = counts[PAGE_FTL_STAT_GC_COPY];
+	stat->nr_erase = counts[PAGE_FTL_STAT_ERASE];
+	stat->rmw_read_pages = counts[PAGE_FTL_STAT_RMW_READ];
+	stat->nr_deferred_erase =
+		(uint64_t)g_atomic_int_get(&pgftl->sched.nr_deferred_erase);
+	if (stat->host_write_pages > 0) {
+		stat->waf = (double)stat->flash_write_pages /
+			    (double)stat->host_write_pages;
+	}
+	return 0;
+}
@@ -0,0 +1,328 @@
+/**
+ * @file page-wear.c
+ * @brief wear leveling logic for page ftl
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ */
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+
+#include "page.h"
+#include "log.h"
+#include "bits.h"
+
+/**
+ * @brief check the segment is the bad segment or not
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param segnum target segment number
+ *
+ * @return 1 for bad segment, 0 for normal segment
+ */
+static int page_ftl_is_bad_segment(struct page_ftl *pgftl, size_t segnum)
+{
+	struct device *dev = pgftl->dev;
+	return dev->badseg_bitmap && get_bit(dev->badseg_bitmap, segnum);
+}
+
+/**
+ * @brief find the minimum erase count and the segments which have it
+ *
+ * @param pgftl pointer of the page FTL structure
+ *
+ * @note
+ * The caller must hold the `pgftl->mutex`.
+ */
+static void page_ftl_wear_find_min(struct page_ftl *pgftl)
+{
+	struct page_ftl_wear *wear = &pgftl->wear;
+	size_t nr_segments, segnum;
+
+	wear->min_erase = UINT64_MAX;
+	wear->nr_min_segments = 0;
+	nr_segments = device_get_nr_segments(pgftl->dev);
+	for (segnum = 0; segnum < nr_segments; segnum++) {
+		uint64_t nr_erase;
+		if (page_ftl_is_bad_segment(pgftl, segnum)) {
+			continue;
+		}
+		nr_erase = (uint64_t)g_atomic_int_get(
+			&pgftl->counter.nr_erase[segnum]);
+		if (nr_erase < wear->min_erase) {
+			wear->min_erase = nr_erase;
+			wear->nr_min_segments = 0;
+		}
+		if (nr_erase == wear->min_erase) {
+			wear->nr_min_segments++;
+		}
+	}
+	if (wear->nr_min_segments == 0) {
+		wear->min_erase = 0;
+	}
+}
+
+/**
+ * @brief recount the erase count distribution from the segments
+ *
+ * @param pgftl pointer of the page FTL structure
+ *
+ * @note
+ * The caller must hold the `pgftl->mutex` (or own the page ftl exclusively
+ * like the open).
+ */
+void page_ftl_wear_init(struct page_ftl *pgftl)
+{
+	struct page_ftl_wear *wear = &pgftl->wear;
+	size_t nr_segments, segnum;
+
+	wear->max_erase = 0;
+	wear->total_erase = 0;
+	wear->total_erase_sq = 0;
+	wear->nr_segments = 0;
+	nr_segments = device_get_nr_segments(pgftl->dev);
+	for (segnum = 0; segnum < nr_segments; segnum++) {
+		uint64_t nr_erase;
+		if (page_ftl_is_bad_segment(pgftl, segnum)) {
+			continue;
+		}
+		nr_erase = (uint64_t)g_atomic_int_get(
+			&pgftl->counter.nr_erase[segnum]);
+		wear->max_erase = MAX(wear->max_erase, nr_erase);
+		wear->total_erase += nr_erase;
+		wear->total_erase_sq += nr_erase * nr_erase;
+		wear->nr_segments++;
+	}
+	wear->checked_erase = wear->total_erase;
+	page_ftl_wear_find_min(pgftl);
+}
+
+/**
+ * @brief reflect the erase of the segment to the distribution
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param segnum segment number whose erase count is just increased
+ *
+ * @note
+ * The caller must hold the `pgftl->mutex`.
+ */
+void page_ftl_wear_update(struct page_ftl *pgftl, size_t segnum)
+{
+	struct page_ftl_wear *wear = &pgftl->wear;
+	uint64_t nr_erase;
+
+	if (page_ftl_is_bad_segment(pgftl, segnum)) {
+		return;
+	}
+	nr_erase = (uint64_t)g_atomic_int_get(&pgftl->counter.nr_erase[segnum]);
+	wear->total_erase++;
+	wear->total_erase_sq += 2 * nr_erase - 1; /**< n^2 - (n - 1)^2 */
+	wear->max_erase = MAX(wear->max_erase, nr_erase);
+	if (nr_erase - 1 == wear->min_erase && wear->nr_min_segments > 0 &&
+	    --wear->nr_min_segments == 0) {
+		page_ftl_wear_find_min(pgftl);
+	}
+}
+
+/**
+ * @brief check the static wear leveling is needed
+ *
+ * @param pgftl pointer of the page FTL structure
+ *
+ * @return 1 for needed, 0 for not needed
+ *
+ * @note
+ * The gap is checked only after `PAGE_FTL_WEAR_CHECK_ERASES` erases, so the
+ * idle or balanced device doesn't take the gc locks for the wear leveling.
+ */
+int page_ftl_wear_is_needed(struct page_ftl *pgftl)
+{
+	struct page_ftl_wear *wear = &pgftl->wear;
+	int is_needed = 0;
+
+	if (!g_atomic_int_get(&wear->is_enabled)) {
+		return 0;
+	}
+	pthread_mutex_lock(&pgftl->mutex);
+	if (wear->total_erase - wear->checked_erase >=
+	    PAGE_FTL_WEAR_CHECK_ERASES) {
+		wear->checked_erase = wear->total_erase;
+		is_needed = wear->max_erase - wear->min_erase >=
+			    PAGE_FTL_WEAR_THRESHOLD;
+	}
+	pthread_mutex_unlock(&pgftl->mutex);
+	return is_needed;
+}
+
+/**
+ * @brief enable or disable the static wear leveling of the gc thread
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param is_enabled 1 for enable, 0 for disable
+ *
+ * @return 0 for success
+ */
+int page_ftl_set_wear_leveling(struct page_ftl *pgftl, int is_enabled)
+{
+	g_atomic_int_set(&pgftl->wear.is_enabled, is_enabled ? 1 : 0);
+	return 0;
+}
+
+/**
+ * @brief pick the static wear leveling target
+ *
+ * @param pgftl pointer of the page FTL structure
+ *
+ * @return target segment pointer, NULL means the wear is already balanced
+ *
+ * @note
+ * The target is the fully written segment which has the lowest erase count.
+ * Such a segment holds the cold data, so its erase count never grows unless
+ * the cold data moves to the other segment.
+ *
+ * The caller must hold the `pgftl->gc_mutex` and the `pgftl->mutex`. The
+ * victim of the paced gc is also full and inactive, but the pacer still owns
+ * it. So, it is skipped, and so is the segment which has the pending writes.
+ */
+static struct page_ftl_segment *
+page_ftl_pick_wear_target(struct page_ftl *pgftl)
+{
+	struct page_ftl_segment_counter *counter = &pgftl->counter;
+	struct page_ftl_segment *target;
+	size_t nr_segments, segnum;
+	gint min_erase;
+
+	nr_segments = device_get_nr_segments(pgftl->dev);
+
+	target = NULL;
+	min_erase = INT_MAX;
+	for (segnum = 0; segnum < nr_segments; segnum++) {
+		gint nr_erase;
+		if (page_ftl_is_bad_segment(pgftl, segnum)) {
+			continue;
+		}
+		if (g_atomic_int_get(&counter->nr_free_pages[segnum]) != 0 ||
+		    g_atomic_int_get(&counter->nr_pending_writes[segnum]) ||
+		    page_ftl_is_active_segment(pgftl, segnum) ||
+		    &pgftl->segments[segnum] == pgftl->pacer.victim) {
+			continue;
+		}
+		nr_erase = g_atomic_int_get(&counter->nr_erase[segnum]);
+		if (nr_erase < min_erase) {
+			min_erase = nr_erase;
+			target = &pgftl->segments[segnum];
+		}
+	}
+
+	if (target == NULL ||
+	    pgftl->wear.max_erase - (uint64_t)min_erase <
+		    PAGE_FTL_WEAR_THRESHOLD) {
+		return NULL;
+	}
+	return target;
+}
+
+/**
+ * @brief migrate the cold data from the least worn segment
+ *
+ * @param pgftl pointer of the page FTL structure
+ *
+ * @return number of the migrated segments, negative number for fail
+ *
+ * @note
+ * The target segment is detached from the gc list (if it exists) and handled
+ * the same as the garbage collection victim. After the migration, the target
+ * segment returns to the allocator and receives the hot data.
+ *
+ * The cold data is copied to the wear frontier, which takes the most erased
+ * free segment. If it goes to the least erased one like the gc frontier, the
+ * cold data pins that segment and the gap never closes.
+ */
+ssize_t page_ftl_static_wear_leveling(struct page_ftl *pgftl)
+{
+	struct page_ftl_segment *segment;
+	size_t segnum;
+	ssize_t ret;
+
+	pthread_mutex_lock(&pgftl->gc_mutex);
+#ifdef PAGE_FTL_USE_GLOBAL_RWLOCK
+	pthread_rwlock_wrlock(&pgftl->rwlock);
+#endif
+	pthread_mutex_lock(&pgftl->mutex);
+	segment = page_ftl_pick_wear_target(pgftl);
+	if (segment == NULL) {
+		pthread_mutex_unlock(&pgftl->mutex);
+		ret = 0;
+		goto out;
+	}
+	segnum = page_ftl_get_segment_number(pgftl, (uintptr_t)segment);
+	if (test_and_set_bit(pgftl->gc_seg_bits, segnum)) {
+		pgftl->gc_list = g_list_remove(pgftl->gc_list, segment);
+	}
+	pthread_mutex_unlock(&pgftl->mutex);
+
+	pr_debug("wear leveling target: %zu (erase: %d, valid: %d)\n", segnum,
+		 g_atomic_int_get(&pgftl->counter.nr_erase[segnum]),
+		 g_atomic_int_get(&pgftl->counter.nr_valid_pages[segnum]));
+	ret = page_ftl_gc_segment(pgftl, segment, PAGE_FTL_WEAR_FRONTIER);
+	if (ret < 0) {
+		pr_err("cold data migration failed (segnum: %zu)\n", segnum);
+		goto out;
+	}
+	ret = 1;
+out:
+#ifdef PAGE_FTL_USE_GLOBAL_RWLOCK
+	pthread_rwlock_unlock(&pgftl->rwlock);
+#endif
+	pthread_mutex_unlock(&pgftl->gc_mutex);
+	return ret;
+}
+
+/**
+ * @brief get the erase count distribution of the segments
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param stat pointer of the statistics structure which is filled by this
+ *
+ * @return 0 for success, negative number for fail
+ *
+ * @note
+ * The distribution is kept by each erase, so this doesn't scan the segments.
+ */
+int page_ftl_get_wear_stat(struct page_ftl *pgftl,
+			   struct page_ftl_wear_stat *stat)
+{
+	struct page_ftl_wear *wear;
+	double variance;
+	uint64_t total_erase_sq;
+
+	if (pgftl == NULL || stat == NULL ||
+	    pgftl->counter.nr_erase == NULL) {
+		pr_err("null detected (pgftl:%p, stat:%p)\n", pgftl, stat);
+		return -EINVAL;
+	}
+	wear = &pgftl->wear;
+
+	memset(stat, 0, sizeof(struct page_ftl_wear_stat));
+	pthread_mutex_lock(&pgftl->mutex);
+	stat->nr_free_segments = page_ftl_get_free_segments(pgftl);
+	stat->nr_segments = wear->nr_segments;
+	stat->min_erase = wear->min_erase;
+	stat->max_erase = wear->max_erase;
+	stat->total_erase = wear->total_erase;
+	total_erase_sq = wear->total_erase_sq;
+	pthread_mutex_unlock(&pgftl->mutex);
+
+	if (stat->nr_segments == 0) {
+		return 0;
+	}
+	stat->avg_erase =
+		(double)stat->total_erase / (double)stat->nr_segments;
+	variance = (double)total_erase_sq / (double)stat->nr_segments -
+		   stat->avg_erase * stat->avg_erase;
+	stat->stddev_erase = sqrt(MAX(variance, (double)0));
+	return 0;
+}
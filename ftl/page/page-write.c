@@ -11,6 +11,7 @@
 #include "log.h"
 #include "lru.h"
 #include "bits.h"
+#include "trace.h"
 
 #include <pthread.h>
 #include <assert.h>
@@ -20,8 +21,6 @@
 
 #include <glib.h>
 
-int uesr_flag;
-
 /**
  * @brief invalidate a segment that including to the given LPN
  *
@@ -34,7 +33,7 @@ static void page_ftl_invalidate(struct page_ftl *pgftl, size_t lpn)
 	struct device_address paddr;
 
 	uint32_t segnum;
-	size_t nr_valid_pages, nr_free_pages;
+	size_t nr_free_pages;
 
 	/**< segment information update */
 	paddr.lpn = pgftl->trans_map[lpn];
@@ -44,16 +43,15 @@ static void page_ftl_invalidate(struct page_ftl *pgftl, size_t lpn)
 	segment->lpn_list =
 		g_list_remove(segment->lpn_list, GSIZE_TO_POINTER(lpn));
 
-	nr_valid_pages = g_atomic_int_get(&segment->nr_valid_pages);
-	nr_free_pages = g_atomic_int_get(&segment->nr_free_pages);
-	g_atomic_int_set(&segment->nr_valid_pages,
-			 (unsigned int)(nr_valid_pages - 1));
+	/**< the allocator increases this without the `pgftl->mutex` */
+	g_atomic_int_add(&pgftl->counter.nr_valid_pages[segnum], -1);
+	nr_free_pages = g_atomic_int_get(&pgftl->counter.nr_free_pages[segnum]);
 
 	/**< global information update */
 	pgftl->trans_map[lpn] = PADDR_EMPTY;
-	if (nr_free_pages == 0 && get_bit(pgftl->gc_seg_bits, segnum) != 1) {
+	if (nr_free_pages == 0 &&
+	    !test_and_set_bit(pgftl->gc_seg_bits, segnum)) {
 		pgftl->gc_list = g_list_append(pgftl->gc_list, segment);
-		set_bit(pgftl->gc_seg_bits, segnum);
 	}
 }
 
@@ -61,11 +59,19 @@ static void page_ftl_invalidate(struct page_ftl *pgftl, size_t lpn)
  * @brief write's end request function
  *
  * @param request the request which is submitted before
+ *
+ * @note
+ * The submitter waits for this, because the mapping must not point to the
+ * page whose write is failed. The result is passed by `request->status`.
  */
 static void page_ftl_write_end_rq(struct device_request *request)
 {
-	free(request->data);
-	device_free_request(request);
+	pthread_mutex_lock(&request->mutex);
+	if (g_atomic_int_get(&request->is_finish) == 0) {
+		pthread_cond_signal(&request->cond);
+	}
+	g_atomic_int_set(&request->is_finish, 1);
+	pthread_mutex_unlock(&request->mutex);
 }
 
 /**
@@ -102,11 +108,12 @@ static ssize_t page_ftl_read_for_overwrite(struct page_ftl *pgftl, size_t lpn,
 	read_rq->sector = lpn * page_size;
 	read_rq->data_len = page_size;
 	read_rq->data = buffer;
-	ret = page_ftl_read(pgftl, read_rq);
+	ret = page_ftl_read_class(pgftl, read_rq, PAGE_FTL_SCHED_WRITE);
 	if (ret < 0) {
 		pr_err("previous buffer read failed\n");
 		return -EFAULT;
 	}
+	page_ftl_stat_add(pgftl, PAGE_FTL_STAT_RMW_READ, 1);
 	return ret;
 }
 
@@ -123,7 +130,7 @@ static void page_ftl_write_update_metadata(struct page_ftl *pgftl,
 {
 	struct page_ftl_segment *segment;
 
-	size_t lpn;
+	size_t lpn, segnum;
 	lpn = page_ftl_get_lpn(pgftl, sector);
 	if (pgftl->trans_map[lpn] != PADDR_EMPTY) {
 		page_ftl_invalidate(pgftl, lpn);
@@ -131,7 +138,8 @@ static void page_ftl_write_update_metadata(struct page_ftl *pgftl,
 			 pgftl->trans_map[lpn]);
 	}
 	/**< segment information update */
-	segment = &pgftl->segments[paddr.format.block];
+	segnum = paddr.format.block;
+	segment = &pgftl->segments[segnum];
 	segment->lpn_list =
 		g_list_append(segment->lpn_list, GSIZE_TO_POINTER(lpn));
 
@@ -141,8 +149,8 @@ static void page_ftl_write_update_metadata(struct page_ftl *pgftl,
 	pr_debug("new address: %zu => %u (seg: %u)\n", lpn,
 		 pgftl->trans_map[lpn], pgftl->trans_map[lpn] >> 13);
 	pr_debug("%u/%u(free/valid)\n",
-		 g_atomic_int_get(&segment->nr_free_pages),
-		 g_atomic_int_get(&segment->nr_valid_pages));
+		 g_atomic_int_get(&pgftl->counter.nr_free_pages[segnum]),
+		 g_atomic_int_get(&pgftl->counter.nr_valid_pages[segnum]));
 }
 
 /**
@@ -150,10 +158,12 @@ static void page_ftl_write_update_metadata(struct page_ftl *pgftl,
  *
  * @param pgftl pointer of the page FTL structure
  * @param request user's request pointer
+ * @param frontier frontier which allocates the page for this request
  *
  * @return writing data size. a negative number means fail to write.
  */
-ssize_t page_ftl_write(struct page_ftl *pgftl, struct device_request *request)
+ssize_t page_ftl_write_frontier(struct page_ftl *pgftl,
+				struct device_request *request, int frontier)
 {
 	struct device *dev;
 	struct device_address paddr;
@@ -163,11 +173,13 @@ ssize_t page_ftl_write(struct page_ftl *pgftl, struct device_request *request)
 
 	size_t lpn, offset;
 	size_t nr_entries;
+	size_t pages_per_segment;
 
 	size_t write_size;
 	size_t sector;
 
 	int is_exist;
+	int is_traced = frontier == PAGE_FTL_HOST_FRONTIER;
 
 	dev = pgftl->dev;
 	page_size = device_get_page_size(dev);
@@ -190,30 +202,35 @@ ssize_t page_ftl_write(struct page_ftl *pgftl, struct device_request *request)
 		return -EINVAL;
 	}
 
-	pthread_mutex_lock(&pgftl->mutex);
-	paddr = page_ftl_get_free_page(pgftl); /**< global data retrieve */
-	pthread_mutex_unlock(&pgftl->mutex);
+	paddr = page_ftl_get_free_page(pgftl,
+				       frontier); /**< global data retrieve */
 	if (paddr.lpn == PADDR_EMPTY) {
 		pr_err("cannot allocate the valid page from device\n");
 		return -EFAULT;
 	}
+	if (is_traced) {
+		trace_point(TRACE_POINT_ALLOC);
+	}
 
-	buffer = (char *)malloc(page_size);
+	buffer = (char *)device_alloc_buffer(page_size);
 	if (buffer == NULL) {
 		pr_err("memory allocation failed\n");
-		return -ENOMEM;
+		ret = -ENOMEM;
+		goto exception;
 	}
 	memset(buffer, 0, page_size);
 	pthread_mutex_lock(&pgftl->mutex);
 	is_exist = pgftl->trans_map[lpn] != PADDR_EMPTY;
 	pthread_mutex_unlock(&pgftl->mutex);
-	if (is_exist && !(offset == 0 || page_size == write_size)) {
-	//if (is_exist && write_size < page_size) {
-	//if (is_exist) {
+	/**< the sub-page write keeps the rest of the page */
+	if (is_exist && write_size < page_size) {
 		ret = page_ftl_read_for_overwrite(pgftl, lpn, buffer);
 		if (ret < 0) {
 			pr_err("read failed (lpn:%zu)\n", lpn);
-			return ret;
+			goto exception;
+		}
+		if (is_traced) {
+			trace_point(TRACE_POINT_RMW_READ);
 		}
 	}
 	memcpy(&buffer[offset], request->data, write_size);
@@ -224,24 +241,85 @@ ssize_t page_ftl_write(struct page_ftl *pgftl, struct device_request *request)
 	request->rq_private = (void *)pgftl;
 	request->data_len = page_size;
 	request->end_rq = page_ftl_write_end_rq;
+	request->status = 0;
+	g_atomic_int_set(&request->is_finish, 0);
 
-	/*
-	// check whether user write(benchmark.c) or gc write
-	if(user_flag){
-		user_flag = 0;
-		printf("PPN: %016x\t(segnum: %zu)\n", paddr.lpn, paddr.format.block);
-	}
-	*/
 	//printf("[FTL-log] write\tpaddr : %llX\tdata_len : %zubytes \n", request->paddr, request->data_len);
-	ret = dev->d_op->write(dev, request);
+	if (is_traced) {
+		trace_point(TRACE_POINT_PREPARE);
+	}
+	ret = page_ftl_sched_submit(pgftl, request,
+				    frontier == PAGE_FTL_HOST_FRONTIER ?
+					    PAGE_FTL_SCHED_WRITE :
+					    PAGE_FTL_SCHED_GC);
 	if (ret != (ssize_t)device_get_page_size(dev)) {
 		pr_err("device write failed (ppn: %u)\n", request->paddr.lpn);
-		return ret;
+		goto exception;
+	}
+
+	pthread_mutex_lock(&request->mutex);
+	while (g_atomic_int_get(&request->is_finish) == 0) {
+		pthread_cond_wait(&request->cond, &request->mutex);
+	}
+	pthread_mutex_unlock(&request->mutex);
+	/**< the device passes the failure of the completed write */
+	if (request->status < 0) {
+		ret = request->status;
+		pr_err("device write completion failed (ppn: %u, errno: %zd)\n",
+		       request->paddr.lpn, -ret);
+		free(request->data);
+		device_free_request(request);
+		goto exception;
+	}
+	page_ftl_stat_add(pgftl, PAGE_FTL_STAT_FLASH_WRITE, 1);
+	if (dev->info.is_append) {
+		/**< the segment is ours, and the device decides the page */
+		pages_per_segment = device_get_pages_per_segment(dev);
+		paddr.lpn = paddr.lpn - paddr.lpn % (uint32_t)pages_per_segment +
+			    request->paddr.lpn % (uint32_t)pages_per_segment;
+		page_ftl_set_placement(pgftl, paddr);
+	}
+	free(request->data);
+	device_free_request(request);
+	if (is_traced) {
+		trace_point(TRACE_POINT_DEVICE);
 	}
 
 	pthread_mutex_lock(&pgftl->mutex);
+	if (is_traced) {
+		trace_point(TRACE_POINT_LOCK);
+	}
 	page_ftl_write_update_metadata(pgftl, paddr, sector);
+	g_atomic_int_add(&pgftl->counter.nr_pending_writes[paddr.format.block],
+			 -1);
 	pthread_mutex_unlock(&pgftl->mutex);
+	if (is_traced) {
+		trace_point(TRACE_POINT_METADATA);
+	}
 
 	return write_size;
+
+exception:
+	g_atomic_int_add(&pgftl->counter.nr_pending_writes[paddr.format.block],
+			 -1);
+	return ret;
+}
+
+/**
+ * @brief write the host request to the device.
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param request user's request pointer
+ *
+ * @return writing data size. a negative number means fail to write.
+ */
+ssize_t page_ftl_write(struct page_ftl *pgftl, struct device_request *request)
+{
+	ssize_t ret;
+
+	ret = page_ftl_write_frontier(pgftl, request, PAGE_FTL_HOST_FRONTIER);
+	if (ret > 0) {
+		page_ftl_stat_add(pgftl, PAGE_FTL_STAT_HOST_WRITE, 1);
+	}
+	return ret;
 }
@@ -4,14 +4,19 @@
 #include <stdint.h>
 #include <limits.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BITS_USE_AVX2
+#endif
+
 #define BITS_NOT_FOUND ((uint64_t)UINT64_MAX)
 
 #define BITS_PER_BYTE (8)
 #define BITS_PER_UINT64 (BITS_PER_BYTE * sizeof(uint64_t))
 
 #define BITS_TO_UINT64_ALIGN(x)                                                \
-	(((uint64_t)x / BITS_PER_UINT64 + 1) * sizeof(uint64_t))
-#define BITS_TO_UINT64(x) ((uint64_t)x / BITS_PER_UINT64)
+	((((uint64_t)(x)) / BITS_PER_UINT64 + 1) * sizeof(uint64_t))
+#define BITS_TO_UINT64(x) (((uint64_t)(x)) / BITS_PER_UINT64)
 
 /**
  * @brief set the index position bit in the array(uint64_t)
@@ -51,6 +56,159 @@ static inline void reset_bit(uint64_t *bits, uint64_t index)
 		~((uint64_t)0x1 << (index % BITS_PER_UINT64));
 }
 
+/**
+ * @brief get the bit mask of the index in its word
+ *
+ * @param index bit position
+ *
+ * @return mask which only sets the index position bit
+ */
+#define BITS_MASK(index) ((uint64_t)0x1 << ((index) % BITS_PER_UINT64))
+
+/**
+ * @brief atomically get the value at the index position bit
+ *
+ * @param bits array which contains the bitmap
+ * @param index get position (bit position NOT byte or uint64_t position)
+ *
+ * @return bit status at the index position
+ */
+static inline int atomic_get_bit(uint64_t *bits, uint64_t index)
+{
+	return (__atomic_load_n(&bits[BITS_TO_UINT64(index)],
+				__ATOMIC_ACQUIRE) &
+		BITS_MASK(index)) > 0;
+}
+
+/**
+ * @brief atomically set the index position bit and return the previous value
+ *
+ * @param bits array which contains the bitmap
+ * @param index set position (bit position NOT byte or uint64_t position)
+ *
+ * @return bit status before the set
+ */
+static inline int test_and_set_bit(uint64_t *bits, uint64_t index)
+{
+	return (__atomic_fetch_or(&bits[BITS_TO_UINT64(index)],
+				  BITS_MASK(index), __ATOMIC_ACQ_REL) &
+		BITS_MASK(index)) > 0;
+}
+
+/**
+ * @brief atomically reset the index position bit and return the previous value
+ *
+ * @param bits array which contains the bitmap
+ * @param index reset position (bit position NOT byte or uint64_t position)
+ *
+ * @return bit status before the reset
+ */
+static inline int test_and_reset_bit(uint64_t *bits, uint64_t index)
+{
+	return (__atomic_fetch_and(&bits[BITS_TO_UINT64(index)],
+				   ~BITS_MASK(index), __ATOMIC_ACQ_REL) &
+		BITS_MASK(index)) > 0;
+}
+
+/**
+ * @brief atomically set the index position bit
+ *
+ * @param bits array which contains the bitmap
+ * @param index set position (bit position NOT byte or uint64_t position)
+ */
+static inline void atomic_set_bit(uint64_t *bits, uint64_t index)
+{
+	(void)test_and_set_bit(bits, index);
+}
+
+/**
+ * @brief atomically reset the index position bit
+ *
+ * @param bits array which contains the bitmap
+ * @param index reset position (bit position NOT byte or uint64_t position)
+ */
+static inline void atomic_reset_bit(uint64_t *bits, uint64_t index)
+{
+	(void)test_and_reset_bit(bits, index);
+}
+
+/**
+ * @brief find the first word which contains the target bit
+ *
+ * @param bits array which contains the bitmap
+ * @param word_idx start position word (uint64_t position)
+ * @param nr_words number of words in the bitmap
+ * @param invert 0 to find the one bit, UINT64_MAX to find the zero bit
+ * @param skip_mask bits of each word which are never the target
+ *
+ * @return first word position, nr_words means not found
+ *
+ * @note
+ * If the compiler supports the AVX2 (e.g., `make USE_AVX2=1`), this checks
+ * the 4 words at once. Otherwise, this uses the scalar loop. The words are
+ * read without the lock, so the lock-free claim uses the result as a hint and
+ * reads the word again by the atomic operation.
+ */
+static inline uint64_t __find_first_word(const uint64_t *bits,
+					 uint64_t word_idx, uint64_t nr_words,
+					 uint64_t invert, uint64_t skip_mask)
+{
+#ifdef BITS_USE_AVX2
+	const __m256i mask = _mm256_set1_epi64x((long long)invert);
+	const __m256i skip = _mm256_set1_epi64x((long long)skip_mask);
+	for (; word_idx + 4 <= nr_words; word_idx += 4) {
+		__m256i bucket = _mm256_loadu_si256(
+			(const __m256i *)(const void *)&bits[word_idx]);
+		bucket = _mm256_xor_si256(_mm256_or_si256(bucket, skip), mask);
+		if (!_mm256_testz_si256(bucket, bucket)) {
+			break;
+		}
+	}
+#endif
+	for (; word_idx < nr_words; word_idx++) {
+		if (((bits[word_idx] | skip_mask) ^ invert) != 0) {
+			break;
+		}
+	}
+	return word_idx;
+}
+
+/**
+ * @brief find first bit which is different from the invert
+ *
+ * @param bits array which contains the bitmap
+ * @param size bitmap's size (the number of bits NOT bytes)
+ * @param idx start position bit
+ * @param invert 0 to find the one bit, UINT64_MAX to find the zero bit
+ *
+ * @return first bit position
+ */
+static inline uint64_t __find_first_bit(const uint64_t *bits, uint64_t size,
+					uint64_t idx, uint64_t invert)
+{
+	uint64_t nr_words, word_idx, bucket;
+
+	if (idx >= size) {
+		return BITS_NOT_FOUND;
+	}
+	nr_words = BITS_TO_UINT64(size - 1) + 1;
+	word_idx = BITS_TO_UINT64(idx);
+	/**< ignore the bits before the start position */
+	bucket = (bits[word_idx] ^ invert) &
+		 ((uint64_t)UINT64_MAX << (idx % BITS_PER_UINT64));
+	if (bucket == 0) {
+		word_idx = __find_first_word(bits, word_idx + 1, nr_words,
+					     invert, 0);
+		if (word_idx >= nr_words) {
+			return BITS_NOT_FOUND;
+		}
+		bucket = bits[word_idx] ^ invert;
+	}
+	idx = word_idx * BITS_PER_UINT64 +
+	      (uint64_t)__builtin_ctzll((unsigned long long)bucket);
+	return idx < size ? idx : BITS_NOT_FOUND;
+}
+
 /**
  * @brief find first zero bit in the array(uint64_t)
  *
@@ -63,21 +221,7 @@ static inline void reset_bit(uint64_t *bits, uint64_t index)
 static inline uint64_t find_first_zero_bit(uint64_t *bits, uint64_t size,
 					   uint64_t idx)
 {
-	while (idx < size) {
-		uint64_t bucket = bits[BITS_TO_UINT64(idx)];
-		if (bucket < (uint64_t)UINT64_MAX) {
-			uint64_t diff = 0;
-			for (diff = 0; diff < BITS_PER_UINT64; diff++) {
-				if ((bucket & (uint64_t)((uint64_t)0x1
-							 << diff)) == 0x0) {
-					break;
-				}
-			}
-			return idx + diff;
-		}
-		idx += BITS_PER_UINT64;
-	}
-	return BITS_NOT_FOUND;
+	return __find_first_bit(bits, size, idx, (uint64_t)UINT64_MAX);
 }
 
 /**
@@ -92,21 +236,158 @@ static inline uint64_t find_first_zero_bit(uint64_t *bits, uint64_t size,
 static inline uint64_t find_first_one_bit(uint64_t *bits, uint64_t size,
 					  uint64_t idx)
 {
-	while (idx < size) {
-		uint64_t bucket = bits[BITS_TO_UINT64(idx)];
-		if (bucket > (uint64_t)0x0) {
-			uint64_t diff = 0;
-			for (diff = 0; diff < BITS_PER_UINT64; diff++) {
-				if ((bucket &
-				     (uint64_t)((uint64_t)0x1 << diff)) > 0) {
-					break;
-				}
+	return __find_first_bit(bits, size, idx, (uint64_t)0);
+}
+
+/**
+ * @brief find the first zero bit which is not skipped and set it without the
+ * lock
+ *
+ * @param bits array which contains the bitmap
+ * @param size bitmap's size (the number of bits NOT bytes)
+ * @param idx start position bit
+ * @param skip_mask bits of each word which are never claimed
+ *
+ * @return claimed bit position, BITS_NOT_FOUND means the bitmap is full
+ *
+ * @note
+ * Each word is updated by the compare-and-swap. If the other thread changes
+ * the word between the load and the swap, this retries with the new value.
+ * So the same bit is never returned to two threads. The full words are
+ * skipped by the `__find_first_word()` (4 words at once with the AVX2).
+ */
+static inline uint64_t __claim_first_zero_bit(uint64_t *bits, uint64_t size,
+					      uint64_t idx, uint64_t skip_mask)
+{
+	uint64_t nr_words, word_idx, start_mask;
+
+	if (idx >= size) {
+		return BITS_NOT_FOUND;
+	}
+	nr_words = BITS_TO_UINT64(size - 1) + 1;
+	word_idx = BITS_TO_UINT64(idx);
+	/**< ignore the bits before the start position */
+	start_mask = skip_mask |
+		     ~((uint64_t)UINT64_MAX << (idx % BITS_PER_UINT64));
+	while (word_idx < nr_words) {
+		uint64_t bucket, offset, claimed;
+
+		bucket = __atomic_load_n(&bits[word_idx], __ATOMIC_ACQUIRE);
+		while ((bucket | start_mask) != (uint64_t)UINT64_MAX) {
+			offset = (uint64_t)__builtin_ctzll(
+				(unsigned long long)~(bucket | start_mask));
+			claimed = word_idx * BITS_PER_UINT64 + offset;
+			if (claimed >= size) {
+				return BITS_NOT_FOUND;
+			}
+			/**< `bucket` is refreshed when the swap fails */
+			if (__atomic_compare_exchange_n(
+				    &bits[word_idx], &bucket,
+				    bucket | ((uint64_t)0x1 << offset), 0,
+				    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				return claimed;
 			}
-			return idx + diff;
 		}
-		idx += BITS_PER_UINT64;
+		/**< the full words are skipped by the wide scan */
+		word_idx = __find_first_word(bits, word_idx + 1, nr_words,
+					     (uint64_t)UINT64_MAX, skip_mask);
+		start_mask = skip_mask;
 	}
 	return BITS_NOT_FOUND;
 }
 
+/**
+ * @brief find the first zero bit and set it without the lock
+ *
+ * @param bits array which contains the bitmap
+ * @param size bitmap's size (the number of bits NOT bytes)
+ * @param idx start position bit
+ *
+ * @return claimed bit position, BITS_NOT_FOUND means the bitmap is full
+ */
+static inline uint64_t claim_first_zero_bit(uint64_t *bits, uint64_t size,
+					    uint64_t idx)
+{
+	return __claim_first_zero_bit(bits, size, idx, 0);
+}
+
+/**
+ * @brief find the first zero bit in the masked positions and set it without
+ * the lock
+ *
+ * @param bits array which contains the bitmap
+ * @param size bitmap's size (the number of bits NOT bytes)
+ * @param mask positions in each word which can be claimed
+ *
+ * @return claimed bit position, BITS_NOT_FOUND means the masked positions
+ * are full
+ *
+ * @note
+ * The same mask is applied to every word. So, the mask `0x5555...` claims
+ * only the even positions in the whole bitmap.
+ */
+static inline uint64_t claim_first_zero_bit_masked(uint64_t *bits,
+						   uint64_t size, uint64_t mask)
+{
+	return __claim_first_zero_bit(bits, size, 0, ~mask);
+}
+
+/**
+ * @brief count the one bits in the range of the array(uint64_t)
+ *
+ * @param bits array which contains the bitmap
+ * @param start start position bit (inclusive)
+ * @param end end position bit (exclusive)
+ *
+ * @return the number of one bits in [start, end)
+ */
+static inline uint64_t count_one_bits(uint64_t *bits, uint64_t start,
+				      uint64_t end)
+{
+	uint64_t first, last, word_idx;
+	uint64_t head_mask, tail_mask;
+	uint64_t count;
+
+	if (start >= end) {
+		return 0;
+	}
+	first = BITS_TO_UINT64(start);
+	last = BITS_TO_UINT64(end - 1);
+	head_mask = (uint64_t)UINT64_MAX << (start % BITS_PER_UINT64);
+	tail_mask = (uint64_t)UINT64_MAX >>
+		    (BITS_PER_UINT64 - 1 - ((end - 1) % BITS_PER_UINT64));
+	if (first == last) {
+		return (uint64_t)__builtin_popcountll(
+			(unsigned long long)(bits[first] & head_mask &
+					     tail_mask));
+	}
+	count = (uint64_t)__builtin_popcountll(
+		(unsigned long long)(bits[first] & head_mask));
+	for (word_idx = first + 1; word_idx < last; word_idx++) {
+		count += (uint64_t)__builtin_popcountll(
+			(unsigned long long)bits[word_idx]);
+	}
+	count += (uint64_t)__builtin_popcountll(
+		(unsigned long long)(bits[last] & tail_mask));
+	return count;
+}
+
+/**
+ * @brief count the zero bits in the range of the array(uint64_t)
+ *
+ * @param bits array which contains the bitmap
+ * @param start start position bit (inclusive)
+ * @param end end position bit (exclusive)
+ *
+ * @return the number of zero bits in [start, end)
+ */
+static inline uint64_t count_zero_bits(uint64_t *bits, uint64_t start,
+				       uint64_t end)
+{
+	if (start >= end) {
+		return 0;
+	}
+	return (end - start) - count_one_bits(bits, start, end);
+}
+
 #endif
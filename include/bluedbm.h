@@ -16,6 +16,12 @@
 #define BLUEDBM_NR_BLOCKS                                                      \
 	(8192) /**< number of blocks(segments) in the flash board */
 
+#ifndef BLUEDBM_NR_DMA_TAGS
+#define BLUEDBM_NR_DMA_TAGS (128) /**< DMA tags of each direction */
+#endif
+
+struct bluedbm;
+
 /**
  * @brief structure for manage the dma
  */
@@ -23,6 +29,8 @@ typedef struct {
 	uint32_t tag;
 	char *data;
 	void *d_private;
+	struct bluedbm *bdbm; /**< owner of this dma */
+	async_bdbm_req rw_req; /**< request which is submitted with this dma */
 } bluedbm_dma_t;
 
 /**
@@ -32,6 +40,15 @@ struct bluedbm {
 	size_t size;
 	memio_t *mio;
 	int o_flags;
+
+	gint *badseg_counter; /**< counter for bad segemnt detection */
+	gint *erase_counter; /**< counter for # of erase in the segment */
+
+	bluedbm_dma_t *write_dma; /**< indexed by the write DMA tag */
+	bluedbm_dma_t *read_dma; /**< indexed by the read DMA tag */
+
+	long read_sum, write_sum; /**< device layer latency sum (ns) */
+	long read_cnt, write_cnt;
 };
 
 int bluedbm_open(struct device *, const char *name, int flags);
@@ -18,11 +18,12 @@
 
 #define PADDR_EMPTY ((uint32_t)UINT32_MAX)
 
-extern int user_flag;
 struct device_request;
 struct device_operations;
 
 #define DEVICE_PAGE_SIZE (8192)
+#define DEVICE_OOB_SIZE (64) /**< out-of-band area of each page (bytes) */
+#define DEVICE_BUFFER_ALIGN (4096) /**< alignment of the direct I/O buffer */
 
 /**
  * @brief request allocation flags
@@ -117,9 +118,11 @@ struct device_request {
 	struct device_address paddr; /**< this contains the ppa */
 
 	void *data; /**< pointer of the data */
+	void *oob; /**< `DEVICE_OOB_SIZE` bytes of the out-of-band data or NULL */
 	device_end_req_fn end_rq; /**< end request function */
 
 	gint is_finish;
+	int status; /**< 0 or the negative errno of the completed request */
 	struct timespec begin;
 
 	pthread_mutex_t mutex;
@@ -158,6 +161,8 @@ struct device_info {
 	struct device_package package;
 	size_t nr_bus; /**< bus equal to channel */
 	size_t nr_chips; /**< chip equal to way */
+	size_t max_open_segments; /**< partially written segments (0: no limit) */
+	int is_append; /**< the device places the write and returns its `paddr` */
 };
 
 /**
@@ -181,10 +186,14 @@ struct device_operations {
 	ssize_t (*read)(struct device *, struct device_request *);
 	int (*erase)(struct device *, struct device_request *);
 	int (*close)(struct device *);
+	int (*flush)(struct device *); /**< persist the data (it can be NULL) */
+	/**< NUMA node of the bus's memory, negative for unknown (it can be NULL) */
+	int (*get_bus_node)(struct device *, size_t bus);
 };
 
 struct device_request *device_alloc_request(uint64_t flags);
 void device_free_request(struct device_request *);
+void *device_alloc_buffer(size_t size);
 
 int device_module_init(const uint64_t modnum, struct device **, uint64_t flags);
 int device_module_exit(struct device *);
@@ -0,0 +1,132 @@
+/**
+ * @file hist.h
+ * @brief data structures and interfaces for the log-linear histogram
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ * @note
+ * Each histogram must have only one writer. The other threads can read
+ * the histogram while the writer records (e.g., merge or percentile).
+ */
+#ifndef HIST_H
+#define HIST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define HIST_SUB_BUCKET_BITS                                                   \
+	(7) /**< each power of 2 range is split by 64 sub-buckets (< 1.6%) */
+#define HIST_SUB_BUCKET_HALF ((uint64_t)1 << (HIST_SUB_BUCKET_BITS - 1))
+#define HIST_NR_BUCKETS                                                        \
+	((64 - HIST_SUB_BUCKET_BITS + 2) * HIST_SUB_BUCKET_HALF)
+
+/**
+ * @brief log-linear (HDR-style) histogram
+ *
+ * @note
+ * Values under `2^HIST_SUB_BUCKET_BITS` are recorded exactly, and the larger
+ * values are recorded with the constant relative error. So, the memory usage
+ * doesn't depend on the number of the recorded values.
+ */
+struct hist {
+	uint64_t *counts; /**< number of the values in each bucket */
+	uint64_t total; /**< number of the recorded values */
+	uint64_t sum; /**< sum of the recorded values */
+	uint64_t min;
+	uint64_t max;
+};
+
+int hist_init(struct hist *hist);
+void hist_reset(struct hist *hist);
+void hist_merge(struct hist *dst, const struct hist *src);
+void hist_diff(struct hist *dst, const struct hist *cur,
+	       const struct hist *prev);
+uint64_t hist_percentile(const struct hist *hist, double percentile);
+void hist_free(struct hist *hist);
+
+/**
+ * @brief get the bucket index of the value
+ *
+ * @param value recorded value
+ *
+ * @return bucket index
+ */
+static inline size_t hist_get_index(uint64_t value)
+{
+	int msb, shift;
+
+	if (value < (HIST_SUB_BUCKET_HALF << 1)) {
+		return (size_t)value;
+	}
+	msb = 63 - __builtin_clzll(value);
+	shift = msb - (HIST_SUB_BUCKET_BITS - 1);
+	return (size_t)shift * HIST_SUB_BUCKET_HALF + (size_t)(value >> shift);
+}
+
+/**
+ * @brief get the representative value (middle) of the bucket
+ *
+ * @param index bucket index
+ *
+ * @return middle value of the bucket
+ */
+static inline uint64_t hist_get_value(size_t index)
+{
+	uint64_t shift, sub;
+
+	if (index < (HIST_SUB_BUCKET_HALF << 1)) {
+		return (uint64_t)index;
+	}
+	shift = index / HIST_SUB_BUCKET_HALF - 1;
+	sub = index - shift * HIST_SUB_BUCKET_HALF;
+	return (sub << shift) + (((uint64_t)1 << shift) >> 1);
+}
+
+/**
+ * @brief record the value to the histogram
+ *
+ * @param hist pointer of the histogram
+ * @param value value which wants to record
+ *
+ * @note
+ * The writer uses the relaxed atomic stores, so the other threads can read
+ * the histogram without the lock.
+ */
+static inline void hist_record(struct hist *hist, uint64_t value)
+{
+	size_t index = hist_get_index(value);
+	__atomic_fetch_add(&hist->counts[index], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&hist->sum, value, __ATOMIC_RELAXED);
+	if (value < __atomic_load_n(&hist->min, __ATOMIC_RELAXED)) {
+		__atomic_store_n(&hist->min, value, __ATOMIC_RELAXED);
+	}
+	if (value > __atomic_load_n(&hist->max, __ATOMIC_RELAXED)) {
+		__atomic_store_n(&hist->max, value, __ATOMIC_RELAXED);
+	}
+	__atomic_fetch_add(&hist->total, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief get the average of the recorded values
+ *
+ * @param hist pointer of the histogram
+ *
+ * @return average value (0 for the empty histogram)
+ */
+static inline double hist_mean(const struct hist *hist)
+{
+	if (hist->total == 0) {
+		return 0;
+	}
+	return (double)hist->sum / (double)hist->total;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
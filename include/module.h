@@ -13,6 +13,7 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stddef.h>
 
 #include "flash.h"
 
@@ -20,6 +21,8 @@ enum { PAGE_FTL_MODULE = 0 /**< page FTL number*/,
 };
 
 int module_init(const int modnum, struct flash_device **, uint64_t flags);
+int module_init_partitions(const int modnum, struct flash_device **,
+			   size_t nr_parts, uint64_t flags);
 int module_exit(struct flash_device *);
 
 #ifdef __cplusplus
@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include <assert.h>
 #include <limits.h>
@@ -29,33 +30,222 @@
 #define PAGE_FTL_GC_THRESHOLD                                                  \
 	((double)99.95 /                                                          \
 	 100) /**< gc triggered when number of the free pages under threshold */
+#define PAGE_FTL_WEAR_THRESHOLD                                                \
+	(16) /**< erase count gap which triggers the static wear leveling */
+#define PAGE_FTL_WEAR_CHECK_ERASES                                             \
+	(64) /**< erases between the static wear leveling checks */
+#define PAGE_FTL_GC_PACE_HIGH                                                  \
+	((double)25 / 100) /**< paced gc starts under this free segment ratio */
+#define PAGE_FTL_GC_PACE_MAX_BUDGET                                            \
+	(8) /**< relocation pages per host write when the free space is empty */
+#define PAGE_FTL_GC_PACE_BUCKET (64) /**< maximum tokens in the bucket */
+#define PAGE_FTL_GC_PACE_MIN_FREE                                              \
+	(2) /**< paced gc ignores the tokens under this free segments */
+#define PAGE_FTL_SCHED_MAX_BYPASS                                              \
+	(8) /**< host writes and gc are bypassed by the reads at most this */
+#define PAGE_FTL_SCHED_MAX_DEFER                                               \
+	(64) /**< erase is deferred by the other requests at most this */
+#define PAGE_FTL_STAT_NR_SLOTS                                                 \
+	(16) /**< counters are striped by the cpu to avoid the contention */
+#define PAGE_FTL_MAX_STRIPES                                                   \
+	(8) /**< active segments of a frontier on the appending device */
+
+#define PAGE_FTL_NO_SEGMENT                                                    \
+	((uint64_t)UINT64_MAX) /**< frontier doesn't have the active segment */
+
+/**
+ * @brief write frontiers which own their active segment
+ */
+enum {
+	PAGE_FTL_HOST_FRONTIER = 0, /**< frontier for the host writes */
+	PAGE_FTL_GC_FRONTIER, /**< frontier for the valid page copies */
+	PAGE_FTL_WEAR_FRONTIER, /**< frontier for the cold data migration */
+	PAGE_FTL_NR_FRONTIERS,
+};
+
+/**
+ * @brief request classes of the scheduler (lower value is higher priority)
+ */
+enum {
+	PAGE_FTL_SCHED_READ = 0, /**< host reads */
+	PAGE_FTL_SCHED_WRITE, /**< host writes (including read-modify-write) */
+	PAGE_FTL_SCHED_GC, /**< valid page copies */
+	PAGE_FTL_SCHED_ERASE, /**< segment erases */
+	PAGE_FTL_SCHED_NR_CLASSES,
+};
 
 enum {
 	PAGE_FTL_IOCTL_TRIM = 0,
+	PAGE_FTL_IOCTL_WEAR_STAT, /**< fill the `struct page_ftl_wear_stat` */
+	PAGE_FTL_IOCTL_GC_PACING, /**< enable(1) or disable(0) the paced gc */
+	PAGE_FTL_IOCTL_STAT, /**< fill the `struct page_ftl_stat` */
+	PAGE_FTL_IOCTL_FLUSH, /**< persist the written data in the device */
+	PAGE_FTL_IOCTL_LOCAL_NODE, /**< the caller prefers the node's buses */
+	PAGE_FTL_IOCTL_WEAR_LEVELING, /**< enable(1) or disable(0) the static
+					 wear leveling */
+};
+
+/**
+ * @brief internal I/O counters of the page ftl
+ */
+enum {
+	PAGE_FTL_STAT_HOST_WRITE = 0, /**< pages written by the host */
+	PAGE_FTL_STAT_HOST_READ, /**< pages read by the host */
+	PAGE_FTL_STAT_FLASH_WRITE, /**< pages programmed to the device */
+	PAGE_FTL_STAT_GC_COPY, /**< valid pages relocated by gc and wear */
+	PAGE_FTL_STAT_ERASE, /**< erased segments */
+	PAGE_FTL_STAT_RMW_READ, /**< reads of the read-modify-write */
+	PAGE_FTL_STAT_NR_COUNTERS,
 };
 
 /**
  * @brief segment information structure
  * @note
- * Segment number is same as block number
+ * Segment number is same as block number. The segment's counters are stored
+ * in the `struct page_ftl_segment_counter` and indexed by the segment number.
  */
 struct page_ftl_segment {
-	gint nr_free_pages;
-	gint nr_valid_pages;
-	gint is_gc;
-
 	uint64_t *use_bits; /**< contain the use page information */
 	GList *lpn_list; /**< lba_list which contains the valid data */
 };
 
+/**
+ * @brief counters of all segments (structure-of-arrays)
+ * @note
+ * Each array is indexed by the segment number. All arrays are carved from
+ * the one allocation, so scanning a counter touches the contiguous memory.
+ */
+struct page_ftl_segment_counter {
+	gint *nr_free_pages;
+	gint *nr_valid_pages;
+	gint *nr_erase; /**< number of erases which the segment experienced */
+	gint *nr_pending_writes; /**< allocated pages not in the `lpn_list` */
+};
+
+#define PAGE_FTL_NR_SEGMENT_COUNTERS                                           \
+	(sizeof(struct page_ftl_segment_counter) /                             \
+	 sizeof(gint *)) /**< arrays in the `struct page_ftl_segment_counter` */
+
+/**
+ * @brief free segment which is ordered by its erase count
+ */
+struct page_ftl_free_segment {
+	size_t segnum;
+	gint nr_erase; /**< erase count when the segment is pushed */
+	uint64_t seq; /**< push order which breaks the tie */
+};
+
+/**
+ * @brief min-heap which contains the free segments
+ * @note
+ * The root is the least erased segment. The segments which have the same
+ * erase count are popped in the pushed order.
+ */
+struct page_ftl_segment_queue {
+	struct page_ftl_free_segment *entries;
+	size_t nr_entries; /**< number of the queued segments */
+	size_t capacity;
+	uint64_t seq; /**< sequence of the next pushed segment */
+};
+
+struct page_ftl_sched_rq;
+
+/**
+ * @brief scheduling information of a chip
+ */
+struct page_ftl_sched_chip {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int is_busy; /**< the request on this chip is not completed yet */
+	int nr_waiting[PAGE_FTL_SCHED_NR_CLASSES];
+	int nr_bypass[PAGE_FTL_SCHED_NR_CLASSES]; /**< bypassed count by the
+						     higher priority classes */
+	struct page_ftl_sched_rq *free_rqs; /**< reusable request contexts */
+};
+
+/**
+ * @brief scheduler between the page ftl and the device
+ * @note
+ * Each chip arbitrates its waiting requests by the class priority. The lower
+ * classes are bounded by `PAGE_FTL_SCHED_MAX_BYPASS` and
+ * `PAGE_FTL_SCHED_MAX_DEFER` to prevent the starvation.
+ *
+ * The chip doesn't queue the requests. It only counts the waiters of each
+ * class, and the release wakes all of them by the broadcast. So, the class
+ * order is kept, but the requests of the same class are issued in no
+ * particular order (not FIFO).
+ */
+struct page_ftl_sched {
+	struct page_ftl_sched_chip *chips; /**< indexed by bus * nr_chips + chip */
+	size_t nr_bus;
+	size_t nr_chips;
+	gint nr_deferred_erase; /**< chips which deferred the erase */
+};
+
+/**
+ * @brief token bucket of the paced garbage collection
+ * @note
+ * Every member except `is_enabled` is protected by the `gc_mutex`.
+ */
+struct page_ftl_gc_pacer {
+	gint is_enabled;
+	double tokens; /**< number of pages which can be relocated now */
+	int is_urgent; /**< the free segments are under the minimum */
+	struct page_ftl_segment *victim; /**< segment which is being collected */
+};
+
+/**
+ * @brief erase count distribution which is updated by each erase
+ * @note
+ * Every member except `is_enabled` is protected by the `pgftl->mutex`. The
+ * minimum is recounted only when its last segment is erased, so each erase
+ * costs O(1) on average.
+ */
+struct page_ftl_wear {
+	gint is_enabled; /**< the gc thread runs the static wear leveling */
+	uint64_t min_erase;
+	uint64_t max_erase;
+	uint64_t total_erase;
+	uint64_t total_erase_sq; /**< sum of the squared erase counts */
+	size_t nr_min_segments; /**< segments which have the `min_erase` */
+	size_t nr_segments; /**< segments except the bad segments */
+	uint64_t checked_erase; /**< `total_erase` at the last check */
+};
+
+/**
+ * @brief local buses of the thread which writes to the page ftl
+ */
+struct page_ftl_local_node {
+	struct page_ftl *pgftl; /**< instance which the preference belongs to */
+	uint64_t page_mask; /**< pages of the local buses in a `use_bits` word */
+};
+
+/**
+ * @brief counters of the cpus which share the slot
+ *
+ * @note
+ * Each slot occupies its own cache line, so the cpus don't bounce the line.
+ */
+struct page_ftl_stat_slot {
+	uint64_t counts[PAGE_FTL_STAT_NR_COUNTERS];
+} __attribute__((aligned(64)));
+
 /**
  * @brief contain the page flash translation layer information
  */
 struct page_ftl {
 	uint32_t *trans_map; /**< page-level mapping table */
-	uint64_t alloc_segnum; /**< last allocated segment number */
+	uint64_t alloc_segnum[PAGE_FTL_NR_FRONTIERS]
+			     [PAGE_FTL_MAX_STRIPES]; /**< active segments of each
+							frontier */
+	size_t nr_stripes; /**< active segments which are written at once */
+	gint next_stripe; /**< round-robin counter of the host writes */
 	struct page_ftl_segment *segments;
+	struct page_ftl_segment_counter counter; /**< segments' counters */
+	uint64_t *bitmap_arena; /**< contains all segments' `use_bits` */
+	struct page_ftl_segment_queue free_segq; /**< erased segments */
 	struct device *dev;
+	struct page_ftl_sched sched; /**< dispatches the requests to the device */
 	pthread_mutex_t mutex;
 	pthread_mutex_t gc_mutex;
 	pthread_rwlock_t *bus_rwlock;
@@ -63,10 +253,45 @@ struct page_ftl {
 	pthread_rwlock_t rwlock;
 #endif
 	pthread_t gc_thread;
+	int is_gc_thread_running; /**< gc_thread must be joined by the close */
+	gint is_gc_thread_exit; /**< set to 1 to stop this instance's gc thread */
 	int o_flags;
 
 	GList *gc_list; /**< garbage collection target list */
 	uint64_t *gc_seg_bits; /**< to find segnum is in gc list or not */
+	struct page_ftl_gc_pacer pacer; /**< paces the gc by the host writes */
+	struct page_ftl_wear wear; /**< erase count distribution */
+	GList *local_nodes; /**< `struct page_ftl_local_node` of the threads */
+	pthread_key_t local_key; /**< the calling thread's local node entry */
+	int is_local_key_created;
+	struct page_ftl_stat_slot stat_slots[PAGE_FTL_STAT_NR_SLOTS];
+};
+
+/**
+ * @brief erase count distribution of the page ftl's segments
+ */
+struct page_ftl_wear_stat {
+	size_t nr_segments; /**< number of segments (except bad segments) */
+	uint64_t min_erase;
+	uint64_t max_erase;
+	uint64_t total_erase;
+	double avg_erase;
+	double stddev_erase;
+	size_t nr_free_segments; /**< number of the erased segments */
+};
+
+/**
+ * @brief snapshot of the internal I/O counters
+ */
+struct page_ftl_stat {
+	uint64_t host_write_pages;
+	uint64_t host_read_pages;
+	uint64_t flash_write_pages; /**< host writes and relocations */
+	uint64_t gc_copy_pages;
+	uint64_t nr_erase;
+	uint64_t rmw_read_pages;
+	uint64_t nr_deferred_erase; /**< chips which deferred the erase */
+	double waf; /**< flash written pages / host written pages */
 };
 
 /* page-interface.c */
@@ -75,13 +300,27 @@ int page_ftl_close(struct page_ftl *);
 
 ssize_t page_ftl_submit_request(struct page_ftl *, struct device_request *);
 ssize_t page_ftl_write(struct page_ftl *, struct device_request *);
+ssize_t page_ftl_write_frontier(struct page_ftl *, struct device_request *,
+				int frontier);
 ssize_t page_ftl_read(struct page_ftl *, struct device_request *);
+ssize_t page_ftl_read_class(struct page_ftl *, struct device_request *,
+			    int sched_class);
 
 int page_ftl_module_init(struct flash_device *, uint64_t flags);
+int page_ftl_module_init_with_device(struct flash_device *, struct device *);
 int page_ftl_module_exit(struct flash_device *);
 
 /* page-map.c */
-struct device_address page_ftl_get_free_page(struct page_ftl *);
+struct device_address page_ftl_get_free_page(struct page_ftl *, int frontier);
+size_t page_ftl_get_nr_stripes(struct device *);
+void page_ftl_set_placement(struct page_ftl *, struct device_address paddr);
+int page_ftl_set_local_node(struct page_ftl *, int node);
+uint64_t page_ftl_get_local_page_mask(struct page_ftl *);
+void page_ftl_release_local_node(void *local);
+void page_ftl_push_free_segment(struct page_ftl *, size_t segnum);
+uint64_t page_ftl_pop_free_segment(struct page_ftl *);
+uint64_t page_ftl_pop_worn_free_segment(struct page_ftl *);
+int page_ftl_is_active_segment(struct page_ftl *, size_t segnum);
 int page_ftl_update_map(struct page_ftl *, size_t sector, uint32_t ppn);
 
 /* page-core.c */
@@ -91,6 +330,47 @@ int page_ftl_segment_data_init(struct page_ftl *, struct page_ftl_segment *);
 ssize_t page_ftl_do_gc(struct page_ftl *);
 ssize_t page_ftl_gc_from_list(struct page_ftl *, struct device_request *,
 			      double gc_ratio);
+ssize_t page_ftl_gc_segment(struct page_ftl *, struct page_ftl_segment *,
+			    int frontier);
+int page_ftl_gc_pace_refill(struct page_ftl *);
+ssize_t page_ftl_gc_pace(struct page_ftl *);
+int page_ftl_gc_set_pacing(struct page_ftl *, int is_enabled);
+
+/* page-sched.c */
+int page_ftl_sched_init(struct page_ftl *);
+void page_ftl_sched_free(struct page_ftl *);
+ssize_t page_ftl_sched_submit(struct page_ftl *, struct device_request *,
+			      int sched_class);
+
+/* page-stat.c */
+void page_ftl_stat_reset(struct page_ftl *);
+int page_ftl_get_stat(struct page_ftl *, struct page_ftl_stat *);
+
+/* page-wear.c */
+void page_ftl_wear_init(struct page_ftl *);
+void page_ftl_wear_update(struct page_ftl *, size_t segnum);
+int page_ftl_wear_is_needed(struct page_ftl *);
+int page_ftl_set_wear_leveling(struct page_ftl *, int is_enabled);
+ssize_t page_ftl_static_wear_leveling(struct page_ftl *);
+int page_ftl_get_wear_stat(struct page_ftl *, struct page_ftl_wear_stat *);
+
+/**
+ * @brief add the value to the counter of the running cpu's slot
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param counter counter number (`PAGE_FTL_STAT_*`)
+ * @param value value which is added
+ */
+static inline void page_ftl_stat_add(struct page_ftl *pgftl, int counter,
+				     uint64_t value)
+{
+	int cpu = sched_getcpu();
+	struct page_ftl_stat_slot *slot;
+
+	slot = &pgftl->stat_slots[(size_t)(cpu < 0 ? 0 : cpu) %
+				  PAGE_FTL_STAT_NR_SLOTS];
+	__atomic_fetch_add(&slot->counts[counter], value, __ATOMIC_RELAXED);
+}
 
 static inline size_t page_ftl_get_map_size(struct page_ftl *pgftl)
 {
@@ -118,37 +398,22 @@ static inline size_t page_ftl_get_segment_number(struct page_ftl *pgftl,
 
 static inline size_t page_ftl_get_free_segments(struct page_ftl *pgftl)
 {
-	size_t free_segments;
-	size_t nr_segments, segnum;
-	gint nr_pages_per_segments;
-	struct page_ftl_segment *segment;
-
-	nr_segments = device_get_nr_segments(pgftl->dev);
-	nr_pages_per_segments = (gint)device_get_pages_per_segment(pgftl->dev);
-
-	free_segments = 0;
-	for (segnum = 0; segnum < nr_segments; segnum++) {
-		segment = &pgftl->segments[segnum];
-		if(segment->nr_free_pages == nr_pages_per_segments)	{
-			free_segments++;
-		}
-	}
-	return free_segments;
+	return pgftl->free_segq.nr_entries;
 }
 
 static inline size_t page_ftl_get_free_pages(struct page_ftl *pgftl)
 {
 	size_t free_pages;
 	size_t nr_segments, segnum;
-	struct page_ftl_segment *segment;
+	gint *nr_free_pages;
 
 	nr_segments = device_get_nr_segments(pgftl->dev);
+	nr_free_pages = pgftl->counter.nr_free_pages;
+	assert(NULL != nr_free_pages);
 
 	free_pages = 0;
 	for (segnum = 0; segnum < nr_segments; segnum++) {
-		segment = &pgftl->segments[segnum];
-		assert(NULL != segment);
-		free_pages += (size_t)g_atomic_int_get(&segment->nr_free_pages);
+		free_pages += (size_t)g_atomic_int_get(&nr_free_pages[segnum]);
 	}
 	return free_pages;
 }
@@ -0,0 +1,58 @@
+/**
+ * @file part.h
+ * @brief partition(namespace) layer's header file
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ */
+#ifndef PART_H
+#define PART_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <glib.h>
+
+#include "device.h"
+
+/**
+ * @brief information shared by the partitions of the one device
+ */
+struct part_shared {
+	struct device *parent; /**< device which is split by the partitions */
+	pthread_mutex_t mutex;
+	size_t nr_parts;
+	int nr_opened; /**< number of the partitions which open the parent */
+	int nr_refs; /**< number of the partitions which are not exited */
+};
+
+/**
+ * @brief structure for manage the partition
+ *
+ * @note
+ * Each partition has the disjoint segment range of the parent device
+ * (`base_segnum` ~ `base_segnum + nr_segments - 1`). The partition's segment
+ * number starts from 0, and it is converted to the parent's segment number
+ * before submitting the request.
+ */
+struct part {
+	struct part_shared *shared;
+	size_t id;
+	size_t base_segnum;
+	size_t nr_segments;
+	int o_flags;
+};
+
+int part_create(const uint64_t modnum, struct device **parts, size_t nr_parts);
+
+int part_open(struct device *, const char *name, int flags);
+ssize_t part_write(struct device *, struct device_request *);
+ssize_t part_read(struct device *, struct device_request *);
+int part_erase(struct device *, struct device_request *);
+int part_close(struct device *);
+int part_flush(struct device *);
+int part_get_bus_node(struct device *, size_t bus);
+
+int part_device_exit(struct device *);
+
+#endif
@@ -11,18 +11,147 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <glib.h>
+#include <pthread.h>
 #include <sys/time.h>
 
 #include "device.h"
 
+#define RAMDISK_HUGEPAGE_SIZE ((size_t)2 << 20) /**< 2MiB */
+
+#define RAMDISK_FILE_MAGIC "FTLRDISK"
+#define RAMDISK_FILE_HEADER_SIZE ((size_t)4096)
+
+/**
+ * @brief header of the persistent ramdisk's backing file
+ *
+ * @note
+ * The file contains the header, data, out-of-band area and used-page bitmap
+ * in this order. The data is stored in the bus-major order like the memory.
+ */
+struct ramdisk_file_header {
+	char magic[8];
+	uint64_t page_size;
+	uint64_t nr_pages;
+	uint64_t oob_size;
+	uint64_t is_clean; /**< 0 when the last process didn't close it */
+};
+
+/**
+ * @brief default NAND timing of the ramdisk (nanoseconds)
+ *
+ * @note
+ * These are used only when the timing emulation is enabled. You can change
+ * them by the compile flags (e.g., `-DRAMDISK_TIMING_READ_NS=60000`).
+ */
+#ifndef RAMDISK_TIMING_READ_NS
+#define RAMDISK_TIMING_READ_NS (50000) /**< tR */
+#endif
+
+#ifndef RAMDISK_TIMING_PROG_NS
+#define RAMDISK_TIMING_PROG_NS (500000) /**< tPROG */
+#endif
+
+#ifndef RAMDISK_TIMING_ERASE_NS
+#define RAMDISK_TIMING_ERASE_NS (3000000) /**< tBERS */
+#endif
+
+#ifndef RAMDISK_TIMING_XFER_NS
+#define RAMDISK_TIMING_XFER_NS (10000) /**< a page transfer on the channel */
+#endif
+
+#ifndef RAMDISK_TIMING_QUEUE_DEPTH
+#define RAMDISK_TIMING_QUEUE_DEPTH (128) /**< maximum in-flight requests */
+#endif
+
+/**
+ * @brief NAND timing parameters of the ramdisk
+ *
+ * @note
+ * You must set these before the `open`.
+ */
+struct ramdisk_timing {
+	int is_enabled; /**< 0 completes the requests immediately */
+	uint64_t read_ns;
+	uint64_t prog_ns;
+	uint64_t erase_ns;
+	uint64_t xfer_ns;
+	size_t queue_depth;
+};
+
+struct ramdisk_timing_entry;
+
+/**
+ * @brief requests which wait for their modeled completion time
+ * @note
+ * The `pending` is a min-heap of `queue_depth` entries, and the root is
+ * completed first.
+ */
+struct ramdisk_timing_queue {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond; /**< wake up the completion thread */
+	pthread_cond_t space; /**< wake up the submitters waiting for a slot */
+	struct ramdisk_timing_entry *pending; /**< ordered by completion time */
+	size_t nr_inflight; /**< number of the entries in the `pending` */
+	uint64_t seq; /**< sequence of the next submitted request */
+	int is_stop;
+
+	uint64_t *bus_busy_until; /**< channel's busy-until time */
+	uint64_t *chip_busy_until; /**< chip's busy-until time */
+};
+
+/**
+ * @brief per-bus request queue of the asynchronous ramdisk
+ */
+struct ramdisk_async_bus {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond; /**< wake up the worker */
+	pthread_cond_t idle; /**< wake up the drain */
+	GList *head;
+	GList *tail;
+	size_t nr_queued; /**< queued and executing requests */
+	int is_stop;
+	unsigned int seed; /**< random seed for the out-of-order completion */
+	struct device *dev;
+};
+
+/**
+ * @brief NUMA placement of the ramdisk's bus regions
+ */
+enum { RAMDISK_NUMA_NONE = 0, /**< the first touch decides the node */
+       RAMDISK_NUMA_LOCAL, /**< each bus region is bound to its node */
+       RAMDISK_NUMA_INTERLEAVE, /**< pages are interleaved over the nodes */
+};
+
 /**
  * @brief structure for manage the ramdisk
+ *
+ * @note
+ * The buffer is split to the bus regions (bus-major order), so each bus's
+ * pages are contiguous and can be placed on a NUMA node.
  */
 struct ramdisk {
 	size_t size;
 	char *buffer;
 	uint64_t *is_used;
 	int o_flags;
+
+	char *base; /**< mapping which contains the buffer, oob and is_used */
+	size_t map_size;
+	char *oob; /**< `DEVICE_OOB_SIZE` bytes for each page */
+	int is_persistent; /**< the open's name is the backing file */
+	int fd;
+
+	struct ramdisk_timing timing;
+	struct ramdisk_timing_queue *queue; /**< NULL when the timing is off */
+
+	int is_async; /**< worker threads process the requests */
+	int is_out_of_order; /**< workers pick the chips randomly */
+	struct ramdisk_async_bus *buses; /**< NULL when the async is off */
+
+	int numa_policy; /**< `RAMDISK_NUMA_*` (set before the `open`) */
+	int *bus_node; /**< node of each bus region (negative for unbound) */
 };
 
 int ramdisk_open(struct device *, const char *name, int flags);
@@ -30,6 +159,22 @@ ssize_t ramdisk_write(struct device *, struct device_request *);
 ssize_t ramdisk_read(struct device *, struct device_request *);
 int ramdisk_erase(struct device *, struct device_request *);
 int ramdisk_close(struct device *);
+int ramdisk_flush(struct device *);
+
+int ramdisk_execute(struct device *, struct device_request *);
+
+int ramdisk_timing_init(struct device *);
+int ramdisk_timing_submit(struct device *, struct device_request *);
+void ramdisk_timing_free(struct device *);
+
+int ramdisk_async_init(struct device *);
+int ramdisk_async_submit(struct device *, struct device_request *);
+void ramdisk_async_drain(struct device *);
+void ramdisk_async_free(struct device *);
+
+int ramdisk_numa_init(struct device *);
+int ramdisk_get_bus_node(struct device *, size_t bus);
+void ramdisk_numa_free(struct device *);
 
 int ramdisk_device_init(struct device *, uint64_t flags);
 int ramdisk_device_exit(struct device *);
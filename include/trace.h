@@ -0,0 +1,120 @@
+/**
+ * @file trace.h
+ * @brief compile-time optional tracepoints of the I/O path
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ * @note
+ * The tracepoints are compiled only with `USE_TRACE`. Each thread records
+ * the timestamps into its own ring buffer without the lock, and the rings
+ * are written by `trace_dump()`. `trace-report.out` makes the per-stage
+ * latency breakdown from the dumped file.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <time.h>
+
+#define TRACE_FILE_MAGIC "FTLTPNTS" /**< header of the dumped file */
+#define TRACE_FILE_MAGIC_SIZE (8)
+#define TRACE_RING_BITS (16) /**< each thread keeps the last 64K events */
+#define TRACE_RING_SIZE ((uint64_t)1 << TRACE_RING_BITS)
+
+/**
+ * @brief tracepoints of the I/O path
+ *
+ * @note
+ * Each tracepoint is recorded when the stage is finished. So, the stage's
+ * latency is the gap from the previous tracepoint of the same thread.
+ */
+enum {
+	TRACE_POINT_WRITE_BEGIN = 0, /**< host write page is submitted */
+	TRACE_POINT_READ_BEGIN, /**< host read page is submitted */
+	TRACE_POINT_GC_LOCK, /**< wait for the `gc_mutex` */
+	TRACE_POINT_GC_PACE, /**< paced garbage collection */
+	TRACE_POINT_ALLOC, /**< `page_ftl_get_free_page()` */
+	TRACE_POINT_RMW_READ, /**< read of the read-modify-write */
+	TRACE_POINT_MAP_LOOKUP, /**< mapping table lookup (with the `mutex`) */
+	TRACE_POINT_PREPARE, /**< buffer and request setup */
+	TRACE_POINT_DEVICE, /**< scheduler and device */
+	TRACE_POINT_LOCK, /**< wait for the `mutex` */
+	TRACE_POINT_METADATA, /**< mapping and segment update */
+	TRACE_POINT_END, /**< remains until the page is completed */
+	TRACE_NR_POINTS,
+};
+
+extern const char *trace_point_str[TRACE_NR_POINTS];
+
+/**
+ * @brief event of the tracepoint (also the dumped file's format)
+ */
+struct trace_event {
+	uint64_t timestamp; /**< CLOCK_MONOTONIC (ns) */
+	uint32_t tid; /**< sequence number of the recording thread */
+	uint16_t point;
+	uint16_t reserved;
+};
+
+int trace_dump(const char *path);
+
+#ifdef USE_TRACE
+/**
+ * @brief per-thread ring buffer of the tracepoints
+ */
+struct trace_ring {
+	struct trace_event events[TRACE_RING_SIZE];
+	uint64_t head; /**< number of the recorded tracepoints */
+	uint32_t tid;
+	struct trace_ring *next; /**< list of every thread's ring */
+};
+
+extern __thread struct trace_ring *trace_local_ring;
+struct trace_ring *trace_ring_alloc(void);
+
+/**
+ * @brief record the tracepoint to the running thread's ring buffer
+ *
+ * @param point tracepoint number (`TRACE_POINT_*`)
+ *
+ * @note
+ * The ring is allocated by the thread's first tracepoint. After that, this
+ * doesn't take any lock. The oldest event is overwritten when the ring is
+ * full.
+ */
+static inline void trace_point(int point)
+{
+	struct trace_ring *ring = trace_local_ring;
+	struct trace_event *event;
+	struct timespec now;
+
+	if (ring == NULL) {
+		ring = trace_ring_alloc();
+		if (ring == NULL) {
+			return;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	event = &ring->events[ring->head & (TRACE_RING_SIZE - 1)];
+	event->timestamp = (uint64_t)now.tv_sec * 1000000000ULL +
+			    (uint64_t)now.tv_nsec;
+	event->tid = ring->tid;
+	event->point = (uint16_t)point;
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+#else
+static inline void trace_point(int point)
+{
+	(void)point;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
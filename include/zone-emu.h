@@ -0,0 +1,153 @@
+/**
+ * @file zone-emu.h
+ * @brief emulated zoned block device which replaces the libzbd
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ *
+ * @note
+ * The emulator provides the part of the libzbd's interface which is used by
+ * the zone module. A regular file (e.g., on the tmpfs for the memory-backed
+ * device) keeps the zones' data, and the zones' write pointers and
+ * conditions are kept in the metadata area at the end of the file.
+ */
+#ifndef ZONE_EMU_H
+#define ZONE_EMU_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "device.h"
+
+#define ZONE_EMU_MAGIC "FTLZONED"
+#define ZONE_EMU_BLOCK_SIZE (4096)
+
+#ifndef ZONE_EMU_NR_ZONES
+#define ZONE_EMU_NR_ZONES (64)
+#endif
+
+#ifndef ZONE_EMU_ZONE_SIZE
+#define ZONE_EMU_ZONE_SIZE                                                     \
+	((uint64_t)DEVICE_PAGE_SIZE                                            \
+	 << (DEVICE_NR_BUS_BITS + DEVICE_NR_CHIPS_BITS + DEVICE_NR_PAGES_BITS))
+#endif
+
+#ifndef ZONE_EMU_ZONE_CAPACITY
+#define ZONE_EMU_ZONE_CAPACITY ZONE_EMU_ZONE_SIZE
+#endif
+
+#ifndef ZONE_EMU_MAX_OPEN_ZONES
+#define ZONE_EMU_MAX_OPEN_ZONES (14) /**< 0 means unlimited */
+#endif
+
+#define ZBD_VENDOR_ID_LENGTH (32)
+
+enum zbd_dev_model {
+	ZBD_DM_HOST_MANAGED = 1,
+	ZBD_DM_HOST_AWARE,
+	ZBD_DM_NOT_ZONED,
+};
+
+enum zbd_zone_type {
+	ZBD_ZONE_TYPE_CNV = 0x1,
+	ZBD_ZONE_TYPE_SWR = 0x2,
+	ZBD_ZONE_TYPE_SWP = 0x3,
+};
+
+enum zbd_zone_cond {
+	ZBD_ZONE_COND_NOT_WP = 0x0,
+	ZBD_ZONE_COND_EMPTY = 0x1,
+	ZBD_ZONE_COND_IMP_OPEN = 0x2,
+	ZBD_ZONE_COND_EXP_OPEN = 0x3,
+	ZBD_ZONE_COND_CLOSED = 0x4,
+	ZBD_ZONE_COND_READONLY = 0xD,
+	ZBD_ZONE_COND_FULL = 0xE,
+	ZBD_ZONE_COND_OFFLINE = 0xF,
+};
+
+enum zbd_report_option {
+	ZBD_RO_ALL = 0x00,
+};
+
+/**
+ * @brief device information (same layout as the libzbd's)
+ */
+struct zbd_info {
+	char vendor_id[ZBD_VENDOR_ID_LENGTH];
+	unsigned long long nr_sectors;
+	unsigned long long nr_lblocks;
+	unsigned long long nr_pblocks;
+	unsigned long long zone_size;
+	unsigned int zone_sectors;
+	unsigned int lblock_size;
+	unsigned int pblock_size;
+	unsigned int nr_zones;
+	unsigned int max_nr_open_zones;
+	unsigned int max_nr_active_zones;
+	unsigned int model;
+};
+
+/**
+ * @brief zone information (same layout as the libzbd's)
+ */
+struct zbd_zone {
+	unsigned long long start;
+	unsigned long long len;
+	unsigned long long capacity;
+	unsigned long long wp; /**< start + len for the full zone */
+	unsigned int flags;
+	unsigned int type;
+	unsigned int cond;
+	unsigned char reserved[20];
+};
+
+#define zbd_zone_type(z) ((z)->type)
+#define zbd_zone_cond(z) ((z)->cond)
+
+/**
+ * @brief geometry of the emulated device which is made by the `zbd_open()`
+ *
+ * @note
+ * The existing file which has another geometry is formatted again.
+ */
+struct zone_emu_config {
+	uint64_t nr_zones;
+	uint64_t zone_size; /**< bytes */
+	uint64_t zone_capacity; /**< writable bytes of a zone (<= zone_size) */
+	unsigned int max_open_zones;
+};
+
+/**
+ * @brief header of the metadata area
+ */
+struct zone_emu_header {
+	char magic[8];
+	uint64_t nr_zones;
+	uint64_t zone_size;
+	uint64_t zone_capacity;
+	uint64_t max_open_zones;
+	uint64_t nr_open_zones; /**< implicitly opened zones */
+};
+
+/**
+ * @brief write pointer and condition of the emulated zone
+ */
+struct zone_emu_zone {
+	uint64_t wp; /**< offset in the device (bytes) */
+	uint64_t cond; /**< `enum zbd_zone_cond` */
+};
+
+struct zone_emu_config *zone_emu_get_config(void);
+
+int zbd_open(const char *filename, int flags, struct zbd_info *info);
+void zbd_close(int fd);
+int zbd_list_zones(int fd, off_t ofst, off_t len, enum zbd_report_option ro,
+		   struct zbd_zone **zones, unsigned int *nr_zones);
+int zbd_reset_zones(int fd, off_t ofst, off_t len);
+int zbd_finish_zones(int fd, off_t ofst, off_t len);
+
+int zone_emu_advance(int fd, uint64_t offset, size_t count);
+ssize_t zone_emu_pwrite(int fd, const void *buffer, size_t count,
+			off_t offset);
+
+#endif
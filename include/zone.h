@@ -8,10 +8,30 @@
 #ifndef ZONE_H
 #define ZONE_H
 
-#include <libzbd/zbd.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <glib.h>
 
 #include "device.h"
 
+#ifdef ZONE_USE_EMULATION
+#include "zone-emu.h"
+#else
+#include <libzbd/zbd.h>
+#endif
+
+#ifndef ZONE_URING_QUEUE_DEPTH
+#define ZONE_URING_QUEUE_DEPTH (128) /**< maximum in-flight requests */
+#endif
+
+#ifndef ZONE_NR_BUFFERS
+#define ZONE_NR_BUFFERS (32) /**< bounce buffers of the unaligned writes */
+#endif
+
+#ifndef ZONE_URING_BATCH
+#define ZONE_URING_BATCH (16) /**< queued requests which force the submission */
+#endif
+
 /**
  * @brief containing a zone file's metadata
  */
@@ -19,6 +39,98 @@ struct zone_file_descriptor {
 	int fd;
 };
 
+/**
+ * @brief write state of a zone
+ */
+struct zone_state {
+	pthread_mutex_t mutex; /**< serializes the writes of the zone */
+	gint is_open; /**< the zone is written but not full */
+	gint is_stale; /**< the write pointer must be read from the device */
+};
+
+/**
+ * @brief pre-aligned bounce buffers of the unaligned writes
+ *
+ * @note
+ * The write file descriptor is opened with the `O_DIRECT`. The data which is
+ * allocated by the `device_alloc_buffer()` is written directly, and only the
+ * other data is copied to the buffer of this pool.
+ */
+struct zone_buffer_pool {
+	char *buffers;
+	int *free_buffers; /**< stack of the free buffer numbers */
+	size_t nr_free_buffers;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond; /**< wake up the writers waiting for a buffer */
+};
+
+/**
+ * @brief in-flight request of the io_uring
+ */
+struct zone_uring_slot {
+	struct device_request *request;
+	unsigned int flag; /**< the request can be reused before `end_rq` */
+	uint64_t offset; /**< position in the device (bytes) */
+	uint64_t zone_num;
+	char *buffer; /**< registered (fixed) buffer of this slot */
+	char *data; /**< buffer of the I/O (the `buffer` or the request's data) */
+	int result; /**< result of the completion (bytes or negative errno) */
+};
+
+/**
+ * @brief requests of a zone which wait for the zone's previous write
+ *
+ * @note
+ * The zone accepts the writes only at its write pointer. So, a write is
+ * submitted after the previous write of the zone is completed, and the read
+ * of the zone waits for the previous writes (read-after-write).
+ */
+struct zone_uring_zone {
+	GList *waiting; /**< slot numbers in the submitted order */
+	int is_writing;
+};
+
+/**
+ * @brief io_uring submission path of the zoned block device
+ */
+struct zone_uring {
+	int fd;
+	unsigned int nr_entries;
+	int is_fixed; /**< the slots' buffers are registered */
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	void *cq_ring;
+	size_t cq_ring_size;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	pthread_t thread; /**< completion reaping thread */
+	pthread_mutex_t mutex;
+	pthread_cond_t space; /**< wake up the submitters waiting for a slot */
+	pthread_cond_t idle; /**< wake up the drain */
+	size_t nr_pending; /**< prepared but not submitted entries */
+	size_t nr_submitted; /**< submitted but not completed entries */
+	int is_stop;
+	int is_running;
+
+	char *buffers;
+	struct zone_uring_slot *slots;
+	int *free_slots; /**< stack of the free slot numbers */
+	size_t nr_free_slots;
+	int *completed; /**< slot numbers which are reaped together */
+	struct zone_uring_zone *zones;
+};
+
 /**
  * @brief containing a zoned block device's metadata
  */
@@ -33,6 +145,15 @@ struct zone_meta {
 	struct zone_file_descriptor write;
 	struct zbd_info info;
 	struct zbd_zone *zones;
+	struct zone_state *states;
+	struct zone_buffer_pool pool;
+
+	int is_append; /**< the device decides the page of the write */
+	size_t max_open_zones; /**< 0 means unlimited */
+	gint nr_open_zones;
+
+	int is_uring; /**< submit the requests by the io_uring */
+	struct zone_uring *uring; /**< NULL when the io_uring is off */
 };
 
 int zone_open(struct device *, const char *name, int flags);
@@ -40,6 +161,14 @@ ssize_t zone_write(struct device *, struct device_request *);
 ssize_t zone_read(struct device *, struct device_request *);
 int zone_erase(struct device *, struct device_request *);
 int zone_close(struct device *);
+int zone_flush(struct device *);
+void zone_close_zone(struct device *, uint64_t zone_num);
+
+int zone_uring_init(struct device *);
+int zone_uring_submit(struct device *, struct device_request *,
+		      uint64_t zone_num);
+void zone_uring_drain(struct device *);
+void zone_uring_free(struct device *);
 
 int zone_device_init(struct device *, uint64_t flags);
 int zone_device_exit(struct device *);
@@ -51,4 +180,20 @@ static inline uint64_t zone_get_zone_number(struct device *dev,
 	return paddr.format.block;
 }
 
+/**
+ * @brief check the zone is written up to its capacity
+ *
+ * @param zone pointer of the zone
+ *
+ * @return 1 for the full zone, 0 for the others
+ *
+ * @note
+ * The capacity can be smaller than the zone size, and the device reports
+ * the full zone's write pointer as the end of the zone.
+ */
+static inline int zone_is_full(const struct zbd_zone *zone)
+{
+	return zone->wp >= zone->start + zone->capacity;
+}
+
 #endif
@@ -6,10 +6,14 @@
  * @date 2021-09-22
  */
 #include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "flash.h"
 #include "module.h"
 #include "page.h"
+#include "part.h"
 #include "log.h"
 
 /**
@@ -25,6 +29,17 @@ static int (*submodule_init[])(struct flash_device *, uint64_t) = {
 	/* [PAGE_FTL_MODULE] = */ page_ftl_module_init,
 };
 
+/**
+ * @brief submodule list table which uses the given device
+ *
+ * @note
+ * You must follow the submodule index in the `module.h`
+ */
+static int (*submodule_init_with_device[])(struct flash_device *,
+					   struct device *) = {
+	/* [PAGE_FTL_MODULE] = */ page_ftl_module_init_with_device,
+};
+
 /**
  * @brief generic initializer for initialize the module
  *
@@ -56,6 +71,72 @@ int module_init(const int modnum, struct flash_device **__flash, uint64_t flags)
 	return 0;
 }
 
+/**
+ * @brief initialize the modules on each partition of the one device
+ *
+ * @param modnum module number described in the `module.h`
+ * @param flashes array of the flash device pointer (will be allocated)
+ * @param nr_parts number of partitions
+ * @param flags flags for flash and device module number
+ *
+ * @return zero to success, error number to fail
+ *
+ * @note
+ * Each partition owns the disjoint segment range of the device, and each
+ * flash device has its own submodule instance. Deallocate each flash device by
+ * `module_exit()`; the device is deallocated with the last flash device.
+ */
+int module_init_partitions(const int modnum, struct flash_device **flashes,
+			   size_t nr_parts, uint64_t flags)
+{
+	struct device **parts;
+	size_t idx;
+	int err;
+
+	parts = (struct device **)malloc(sizeof(struct device *) * nr_parts);
+	if (parts == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	err = part_create(flags, parts, nr_parts);
+	if (err) {
+		pr_err("partition create failed\n");
+		free(parts);
+		return err;
+	}
+
+	memset(flashes, 0, sizeof(struct flash_device *) * nr_parts);
+	for (idx = 0; idx < nr_parts; idx++) {
+		err = flash_module_init(&flashes[idx], flags);
+		if (err) {
+			pr_err("flash initialize failed (part: %zu)\n", idx);
+			goto exception;
+		}
+		err = submodule_init_with_device[modnum](flashes[idx], parts[idx]);
+		parts[idx] = NULL; /**< the submodule owns the partition */
+		if (err) {
+			pr_err("submodule initialize failed (part: %zu)\n", idx);
+			goto exception;
+		}
+	}
+	pr_info("%zu partitions initialize success\n", nr_parts);
+	free(parts);
+	return 0;
+
+exception:
+	for (idx = 0; idx < nr_parts; idx++) {
+		if (flashes[idx]) {
+			module_exit(flashes[idx]);
+			flashes[idx] = NULL;
+		}
+		if (parts[idx]) {
+			device_module_exit(parts[idx]);
+		}
+	}
+	free(parts);
+	return err;
+}
+
 /**
  * @brief free resources in the flash module and submodule
  *
@@ -2,6 +2,7 @@
 #include "unity.h"
 
 #include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -88,10 +89,318 @@ void test_get_bits(void)
 	}
 }
 
+void test_find_bits_from_offset(void)
+{
+	const uint64_t nr_bits = 1000;
+	uint64_t *bits;
+	uint64_t i;
+	bits = (uint64_t *)malloc(BITS_TO_UINT64_ALIGN(nr_bits));
+	memset(bits, 0, BITS_TO_UINT64_ALIGN(nr_bits));
+	set_bit(bits, 3);
+	set_bit(bits, 130);
+	set_bit(bits, 999);
+	TEST_ASSERT_EQUAL_UINT(3, (uint)find_first_one_bit(bits, nr_bits, 0));
+	TEST_ASSERT_EQUAL_UINT(130,
+			       (uint)find_first_one_bit(bits, nr_bits, 4));
+	TEST_ASSERT_EQUAL_UINT(999,
+			       (uint)find_first_one_bit(bits, nr_bits, 131));
+	TEST_ASSERT_EQUAL_INT(-1, (int)find_first_one_bit(bits, 999, 131));
+	TEST_ASSERT_EQUAL_UINT(4, (uint)find_first_zero_bit(bits, nr_bits, 3));
+
+	for (i = 0; i < nr_bits; i++) {
+		set_bit(bits, i);
+	}
+	/**< bits after the bitmap's size must be ignored */
+	TEST_ASSERT_EQUAL_INT(-1, (int)find_first_zero_bit(bits, nr_bits, 0));
+	reset_bit(bits, 640);
+	TEST_ASSERT_EQUAL_UINT(640,
+			       (uint)find_first_zero_bit(bits, nr_bits, 0));
+	TEST_ASSERT_EQUAL_INT(-1,
+			      (int)find_first_zero_bit(bits, nr_bits, 641));
+	free(bits);
+}
+
+void test_count_bits(void)
+{
+	const uint64_t nr_bits = 4096;
+	uint64_t *bits;
+	char *setbit;
+	uint64_t i;
+
+	setbit = (char *)malloc((size_t)nr_bits);
+	bits = (uint64_t *)malloc(BITS_TO_UINT64_ALIGN(nr_bits));
+	memset(bits, 0, BITS_TO_UINT64_ALIGN(nr_bits));
+	srand((unsigned int)time(NULL));
+	for (i = 0; i < nr_bits; i++) {
+		setbit[i] = (char)(rand() % 2);
+		if (setbit[i]) {
+			set_bit(bits, i);
+		}
+	}
+	for (i = 0; i < 1000; i++) {
+		uint64_t start, end, pos, nr_ones;
+		start = (uint64_t)rand() % nr_bits;
+		end = start + (uint64_t)rand() % (nr_bits - start + 1);
+		nr_ones = 0;
+		for (pos = start; pos < end; pos++) {
+			nr_ones += (uint64_t)setbit[pos];
+		}
+		TEST_ASSERT_EQUAL_UINT(nr_ones,
+				       (uint)count_one_bits(bits, start, end));
+		TEST_ASSERT_EQUAL_UINT((end - start) - nr_ones,
+				       (uint)count_zero_bits(bits, start, end));
+	}
+	free(bits);
+	free(setbit);
+}
+
+/**
+ * @brief bit-by-bit search which was used before the word-level search
+ */
+static uint64_t legacy_find_first_zero_bit(uint64_t *bits, uint64_t size,
+					   uint64_t idx)
+{
+	while (idx < size) {
+		uint64_t bucket = bits[BITS_TO_UINT64(idx)];
+		if (bucket < (uint64_t)UINT64_MAX) {
+			uint64_t diff = 0;
+			for (diff = 0; diff < BITS_PER_UINT64; diff++) {
+				if ((bucket & (uint64_t)((uint64_t)0x1
+							 << diff)) == 0x0) {
+					break;
+				}
+			}
+			return idx + diff;
+		}
+		idx += BITS_PER_UINT64;
+	}
+	return BITS_NOT_FOUND;
+}
+
+static uint64_t get_elapsed_ns(struct timespec *start, struct timespec *end)
+{
+	return (uint64_t)(end->tv_sec - start->tv_sec) * 1000000000UL +
+	       (uint64_t)(end->tv_nsec - start->tv_nsec);
+}
+
+static void check_allocation_order(const uint64_t *pages, uint64_t nr_bits)
+{
+	uint64_t i;
+	for (i = 0; i < nr_bits; i++) {
+		TEST_ASSERT_EQUAL_UINT(i, (uint)pages[i]);
+	}
+}
+
+void test_find_bits_benchmark(void)
+{
+	const uint64_t nr_bits = 8192; /**< pages in a segment */
+	const int nr_loops = 20;
+	struct timespec start, end;
+	uint64_t legacy_ns, current_ns, claim_ns;
+	uint64_t *bits, *pages;
+	uint64_t i;
+	int loop;
+
+	bits = (uint64_t *)malloc(BITS_TO_UINT64_ALIGN(nr_bits));
+	pages = (uint64_t *)malloc(nr_bits * sizeof(uint64_t));
+
+	legacy_ns = 0;
+	current_ns = 0;
+	claim_ns = 0;
+	/**< the results are checked after the measurement */
+	for (loop = 0; loop < nr_loops; loop++) {
+		/**< emulate the page allocation of a segment */
+		memset(bits, 0, BITS_TO_UINT64_ALIGN(nr_bits));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < nr_bits; i++) {
+			pages[i] = legacy_find_first_zero_bit(bits, nr_bits, 0);
+			set_bit(bits, pages[i]);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		legacy_ns += get_elapsed_ns(&start, &end);
+		check_allocation_order(pages, nr_bits);
+
+		memset(bits, 0, BITS_TO_UINT64_ALIGN(nr_bits));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < nr_bits; i++) {
+			pages[i] = find_first_zero_bit(bits, nr_bits, 0);
+			set_bit(bits, pages[i]);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		current_ns += get_elapsed_ns(&start, &end);
+		check_allocation_order(pages, nr_bits);
+
+		/**< the page FTL's allocator claims the page without the lock */
+		memset(bits, 0, BITS_TO_UINT64_ALIGN(nr_bits));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < nr_bits; i++) {
+			pages[i] = claim_first_zero_bit(bits, nr_bits, 0);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		claim_ns += get_elapsed_ns(&start, &end);
+		check_allocation_order(pages, nr_bits);
+	}
+	printf("[find_first_zero_bit] legacy: %.2lf ns/op, current: %.2lf ns/op, claim: %.2lf ns/op"
+#ifdef BITS_USE_AVX2
+	       " (avx2)"
+#endif
+	       "\n",
+	       (double)legacy_ns / (double)(nr_bits * (uint64_t)nr_loops),
+	       (double)current_ns / (double)(nr_bits * (uint64_t)nr_loops),
+	       (double)claim_ns / (double)(nr_bits * (uint64_t)nr_loops));
+	free(pages);
+	free(bits);
+}
+
+void test_claim_bits_skip_words(void)
+{
+	const uint64_t nr_bits = 1000;
+	uint64_t *bits;
+	uint64_t i;
+
+	bits = (uint64_t *)malloc(BITS_TO_UINT64_ALIGN(nr_bits));
+	memset(bits, 0xFF, BITS_TO_UINT64_ALIGN(nr_bits));
+
+	/**< the free bit is found after many full words */
+	reset_bit(bits, 901);
+	reset_bit(bits, 5);
+	TEST_ASSERT_EQUAL_UINT(901,
+			       (uint)claim_first_zero_bit(bits, nr_bits, 6));
+	TEST_ASSERT_EQUAL_UINT(5, (uint)claim_first_zero_bit(bits, nr_bits, 0));
+	TEST_ASSERT_EQUAL_INT(-1, (int)claim_first_zero_bit(bits, nr_bits, 0));
+
+	/**< the word which is full only in the masked positions is skipped */
+	for (i = 0; i < nr_bits; i += 2) {
+		reset_bit(bits, i);
+	}
+	reset_bit(bits, 777);
+	TEST_ASSERT_EQUAL_UINT(777, (uint)claim_first_zero_bit_masked(
+					    bits, nr_bits,
+					    0xAAAAAAAAAAAAAAAAULL));
+	TEST_ASSERT_EQUAL_INT(-1, (int)claim_first_zero_bit_masked(
+					  bits, nr_bits,
+					  0xAAAAAAAAAAAAAAAAULL));
+	TEST_ASSERT_EQUAL_UINT(0, (uint)claim_first_zero_bit(bits, nr_bits, 0));
+	free(bits);
+}
+
+void test_atomic_bits(void)
+{
+	const uint64_t nr_bits = 200;
+	const uint64_t tail = (BITS_TO_UINT64(nr_bits) + 1) * BITS_PER_UINT64;
+	uint64_t *bits;
+	bits = (uint64_t *)malloc(BITS_TO_UINT64_ALIGN(nr_bits));
+	memset(bits, 0, BITS_TO_UINT64_ALIGN(nr_bits));
+
+	TEST_ASSERT_EQUAL_INT(0, test_and_set_bit(bits, 70));
+	TEST_ASSERT_EQUAL_INT(1, test_and_set_bit(bits, 70));
+	TEST_ASSERT_EQUAL_INT(1, atomic_get_bit(bits, 70));
+	TEST_ASSERT_EQUAL_INT(1, get_bit(bits, 70));
+	TEST_ASSERT_EQUAL_INT(1, test_and_reset_bit(bits, 70));
+	TEST_ASSERT_EQUAL_INT(0, test_and_reset_bit(bits, 70));
+	atomic_set_bit(bits, 199);
+	TEST_ASSERT_EQUAL_INT(1, get_bit(bits, 199));
+	atomic_reset_bit(bits, 199);
+	TEST_ASSERT_EQUAL_INT(0, get_bit(bits, 199));
+
+	TEST_ASSERT_EQUAL_UINT(0, (uint)claim_first_zero_bit(bits, nr_bits, 0));
+	TEST_ASSERT_EQUAL_UINT(1, (uint)claim_first_zero_bit(bits, nr_bits, 0));
+	TEST_ASSERT_EQUAL_UINT(67,
+			       (uint)claim_first_zero_bit(bits, nr_bits, 67));
+	TEST_ASSERT_EQUAL_UINT(68,
+			       (uint)claim_first_zero_bit(bits, nr_bits, 67));
+	TEST_ASSERT_EQUAL_UINT(2, (uint)claim_first_zero_bit(bits, nr_bits, 0));
+	while (claim_first_zero_bit(bits, nr_bits, 0) != BITS_NOT_FOUND)
+		;
+	TEST_ASSERT_EQUAL_UINT(nr_bits,
+			       (uint)count_one_bits(bits, 0, nr_bits));
+	/**< bits after the bitmap's size must not be claimed */
+	TEST_ASSERT_EQUAL_UINT(0, (uint)count_one_bits(bits, nr_bits, tail));
+
+	/**< only the odd positions (e.g., odd buses) are claimed */
+	memset(bits, 0, BITS_TO_UINT64_ALIGN(nr_bits));
+	set_bit(bits, 1);
+	TEST_ASSERT_EQUAL_UINT(3, (uint)claim_first_zero_bit_masked(
+					  bits, nr_bits, 0xAAAAAAAAAAAAAAAAULL));
+	while (claim_first_zero_bit_masked(bits, nr_bits,
+					   0xAAAAAAAAAAAAAAAAULL) !=
+	       BITS_NOT_FOUND)
+		;
+	TEST_ASSERT_EQUAL_UINT(nr_bits / 2,
+			       (uint)count_one_bits(bits, 0, nr_bits));
+	TEST_ASSERT_EQUAL_INT(0, get_bit(bits, 198));
+	TEST_ASSERT_EQUAL_UINT(0, (uint)count_one_bits(bits, nr_bits, tail));
+	free(bits);
+}
+
+#define NR_CLAIM_THREADS (4)
+#define NR_CLAIM_BITS (1 << 16)
+
+struct claim_parm {
+	uint64_t *bits;
+	uint64_t *claimed;
+	uint64_t nr_claimed;
+};
+
+static void *claim_thread(void *data)
+{
+	struct claim_parm *parm = (struct claim_parm *)data;
+	uint64_t bit;
+	parm->nr_claimed = 0;
+	while ((bit = claim_first_zero_bit(parm->bits, NR_CLAIM_BITS, 0)) !=
+	       BITS_NOT_FOUND) {
+		parm->claimed[parm->nr_claimed++] = bit;
+	}
+	return NULL;
+}
+
+void test_claim_bits_concurrent(void)
+{
+	struct claim_parm parm[NR_CLAIM_THREADS];
+	pthread_t threads[NR_CLAIM_THREADS];
+	uint64_t *bits, *owner;
+	uint64_t total;
+	int i;
+
+	bits = (uint64_t *)malloc(BITS_TO_UINT64_ALIGN(NR_CLAIM_BITS));
+	owner = (uint64_t *)malloc(BITS_TO_UINT64_ALIGN(NR_CLAIM_BITS));
+	memset(bits, 0, BITS_TO_UINT64_ALIGN(NR_CLAIM_BITS));
+	memset(owner, 0, BITS_TO_UINT64_ALIGN(NR_CLAIM_BITS));
+	for (i = 0; i < NR_CLAIM_THREADS; i++) {
+		parm[i].bits = bits;
+		parm[i].claimed =
+			(uint64_t *)malloc(NR_CLAIM_BITS * sizeof(uint64_t));
+		pthread_create(&threads[i], NULL, claim_thread, &parm[i]);
+	}
+	total = 0;
+	for (i = 0; i < NR_CLAIM_THREADS; i++) {
+		uint64_t j;
+		pthread_join(threads[i], NULL);
+		for (j = 0; j < parm[i].nr_claimed; j++) {
+			/**< each bit must be claimed by only one thread */
+			TEST_ASSERT_EQUAL_INT(
+				0, test_and_set_bit(owner, parm[i].claimed[j]));
+		}
+		total += parm[i].nr_claimed;
+		free(parm[i].claimed);
+	}
+	TEST_ASSERT_EQUAL_UINT(NR_CLAIM_BITS, (uint)total);
+	TEST_ASSERT_EQUAL_UINT(NR_CLAIM_BITS,
+			       (uint)count_one_bits(bits, 0, NR_CLAIM_BITS));
+	free(owner);
+	free(bits);
+}
+
 int main(void)
 {
 	UNITY_BEGIN();
 	RUN_TEST(test_bits);
 	RUN_TEST(test_get_bits);
+	RUN_TEST(test_find_bits_from_offset);
+	RUN_TEST(test_count_bits);
+	RUN_TEST(test_find_bits_benchmark);
+	RUN_TEST(test_atomic_bits);
+	RUN_TEST(test_claim_bits_skip_words);
+	RUN_TEST(test_claim_bits_concurrent);
 	return UNITY_END();
 }
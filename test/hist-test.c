@@ -0,0 +1,118 @@
+#include "hist.h"
+#include "unity.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_hist_index(void)
+{
+	size_t prev_index = 0;
+	uint64_t value;
+
+	TEST_ASSERT_TRUE(hist_get_index(UINT64_MAX) < HIST_NR_BUCKETS);
+	for (value = 0; value < (1 << 20); value++) {
+		size_t index = hist_get_index(value);
+		uint64_t middle = hist_get_value(index);
+		uint64_t error = middle > value ? middle - value : value - middle;
+		/**< index never decreases and the relative error is bounded */
+		TEST_ASSERT_TRUE(index >= prev_index);
+		TEST_ASSERT_TRUE(error * HIST_SUB_BUCKET_HALF <= value);
+		prev_index = index;
+	}
+}
+
+void test_hist_percentile(void)
+{
+	struct hist hist;
+	uint64_t value;
+
+	TEST_ASSERT_EQUAL_INT(0, hist_init(&hist));
+	TEST_ASSERT_EQUAL_UINT64(0, hist_percentile(&hist, 50.0));
+	for (value = 1; value <= 100000; value++) {
+		hist_record(&hist, value);
+	}
+	TEST_ASSERT_EQUAL_UINT64(100000, hist.total);
+	TEST_ASSERT_EQUAL_UINT64(1, hist.min);
+	TEST_ASSERT_EQUAL_UINT64(100000, hist.max);
+	TEST_ASSERT_UINT64_WITHIN(50000 / 50, 50000,
+				  hist_percentile(&hist, 50.0));
+	TEST_ASSERT_UINT64_WITHIN(99000 / 50, 99000,
+				  hist_percentile(&hist, 99.0));
+	TEST_ASSERT_EQUAL_UINT64(100000, hist_percentile(&hist, 100.0));
+	TEST_ASSERT_EQUAL_UINT64(1, hist_percentile(&hist, 0.0));
+	hist_free(&hist);
+}
+
+void test_hist_merge(void)
+{
+	struct hist hist[2], merged;
+	uint64_t value;
+
+	TEST_ASSERT_EQUAL_INT(0, hist_init(&hist[0]));
+	TEST_ASSERT_EQUAL_INT(0, hist_init(&hist[1]));
+	TEST_ASSERT_EQUAL_INT(0, hist_init(&merged));
+	for (value = 0; value < 1000; value++) {
+		hist_record(&hist[value % 2], value);
+	}
+	hist_merge(&merged, &hist[0]);
+	hist_merge(&merged, &hist[1]);
+	TEST_ASSERT_EQUAL_UINT64(1000, merged.total);
+	TEST_ASSERT_EQUAL_UINT64(0, merged.min);
+	TEST_ASSERT_EQUAL_UINT64(999, merged.max);
+	TEST_ASSERT_EQUAL_UINT64(999 * 1000 / 2, merged.sum);
+
+	hist_reset(&merged);
+	TEST_ASSERT_EQUAL_UINT64(0, merged.total);
+	hist_free(&merged);
+	hist_free(&hist[0]);
+	hist_free(&hist[1]);
+}
+
+void test_hist_diff(void)
+{
+	struct hist hist, prev, diff;
+	uint64_t value;
+
+	TEST_ASSERT_EQUAL_INT(0, hist_init(&hist));
+	TEST_ASSERT_EQUAL_INT(0, hist_init(&prev));
+	TEST_ASSERT_EQUAL_INT(0, hist_init(&diff));
+	for (value = 1; value <= 100; value++) {
+		hist_record(&hist, value);
+	}
+	hist_merge(&prev, &hist);
+	for (value = 1000; value < 1100; value++) {
+		hist_record(&hist, value);
+	}
+	hist_diff(&diff, &hist, &prev);
+	TEST_ASSERT_EQUAL_UINT64(100, diff.total);
+	TEST_ASSERT_EQUAL_UINT64((1000 + 1099) * 100 / 2, diff.sum);
+	TEST_ASSERT_UINT64_WITHIN(1099 / 32, 1000, diff.min);
+	TEST_ASSERT_UINT64_WITHIN(1099 / 32, 1099, diff.max);
+	TEST_ASSERT_UINT64_WITHIN(1050 / 32, 1050,
+				  hist_percentile(&diff, 50.0));
+
+	hist_diff(&diff, &hist, &hist);
+	TEST_ASSERT_EQUAL_UINT64(0, diff.total);
+	TEST_ASSERT_EQUAL_UINT64(0, hist_percentile(&diff, 99.0));
+	hist_free(&diff);
+	hist_free(&prev);
+	hist_free(&hist);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_hist_index);
+	RUN_TEST(test_hist_percentile);
+	RUN_TEST(test_hist_merge);
+	RUN_TEST(test_hist_diff);
+	return UNITY_END();
+}
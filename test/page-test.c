@@ -0,0 +1,763 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <glib.h>
+
+#include "module.h"
+#include "flash.h"
+#include "page.h"
+#include "device.h"
+#include "ramdisk.h"
+#include "unity.h"
+
+#define NR_INSTANCES (4)
+#define NR_IO_PAGES (4096)
+
+struct flash_device *flash[NR_INSTANCES];
+
+static gint nr_sched_done;
+static int sched_order[8]; /**< tags of the requests in the completion order */
+
+void setUp(void)
+{
+	int i;
+	for (i = 0; i < NR_INSTANCES; i++) {
+		flash[i] = NULL;
+		TEST_ASSERT_EQUAL_INT(0, module_init(PAGE_FTL_MODULE, &flash[i],
+						     RAMDISK_MODULE));
+		TEST_ASSERT_EQUAL_INT(0, flash[i]->f_op->open(flash[i], NULL,
+							      O_CREAT |
+								      O_RDWR));
+	}
+}
+
+void tearDown(void)
+{
+	int i;
+	for (i = 0; i < NR_INSTANCES; i++) {
+		TEST_ASSERT_NOT_NULL(flash[i]);
+		/**< this closes the page ftl and the device */
+		TEST_ASSERT_EQUAL_INT(0, module_exit(flash[i]));
+	}
+}
+
+/**
+ * @brief write the instance specific pattern
+ *
+ * @param dev pointer of the flash device
+ * @param page logical page number which is written
+ *
+ * @return 0 for success, -1 for the write failure
+ */
+static int write_page(struct flash_device *dev, size_t page)
+{
+	size_t buffer[DEVICE_PAGE_SIZE / sizeof(size_t)];
+
+	memset(buffer, 0, sizeof(buffer));
+	buffer[0] = (size_t)(uintptr_t)dev;
+	buffer[1] = page;
+	if (dev->f_op->write(dev, buffer, sizeof(buffer),
+			     (off_t)(page * sizeof(buffer))) !=
+	    (ssize_t)sizeof(buffer)) {
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief read back the instance specific pattern
+ *
+ * @param dev pointer of the flash device
+ * @param page logical page number which is read
+ *
+ * @return 0 for success, -1 for the read failure or the data mismatch
+ */
+static int read_page(struct flash_device *dev, size_t page)
+{
+	size_t buffer[DEVICE_PAGE_SIZE / sizeof(size_t)];
+
+	memset(buffer, 0, sizeof(buffer));
+	if (dev->f_op->read(dev, buffer, sizeof(buffer),
+			    (off_t)(page * sizeof(buffer))) !=
+	    (ssize_t)sizeof(buffer)) {
+		return -1;
+	}
+	if (buffer[0] != (size_t)(uintptr_t)dev || buffer[1] != page) {
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief read back the instance specific pattern
+ *
+ * @param data pointer of the flash device
+ *
+ * @return NULL for success, non-NULL for the data mismatch
+ */
+static void *verify_thread(void *data)
+{
+	struct flash_device *dev = (struct flash_device *)data;
+	size_t page;
+
+	for (page = 0; page < NR_IO_PAGES; page++) {
+		if (read_page(dev, page)) {
+			return dev;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief write and read back the instance specific pattern
+ *
+ * @param data pointer of the flash device
+ *
+ * @return NULL for success, non-NULL for the data mismatch
+ */
+static void *io_thread(void *data)
+{
+	struct flash_device *dev = (struct flash_device *)data;
+	size_t page;
+
+	for (page = 0; page < NR_IO_PAGES; page++) {
+		if (write_page(dev, page)) {
+			return dev;
+		}
+	}
+	return verify_thread(dev);
+}
+
+void test_concurrent_instances(void)
+{
+	pthread_t threads[NR_INSTANCES];
+	void *status;
+	int i;
+
+	for (i = 0; i < NR_INSTANCES; i++) {
+		TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL,
+							io_thread, flash[i]));
+	}
+	for (i = 0; i < NR_INSTANCES; i++) {
+		status = NULL;
+		pthread_join(threads[i], &status);
+		TEST_ASSERT_NULL(status);
+	}
+}
+
+void test_independent_gc_thread(void)
+{
+	struct page_ftl *pgftl[NR_INSTANCES];
+	int i;
+
+	for (i = 0; i < NR_INSTANCES; i++) {
+		pgftl[i] = (struct page_ftl *)flash[i]->f_private;
+		TEST_ASSERT_NOT_NULL(pgftl[i]);
+		TEST_ASSERT_EQUAL_INT(
+			0, g_atomic_int_get(&pgftl[i]->is_gc_thread_exit));
+	}
+
+	/**< closing an instance must not stop the other instances' gc */
+	TEST_ASSERT_EQUAL_INT(0, page_ftl_close(pgftl[0]));
+	TEST_ASSERT_EQUAL_INT(1,
+			      g_atomic_int_get(&pgftl[0]->is_gc_thread_exit));
+	for (i = 1; i < NR_INSTANCES; i++) {
+		TEST_ASSERT_EQUAL_INT(
+			0, g_atomic_int_get(&pgftl[i]->is_gc_thread_exit));
+	}
+	TEST_ASSERT_EQUAL_INT(0, flash[0]->f_op->open(flash[0], NULL,
+						      O_CREAT | O_RDWR));
+	TEST_ASSERT_NULL(io_thread(flash[0]));
+}
+
+void test_paced_gc(void)
+{
+	struct flash_device *dev = flash[0];
+	struct page_ftl *pgftl = (struct page_ftl *)dev->f_private;
+	size_t total_pages, pass;
+
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev, PAGE_FTL_IOCTL_GC_PACING,
+						  1));
+	/**< overwrite more than the device capacity without the gc thread */
+	total_pages = device_get_total_size(pgftl->dev) /
+		      device_get_page_size(pgftl->dev);
+	for (pass = 0; pass * NR_IO_PAGES < total_pages * 2; pass++) {
+		TEST_ASSERT_NULL(io_thread(dev));
+	}
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev, PAGE_FTL_IOCTL_GC_PACING,
+						  0));
+	TEST_ASSERT_NULL(pgftl->pacer.victim);
+	TEST_ASSERT_NULL(io_thread(dev));
+}
+
+void test_paced_gc_with_wear_leveling(void)
+{
+	struct flash_device *dev = flash[0];
+	struct page_ftl *pgftl = (struct page_ftl *)dev->f_private;
+	struct page_ftl_segment *victim;
+	size_t nr_pages, nr_segments, segnum, page, i;
+
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev, PAGE_FTL_IOCTL_GC_PACING,
+						  1));
+	/**< the random overwrites leave the valid pages in the victims */
+	nr_pages = device_get_total_size(pgftl->dev) /
+		   device_get_page_size(pgftl->dev) / 2;
+	for (page = 0; page < nr_pages; page++) {
+		TEST_ASSERT_EQUAL_INT(0, write_page(dev, page));
+	}
+	victim = NULL;
+	page = 0;
+	for (i = 0; i < nr_pages * 8; i++) {
+		page = (page * 1103515245 + 12345) % nr_pages;
+		TEST_ASSERT_EQUAL_INT(0, write_page(dev, page));
+		victim = pgftl->pacer.victim;
+		if (victim != NULL && victim->lpn_list != NULL) {
+			break;
+		}
+	}
+	TEST_ASSERT_NOT_NULL(victim);
+	TEST_ASSERT_NOT_NULL(victim->lpn_list);
+
+	/**< the victim looks like the coldest segment to the wear leveling */
+	nr_segments = device_get_nr_segments(pgftl->dev);
+	for (segnum = 0; segnum < nr_segments; segnum++) {
+		g_atomic_int_set(&pgftl->counter.nr_erase[segnum],
+				 PAGE_FTL_WEAR_THRESHOLD);
+	}
+	segnum = page_ftl_get_segment_number(pgftl, (uintptr_t)victim);
+	g_atomic_int_set(&pgftl->counter.nr_erase[segnum], 0);
+	pthread_mutex_lock(&pgftl->mutex);
+	page_ftl_wear_init(pgftl);
+	pthread_mutex_unlock(&pgftl->mutex);
+	TEST_ASSERT_TRUE(page_ftl_static_wear_leveling(pgftl) >= 0);
+
+	TEST_ASSERT_TRUE(victim == pgftl->pacer.victim);
+	TEST_ASSERT_EQUAL_INT(
+		0, g_atomic_int_get(&pgftl->counter.nr_erase[segnum]));
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev, PAGE_FTL_IOCTL_GC_PACING,
+						  0));
+	for (page = 0; page < nr_pages; page++) {
+		TEST_ASSERT_EQUAL_INT(0, read_page(dev, page));
+	}
+}
+
+static void sched_end_rq(struct device_request *request)
+{
+	gint idx = g_atomic_int_add(&nr_sched_done, 1);
+
+	sched_order[idx] = GPOINTER_TO_INT(request->rq_private);
+	free(request->data);
+	device_free_request(request);
+}
+
+/**
+ * @brief make the request to the first chip of the last segment
+ *
+ * @param pgftl pointer of the page FTL structure
+ * @param flag direction of the request
+ * @param page page number in the chip
+ * @param tag tag which is recorded when the request is completed
+ *
+ * @return allocated request
+ */
+static struct device_request *sched_alloc_request(struct page_ftl *pgftl,
+						  unsigned int flag,
+						  uint32_t page, int tag)
+{
+	struct device_request *request;
+	size_t page_size = device_get_page_size(pgftl->dev);
+
+	request = device_alloc_request(DEVICE_DEFAULT_REQUEST);
+	TEST_ASSERT_NOT_NULL(request);
+	request->flag = flag;
+	request->paddr.lpn = 0;
+	request->paddr.format.block =
+		((uint32_t)device_get_nr_segments(pgftl->dev) - 1) &
+		((1U << DEVICE_NR_BLOCKS_BITS) - 1);
+	request->paddr.format.page = page & ((1U << DEVICE_NR_PAGES_BITS) - 1);
+	request->data_len = flag == DEVICE_ERASE ? 0 : page_size;
+	request->data = flag == DEVICE_ERASE ? NULL :
+					       device_alloc_buffer(page_size);
+	request->rq_private = GINT_TO_POINTER(tag);
+	request->end_rq = sched_end_rq;
+	return request;
+}
+
+struct sched_job {
+	struct page_ftl *pgftl;
+	struct device_request *request;
+	int sched_class;
+};
+
+static void *sched_thread(void *data)
+{
+	struct sched_job *job = (struct sched_job *)data;
+	page_ftl_sched_submit(job->pgftl, job->request, job->sched_class);
+	return NULL;
+}
+
+/**
+ * @brief wait until the requests of the class are waiting for the chip
+ */
+static void sched_wait_class(struct page_ftl_sched_chip *chip,
+			     int sched_class, int nr_waiting)
+{
+	int is_waiting = 0;
+	while (!is_waiting) {
+		pthread_mutex_lock(&chip->mutex);
+		is_waiting = chip->nr_waiting[sched_class] == nr_waiting;
+		pthread_mutex_unlock(&chip->mutex);
+		sched_yield();
+	}
+}
+
+void test_static_wear_leveling(void)
+{
+	struct flash_device *dev = flash[0];
+	struct page_ftl *pgftl = (struct page_ftl *)dev->f_private;
+	struct page_ftl_wear_stat stat;
+	struct device_address paddr;
+	size_t nr_segments, segnum, cold;
+	uint64_t nr_erase, min_erase, max_erase, total_erase;
+
+	/**< the wear leveling is driven by hand without the gc thread */
+	g_atomic_int_set(&pgftl->is_gc_thread_exit, 1);
+	pthread_join(pgftl->gc_thread, NULL);
+	pgftl->is_gc_thread_running = 0;
+
+	TEST_ASSERT_NULL(io_thread(dev));
+	paddr.lpn = pgftl->trans_map[0];
+	cold = paddr.format.block; /**< full and not active */
+
+	/**< every segment except the cold one is worn */
+	nr_segments = device_get_nr_segments(pgftl->dev);
+	pthread_mutex_lock(&pgftl->mutex);
+	for (segnum = 0; segnum < nr_segments; segnum++) {
+		g_atomic_int_set(&pgftl->counter.nr_erase[segnum],
+				 segnum == cold ? 0 : PAGE_FTL_WEAR_THRESHOLD);
+	}
+	page_ftl_wear_init(pgftl);
+	pgftl->wear.checked_erase -= PAGE_FTL_WEAR_CHECK_ERASES;
+	pthread_mutex_unlock(&pgftl->mutex);
+
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev,
+						  PAGE_FTL_IOCTL_WEAR_LEVELING,
+						  0));
+	TEST_ASSERT_EQUAL_INT(0, page_ftl_wear_is_needed(pgftl));
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev,
+						  PAGE_FTL_IOCTL_WEAR_LEVELING,
+						  1));
+	TEST_ASSERT_EQUAL_INT(1, page_ftl_wear_is_needed(pgftl));
+	/**< the gap is checked again after the next erases */
+	TEST_ASSERT_EQUAL_INT(0, page_ftl_wear_is_needed(pgftl));
+
+	TEST_ASSERT_EQUAL_INT(1, page_ftl_static_wear_leveling(pgftl));
+	TEST_ASSERT_EQUAL_INT(1,
+			      g_atomic_int_get(&pgftl->counter.nr_erase[cold]));
+	TEST_ASSERT_NULL(verify_thread(dev));
+
+	/**< the kept distribution is same as the recounted one */
+	min_erase = UINT64_MAX;
+	max_erase = 0;
+	total_erase = 0;
+	for (segnum = 0; segnum < nr_segments; segnum++) {
+		nr_erase = (uint64_t)g_atomic_int_get(
+			&pgftl->counter.nr_erase[segnum]);
+		min_erase = MIN(min_erase, nr_erase);
+		max_erase = MAX(max_erase, nr_erase);
+		total_erase += nr_erase;
+	}
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev, PAGE_FTL_IOCTL_WEAR_STAT,
+						  &stat));
+	TEST_ASSERT_EQUAL_UINT64(nr_segments, stat.nr_segments);
+	TEST_ASSERT_EQUAL_UINT64(min_erase, stat.min_erase);
+	TEST_ASSERT_EQUAL_UINT64(max_erase, stat.max_erase);
+	TEST_ASSERT_EQUAL_UINT64(total_erase, stat.total_erase);
+	TEST_ASSERT_TRUE(stat.stddev_erase > 0);
+}
+
+void test_wear_leveling_closes_gap(void)
+{
+	struct flash_device *dev = flash[0];
+	struct page_ftl *pgftl = (struct page_ftl *)dev->f_private;
+	struct page_ftl_wear_stat stat;
+	struct device_address paddr;
+	size_t nr_segments, nr_free, segnum, cold, i;
+	uint64_t *segnums;
+	uint64_t gap;
+
+	g_atomic_int_set(&pgftl->is_gc_thread_exit, 1);
+	pthread_join(pgftl->gc_thread, NULL);
+	pgftl->is_gc_thread_running = 0;
+
+	TEST_ASSERT_NULL(io_thread(dev));
+	paddr.lpn = pgftl->trans_map[0];
+	cold = paddr.format.block;
+
+	/**< a free segment is worn like the others, and the rest are fresh */
+	nr_segments = device_get_nr_segments(pgftl->dev);
+	pthread_mutex_lock(&pgftl->mutex);
+	nr_free = page_ftl_get_free_segments(pgftl);
+	segnums = (uint64_t *)malloc(sizeof(uint64_t) * nr_free);
+	TEST_ASSERT_NOT_NULL(segnums);
+	for (i = 0; i < nr_free; i++) {
+		segnums[i] = page_ftl_pop_free_segment(pgftl);
+	}
+	for (segnum = 0; segnum < nr_segments; segnum++) {
+		g_atomic_int_set(&pgftl->counter.nr_erase[segnum],
+				 segnum == cold ? 0 : PAGE_FTL_WEAR_THRESHOLD);
+	}
+	for (i = 0; i < nr_free; i++) {
+		g_atomic_int_set(&pgftl->counter.nr_erase[segnums[i]],
+				 i == 0 ? PAGE_FTL_WEAR_THRESHOLD : 1);
+		page_ftl_push_free_segment(pgftl, (size_t)segnums[i]);
+	}
+	page_ftl_wear_init(pgftl);
+	pthread_mutex_unlock(&pgftl->mutex);
+	free(segnums);
+
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev, PAGE_FTL_IOCTL_WEAR_STAT,
+						  &stat));
+	gap = stat.max_erase - stat.min_erase;
+	TEST_ASSERT_EQUAL_INT(1, page_ftl_static_wear_leveling(pgftl));
+	TEST_ASSERT_NULL(verify_thread(dev));
+
+	/**< the cold data leaves the fresh segments to the hot data */
+	paddr.lpn = pgftl->trans_map[0];
+	TEST_ASSERT_EQUAL_INT(PAGE_FTL_WEAR_THRESHOLD,
+			      g_atomic_int_get(
+				      &pgftl->counter.nr_erase[paddr.format.block]));
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev, PAGE_FTL_IOCTL_WEAR_STAT,
+						  &stat));
+	TEST_ASSERT_TRUE(stat.max_erase - stat.min_erase < gap);
+}
+
+void test_gc_skips_pending_writes(void)
+{
+	struct flash_device *dev = flash[0];
+	struct page_ftl *pgftl = (struct page_ftl *)dev->f_private;
+	struct device_address paddr;
+	size_t segnum;
+
+	g_atomic_int_set(&pgftl->is_gc_thread_exit, 1);
+	pthread_join(pgftl->gc_thread, NULL);
+	pgftl->is_gc_thread_running = 0;
+
+	TEST_ASSERT_NULL(io_thread(dev));
+	paddr.lpn = pgftl->trans_map[0];
+	segnum = paddr.format.block;
+	/**< the invalidation puts the full segment in the gc list */
+	TEST_ASSERT_EQUAL_INT(0, write_page(dev, 0));
+	TEST_ASSERT_NOT_NULL(pgftl->gc_list);
+
+	/**< the write which is not in the `lpn_list` yet */
+	g_atomic_int_inc(&pgftl->counter.nr_pending_writes[segnum]);
+	TEST_ASSERT_EQUAL_INT(0, page_ftl_do_gc(pgftl));
+	TEST_ASSERT_EQUAL_INT(0,
+			      g_atomic_int_get(&pgftl->counter.nr_erase[segnum]));
+	TEST_ASSERT_TRUE(g_list_find(pgftl->gc_list,
+				     &pgftl->segments[segnum]) != NULL);
+
+	g_atomic_int_add(&pgftl->counter.nr_pending_writes[segnum], -1);
+	TEST_ASSERT_EQUAL_INT(0, page_ftl_do_gc(pgftl));
+	TEST_ASSERT_EQUAL_INT(1,
+			      g_atomic_int_get(&pgftl->counter.nr_erase[segnum]));
+	TEST_ASSERT_NULL(verify_thread(dev));
+}
+
+/**
+ * @brief get the local page mask of the calling thread
+ *
+ * @param data pointer of the flash device
+ *
+ * @return local page mask of the thread (casted to the pointer)
+ */
+static void *local_mask_thread(void *data)
+{
+	struct flash_device *dev = (struct flash_device *)data;
+	struct page_ftl *pgftl = (struct page_ftl *)dev->f_private;
+
+	return (void *)(uintptr_t)page_ftl_get_local_page_mask(pgftl);
+}
+
+/**
+ * @brief set the local node of the calling thread and exit
+ *
+ * @param data pointer of the flash device
+ *
+ * @return NULL for success, non-NULL for the ioctl failure
+ */
+static void *local_node_thread(void *data)
+{
+	struct flash_device *dev = (struct flash_device *)data;
+
+	if (dev->f_op->ioctl(dev, PAGE_FTL_IOCTL_LOCAL_NODE, 0)) {
+		return dev;
+	}
+	return local_mask_thread(dev) != NULL ? NULL : dev;
+}
+
+void test_local_node_per_instance(void)
+{
+	struct flash_device *dev = flash[0];
+	struct page_ftl *pgftl = (struct page_ftl *)dev->f_private;
+	struct ramdisk *ramdisk = (struct ramdisk *)pgftl->dev->d_private;
+	struct device_address paddr;
+	size_t nr_bus, bus, page;
+	pthread_t thread;
+	void *status;
+
+	/**< the even buses are placed on the node 0 */
+	nr_bus = pgftl->dev->info.nr_bus;
+	TEST_ASSERT_NOT_NULL(ramdisk->bus_node);
+	for (bus = 0; bus < nr_bus; bus++) {
+		ramdisk->bus_node[bus] = (int)(bus % 2);
+	}
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev,
+						  PAGE_FTL_IOCTL_LOCAL_NODE,
+						  0));
+	TEST_ASSERT_TRUE(local_mask_thread(dev) != NULL);
+
+	/**< the preference belongs to this thread and this instance */
+	TEST_ASSERT_NULL(local_mask_thread(flash[1]));
+	TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL,
+						local_mask_thread, dev));
+	status = dev;
+	pthread_join(thread, &status);
+	TEST_ASSERT_NULL(status);
+
+	for (page = 0; page < nr_bus; page++) {
+		TEST_ASSERT_EQUAL_INT(0, write_page(dev, page));
+		paddr.lpn = pgftl->trans_map[page];
+		TEST_ASSERT_EQUAL_INT(0, paddr.format.bus % 2);
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev,
+						  PAGE_FTL_IOCTL_LOCAL_NODE,
+						  -1));
+	TEST_ASSERT_NULL(local_mask_thread(dev));
+	TEST_ASSERT_NULL(pgftl->local_nodes);
+
+	/**< the entry of the exited thread is removed */
+	TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL,
+						local_node_thread, dev));
+	status = dev;
+	pthread_join(thread, &status);
+	TEST_ASSERT_NULL(status);
+	TEST_ASSERT_NULL(pgftl->local_nodes);
+}
+
+void test_sched_priority(void)
+{
+	struct flash_device *dev = flash[0];
+	struct page_ftl *pgftl = (struct page_ftl *)dev->f_private;
+	struct page_ftl_sched_chip *chip;
+	struct page_ftl_stat stat;
+	struct sched_job jobs[2];
+	pthread_t threads[2];
+	struct ramdisk *ramdisk;
+	size_t page_size;
+
+	/**< the long program time makes the chip's occupancy observable */
+	TEST_ASSERT_EQUAL_INT(0, page_ftl_close(pgftl));
+	ramdisk = (struct ramdisk *)pgftl->dev->d_private;
+	ramdisk->timing.is_enabled = 1;
+	ramdisk->timing.prog_ns = 50000000;
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->open(dev, NULL, O_CREAT | O_RDWR));
+	chip = &pgftl->sched.chips[0];
+	page_size = device_get_page_size(pgftl->dev);
+	g_atomic_int_set(&nr_sched_done, 0);
+
+	/**< the chip is busy until the write is completed */
+	TEST_ASSERT_EQUAL_INT(
+		page_size,
+		page_ftl_sched_submit(pgftl,
+				      sched_alloc_request(pgftl, DEVICE_WRITE,
+							  0, 0),
+				      PAGE_FTL_SCHED_WRITE));
+	TEST_ASSERT_EQUAL_INT(1, chip->is_busy);
+
+	/**< the read overtakes the write which waits before it */
+	jobs[0].pgftl = pgftl;
+	jobs[0].request = sched_alloc_request(pgftl, DEVICE_WRITE, 1, 1);
+	jobs[0].sched_class = PAGE_FTL_SCHED_WRITE;
+	TEST_ASSERT_EQUAL_INT(
+		0, pthread_create(&threads[0], NULL, sched_thread, &jobs[0]));
+	sched_wait_class(chip, PAGE_FTL_SCHED_WRITE, 1);
+	jobs[1].pgftl = pgftl;
+	jobs[1].request = sched_alloc_request(pgftl, DEVICE_READ, 0, 2);
+	jobs[1].sched_class = PAGE_FTL_SCHED_READ;
+	TEST_ASSERT_EQUAL_INT(
+		0, pthread_create(&threads[1], NULL, sched_thread, &jobs[1]));
+	sched_wait_class(chip, PAGE_FTL_SCHED_READ, 1);
+	TEST_ASSERT_EQUAL_INT(1, chip->is_busy);
+	pthread_join(threads[0], NULL);
+	pthread_join(threads[1], NULL);
+
+	/**< the erase is deferred by the busy chip */
+	TEST_ASSERT_EQUAL_INT(0, page_ftl_sched_submit(
+					 pgftl,
+					 sched_alloc_request(pgftl,
+							     DEVICE_ERASE, 0,
+							     3),
+					 PAGE_FTL_SCHED_ERASE));
+	while (g_atomic_int_get(&nr_sched_done) < 4) {
+		sched_yield();
+	}
+	TEST_ASSERT_EQUAL_INT(0, sched_order[0]);
+	TEST_ASSERT_EQUAL_INT(2, sched_order[1]);
+	TEST_ASSERT_EQUAL_INT(1, sched_order[2]);
+	TEST_ASSERT_EQUAL_INT(3, sched_order[3]);
+	TEST_ASSERT_EQUAL_INT(0, chip->is_busy);
+
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev, PAGE_FTL_IOCTL_STAT,
+						  &stat));
+	TEST_ASSERT_TRUE(stat.nr_deferred_erase >= 1);
+}
+
+void test_free_segment_wear(void)
+{
+	struct page_ftl *pgftl = (struct page_ftl *)flash[0]->f_private;
+	size_t nr_free, i;
+	uint64_t *segnums;
+	gint prev, nr_erase;
+
+	pthread_mutex_lock(&pgftl->mutex);
+	nr_free = page_ftl_get_free_segments(pgftl);
+	segnums = (uint64_t *)malloc(sizeof(uint64_t) * nr_free);
+	TEST_ASSERT_NOT_NULL(segnums);
+	for (i = 0; i < nr_free; i++) {
+		segnums[i] = page_ftl_pop_free_segment(pgftl);
+		TEST_ASSERT_TRUE(segnums[i] != PAGE_FTL_NO_SEGMENT);
+	}
+	TEST_ASSERT_TRUE(page_ftl_pop_free_segment(pgftl) ==
+			 PAGE_FTL_NO_SEGMENT);
+
+	/**< the later pushed segment has the less erase count */
+	for (i = 0; i < nr_free; i++) {
+		g_atomic_int_set(&pgftl->counter.nr_erase[segnums[i]],
+				 (gint)((nr_free - i) % 7));
+		page_ftl_push_free_segment(pgftl, (size_t)segnums[i]);
+	}
+	prev = 0;
+	for (i = 0; i < nr_free; i++) {
+		segnums[i] = page_ftl_pop_free_segment(pgftl);
+		nr_erase = g_atomic_int_get(
+			&pgftl->counter.nr_erase[segnums[i]]);
+		TEST_ASSERT_TRUE(prev <= nr_erase);
+		prev = nr_erase;
+	}
+	for (i = 0; i < nr_free; i++) {
+		g_atomic_int_set(&pgftl->counter.nr_erase[segnums[i]], 0);
+		page_ftl_push_free_segment(pgftl, (size_t)segnums[i]);
+	}
+	pthread_mutex_unlock(&pgftl->mutex);
+	free(segnums);
+}
+
+void test_partition_isolation(void)
+{
+	struct flash_device *parts[2];
+	struct page_ftl *pgftl[2];
+	pthread_t threads[2];
+	void *status;
+	int i;
+
+	TEST_ASSERT_EQUAL_INT(0, module_init_partitions(PAGE_FTL_MODULE, parts,
+							2, RAMDISK_MODULE));
+	for (i = 0; i < 2; i++) {
+		TEST_ASSERT_EQUAL_INT(0, parts[i]->f_op->open(parts[i], NULL,
+							      O_CREAT |
+								      O_RDWR));
+		pgftl[i] = (struct page_ftl *)parts[i]->f_private;
+	}
+	/**< each partition has the half of the parent's segments */
+	TEST_ASSERT_EQUAL_UINT64(device_get_nr_segments(pgftl[0]->dev),
+				 device_get_nr_segments(pgftl[1]->dev));
+
+	/**< same logical pages, but the data must not be mixed */
+	for (i = 0; i < 2; i++) {
+		TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL,
+							io_thread, parts[i]));
+	}
+	for (i = 0; i < 2; i++) {
+		status = NULL;
+		pthread_join(threads[i], &status);
+		TEST_ASSERT_NULL(status);
+	}
+
+	for (i = 0; i < 2; i++) {
+		TEST_ASSERT_EQUAL_INT(0, module_exit(parts[i]));
+	}
+}
+
+void test_io_counters(void)
+{
+	struct flash_device *dev = flash[0];
+	struct page_ftl_stat stat;
+	char buffer[DEVICE_PAGE_SIZE / 8];
+
+	TEST_ASSERT_NULL(io_thread(dev));
+	/**< the partial overwrite reads the previous page */
+	memset(buffer, 0xff, sizeof(buffer));
+	TEST_ASSERT_EQUAL_INT(sizeof(buffer),
+			      dev->f_op->write(dev, buffer, sizeof(buffer),
+					       (off_t)sizeof(buffer)));
+
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev, PAGE_FTL_IOCTL_STAT,
+						  &stat));
+	TEST_ASSERT_EQUAL_UINT64(NR_IO_PAGES + 1, stat.host_write_pages);
+	TEST_ASSERT_EQUAL_UINT64(NR_IO_PAGES, stat.host_read_pages);
+	TEST_ASSERT_EQUAL_UINT64(1, stat.rmw_read_pages);
+	TEST_ASSERT_EQUAL_UINT64(stat.host_write_pages + stat.gc_copy_pages,
+				 stat.flash_write_pages);
+	TEST_ASSERT_TRUE(stat.waf >= 1.0);
+}
+
+void test_subpage_overwrite(void)
+{
+	struct flash_device *dev = flash[0];
+	struct page_ftl_stat stat;
+	char page[DEVICE_PAGE_SIZE];
+	char expected[DEVICE_PAGE_SIZE];
+	size_t part = DEVICE_PAGE_SIZE / 4;
+
+	memset(page, 0xa5, sizeof(page));
+	TEST_ASSERT_EQUAL_INT(sizeof(page),
+			      dev->f_op->write(dev, page, sizeof(page), 0));
+	/**< the sub-page write at the page's start keeps the rest */
+	memset(page, 0x5a, part);
+	TEST_ASSERT_EQUAL_INT(part, dev->f_op->write(dev, page, part, 0));
+	memcpy(expected, page, sizeof(expected));
+
+	memset(page, 0, sizeof(page));
+	TEST_ASSERT_EQUAL_INT(sizeof(page),
+			      dev->f_op->read(dev, page, sizeof(page), 0));
+	TEST_ASSERT_EQUAL_MEMORY(expected, page, sizeof(page));
+
+	TEST_ASSERT_EQUAL_INT(0, dev->f_op->ioctl(dev, PAGE_FTL_IOCTL_STAT,
+						  &stat));
+	TEST_ASSERT_EQUAL_UINT64(1, stat.rmw_read_pages);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_concurrent_instances);
+	RUN_TEST(test_independent_gc_thread);
+	RUN_TEST(test_paced_gc);
+	RUN_TEST(test_paced_gc_with_wear_leveling);
+	RUN_TEST(test_static_wear_leveling);
+	RUN_TEST(test_wear_leveling_closes_gap);
+	RUN_TEST(test_gc_skips_pending_writes);
+	RUN_TEST(test_local_node_per_instance);
+	RUN_TEST(test_sched_priority);
+	RUN_TEST(test_free_segment_wear);
+	RUN_TEST(test_partition_isolation);
+	RUN_TEST(test_io_counters);
+	RUN_TEST(test_subpage_overwrite);
+	return UNITY_END();
+}
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include "ramdisk.h"
 #include "device.h"
@@ -39,6 +40,7 @@ void test_full_write(void)
 	size_t total_pages;
 
 	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, NULL, O_CREAT | O_RDWR));
+	memset(&request, 0, sizeof(struct device_request));
 	page_size = device_get_page_size(dev);
 	total_pages = device_get_total_pages(dev);
 
@@ -85,6 +87,7 @@ void test_overwrite(void)
 	size_t total_pages;
 
 	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, NULL, O_CREAT | O_RDWR));
+	memset(&request, 0, sizeof(struct device_request));
 	page_size = device_get_page_size(dev);
 	total_pages = device_get_total_pages(dev);
 	buffer = (char *)malloc(page_size);
@@ -128,8 +131,10 @@ void test_erase(void)
 	size_t nr_segments;
 	size_t nr_pages_per_segment;
 	uint16_t segnum;
+	size_t i;
 
 	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, NULL, O_CREAT | O_RDWR));
+	memset(&request, 0, sizeof(struct device_request));
 	page_size = device_get_page_size(dev);
 	total_pages = device_get_total_pages(dev);
 	buffer = (char *)malloc(page_size);
@@ -159,6 +164,19 @@ void test_erase(void)
 		TEST_ASSERT_EQUAL_INT(0, dev->d_op->erase(dev, &request));
 	};
 
+	/**< the erased page must be read as zero */
+	addr.lpn = (uint32_t)total_pages / 2;
+	memset(buffer, 0xff, page_size);
+	request.paddr = addr;
+	request.data_len = page_size;
+	request.end_rq = NULL;
+	request.flag = DEVICE_READ;
+	request.data = buffer;
+	TEST_ASSERT_EQUAL_INT(request.data_len, dev->d_op->read(dev, &request));
+	for (i = 0; i < page_size; i++) {
+		TEST_ASSERT_EQUAL_INT(0, buffer[i]);
+	}
+
 	nr_pages_per_segment = device_get_pages_per_segment(dev);
 	for (addr.lpn = 0; addr.lpn < total_pages - nr_pages_per_segment;
 	     addr.lpn++) {
@@ -207,6 +225,7 @@ void test_end_rq_works(void)
 	size_t nr_segments;
 
 	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, NULL, O_CREAT | O_RDWR));
+	memset(&request, 0, sizeof(struct device_request));
 	page_size = device_get_page_size(dev);
 	total_pages = device_get_total_pages(dev);
 	nr_segments = device_get_nr_segments(dev);
@@ -275,6 +294,224 @@ void test_end_rq_works(void)
 	free(is_check);
 }
 
+static int nr_completed;
+
+static void timing_end_rq(struct device_request *request)
+{
+	/**< the completion thread calls this in the completion time order */
+	request->sector = (size_t)g_atomic_int_add(&nr_completed, 1);
+	pthread_mutex_lock(&request->mutex);
+	g_atomic_int_set(&request->is_finish, 1);
+	pthread_cond_signal(&request->cond);
+	pthread_mutex_unlock(&request->mutex);
+}
+
+static uint64_t timing_wait(struct device_request *request)
+{
+	struct timespec now;
+
+	pthread_mutex_lock(&request->mutex);
+	while (g_atomic_int_get(&request->is_finish) == 0) {
+		pthread_cond_wait(&request->cond, &request->mutex);
+	}
+	pthread_mutex_unlock(&request->mutex);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)(now.tv_sec - request->begin.tv_sec) * 1000000000ULL +
+	       (uint64_t)(now.tv_nsec - request->begin.tv_nsec);
+}
+
+void test_timing(void)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	struct ramdisk_timing *timing = &ramdisk->timing;
+	struct device_request *requests[4];
+	struct timespec begin;
+	char *buffer;
+	size_t page_size;
+	int i;
+
+	timing->is_enabled = 1;
+	timing->read_ns = 2000000;
+	timing->prog_ns = 4000000;
+	timing->erase_ns = 8000000;
+	timing->xfer_ns = 1000000;
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, NULL, O_CREAT | O_RDWR));
+	TEST_ASSERT_NOT_NULL(ramdisk->queue);
+	page_size = device_get_page_size(dev);
+	buffer = (char *)malloc(page_size * 4);
+	TEST_ASSERT_NOT_NULL(buffer);
+
+	/**< 0, 1: same chip / 2: other bus / 3: same bus, after the read 0 */
+	g_atomic_int_set(&nr_completed, 0);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < 4; i++) {
+		requests[i] = device_alloc_request(DEVICE_DEFAULT_REQUEST);
+		TEST_ASSERT_NOT_NULL(requests[i]);
+		requests[i]->flag = DEVICE_READ;
+		requests[i]->data = &buffer[page_size * (size_t)i];
+		requests[i]->data_len = page_size;
+		requests[i]->paddr.lpn = 0;
+		requests[i]->end_rq = timing_end_rq;
+		requests[i]->begin = begin;
+	}
+	requests[1]->paddr.format.page = 1;
+	requests[2]->paddr.format.bus = 1;
+	requests[3]->paddr.format.page = 2;
+	requests[3]->paddr.format.block = 1;
+	for (i = 0; i < 3; i++) {
+		TEST_ASSERT_EQUAL_INT(page_size,
+				      dev->d_op->read(dev, requests[i]));
+	}
+
+	/**< tR + transfer, and the same chip waits for the previous one */
+	TEST_ASSERT_GREATER_OR_EQUAL(3000000, timing_wait(requests[0]));
+	TEST_ASSERT_GREATER_OR_EQUAL(6000000, timing_wait(requests[1]));
+	TEST_ASSERT_GREATER_OR_EQUAL(3000000, timing_wait(requests[2]));
+	TEST_ASSERT_LESS_THAN(2, requests[2]->sector);
+	TEST_ASSERT_EQUAL_UINT(2, requests[1]->sector);
+
+	/**< the erase occupies every chip */
+	requests[0]->flag = DEVICE_ERASE;
+	requests[0]->paddr.lpn = 0;
+	g_atomic_int_set(&requests[0]->is_finish, 0);
+	clock_gettime(CLOCK_MONOTONIC, &requests[0]->begin);
+	requests[3]->begin = requests[0]->begin;
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->erase(dev, requests[0]));
+	TEST_ASSERT_EQUAL_INT(page_size, dev->d_op->read(dev, requests[3]));
+	TEST_ASSERT_GREATER_OR_EQUAL(8000000, timing_wait(requests[0]));
+	TEST_ASSERT_GREATER_OR_EQUAL(11000000, timing_wait(requests[3]));
+
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->close(dev));
+	TEST_ASSERT_NULL(ramdisk->queue);
+	for (i = 0; i < 4; i++) {
+		device_free_request(requests[i]);
+	}
+	free(buffer);
+}
+
+static void async_end_rq(struct device_request *request)
+{
+	(void)request;
+	g_atomic_int_inc(&nr_completed);
+}
+
+void test_async(void)
+{
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	struct device_request *requests, erase_rq;
+	char *buffer;
+	size_t page_size, nr_pages, i;
+
+	ramdisk->is_async = 1;
+	ramdisk->is_out_of_order = 1;
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, NULL, O_CREAT | O_RDWR));
+	TEST_ASSERT_NOT_NULL(ramdisk->buses);
+	page_size = device_get_page_size(dev);
+	nr_pages = device_get_pages_per_segment(dev) * 4;
+
+	/**< write and read back each page without waiting for the write */
+	buffer = (char *)malloc(page_size * nr_pages * 2);
+	TEST_ASSERT_NOT_NULL(buffer);
+	memset(buffer, 0, page_size * nr_pages * 2);
+	requests = (struct device_request *)malloc(
+		sizeof(struct device_request) * nr_pages * 2);
+	TEST_ASSERT_NOT_NULL(requests);
+	memset(requests, 0, sizeof(struct device_request) * nr_pages * 2);
+
+	g_atomic_int_set(&nr_completed, 0);
+	for (i = 0; i < nr_pages * 2; i++) {
+		struct device_request *request = &requests[i];
+		request->paddr.lpn = (uint32_t)(i / 2);
+		request->flag = i % 2 ? DEVICE_READ : DEVICE_WRITE;
+		request->data = &buffer[i * page_size];
+		request->data_len = page_size;
+		request->end_rq = async_end_rq;
+		if (request->flag == DEVICE_WRITE) {
+			memcpy(request->data, &request->paddr.lpn,
+			       sizeof(uint32_t));
+			TEST_ASSERT_EQUAL_INT(page_size,
+					      dev->d_op->write(dev, request));
+		} else {
+			TEST_ASSERT_EQUAL_INT(page_size,
+					      dev->d_op->read(dev, request));
+		}
+	}
+
+	/**< the erase processes the queued requests first */
+	memset(&erase_rq, 0, sizeof(struct device_request));
+	erase_rq.flag = DEVICE_ERASE;
+	erase_rq.paddr.format.block = 4;
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->erase(dev, &erase_rq));
+	TEST_ASSERT_EQUAL_INT(nr_pages * 2, g_atomic_int_get(&nr_completed));
+	for (i = 0; i < nr_pages; i++) {
+		TEST_ASSERT_EQUAL_UINT32(i, *(uint32_t *)requests[i * 2 + 1].data);
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->close(dev));
+	TEST_ASSERT_NULL(ramdisk->buses);
+	free(requests);
+	free(buffer);
+}
+
+void test_persistent(void)
+{
+	const char *path = "./ramdisk-test.img";
+	struct ramdisk *ramdisk = (struct ramdisk *)dev->d_private;
+	struct device_request request;
+	char *buffer, oob[DEVICE_OOB_SIZE];
+	size_t page_size, nr_pages;
+	uint32_t lpn;
+
+	ramdisk->is_persistent = 1;
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, path,
+						 O_CREAT | O_RDWR | O_TRUNC));
+	memset(&request, 0, sizeof(struct device_request));
+	page_size = device_get_page_size(dev);
+	nr_pages = device_get_pages_per_segment(dev) * 2;
+	buffer = (char *)malloc(page_size);
+	TEST_ASSERT_NOT_NULL(buffer);
+
+	for (lpn = 0; lpn < nr_pages; lpn++) {
+		memset(buffer, (int)lpn, page_size);
+		memset(oob, 0, DEVICE_OOB_SIZE);
+		memcpy(oob, &lpn, sizeof(uint32_t));
+		request.paddr.lpn = lpn;
+		request.flag = DEVICE_WRITE;
+		request.data = buffer;
+		request.data_len = page_size;
+		request.oob = oob;
+		TEST_ASSERT_EQUAL_INT(page_size, dev->d_op->write(dev, &request));
+	}
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->flush(dev));
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->close(dev));
+
+	/**< the data, out-of-band area and used pages survive the reopen */
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, path, O_RDWR));
+	for (lpn = 0; lpn < nr_pages; lpn++) {
+		memset(oob, 0xff, DEVICE_OOB_SIZE);
+		request.paddr.lpn = lpn;
+		request.flag = DEVICE_READ;
+		TEST_ASSERT_EQUAL_INT(page_size, dev->d_op->read(dev, &request));
+		TEST_ASSERT_EQUAL_INT((char)lpn, buffer[page_size - 1]);
+		TEST_ASSERT_EQUAL_UINT32(lpn, *(uint32_t *)oob);
+	}
+	request.paddr.lpn = 0;
+	request.flag = DEVICE_WRITE;
+	TEST_ASSERT_EQUAL_INT(-EINVAL, dev->d_op->write(dev, &request));
+
+	request.paddr.lpn = 0;
+	request.flag = DEVICE_ERASE;
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->erase(dev, &request));
+	request.flag = DEVICE_READ;
+	TEST_ASSERT_EQUAL_INT(page_size, dev->d_op->read(dev, &request));
+	TEST_ASSERT_EQUAL_INT(0, buffer[page_size - 1]);
+	TEST_ASSERT_EQUAL_UINT32(0, *(uint32_t *)&oob[sizeof(uint32_t)]);
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->close(dev));
+
+	free(buffer);
+	unlink(path);
+}
+
 int main(void)
 {
 	UNITY_BEGIN();
@@ -283,5 +520,8 @@ int main(void)
 	RUN_TEST(test_overwrite);
 	RUN_TEST(test_erase);
 	RUN_TEST(test_end_rq_works);
+	RUN_TEST(test_timing);
+	RUN_TEST(test_async);
+	RUN_TEST(test_persistent);
 	return UNITY_END();
 }
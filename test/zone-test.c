@@ -1,10 +1,17 @@
+#include <errno.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "device.h"
 #include "zone.h"
 #include "unity.h"
 
+#ifdef ZONE_USE_EMULATION
+#define ZBD_FILE_NAME "./zone-test.img"
+#else
 #define ZBD_FILE_NAME "/dev/nvme0n2"
+#endif
 
 // #define WRITE_PAGE_SIZE(x) (device_get_total_pages(x))
 #define WRITE_PAGE_SIZE(x) (device_get_pages_per_segment(x) * 5)
@@ -282,6 +289,343 @@ void test_end_rq_works(void)
 	free(is_check);
 }
 
+static gint nr_completed;
+
+static void uring_end_rq(struct device_request *request)
+{
+	(void)request;
+	g_atomic_int_inc(&nr_completed);
+}
+
+void test_uring(void)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct device_request *requests;
+	char *buffer;
+	size_t page_size, nr_pages, i;
+
+	meta->is_uring = 1;
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, ZBD_FILE_NAME,
+						 O_CREAT | O_RDWR));
+	TEST_ASSERT_NOT_NULL(meta->uring);
+	page_size = device_get_page_size(dev);
+	nr_pages = device_get_pages_per_segment(dev) * 3;
+
+	/**< write and read back each page without waiting for the write */
+	buffer = (char *)malloc(page_size * nr_pages * 2);
+	TEST_ASSERT_NOT_NULL(buffer);
+	memset(buffer, 0, page_size * nr_pages * 2);
+	requests = (struct device_request *)malloc(
+		sizeof(struct device_request) * nr_pages * 2);
+	TEST_ASSERT_NOT_NULL(requests);
+	memset(requests, 0, sizeof(struct device_request) * nr_pages * 2);
+
+	g_atomic_int_set(&nr_completed, 0);
+	for (i = 0; i < nr_pages * 2; i++) {
+		struct device_request *request = &requests[i];
+		request->paddr.lpn = (uint32_t)(i / 2);
+		request->flag = i % 2 ? DEVICE_READ : DEVICE_WRITE;
+		request->data = &buffer[i * page_size];
+		request->data_len = page_size;
+		request->end_rq = uring_end_rq;
+		if (request->flag == DEVICE_WRITE) {
+			memcpy(request->data, &request->paddr.lpn,
+			       sizeof(uint32_t));
+			TEST_ASSERT_EQUAL_INT(page_size,
+					      dev->d_op->write(dev, request));
+		} else {
+			TEST_ASSERT_EQUAL_INT(page_size,
+					      dev->d_op->read(dev, request));
+		}
+	}
+
+	/**< the flush waits for the in-flight requests */
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->flush(dev));
+	TEST_ASSERT_EQUAL_INT(nr_pages * 2, g_atomic_int_get(&nr_completed));
+	for (i = 0; i < nr_pages; i++) {
+		TEST_ASSERT_EQUAL_UINT32(i, *(uint32_t *)requests[i * 2 + 1].data);
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->close(dev));
+	TEST_ASSERT_NULL(meta->uring);
+	free(requests);
+	free(buffer);
+}
+
+static int failed_status;
+
+static void failure_end_rq(struct device_request *request)
+{
+	failed_status = request->status;
+	g_atomic_int_inc(&nr_completed);
+}
+
+static uint64_t reported_wp(struct zone_meta *meta, uint64_t zone_num)
+{
+	struct zbd_zone *zone = &meta->zones[zone_num];
+	struct zbd_zone *reported = NULL;
+	unsigned int nr_reported = 0;
+	uint64_t wp;
+
+	TEST_ASSERT_EQUAL_INT(0, zbd_list_zones(meta->read.fd,
+						(off_t)zone->start,
+						(off_t)zone->len, ZBD_RO_ALL,
+						&reported, &nr_reported));
+	TEST_ASSERT_EQUAL_UINT(1, nr_reported);
+	wp = reported->wp;
+	free(reported);
+	return wp;
+}
+
+void test_uring_write_failure(void)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct device_request request;
+	size_t page_size, pages_per_segment;
+	char *buffer, *fault;
+	uint64_t wp;
+
+	meta->is_uring = 1;
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, ZBD_FILE_NAME,
+						 O_CREAT | O_RDWR));
+	TEST_ASSERT_NOT_NULL(meta->uring);
+	page_size = device_get_page_size(dev);
+	pages_per_segment = device_get_pages_per_segment(dev);
+
+	/**< the aligned buffer is submitted directly, so the kernel faults */
+	buffer = (char *)mmap(NULL, page_size, PROT_READ | PROT_WRITE,
+			      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	fault = (char *)mmap(NULL, page_size, PROT_NONE,
+			     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	TEST_ASSERT_TRUE(buffer != MAP_FAILED && fault != MAP_FAILED);
+	memset(buffer, 0, page_size);
+
+	memset(&request, 0, sizeof(struct device_request));
+	request.paddr.lpn = (uint32_t)pages_per_segment;
+	request.flag = DEVICE_WRITE;
+	request.data = buffer;
+	request.data_len = page_size;
+	TEST_ASSERT_EQUAL_INT(page_size, dev->d_op->write(dev, &request));
+
+	/**< the failure of the asynchronous write is passed to the end_rq */
+	g_atomic_int_set(&nr_completed, 0);
+	failed_status = 0;
+	request.paddr.lpn = (uint32_t)pages_per_segment + 1;
+	request.data = fault;
+	request.end_rq = failure_end_rq;
+	TEST_ASSERT_EQUAL_INT(page_size, dev->d_op->write(dev, &request));
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->flush(dev));
+	TEST_ASSERT_EQUAL_INT(1, g_atomic_int_get(&nr_completed));
+	TEST_ASSERT_TRUE(failed_status < 0);
+	TEST_ASSERT_EQUAL_INT(1, g_atomic_int_get(&meta->states[1].is_stale));
+
+	/**< the next write follows the device's write pointer */
+	wp = reported_wp(meta, 1);
+	request.paddr.lpn = (uint32_t)(wp / page_size);
+	request.data = buffer;
+	request.end_rq = NULL;
+	memcpy(buffer, &request.paddr.lpn, sizeof(uint32_t));
+	TEST_ASSERT_EQUAL_INT(page_size, dev->d_op->write(dev, &request));
+	TEST_ASSERT_EQUAL_INT(0, g_atomic_int_get(&meta->states[1].is_stale));
+	TEST_ASSERT_EQUAL_UINT64(wp + page_size, meta->zones[1].wp);
+	TEST_ASSERT_EQUAL_UINT64(reported_wp(meta, 1), meta->zones[1].wp);
+
+	memset(buffer, 0, page_size);
+	request.flag = DEVICE_READ;
+	TEST_ASSERT_EQUAL_INT(page_size, dev->d_op->read(dev, &request));
+	TEST_ASSERT_EQUAL_UINT32(wp / page_size, *(uint32_t *)buffer);
+
+	/**< the synchronous write returns the failure */
+	request.paddr.lpn = (uint32_t)(meta->zones[1].wp / page_size);
+	request.flag = DEVICE_WRITE;
+	request.data = fault;
+	TEST_ASSERT_TRUE(dev->d_op->write(dev, &request) < 0);
+	TEST_ASSERT_EQUAL_INT(1, g_atomic_int_get(&meta->states[1].is_stale));
+
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->close(dev));
+	munmap(fault, page_size);
+	munmap(buffer, page_size);
+}
+
+static void append_request(struct device_request *request, size_t zone_num,
+			   unsigned int flag, char *buffer)
+{
+	size_t pages_per_segment = device_get_pages_per_segment(dev);
+
+	memset(request, 0, sizeof(struct device_request));
+	request->paddr.lpn = (uint32_t)(zone_num * pages_per_segment);
+	request->data_len = device_get_page_size(dev);
+	request->flag = flag;
+	request->data = buffer;
+}
+
+void test_append(void)
+{
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct device_request request;
+	char *buffer;
+	size_t page_size, nr_pages, max_open, i;
+	uint32_t value;
+
+	meta->is_append = 1;
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, ZBD_FILE_NAME,
+						 O_CREAT | O_RDWR));
+	TEST_ASSERT_EQUAL_INT(1, dev->info.is_append);
+	page_size = device_get_page_size(dev);
+	nr_pages = device_get_pages_per_segment(dev);
+	buffer = (char *)malloc(page_size);
+	TEST_ASSERT_NOT_NULL(buffer);
+	memset(buffer, 0, page_size);
+
+	/**< the device ignores the page and returns the placement */
+	for (i = 0; i < nr_pages; i++) {
+		value = (uint32_t)i;
+		memcpy(buffer, &value, sizeof(uint32_t));
+		append_request(&request, 1, DEVICE_WRITE, buffer);
+		TEST_ASSERT_EQUAL_INT(page_size, dev->d_op->write(dev, &request));
+		TEST_ASSERT_EQUAL_UINT32(nr_pages + i, request.paddr.lpn);
+	}
+	append_request(&request, 1, DEVICE_WRITE, buffer);
+	TEST_ASSERT_EQUAL_INT(-ENOSPC, dev->d_op->write(dev, &request));
+
+	for (i = 0; i < nr_pages; i++) {
+		append_request(&request, 1, DEVICE_READ, buffer);
+		request.paddr.lpn += (uint32_t)i;
+		TEST_ASSERT_EQUAL_INT(page_size, dev->d_op->read(dev, &request));
+		TEST_ASSERT_EQUAL_UINT32(i, *(uint32_t *)buffer);
+	}
+
+	/**< the full zone is closed, and the reset zone is closed too */
+	max_open = dev->info.max_open_segments;
+	TEST_ASSERT_EQUAL_INT(0, g_atomic_int_get(&meta->nr_open_zones));
+	if (max_open > 0 && max_open + 3 <= meta->nr_zones) {
+		for (i = 0; i < max_open; i++) {
+			append_request(&request, i + 2, DEVICE_WRITE, buffer);
+			TEST_ASSERT_EQUAL_INT(page_size,
+					      dev->d_op->write(dev, &request));
+		}
+		append_request(&request, max_open + 2, DEVICE_WRITE, buffer);
+		TEST_ASSERT_EQUAL_INT(-EBUSY, dev->d_op->write(dev, &request));
+
+		append_request(&request, 2, DEVICE_ERASE, NULL);
+		request.paddr.format.block = 2;
+		TEST_ASSERT_EQUAL_INT(0, dev->d_op->erase(dev, &request));
+		append_request(&request, max_open + 2, DEVICE_WRITE, buffer);
+		TEST_ASSERT_EQUAL_INT(page_size,
+				      dev->d_op->write(dev, &request));
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->close(dev));
+	free(buffer);
+}
+
+#ifdef ZONE_USE_EMULATION
+static void emu_request(struct device_request *request, uint32_t lpn,
+			unsigned int flag, char *buffer)
+{
+	memset(request, 0, sizeof(struct device_request));
+	request->paddr.lpn = lpn;
+	request->data_len = device_get_page_size(dev);
+	request->flag = flag;
+	request->data = buffer;
+}
+
+void test_emulation(void)
+{
+	struct zone_emu_config *config = zone_emu_get_config();
+	struct zone_emu_config backup = *config;
+	struct zone_meta *meta = (struct zone_meta *)dev->d_private;
+	struct device_request request;
+	struct zbd_zone *zones;
+	unsigned int nr_zones;
+	char *buffer;
+	size_t page_size, nr_pages, pages_per_segment, i;
+	uint64_t zone_size;
+
+	/**< only the half of each zone is writable, and 2 zones can be open */
+	config->zone_capacity = config->zone_size / 2;
+	config->max_open_zones = 2;
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, ZBD_FILE_NAME,
+						 O_CREAT | O_RDWR));
+	TEST_ASSERT_EQUAL_UINT64(config->zone_capacity,
+				 meta->zones[0].capacity);
+	TEST_ASSERT_EQUAL_INT(2, dev->info.max_open_segments);
+	page_size = device_get_page_size(dev);
+	pages_per_segment = device_get_pages_per_segment(dev);
+	zone_size = meta->zone_size;
+	nr_pages = config->zone_capacity / page_size;
+	buffer = (char *)device_alloc_buffer(page_size);
+	TEST_ASSERT_NOT_NULL(buffer);
+	memset(buffer, 0, page_size);
+
+	/**< the zone becomes full at its capacity */
+	for (i = 0; i < nr_pages; i++) {
+		memcpy(buffer, &i, sizeof(size_t));
+		emu_request(&request, (uint32_t)i, DEVICE_WRITE, buffer);
+		TEST_ASSERT_EQUAL_INT(page_size,
+				      dev->d_op->write(dev, &request));
+	}
+	emu_request(&request, (uint32_t)nr_pages, DEVICE_WRITE, buffer);
+	TEST_ASSERT_EQUAL_INT(meta->is_append ? -ENOSPC : -EINVAL,
+			      dev->d_op->write(dev, &request));
+	TEST_ASSERT_EQUAL_INT(0, g_atomic_int_get(&meta->nr_open_zones));
+
+	/**< the device rejects the write which is not at the write pointer */
+	TEST_ASSERT_EQUAL_INT(-1, zone_emu_pwrite(meta->write.fd, buffer,
+						  page_size,
+						  (off_t)(zone_size + page_size)));
+	TEST_ASSERT_EQUAL_INT(EIO, errno);
+
+	/**< the device limits the open zones, and the finish closes the zone */
+	for (i = 1; i <= 2; i++) {
+		emu_request(&request, (uint32_t)(i * pages_per_segment),
+			    DEVICE_WRITE, buffer);
+		TEST_ASSERT_EQUAL_INT(page_size,
+				      dev->d_op->write(dev, &request));
+	}
+	TEST_ASSERT_EQUAL_INT(-1, zone_emu_pwrite(meta->write.fd, buffer,
+						  page_size,
+						  (off_t)(zone_size * 3)));
+	TEST_ASSERT_EQUAL_INT(ETOOMANYREFS, errno);
+	TEST_ASSERT_EQUAL_INT(0, zbd_finish_zones(meta->write.fd,
+						  (off_t)zone_size,
+						  (off_t)zone_size));
+	TEST_ASSERT_EQUAL_INT(page_size,
+			      zone_emu_pwrite(meta->write.fd, buffer, page_size,
+					      (off_t)(zone_size * 3)));
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->close(dev));
+
+	/**< the zones' states and data survive the reopen */
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->open(dev, ZBD_FILE_NAME, O_RDWR));
+	TEST_ASSERT_EQUAL_UINT64(zone_size, meta->zones[0].wp);
+	TEST_ASSERT_EQUAL_UINT64(zone_size * 2, meta->zones[1].wp);
+	TEST_ASSERT_EQUAL_UINT64(zone_size * 2 + page_size, meta->zones[2].wp);
+	TEST_ASSERT_EQUAL_UINT64(zone_size * 3 + page_size, meta->zones[3].wp);
+	TEST_ASSERT_EQUAL_INT(2, g_atomic_int_get(&meta->nr_open_zones));
+	for (i = 0; i < nr_pages; i++) {
+		emu_request(&request, (uint32_t)i, DEVICE_READ, buffer);
+		TEST_ASSERT_EQUAL_INT(page_size, dev->d_op->read(dev, &request));
+		TEST_ASSERT_EQUAL_UINT64(i, *(size_t *)buffer);
+	}
+
+	/**< the reset makes the zone empty */
+	emu_request(&request, 0, DEVICE_ERASE, NULL);
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->erase(dev, &request));
+	TEST_ASSERT_EQUAL_INT(0, zbd_list_zones(meta->read.fd, 0,
+						(off_t)zone_size, ZBD_RO_ALL,
+						&zones, &nr_zones));
+	TEST_ASSERT_EQUAL_INT(1, nr_zones);
+	TEST_ASSERT_EQUAL_INT(ZBD_ZONE_COND_EMPTY, zbd_zone_cond(&zones[0]));
+	TEST_ASSERT_EQUAL_UINT64(0, zones[0].wp);
+	free(zones);
+
+	TEST_ASSERT_EQUAL_INT(0, dev->d_op->close(dev));
+	*config = backup;
+	free(buffer);
+	unlink(ZBD_FILE_NAME);
+}
+#endif
+
 int main(void)
 {
 	UNITY_BEGIN();
@@ -290,5 +634,11 @@ int main(void)
 	RUN_TEST(test_overwrite);
 	RUN_TEST(test_erase);
 	RUN_TEST(test_end_rq_works);
+	RUN_TEST(test_uring);
+	RUN_TEST(test_uring_write_failure);
+	RUN_TEST(test_append);
+#ifdef ZONE_USE_EMULATION
+	RUN_TEST(test_emulation);
+#endif
 	return UNITY_END();
 }
@@ -0,0 +1,214 @@
+/**
+ * @file trace-report.c
+ * @brief per-stage latency breakdown of the dumped tracepoints
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ * @note
+ * usage: trace-report.out <dumped file>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "trace.h"
+#include "hist.h"
+
+enum {
+	OP_WRITE = 0,
+	OP_READ,
+	NR_OPS,
+};
+
+static const char *op_str[NR_OPS] = { "write", "read" };
+
+/**
+ * @brief latency of each stage and the whole page request
+ */
+struct breakdown {
+	struct hist stages[NR_OPS][TRACE_NR_POINTS];
+	struct hist total[NR_OPS];
+};
+
+/**
+ * @brief state of the thread's page request which is being parsed
+ */
+struct parse_state {
+	uint32_t tid;
+	int op; /**< -1 means that the request isn't started */
+	uint64_t begin;
+	uint64_t prev;
+};
+
+static int read_events(FILE *fp, struct trace_event **__events,
+			size_t *__nr_events)
+{
+	struct trace_event *events = NULL, *ptr;
+	size_t nr_events = 0, capacity = 0;
+	struct trace_event event;
+
+	while (fread(&event, sizeof(event), 1, fp) == 1) {
+		if (nr_events == capacity) {
+			capacity = capacity ? capacity * 2 : 4096;
+			ptr = (struct trace_event *)realloc(
+				events, capacity * sizeof(struct trace_event));
+			if (ptr == NULL) {
+				free(events);
+				return -1;
+			}
+			events = ptr;
+		}
+		events[nr_events++] = event;
+	}
+	*__events = events;
+	*__nr_events = nr_events;
+	return 0;
+}
+
+/**
+ * @brief accumulate the stages' latencies
+ *
+ * @note
+ * Each thread's events are dumped together and ordered by the time. The
+ * events before the thread's first begin point are dropped because the ring
+ * may overwrite the beginning of the request.
+ */
+static void parse_events(struct breakdown *bd,
+			  const struct trace_event *events, size_t nr_events)
+{
+	struct parse_state state = { UINT32_MAX, -1, 0, 0 };
+	size_t idx;
+
+	for (idx = 0; idx < nr_events; idx++) {
+		const struct trace_event *event = &events[idx];
+		int point = event->point;
+
+		if (event->tid != state.tid) {
+			state.tid = event->tid;
+			state.op = -1;
+		}
+		if (point >= TRACE_NR_POINTS) {
+			continue;
+		}
+		if (point == TRACE_POINT_WRITE_BEGIN ||
+		    point == TRACE_POINT_READ_BEGIN) {
+			state.op = point == TRACE_POINT_WRITE_BEGIN ? OP_WRITE :
+								       OP_READ;
+			state.begin = event->timestamp;
+			state.prev = event->timestamp;
+			continue;
+		}
+		if (state.op < 0 || event->timestamp < state.prev) {
+			continue;
+		}
+		hist_record(&bd->stages[state.op][point],
+			    event->timestamp - state.prev);
+		state.prev = event->timestamp;
+		if (point == TRACE_POINT_END) {
+			hist_record(&bd->total[state.op],
+				    event->timestamp - state.begin);
+			state.op = -1;
+		}
+	}
+}
+
+static void print_breakdown(struct breakdown *bd)
+{
+	int op, point;
+
+	for (op = 0; op < NR_OPS; op++) {
+		struct hist *total = &bd->total[op];
+		if (total->total == 0) {
+			continue;
+		}
+		printf("[%s breakdown] %" PRIu64 " pages\n", op_str[op],
+		       total->total);
+		printf("%-12s%-10s%-12s%-12s%-12s%-12s%-10s\n", "stage",
+		       "count", "avg(us)", "p50(us)", "p99(us)", "max(us)",
+		       "share(%)");
+		printf("=====\n");
+		for (point = 0; point <= TRACE_NR_POINTS; point++) {
+			struct hist *stage = point < TRACE_NR_POINTS ?
+						     &bd->stages[op][point] :
+						     total;
+			if (stage->total == 0) {
+				continue;
+			}
+			printf("%-12s%-10" PRIu64
+			       "%-12.3lf%-12.3lf%-12.3lf%-12.3lf%-10.2lf\n",
+			       point < TRACE_NR_POINTS ? trace_point_str[point] :
+							 "total",
+			       stage->total, hist_mean(stage) / 1000.0,
+			       (double)hist_percentile(stage, 50.0) / 1000.0,
+			       (double)hist_percentile(stage, 99.0) / 1000.0,
+			       (double)stage->max / 1000.0,
+			       (double)stage->sum * 100.0 /
+				       (double)(total->sum ? total->sum : 1));
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct breakdown *bd;
+	struct trace_event *events;
+	char magic[TRACE_FILE_MAGIC_SIZE];
+	size_t nr_events;
+	int op, point;
+	FILE *fp;
+
+	if (argc != 2) {
+		fprintf(stderr, "%s <dumped file>\n", argv[0]);
+		return 1;
+	}
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "cannot open the file (%s)\n", argv[1]);
+		return 1;
+	}
+	if (fread(magic, 1, TRACE_FILE_MAGIC_SIZE, fp) !=
+		    TRACE_FILE_MAGIC_SIZE ||
+	    memcmp(magic, TRACE_FILE_MAGIC, TRACE_FILE_MAGIC_SIZE)) {
+		fprintf(stderr, "invalid trace file (%s)\n", argv[1]);
+		fclose(fp);
+		return 1;
+	}
+	if (read_events(fp, &events, &nr_events)) {
+		fprintf(stderr, "memory allocation failed\n");
+		fclose(fp);
+		return 1;
+	}
+	fclose(fp);
+
+	bd = (struct breakdown *)malloc(sizeof(struct breakdown));
+	if (bd == NULL) {
+		fprintf(stderr, "memory allocation failed\n");
+		free(events);
+		return 1;
+	}
+	for (op = 0; op < NR_OPS; op++) {
+		for (point = 0; point < TRACE_NR_POINTS; point++) {
+			if (hist_init(&bd->stages[op][point])) {
+				return 1;
+			}
+		}
+		if (hist_init(&bd->total[op])) {
+			return 1;
+		}
+	}
+
+	parse_events(bd, events, nr_events);
+	print_breakdown(bd);
+
+	for (op = 0; op < NR_OPS; op++) {
+		for (point = 0; point < TRACE_NR_POINTS; point++) {
+			hist_free(&bd->stages[op][point]);
+		}
+		hist_free(&bd->total[op]);
+	}
+	free(bd);
+	free(events);
+	return 0;
+}
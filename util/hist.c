@@ -0,0 +1,169 @@
+/**
+ * @file hist.c
+ * @brief implementation of the log-linear histogram
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "log.h"
+#include "hist.h"
+
+/**
+ * @brief initialize the histogram
+ *
+ * @param hist pointer of the histogram
+ *
+ * @return 0 for success, negative value for fail
+ */
+int hist_init(struct hist *hist)
+{
+	if (hist == NULL) {
+		pr_err("null histogram detected\n");
+		return -EINVAL;
+	}
+	hist->counts = (uint64_t *)malloc(sizeof(uint64_t) * HIST_NR_BUCKETS);
+	if (hist->counts == NULL) {
+		pr_err("memory allocation failed\n");
+		return -ENOMEM;
+	}
+	hist_reset(hist);
+	return 0;
+}
+
+/**
+ * @brief clear the recorded values
+ *
+ * @param hist pointer of the histogram
+ */
+void hist_reset(struct hist *hist)
+{
+	memset(hist->counts, 0, sizeof(uint64_t) * HIST_NR_BUCKETS);
+	hist->total = 0;
+	hist->sum = 0;
+	hist->min = UINT64_MAX;
+	hist->max = 0;
+}
+
+/**
+ * @brief add the source histogram's values to the destination histogram
+ *
+ * @param dst histogram which receives the values
+ * @param src histogram which is merged (it can be recorded concurrently)
+ */
+void hist_merge(struct hist *dst, const struct hist *src)
+{
+	size_t idx;
+	uint64_t value;
+
+	for (idx = 0; idx < HIST_NR_BUCKETS; idx++) {
+		value = __atomic_load_n(&src->counts[idx], __ATOMIC_RELAXED);
+		dst->counts[idx] += value;
+		dst->total += value;
+	}
+	dst->sum += __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+
+	value = __atomic_load_n(&src->min, __ATOMIC_RELAXED);
+	dst->min = dst->min < value ? dst->min : value;
+	value = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+	dst->max = dst->max > value ? dst->max : value;
+}
+
+/**
+ * @brief get the values which are recorded between the two snapshots
+ *
+ * @param dst histogram which receives the difference
+ * @param cur later snapshot
+ * @param prev earlier snapshot of the same values
+ *
+ * @note
+ * The snapshots don't know the range of the difference. So, the minimum and
+ * maximum are the representative values of the first and last buckets.
+ */
+void hist_diff(struct hist *dst, const struct hist *cur,
+	       const struct hist *prev)
+{
+	uint64_t count;
+	size_t idx;
+
+	hist_reset(dst);
+	for (idx = 0; idx < HIST_NR_BUCKETS; idx++) {
+		count = cur->counts[idx] - prev->counts[idx];
+		if (count == 0) {
+			continue;
+		}
+		if (dst->total == 0) {
+			dst->min = hist_get_value(idx);
+		}
+		dst->counts[idx] = count;
+		dst->total += count;
+		dst->max = hist_get_value(idx);
+	}
+	dst->sum = cur->sum - prev->sum;
+	dst->min = dst->min > cur->min ? dst->min : cur->min;
+	dst->max = dst->max < cur->max ? dst->max : cur->max;
+}
+
+/**
+ * @brief get the value at the percentile
+ *
+ * @param hist pointer of the histogram
+ * @param percentile percentile (0 ~ 100)
+ *
+ * @return value at the percentile (0 for the empty histogram)
+ *
+ * @note
+ * The value is the middle of the bucket, and it is clamped by the recorded
+ * minimum and maximum. The 100th percentile is the recorded maximum.
+ */
+uint64_t hist_percentile(const struct hist *hist, double percentile)
+{
+	uint64_t total, rank, count;
+	uint64_t value;
+	size_t idx;
+
+	total = 0;
+	for (idx = 0; idx < HIST_NR_BUCKETS; idx++) {
+		total += hist->counts[idx];
+	}
+	if (total == 0) {
+		return 0;
+	}
+	if (percentile >= 100.0) {
+		return hist->max;
+	}
+
+	rank = (uint64_t)((percentile / 100.0) * (double)total + 0.5);
+	rank = rank == 0 ? 1 : rank;
+	rank = rank > total ? total : rank;
+
+	count = 0;
+	for (idx = 0; idx < HIST_NR_BUCKETS; idx++) {
+		count += hist->counts[idx];
+		if (count >= rank) {
+			break;
+		}
+	}
+	value = hist_get_value(idx);
+	value = value < hist->min ? hist->min : value;
+	value = value > hist->max ? hist->max : value;
+	return value;
+}
+
+/**
+ * @brief deallocate the histogram's buckets
+ *
+ * @param hist pointer of the histogram
+ */
+void hist_free(struct hist *hist)
+{
+	if (hist == NULL || hist->counts == NULL) {
+		return;
+	}
+	free(hist->counts);
+	hist->counts = NULL;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file trace.c
+ * @brief ring buffers and dump of the tracepoints
+ * @author Gijun Oh
+ * @version 0.2
+ * @date 2026-10-19
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "log.h"
+#include "trace.h"
+
+const char *trace_point_str[TRACE_NR_POINTS] = {
+	/* [TRACE_POINT_WRITE_BEGIN] = */ "write",
+	/* [TRACE_POINT_READ_BEGIN] = */ "read",
+	/* [TRACE_POINT_GC_LOCK] = */ "gc_lock",
+	/* [TRACE_POINT_GC_PACE] = */ "gc_pace",
+	/* [TRACE_POINT_ALLOC] = */ "alloc",
+	/* [TRACE_POINT_RMW_READ] = */ "rmw_read",
+	/* [TRACE_POINT_MAP_LOOKUP] = */ "map_lookup",
+	/* [TRACE_POINT_PREPARE] = */ "prepare",
+	/* [TRACE_POINT_DEVICE] = */ "device",
+	/* [TRACE_POINT_LOCK] = */ "lock",
+	/* [TRACE_POINT_METADATA] = */ "metadata",
+	/* [TRACE_POINT_END] = */ "end",
+};
+
+#ifdef USE_TRACE
+__thread struct trace_ring *trace_local_ring = NULL;
+static struct trace_ring *trace_rings = NULL; /**< every thread's ring */
+static uint32_t trace_nr_rings = 0;
+
+/**
+ * @brief allocate the running thread's ring buffer
+ *
+ * @return pointer of the ring buffer, NULL for fail
+ *
+ * @note
+ * The ring is pushed to the global list by the compare-and-swap, and it is
+ * never freed because `trace_dump()` can be called after the thread exits.
+ */
+struct trace_ring *trace_ring_alloc(void)
+{
+	struct trace_ring *ring;
+
+	ring = (struct trace_ring *)malloc(sizeof(struct trace_ring));
+	if (ring == NULL) {
+		return NULL;
+	}
+	ring->head = 0;
+	ring->tid = __atomic_fetch_add(&trace_nr_rings, 1, __ATOMIC_RELAXED);
+	ring->next = __atomic_load_n(&trace_rings, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&trace_rings, &ring->next, ring,
+					    true, __ATOMIC_RELEASE,
+					    __ATOMIC_RELAXED)) {
+	}
+	trace_local_ring = ring;
+	return ring;
+}
+
+/**
+ * @brief write every thread's events to the file
+ *
+ * @param path path of the dumped file
+ *
+ * @return 0 for success, negative number for fail
+ *
+ * @note
+ * The file is `TRACE_FILE_MAGIC` followed by the `struct trace_event`s.
+ * Each thread's events are written from the oldest. Dump after the I/Os
+ * are finished; the events which are written during the dump can be torn.
+ */
+int trace_dump(const char *path)
+{
+	struct trace_ring *ring;
+	FILE *fp;
+	int ret = 0;
+
+	fp = fopen(path, "wb");
+	if (fp == NULL) {
+		pr_err("cannot open the trace file (%s)\n", path);
+		return -errno;
+	}
+	if (fwrite(TRACE_FILE_MAGIC, 1, TRACE_FILE_MAGIC_SIZE, fp) !=
+	    TRACE_FILE_MAGIC_SIZE) {
+		ret = -EIO;
+		goto out;
+	}
+	for (ring = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE);
+	     ring != NULL; ring = ring->next) {
+		uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE :
+							   0;
+		uint64_t pos;
+
+		for (pos = first; pos < head; pos++) {
+			if (fwrite(&ring->events[pos & (TRACE_RING_SIZE - 1)],
+				   sizeof(struct trace_event), 1, fp) != 1) {
+				ret = -EIO;
+				goto out;
+			}
+		}
+	}
+out:
+	fclose(fp);
+	return ret;
+}
+#else
+int trace_dump(const char *path)
+{
+	pr_warn("tracepoints are not compiled (path: %s)\n", path);
+	return -ENOTSUP;
+}
+#endif